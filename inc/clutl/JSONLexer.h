@@ -38,6 +38,9 @@ namespace clutl
 
 		JSON_TOKEN_INTEGER,
 		JSON_TOKEN_DECIMAL,
+
+		// Element count at the start of an array, written as #count
+		JSON_TOKEN_LENGTH,
 	};
 
 
@@ -78,6 +81,18 @@ namespace clutl
 
 
 
+	//
+	// Source of JSON text for contexts that stream their input in chunks, rather than
+	// requiring the whole document in memory
+	//
+	struct IJSONStream
+	{
+		// Read up to size bytes into dest, returning how many were read. Returning zero marks
+		// the end of the stream.
+		virtual unsigned int Read(void* dest, unsigned int size) = 0;
+	};
+
+
 	//
 	// The main lexer/parser context, for keeping tracking of errors and providing a level of
 	// text parsing abstraction above the data buffer.
@@ -87,6 +102,14 @@ namespace clutl
 	public:
 		JSONContext(clutl::ReadBuffer& read_buffer);
 
+		// Stream the text from the source in chunks of the given size. Only the text from the start
+		// of the last lexed token is kept, so string tokens remain valid until the next token is
+		// lexed. Counting the elements of an array would keep all of it, so arrays of class elements
+		// must be saved with EMIT_ARRAY_LENGTHS to be streamed.
+		JSONContext(clutl::IJSONStream& stream, unsigned int chunk_size = 64 * 1024);
+
+		~JSONContext();
+
 		// Consume the given amount of characters in the data buffer, assuming
 		// they have been parsed correctly. The original position before the
 		// consume operation is returned.
@@ -101,30 +124,99 @@ namespace clutl
 		// data buffer. Automatically sets the error code as a result.
 		bool ReadOverflows(int size, clutl::JSONError::Code code = clutl::JSONError::UNEXPECTED_END_OF_DATA);
 
-		// How many bytes are left to parse?
+		// Ensure at least the given count of characters is buffered at the read position, streaming
+		// more in if needed. Returns false if the data ends before then.
+		bool Fill(unsigned int size);
+
+		// How many buffered bytes are left to parse?
 		unsigned int Remaining() const;
 
+		// Consume any whitespace at the read position, counting the lines passed. Marks the start of the
+		// next token as it goes, so must only be called between tokens.
+		void SkipWhitespace();
+
+		// Consume characters up to the next quote or backslash, or the end of the data buffer,
+		// returning how many were consumed
+		int ConsumeStringChars();
+
 		// Record the first error only, along with its position
 		void SetError(clutl::JSONError::Code code);
 
 		// Increment the current line for error reporting
 		void IncLine();
 
+		// Mark the read position as the start of the next token
+		void BeginToken();
+
 		void PushState(const clutl::JSONToken& token);
 		void PopState(clutl::JSONToken& token);
 
 		clutl::JSONError GetError() const { return m_Error; }
 
+		// Line of the read position and the position of the newline that starts it, for locating
+		// errors in text that's lexed separately
+		unsigned int GetLine() const { return m_Line; }
+		clcpp::uint64 GetLinePosition() const { return m_LinePosition; }
+
+		// Is the text streamed, and how much memory is it buffered in?
+		bool IsStreamed() const { return m_Stream != 0; }
+		unsigned int GetStreamCapacity() const { return m_StreamCapacity; }
+
 
 	private:
-		// Parsing state
-		clutl::ReadBuffer& m_ReadBuffer;
+		// Disable copying
+		JSONContext(const JSONContext&);
+		JSONContext& operator=(const JSONContext&);
+
+		// Position of the read pointer from the start of the data, which can be longer than any
+		// buffer when streamed
+		clcpp::uint64 Position() const;
+
+		// Read the next chunk from the stream into the buffer, discarding any text that's no longer
+		// needed. Returns false at the end of the data.
+		bool ReadChunk();
+
+		// Bit masks of the characters the lexer scans for, one bit per byte in a 64-byte block
+		struct IndexBlock
+		{
+			clcpp::uint64 quotes;
+			clcpp::uint64 backslashes;
+			clcpp::uint64 whitespace;
+			clcpp::uint64 newlines;
+		};
+
+		enum { INDEX_WINDOW_BLOCKS = 8 };
+
+		// Get the index block covering the given position, indexing the next window of the data
+		// buffer if it's not already covered
+		const IndexBlock& GetIndexBlock(unsigned int position);
+
+		// Parsing state, with positions relative to the start of the data
+		clutl::ReadBuffer* m_ReadBuffer;
 		clutl::JSONError m_Error;
 		unsigned int m_Line;
-		unsigned int m_LinePosition;
+		clcpp::uint64 m_LinePosition;
+
+		// Streamed text is buffered in a window that starts at the stream position, kept from the
+		// start of the last token
+		clutl::IJSONStream* m_Stream;
+		clutl::ReadBuffer m_StreamBuffer;
+		char* m_StreamData;
+		unsigned int m_StreamCapacity;
+		clcpp::uint64 m_StreamPosition;
+		unsigned int m_ChunkSize;
+		clcpp::uint64 m_TokenStart;
+
+		// Structural index of the window of the data buffer currently being lexed, built ahead of
+		// the lexer so that whitespace and string characters can be skipped in bulk
+		unsigned int m_IndexStart;
+		unsigned int m_IndexEnd;
+		IndexBlock m_Index[INDEX_WINDOW_BLOCKS];
 
 		// One-level deep parsing state stack
-		unsigned int m_StackPosition;
+		bool m_StackPushed;
+		clcpp::uint64 m_StackPosition;
+		clcpp::uint64 m_StackTokenStart;
 		clutl::JSONToken m_StackToken;
 	};
 
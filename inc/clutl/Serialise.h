@@ -111,9 +111,86 @@ namespace clutl
         virtual unsigned int MapPtr(const void* ptr) = 0;
     };
 
+    class SerialisePlanCache;
+
+    //
+    // A flat list of instructions for saving objects of a type in versioned binary format, compiled
+    // from its reflection data. The fields of a class, its bases and any classes nested within it
+    // are inlined, so that saving an object doesn't have to inspect its type again. Only containers
+    // and custom save functions are dispatched while saving, with containers using the plans of
+    // their element types.
+    //
+    // Loading is driven by the chunks in the data, so the plan of a class instead keeps a table of
+    // the fields of it and its bases, sorted by name hash, with any custom load functions found up
+    // front.
+    //
+    // JSON serialisation doesn't use plans as its output depends on per-call flags and pointer maps.
+    //
+    class CLCPP_API SerialisePlan
+    {
+    public:
+        SerialisePlan(const clcpp::Type* type, unsigned int transient_flags);
+
+        // Save an object of the plan's type, getting the plans of any container elements from the cache
+        void Save(WriteBuffer& out, const void* object, SerialisePlanCache& plans) const;
+
+        // Load the field chunks of an object of the plan's class type, skipping chunks for fields that
+        // don't exist or are transient
+        void Load(ReadBuffer& in, void* object, unsigned int data_size, SerialisePlanCache& plans) const;
+
+        const clcpp::Type* GetType() const
+        {
+            return m_Type;
+        }
+        unsigned int GetTransientFlags() const
+        {
+            return m_TransientFlags;
+        }
+
+    private:
+        // Disable copying
+        SerialisePlan(const SerialisePlan&);
+        SerialisePlan& operator=(const SerialisePlan&);
+
+        const clcpp::Type* m_Type;
+        unsigned int m_TransientFlags;
+        WriteBuffer m_Ops;
+        WriteBuffer m_Fields;
+    };
+
+    //
+    // Plans compiled on demand for each type and set of transient flags. Plans point into the
+    // database their types come from so the cache must be cleared if that database is unloaded.
+    //
+    class CLCPP_API SerialisePlanCache
+    {
+    public:
+        SerialisePlanCache() = default;
+        ~SerialisePlanCache();
+
+        const SerialisePlan* Get(const clcpp::Type* type, unsigned int transient_flags);
+
+        void Clear();
+
+    private:
+        // Disable copying
+        SerialisePlanCache(const SerialisePlanCache&);
+        SerialisePlanCache& operator=(const SerialisePlanCache&);
+
+        unsigned int Index(const clcpp::Type* type, unsigned int transient_flags) const;
+        void Grow();
+
+        SerialisePlan** m_Plans = nullptr;
+        unsigned int m_Capacity = 0;
+        unsigned int m_Size = 0;
+    };
+
     // Binary serialisation
+    // Saving and loading compile plans for the types they encounter, which can be reused between calls by passing a cache
     CLCPP_API void SaveVersionedBinary(WriteBuffer& out, const void* object, const clcpp::Type* type);
+    CLCPP_API void SaveVersionedBinary(WriteBuffer& out, const void* object, const clcpp::Type* type, SerialisePlanCache& plans);
     CLCPP_API void LoadVersionedBinary(ReadBuffer& in, void* object, const clcpp::Type* type);
+    CLCPP_API void LoadVersionedBinary(ReadBuffer& in, void* object, const clcpp::Type* type, SerialisePlanCache& plans);
 
     struct CLCPP_API JSONError
     {
@@ -127,17 +204,20 @@ namespace clutl
             INVALID_KEYWORD,
             INVALID_ESCAPE_SEQUENCE,
             UNEXPECTED_TOKEN,
+
+            // Streamed arrays of class elements must be saved with EMIT_ARRAY_LENGTHS
+            MISSING_ARRAY_LENGTH,
         };
 
         Code code = NONE;
 
-        // Position in the data buffer where the error occurred
-        unsigned int position = 0;
+        // Position in the data where the error occurred, which can be beyond 4GB in streamed text
+        clcpp::uint64 position = 0;
 
         // An attempt to specify the exact line/column where the error occurred
         // Assuming the data buffer is reasonably formatted
         unsigned int line = 0;
-        unsigned int column = 0;
+        clcpp::uint64 column = 0;
     };
 
     struct JSONFlags
@@ -162,13 +242,80 @@ namespace clutl
             // Note that use of this flag will slow serialisation as the inner loop will have to do loop quadratically
             // over the field array.
             SORT_CLASS_FIELDS_BY_OFFSET = 0x80,
+
+            // Arrays of values are saved with their element count leading as "[#count, ...]" so that they can be
+            // loaded in a single pass, without having to count the elements before allocating the container.
+            // Loading reports counts that don't match the elements as errors. This is not compliant with the JSON
+            // standard.
+            EMIT_ARRAY_LENGTHS = 0x100,
         };
     };
 
     // JSON serialisation
     CLCPP_API JSONError LoadJSON(ReadBuffer& in, void* object, const clcpp::Type* type, unsigned int transient_flags);
+    CLCPP_API JSONError LoadJSON(JSONContext& ctx, void* object, const clcpp::Type* type, unsigned int transient_flags);
     CLCPP_API JSONError LoadJSON(JSONContext& ctx, void* object, const clcpp::Field* field, unsigned int transient_flags);
 
+    //
+    // Loads individual fields from JSON text without loading the objects they're saved in. Fields are
+    // given as paths of field names separated by '.', resolved from the root class through its fields
+    // and those of its bases. Only the objects on the way to the fields are parsed; all other values are
+    // lexed and skipped by matching brackets. Malformed tokens within them are reported as errors, but the
+    // order of the tokens between brackets isn't checked. Parsing stops as soon as all the fields have been
+    // loaded.
+    //
+    class CLCPP_API JSONQuery
+    {
+    public:
+        JSONQuery(const clcpp::Type* type, unsigned int transient_flags);
+
+        // Add a field to load into dest, which must point to an object of the field's type. Returns false
+        // if the path doesn't lead through nested classes to a non-transient field, or has been added.
+        bool AddField(const char* path, void* dest);
+
+        JSONError Run(ReadBuffer& in);
+        JSONError Run(JSONContext& ctx);
+
+        // How many of the fields were found by the last run
+        unsigned int GetNbFound() const
+        {
+            return m_NbFound;
+        }
+
+    private:
+        // Disable copying
+        JSONQuery(const JSONQuery&);
+        JSONQuery& operator=(const JSONQuery&);
+
+        const clcpp::Type* m_Type;
+        unsigned int m_TransientFlags;
+
+        // Tree of the field paths, with the root class first
+        WriteBuffer m_Nodes;
+        unsigned int m_NbFields = 0;
+        unsigned int m_NbFound = 0;
+    };
+
+    //
+    // Runs jobs on the application's threads, as the runtime has none of its own
+    //
+    struct IParallelFor
+    {
+        // Call job(data, index) for each index from zero up to count, returning once all calls have completed
+        virtual void Run(void (*job)(void* data, unsigned int index), void* data, unsigned int count) = 0;
+    };
+
+    //
+    // Loads a JSON array of independent values into a container, parsing its elements in parallel. The
+    // array is split at its top-level element boundaries by matching brackets and stepping over strings,
+    // the container is allocated with the element count and batches of elements are then parsed into it
+    // as separate jobs. Any custom load and post-load functions are called from those jobs so must be safe
+    // to call concurrently. The first error in the text is returned, as with LoadJSON. Types that aren't
+    // dynamic containers, and text that can't be split, are loaded on the calling thread.
+    //
+    CLCPP_API JSONError LoadJSONArray(ReadBuffer& in, void* object, const clcpp::Type* type, unsigned int transient_flags,
+                                      IParallelFor& parallel);
+
     // Save an object of a given type to the write buffer.
     // If ptr_save is null, no pointers are serialised.
     CLCPP_API void SaveJSON(WriteBuffer& out, const void* object, const clcpp::Type* type, IPtrMap* ptr_map, unsigned int flags,
@@ -11,6 +11,7 @@
 #include "Database.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 
@@ -42,7 +43,82 @@ cldb::u32 cldb::CalculateFunctionUniqueID(const std::vector<Field>& parameters)
 }
 
 
+cldb::NamePool::NamePool()
+	: m_BlockPos(0)
+	, m_BlockRemaining(0)
+{
+}
+
+
+cldb::NamePool::~NamePool()
+{
+	for (size_t i = 0; i < m_Blocks.size(); i++)
+		delete [] m_Blocks[i];
+}
+
+
+const char* cldb::NamePool::Intern(u32 hash, const char* text)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Return any existing copy, leaving collision checks to the caller
+	std::unordered_map<u32, const char*>::const_iterator i = m_Texts.find(hash);
+	if (i != m_Texts.end())
+		return i->second;
+
+	const char* pooled_text = CopyText(text);
+	m_Texts[hash] = pooled_text;
+	return pooled_text;
+}
+
+
+void cldb::NamePool::InternTable(Name* names, size_t nb_names)
+{
+	// One lock for the whole table, rather than one for each name
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (size_t i = 0; i < nb_names; i++)
+	{
+		Name& name = names[i];
+		std::pair<std::unordered_map<u32, const char*>::iterator, bool> result = m_Texts.insert(std::make_pair(name.hash, name.text));
+		if (result.second)
+			result.first->second = CopyText(name.text);
+		assert(strcmp(result.first->second, name.text) == 0 && "Hash collision!");
+		name.text = result.first->second;
+	}
+}
+
+
+const char* cldb::NamePool::CopyText(const char* text)
+{
+	// Start a new block when the current one is full, giving long names a block of their own
+	const size_t BLOCK_SIZE = 64 * 1024;
+	size_t size = strlen(text) + 1;
+	if (size > m_BlockRemaining)
+	{
+		size_t block_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+		m_Blocks.push_back(new char[block_size]);
+		m_BlockPos = m_Blocks.back();
+		m_BlockRemaining = block_size;
+	}
+
+	char* pooled_text = m_BlockPos;
+	memcpy(pooled_text, text, size);
+	m_BlockPos += size;
+	m_BlockRemaining -= size;
+
+	return pooled_text;
+}
+
+
 cldb::Database::Database()
+	: m_NamePool(new NamePool)
+{
+}
+
+
+cldb::Database::Database(const std::shared_ptr<NamePool>& name_pool)
+	: m_NamePool(name_pool)
 {
 }
 
@@ -85,7 +161,7 @@ void cldb::Database::AddContainerInfo(const std::string& container, const std::s
 
 void cldb::Database::AddTypeInheritance(const Name& derived_type, const Name& base_type)
 {
-	std::string text = base_type.text + "<-" + derived_type.text;
+	std::string text = std::string(base_type.text) + "<-" + derived_type.text;
 	TypeInheritance ti;
 	ti.name = GetName(text.c_str()); 
 	ti.derived_type = derived_type;
@@ -113,13 +189,12 @@ const cldb::Name& cldb::Database::GetName(const char* text)
 	if (i != m_Names.end())
 	{
 		// Check for collision
-		assert(i->second.text == text && "Hash collision!");
+		assert(strcmp(i->second.text, text) == 0 && "Hash collision!");
 		return i->second;
 	}
 
 	// Add to the database
-	i = m_Names.insert(NameMap::value_type(hash, Name(hash, text))).first;
-	return i->second;
+	return AddName(hash, text);
 }
 
 
@@ -134,3 +209,12 @@ const cldb::Name& cldb::Database::GetName(u32 hash) const
 	}
 	return i->second;
 }
+
+
+const cldb::Name& cldb::Database::AddName(u32 hash, const char* text)
+{
+	// Names may already have been pooled by another database sharing the pool
+	const char* pooled_text = m_NamePool->Intern(hash, text);
+	assert(strcmp(pooled_text, text) == 0 && "Hash collision!");
+	return m_Names[hash] = Name(hash, pooled_text);
+}
@@ -16,9 +16,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <cassert>
 #include <clcpp/clcpp.h>
 
+
 namespace cldb
 {
 	//
@@ -39,16 +46,17 @@ namespace cldb
 	//
 	// A descriptive text name with a unique 32-bit hash value for mapping primitives.
 	//
-	// Note this new representation requires string copying whenever the name is
-	// copied.
+	// The text is interned in the name pool of the database that created the name so
+	// copying a name is as cheap as copying a pointer. The text remains valid for as
+	// long as any database sharing that pool is alive.
 	//
 	struct Name
 	{
 		// No-name default constructor
-		Name() : hash(0) { }
+		Name() : hash(0), text("") { }
 
-		// Initialise with hash and string representation
-		Name(u32 h, const std::string& t) : hash(h), text(t) { }
+		// Initialise with hash and interned string representation
+		Name(u32 h, const char* t) : hash(h), text(t) { }
 
 		// Fast name comparisons using the hash, assuming there are no collisions
 		bool operator == (const Name& rhs) const
@@ -61,11 +69,47 @@ namespace cldb
 		}
 
 		u32 hash;
-		std::string text;
+		const char* text;
 	};
 	typedef std::map<u32, Name> NameMap;
 
 
+	//
+	// Immutable storage for the text of all names, allocated in large blocks that are only
+	// released when the pool is destroyed. A pool can be shared between databases that
+	// exchange primitives, such as the inputs and output of a merge, and is safe to add
+	// to from multiple threads.
+	//
+	class NamePool
+	{
+	public:
+		NamePool();
+		~NamePool();
+
+		// Returns the pooled copy of the text for a hash, adding it if it's not already present
+		const char* Intern(u32 hash, const char* text);
+
+		// Pools a table of names, replacing each text pointer with the pooled one. The text of new names
+		// is copied into the pool, never referenced where it was read from, so that the files databases
+		// are read from can be rewritten once they're loaded.
+		void InternTable(Name* names, size_t nb_names);
+
+	private:
+		NamePool(const NamePool&);
+		NamePool& operator = (const NamePool&);
+
+		const char* CopyText(const char* text);
+
+		std::mutex m_Mutex;
+		std::unordered_map<u32, const char*> m_Texts;
+
+		// Blocks of text storage with the remaining space in the most recent
+		std::vector<char*> m_Blocks;
+		char* m_BlockPos;
+		size_t m_BlockRemaining;
+	};
+
+
 	//
 	// Rather than create a new Type for "X" vs "const X", bloating the database,
 	// this stores the qualifier separately. Additionally, the concept of whether
@@ -148,6 +192,13 @@ namespace cldb
 				parent == rhs.parent;
 		}
 
+		// Hash of everything that Equals compares, so that equal primitives can be found without
+		// comparing against every primitive of the same name
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(clcpp::internal::MixHashes(kind, name.hash), parent.hash);
+		}
+
 		Kind kind;
 		Name name;
 
@@ -197,6 +248,10 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && value == rhs.value;
 		}
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), value);
+		}
 		int value;
 	};
 	struct FloatAttribute : public Attribute
@@ -208,6 +263,12 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && value == rhs.value;
 		}
+		u32 ContentHash() const
+		{
+			// Positive and negative zero compare equal so must hash the same
+			float hashed_value = value == 0 ? 0 : value;
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), clcpp::internal::HashData(&hashed_value, sizeof(hashed_value)));
+		}
 		float value;
 	};
 	struct PrimitiveAttribute : public Attribute
@@ -219,6 +280,10 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && value == rhs.value;
 		}
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), value.hash);
+		}
 		Name value;
 	};
 	struct TextAttribute : public Attribute
@@ -230,6 +295,10 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && value == rhs.value;
 		}
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), clcpp::internal::HashData(value.data(), (int)value.length()));
+		}
 		std::string value;
 	};
 
@@ -287,6 +356,10 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && value == rhs.value;
 		}
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), value);
+		}
 
 		// Enumeration constants can have values that are signed/unsigned and of arbitrary width in clang.
 		// The standard assures that they're of integral size and is quite vague.
@@ -353,6 +426,13 @@ namespace cldb
 				offset == rhs.offset &&
 				parent_unique_id == rhs.parent_unique_id;
 		}
+		u32 ContentHash() const
+		{
+			u32 hash = clcpp::internal::MixHashes(Primitive::ContentHash(), type.hash);
+			hash = clcpp::internal::MixHashes(hash, qualifier.op << 1 | qualifier.is_const);
+			hash = clcpp::internal::MixHashes(hash, offset);
+			return clcpp::internal::MixHashes(hash, parent_unique_id);
+		}
 
 		bool IsFunctionParameter() const
 		{
@@ -398,6 +478,10 @@ namespace cldb
 		{
 			return Primitive::Equals(rhs) && unique_id == rhs.unique_id;
 		}
+		u32 ContentHash() const
+		{
+			return clcpp::internal::MixHashes(Primitive::ContentHash(), unique_id);
+		}
 
 		// An ID unique to this function among other functions that have the same name
 		// This allows the function to be referenced accurately by any children
@@ -532,16 +616,385 @@ namespace cldb
 	// The default DBMap allow multiple primitives of the same type to be stored and
 	// quickly looked up, allowing symbol overloading.
 	//
+	// Primitives are stored in the order they're added, in blocks that keep references to
+	// them valid as more are added. An open-addressing hash table maps each name hash to
+	// the chain of primitives sharing it, which is what find and equal_range walk. Iterating
+	// the whole map visits primitives in name hash order and then in the order they were
+	// added, as the std::multimap this replaces did, so that the databases written from it
+	// are reproducible.
+	//
+	// Overloaded primitives can also be found by their content with find_equal, which uses
+	// a second index that is kept up to date as primitives are added.
+	//
+	// Const members can be called from multiple threads at once, as databases are read
+	// concurrently when exporting. The key order is only sorted when the map is next
+	// iterated after being added to, under a lock, so that it's built once even when
+	// several threads start iterating together. Adding primitives, and any other non-const
+	// use, needs exclusive access to the map.
+	//
 	template <typename TYPE>
-	struct DBMap : public std::multimap<u32, TYPE>
+	struct DBMap
 	{
-#ifdef __GNUC__
-        typedef typename std::multimap<u32, TYPE>::iterator iterator;
-        typedef typename std::multimap<u32, TYPE>::const_iterator const_iterator;
-#endif  // __GNUC__
+	public:
+		typedef std::pair<u32, TYPE> value_type;
+
+	private:
+		static const u32 INVALID_INDEX = 0xFFFFFFFF;
+
+		// Either walks the whole map in key order or a single chain
+		template <typename MAP_TYPE, typename VALUE_TYPE>
+		class Iterator
+		{
+		public:
+			Iterator()
+				: m_Map(0)
+				, m_Index(INVALID_INDEX)
+				, m_OrderPos(INVALID_INDEX)
+			{
+			}
 
-        typedef std::pair<iterator, iterator> range;
+			Iterator(MAP_TYPE* map, u32 index, u32 order_pos)
+				: m_Map(map)
+				, m_Index(index)
+				, m_OrderPos(order_pos)
+			{
+			}
+
+			// Allow conversion from iterator to const_iterator
+			template <typename OTHER_MAP_TYPE, typename OTHER_VALUE_TYPE>
+			Iterator(const Iterator<OTHER_MAP_TYPE, OTHER_VALUE_TYPE>& other)
+				: m_Map(other.m_Map)
+				, m_Index(other.m_Index)
+				, m_OrderPos(other.m_OrderPos)
+			{
+			}
+
+			VALUE_TYPE& operator * () const
+			{
+				return m_Map->m_Entries[m_Index];
+			}
+			VALUE_TYPE* operator -> () const
+			{
+				return &m_Map->m_Entries[m_Index];
+			}
+
+			Iterator& operator ++ ()
+			{
+				if (m_OrderPos == INVALID_INDEX)
+				{
+					m_Index = m_Map->m_Next[m_Index];
+				}
+				else
+				{
+					m_OrderPos++;
+					m_Index = m_OrderPos < m_Map->m_Order.size() ? m_Map->m_Order[m_OrderPos] : INVALID_INDEX;
+				}
+				return *this;
+			}
+			Iterator operator ++ (int)
+			{
+				Iterator copy = *this;
+				++*this;
+				return copy;
+			}
+
+			// Any iterator that has run off the end equals end()
+			bool operator == (const Iterator& rhs) const
+			{
+				return m_Index == rhs.m_Index;
+			}
+			bool operator != (const Iterator& rhs) const
+			{
+				return m_Index != rhs.m_Index;
+			}
+
+		private:
+			template <typename, typename> friend class Iterator;
+
+			MAP_TYPE* m_Map;
+
+			// Index of the entry pointed to
+			u32 m_Index;
+
+			// Position in the key order when iterating the whole map, INVALID_INDEX when walking a chain
+			u32 m_OrderPos;
+		};
+
+	public:
+		typedef Iterator<DBMap, value_type> iterator;
+		typedef Iterator<const DBMap, const value_type> const_iterator;
+		typedef std::pair<iterator, iterator> range;
 		typedef std::pair<const_iterator, const_iterator> const_range;
+
+		DBMap()
+			: m_NbKeys(0)
+			, m_OrderValid(true)
+		{
+		}
+
+		DBMap(const DBMap& rhs)
+			: m_NbKeys(0)
+			, m_OrderValid(true)
+		{
+			*this = rhs;
+		}
+
+		DBMap(DBMap&& rhs)
+			: m_NbKeys(0)
+			, m_OrderValid(true)
+		{
+			*this = std::move(rhs);
+		}
+
+		DBMap& operator = (const DBMap& rhs)
+		{
+			// Other threads may be iterating the source, so its order is completed first rather
+			// than copying it while it's built
+			rhs.UpdateOrder();
+			m_Entries = rhs.m_Entries;
+			m_Next = rhs.m_Next;
+			m_Slots = rhs.m_Slots;
+			m_NbKeys = rhs.m_NbKeys;
+			m_Order = rhs.m_Order;
+			m_OrderValid.store(true, std::memory_order_relaxed);
+			m_ContentSlots = rhs.m_ContentSlots;
+			return *this;
+		}
+
+		DBMap& operator = (DBMap&& rhs)
+		{
+			m_Entries = std::move(rhs.m_Entries);
+			m_Next = std::move(rhs.m_Next);
+			m_Slots = std::move(rhs.m_Slots);
+			m_NbKeys = rhs.m_NbKeys;
+			m_Order = std::move(rhs.m_Order);
+			m_OrderValid.store(rhs.m_OrderValid.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			m_ContentSlots = std::move(rhs.m_ContentSlots);
+			rhs.clear();
+			return *this;
+		}
+
+		iterator insert(const value_type& value)
+		{
+			u32 index = (u32)m_Entries.size();
+			m_Entries.push_back(value);
+			m_Next.push_back(u32(INVALID_INDEX));
+			m_OrderValid.store(false, std::memory_order_relaxed);
+
+			// Keep the hash table at most half full
+			if ((m_NbKeys + 1) * 2 > m_Slots.size())
+				Rehash(m_Slots.empty() ? 64 : m_Slots.size() * 2);
+
+			// Start a new chain or append to the end of an existing one
+			Slot& slot = m_Slots[FindSlot(value.first)];
+			if (slot.first == INVALID_INDEX)
+			{
+				slot.key = value.first;
+				slot.first = index;
+				m_NbKeys++;
+			}
+			else
+			{
+				m_Next[slot.last] = index;
+			}
+			slot.last = index;
+
+			// Primitives with the same content hash occupy separate slots
+			if ((index + 1) * 2 > m_ContentSlots.size())
+				RehashContent(m_ContentSlots.empty() ? 64 : m_ContentSlots.size() * 2);
+			ContentSlot content_slot;
+			content_slot.hash = value.second.ContentHash();
+			content_slot.index = index;
+			AddContentSlot(content_slot);
+
+			return iterator(this, index, INVALID_INDEX);
+		}
+
+		// Returns the first primitive added with the key
+		iterator find(u32 key)
+		{
+			return iterator(this, FindFirst(key), INVALID_INDEX);
+		}
+		const_iterator find(u32 key) const
+		{
+			return const_iterator(this, FindFirst(key), INVALID_INDEX);
+		}
+
+		range equal_range(u32 key)
+		{
+			return range(find(key), end());
+		}
+		const_range equal_range(u32 key) const
+		{
+			return const_range(find(key), end());
+		}
+
+		// Returns a primitive that Equals the value, or end() if there is none
+		const_iterator find_equal(const TYPE& value) const
+		{
+			if (m_ContentSlots.empty())
+				return end();
+
+			u32 hash = value.ContentHash();
+			size_t mask = m_ContentSlots.size() - 1;
+			for (size_t i = hash & mask; m_ContentSlots[i].index != INVALID_INDEX; i = (i + 1) & mask)
+			{
+				const ContentSlot& slot = m_ContentSlots[i];
+				if (slot.hash == hash && m_Entries[slot.index].second.Equals(value))
+					return const_iterator(this, slot.index, INVALID_INDEX);
+			}
+
+			return end();
+		}
+
+		iterator begin()
+		{
+			UpdateOrder();
+			return iterator(this, m_Order.empty() ? INVALID_INDEX : m_Order[0], 0);
+		}
+		const_iterator begin() const
+		{
+			UpdateOrder();
+			return const_iterator(this, m_Order.empty() ? INVALID_INDEX : m_Order[0], 0);
+		}
+
+		iterator end()
+		{
+			return iterator(this, INVALID_INDEX, INVALID_INDEX);
+		}
+		const_iterator end() const
+		{
+			return const_iterator(this, INVALID_INDEX, INVALID_INDEX);
+		}
+
+		size_t size() const
+		{
+			return m_Entries.size();
+		}
+		bool empty() const
+		{
+			return m_Entries.empty();
+		}
+
+		void clear()
+		{
+			m_Entries.clear();
+			m_Next.clear();
+			m_Slots.clear();
+			m_NbKeys = 0;
+			m_Order.clear();
+			m_OrderValid.store(true, std::memory_order_relaxed);
+			m_ContentSlots.clear();
+		}
+
+	private:
+		struct Slot
+		{
+			Slot() : key(0), first(INVALID_INDEX), last(INVALID_INDEX) { }
+			u32 key;
+			u32 first;
+			u32 last;
+		};
+
+		struct ContentSlot
+		{
+			ContentSlot() : hash(0), index(INVALID_INDEX) { }
+			u32 hash;
+			u32 index;
+		};
+
+		size_t FindSlot(u32 key) const
+		{
+			// Keys are already well-distributed name hashes so linear probing from the low bits is enough
+			size_t mask = m_Slots.size() - 1;
+			size_t i = key & mask;
+			while (m_Slots[i].first != INVALID_INDEX && m_Slots[i].key != key)
+				i = (i + 1) & mask;
+			return i;
+		}
+
+		u32 FindFirst(u32 key) const
+		{
+			return m_Slots.empty() ? INVALID_INDEX : m_Slots[FindSlot(key)].first;
+		}
+
+		void Rehash(size_t nb_slots)
+		{
+			std::vector<Slot> old_slots(nb_slots);
+			m_Slots.swap(old_slots);
+			for (size_t i = 0; i < old_slots.size(); i++)
+			{
+				if (old_slots[i].first != INVALID_INDEX)
+					m_Slots[FindSlot(old_slots[i].key)] = old_slots[i];
+			}
+		}
+
+		void RehashContent(size_t nb_slots)
+		{
+			std::vector<ContentSlot> old_slots(nb_slots);
+			m_ContentSlots.swap(old_slots);
+			for (size_t i = 0; i < old_slots.size(); i++)
+			{
+				if (old_slots[i].index != INVALID_INDEX)
+					AddContentSlot(old_slots[i]);
+			}
+		}
+
+		void AddContentSlot(const ContentSlot& slot)
+		{
+			size_t mask = m_ContentSlots.size() - 1;
+			size_t i = slot.hash & mask;
+			while (m_ContentSlots[i].index != INVALID_INDEX)
+				i = (i + 1) & mask;
+			m_ContentSlots[i] = slot;
+		}
+
+		void UpdateOrder() const
+		{
+			// Only readers that find the order out of date take the lock, with the first to get
+			// it building the order for all of them
+			if (m_OrderValid.load(std::memory_order_acquire))
+				return;
+			std::lock_guard<std::mutex> lock(m_OrderMutex);
+			if (m_OrderValid.load(std::memory_order_relaxed))
+				return;
+
+			// Sort the unique keys and then lay out their chains one after the other
+			std::vector<u32> keys;
+			keys.reserve(m_NbKeys);
+			for (size_t i = 0; i < m_Slots.size(); i++)
+			{
+				if (m_Slots[i].first != INVALID_INDEX)
+					keys.push_back(m_Slots[i].key);
+			}
+			std::sort(keys.begin(), keys.end());
+
+			m_Order.clear();
+			m_Order.reserve(m_Entries.size());
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				for (u32 j = FindFirst(keys[i]); j != INVALID_INDEX; j = m_Next[j])
+					m_Order.push_back(j);
+			}
+			m_OrderValid.store(true, std::memory_order_release);
+		}
+
+		// All entries in the order they were added, with the index of the next entry sharing each key
+		std::deque<value_type> m_Entries;
+		std::vector<u32> m_Next;
+
+		// Open-addressing hash table of chains with a power-of-two size
+		std::vector<Slot> m_Slots;
+		size_t m_NbKeys;
+
+		// Entry indices in key order, built on demand for iterating the whole map and only written
+		// by UpdateOrder while holding the lock
+		mutable std::vector<u32> m_Order;
+		mutable std::atomic<bool> m_OrderValid;
+		mutable std::mutex m_OrderMutex;
+
+		// Open-addressing hash table of the content hashes of all entries, for find_equal
+		std::vector<ContentSlot> m_ContentSlots;
 	};
 
 
@@ -618,8 +1071,13 @@ namespace cldb
 	class Database
 	{
 	public:
+		// Creates a database with its own name pool
 		Database();
 
+		// Creates a database that shares the name pool of another, required for any databases
+		// whose primitives are merged together
+		explicit Database(const std::shared_ptr<NamePool>& name_pool);
+
 		void AddBaseTypePrimitives();
 
 		void AddContainerInfo(const std::string& container, const std::string& read_iterator, const std::string& write_iterator, bool has_key);
@@ -628,6 +1086,9 @@ namespace cldb
 		const Name& GetName(const char* text);
 		const Name& GetName(u32 hash) const;
 
+		// Adds a name whose hash has already been calculated, for use by the serialisers
+		const Name& AddName(u32 hash, const char* text);
+
 		template <typename TYPE> void Add(const Name& name, const TYPE& object)
 		{
 			assert(name != Name() && "Unnamed objects not supported");
@@ -676,6 +1137,9 @@ namespace cldb
 			return const_cast<Database*>(this)->GetDBMap<TYPE>();
 		}
 
+		// Text storage for all names, possibly shared with other databases
+		std::shared_ptr<NamePool> m_NamePool;
+
 		// All unique, scope-qualified names
 		NameMap m_Names;
 
@@ -11,9 +11,13 @@
 #include "DatabaseBinarySerialiser.h"
 #include "Database.h"
 #include "DatabaseMetadata.h"
+#include "MappedFile.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory.h>
 #include <stdio.h>
+#include <thread>
 #include <vector>
 
 
@@ -21,12 +25,29 @@ namespace
 {
 	// 'cldb'
 	const unsigned int FILE_HEADER = 0x62647263;
-	const unsigned int FILE_VERSION = 1;
+	const unsigned int FILE_VERSION = 2;
+
+	// Version 1 stored names without their null terminator. These are still read by copying each name.
+	const unsigned int FILE_VERSION_UNTERMINATED_NAMES = 1;
+
+
+	bool IsReadableVersion(unsigned int version)
+	{
+		return version == FILE_VERSION || version == FILE_VERSION_UNTERMINATED_NAMES;
+	}
 
 
 	// Map from hash to a text attribute, mainly for binary serialisation of a
 	// single translation unit
-	std::map<cldb::u32, std::string> g_TextAttributeMap;
+	typedef std::map<cldb::u32, std::string> TextAttributeMap;
+
+
+	// Everything the field copy functions need to convert between names and their hashes
+	struct CopyContext
+	{
+		const cldb::Database& db;
+		const TextAttributeMap& text_attributes;
+	};
 
 
 	template <typename TYPE>
@@ -44,9 +65,18 @@ namespace
 	}
 
 
+	void WriteName(FILE* fp, const char* text)
+	{
+		// Names are stored with their null terminator so that they can be used in place when the file is mapped
+		int len = strlen(text);
+		Write(fp, len);
+		fwrite(text, len + 1, 1, fp);
+	}
+
+
     // TODO: This files contains lots of size variable using int type, check if we need to change this
 	template <typename TYPE, int SIZE>
-	void CopyInteger(const cldb::Database&, char* dest, const char* source, int)
+	void CopyInteger(const CopyContext&, char* dest, const char* source, int)
 	{
 		// Ensure the assumed size is the same as the machine size
 		int assert_size_is_correct[sizeof(TYPE) == SIZE];
@@ -57,13 +87,13 @@ namespace
 	}
 
 
-	void CopyMemory(const cldb::Database&, char* dest, const char* source, int size)
+	void CopyMemory(const CopyContext&, char* dest, const char* source, int size)
 	{
 		memcpy(dest, source, size);
 	}
 
 
-	void CopyNameToHash(const cldb::Database& db, char* dest, const char* source, int)
+	void CopyNameToHash(const CopyContext&, char* dest, const char* source, int)
 	{
 		// Strip the hash from the name
 		cldb::Name& name = *(cldb::Name*)source;
@@ -71,7 +101,7 @@ namespace
 	}
 
 
-	void CopyStringToHash(const cldb::Database& db, char* dest, const char* source, int)
+	void CopyStringToHash(const CopyContext&, char* dest, const char* source, int)
 	{
 		// Calculate the hash from the string
 		std::string& str = *(std::string*)source;
@@ -79,34 +109,34 @@ namespace
 	}
 
 
-	template <void COPY_FUNC(const cldb::Database&, char*, const char*, int)>
-	void CopyStridedData(const cldb::Database& db, char* dest, const char* source, int nb_entries, int dest_stride, int source_stride, int field_size)
+	template <void COPY_FUNC(const CopyContext&, char*, const char*, int)>
+	void CopyStridedData(const CopyContext& ctx, char* dest, const char* source, int nb_entries, int dest_stride, int source_stride, int field_size)
 	{
 		// The compiler should be able to inline the call the COPY_FUNC for each entry
 		for (int i = 0; i < nb_entries; i++)
 		{
-			COPY_FUNC(db, dest, source, field_size);
+			COPY_FUNC(ctx, dest, source, field_size);
 			dest += dest_stride;
 			source += source_stride;
 		}
 	}
 
 
-	void CopyBasicFields(const cldb::Database& db, char* dest, const char* source, int nb_entries, int dest_stride, int source_stride, int field_size)
+	void CopyBasicFields(const CopyContext& ctx, char* dest, const char* source, int nb_entries, int dest_stride, int source_stride, int field_size)
 	{
 		// Use memcpy as a last resort - try at least to use some big machine-size types
 		switch (field_size)
 		{
-		case (1): CopyStridedData< CopyInteger<bool, 1> >(db, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
-		case (2): CopyStridedData< CopyInteger<short, 2> >(db, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
-		case (4): CopyStridedData< CopyInteger<int, 4> >(db, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
-		default: CopyStridedData< CopyMemory >(db, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
+		case (1): CopyStridedData< CopyInteger<bool, 1> >(ctx, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
+		case (2): CopyStridedData< CopyInteger<short, 2> >(ctx, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
+		case (4): CopyStridedData< CopyInteger<int, 4> >(ctx, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
+		default: CopyStridedData< CopyMemory >(ctx, dest, source, nb_entries, dest_stride, source_stride, field_size); break;
 		}
 	}
 
 
 	template <typename TYPE>
-	void PackTable(const cldb::Database& db, const std::vector<TYPE>& table, const cldb::meta::DatabaseType& type, char* output)
+	void PackTable(const CopyContext& ctx, const std::vector<TYPE>& table, const cldb::meta::DatabaseType& type, char* output)
 	{
 		// Walk up through the inheritance hierarhcy
 		for (const cldb::meta::DatabaseType* cur_type = &type; cur_type; cur_type = cur_type->base_type)
@@ -125,9 +155,9 @@ namespace
 					// Perform strided copies depending on field type - pass information about the root type
 					switch (field.type)
 					{
-					case (cldb::meta::FIELD_TYPE_BASIC): CopyBasicFields(db, dest, source, table.size(), type.packed_size, type.size, field.size); break;
-					case (cldb::meta::FIELD_TYPE_NAME): CopyStridedData<CopyNameToHash>(db, dest, source, table.size(), type.packed_size, type.size, field.size); break;
-					case (cldb::meta::FIELD_TYPE_STRING): CopyStridedData<CopyStringToHash>(db, dest, source, table.size(), type.packed_size, type.size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_BASIC): CopyBasicFields(ctx, dest, source, table.size(), type.packed_size, type.size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_NAME): CopyStridedData<CopyNameToHash>(ctx, dest, source, table.size(), type.packed_size, type.size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_STRING): CopyStridedData<CopyStringToHash>(ctx, dest, source, table.size(), type.packed_size, type.size, field.size); break;
 					default: break;
 					}
 				}
@@ -148,11 +178,11 @@ namespace
 
 
 	template <typename TYPE>
-	void WriteTable(FILE* fp, const cldb::Database& db, const cldb::meta::DatabaseTypes& dbtypes)
+	void WriteTable(FILE* fp, const CopyContext& ctx, const cldb::meta::DatabaseTypes& dbtypes)
 	{
 		// Generate a memory-contiguous table
 		std::vector<TYPE> table;
-		CopyMapToTable(db.GetDBMap<TYPE>(), table);
+		CopyMapToTable(ctx.db.GetDBMap<TYPE>(), table);
 
 		// Record the table size
 		int table_size = table.size();
@@ -166,7 +196,7 @@ namespace
 			char* data = new char[packed_size];
 
 			// Binary pack the table
-			PackTable(db, table, type, data);
+			PackTable(ctx, table, type, data);
 
 			// Write to file and cleanup
 			fwrite(data, packed_size, 1, fp);
@@ -185,28 +215,27 @@ namespace
 		for (cldb::NameMap::const_iterator i = db.m_Names.begin(); i != db.m_Names.end(); ++i)
 		{
 			Write(fp, i->second.hash);
-			Write(fp, i->second.text);
+			WriteName(fp, i->second.text);
 		}
 	}
 
 
-	void WriteTextAttributeTable(FILE* fp, const cldb::Database& db)
+	void WriteTextAttributeTable(FILE* fp, const cldb::Database& db, TextAttributeMap& text_attributes)
 	{
-		// Write the table header
-		int nb_text_attributes = db.m_TextAttributes.size();
-		Write(fp, nb_text_attributes);
-
 		// Populate the hash map
-		g_TextAttributeMap.clear();
 		for (cldb::DBMap<cldb::TextAttribute>::const_iterator i = db.m_TextAttributes.begin(); i != db.m_TextAttributes.end(); ++i)
 		{
 			const std::string& text = i->second.value;
 			cldb::u32 hash = clcpp::internal::HashNameString(text.c_str());
-			g_TextAttributeMap[hash] = text;
+			text_attributes[hash] = text;
 		}
 
+		// Write the table header, with attributes that share the same text only written once
+		int nb_text_attributes = text_attributes.size();
+		Write(fp, nb_text_attributes);
+
 		// Write the hash map
-		for (std::map<cldb::u32, std::string>::const_iterator i = g_TextAttributeMap.begin(); i != g_TextAttributeMap.end(); ++i)
+		for (TextAttributeMap::const_iterator i = text_attributes.begin(); i != text_attributes.end(); ++i)
 		{
 			Write(fp, i->first);
 			Write(fp, i->second);
@@ -218,37 +247,43 @@ namespace
 void cldb::WriteBinaryDatabase(const char* filename, const Database& db)
 {
 	FILE* fp = fopen(filename, "wb");
+	WriteBinaryDatabase(fp, db);
+	fclose(fp);
+}
+
 
+void cldb::WriteBinaryDatabase(FILE* fp, const Database& db)
+{
 	// Write the header
 	Write(fp, FILE_HEADER);
 	Write(fp, FILE_VERSION);
 
 	// Write each table with explicit ordering
 	cldb::meta::DatabaseTypes dbtypes;
+	TextAttributeMap text_attributes;
+	CopyContext ctx = { db, text_attributes };
 	WriteNameTable(fp, db);
-	WriteTextAttributeTable(fp, db);
-	WriteTable<cldb::Type>(fp, db, dbtypes);
-	WriteTable<cldb::EnumConstant>(fp, db, dbtypes);
-	WriteTable<cldb::Enum>(fp, db, dbtypes);
-	WriteTable<cldb::Field>(fp, db, dbtypes);
-	WriteTable<cldb::Function>(fp, db, dbtypes);
-	WriteTable<cldb::Class>(fp, db, dbtypes);
-	WriteTable<cldb::Template>(fp, db, dbtypes);
-	WriteTable<cldb::TemplateType>(fp, db, dbtypes);
-	WriteTable<cldb::Namespace>(fp, db, dbtypes);
+	WriteTextAttributeTable(fp, db, text_attributes);
+	WriteTable<cldb::Type>(fp, ctx, dbtypes);
+	WriteTable<cldb::EnumConstant>(fp, ctx, dbtypes);
+	WriteTable<cldb::Enum>(fp, ctx, dbtypes);
+	WriteTable<cldb::Field>(fp, ctx, dbtypes);
+	WriteTable<cldb::Function>(fp, ctx, dbtypes);
+	WriteTable<cldb::Class>(fp, ctx, dbtypes);
+	WriteTable<cldb::Template>(fp, ctx, dbtypes);
+	WriteTable<cldb::TemplateType>(fp, ctx, dbtypes);
+	WriteTable<cldb::Namespace>(fp, ctx, dbtypes);
 
 	// Write attribute tables with explicit ordering
-	WriteTable<cldb::FlagAttribute>(fp, db, dbtypes);
-	WriteTable<cldb::IntAttribute>(fp, db, dbtypes);
-	WriteTable<cldb::FloatAttribute>(fp, db, dbtypes);
-	WriteTable<cldb::PrimitiveAttribute>(fp, db, dbtypes);
-	WriteTable<cldb::TextAttribute>(fp, db, dbtypes);
+	WriteTable<cldb::FlagAttribute>(fp, ctx, dbtypes);
+	WriteTable<cldb::IntAttribute>(fp, ctx, dbtypes);
+	WriteTable<cldb::FloatAttribute>(fp, ctx, dbtypes);
+	WriteTable<cldb::PrimitiveAttribute>(fp, ctx, dbtypes);
+	WriteTable<cldb::TextAttribute>(fp, ctx, dbtypes);
 
-	WriteTable<cldb::ContainerInfo>(fp, db, dbtypes);
+	WriteTable<cldb::ContainerInfo>(fp, ctx, dbtypes);
 
-	WriteTable<cldb::TypeInheritance>(fp, db, dbtypes);
-
-	fclose(fp);
+	WriteTable<cldb::TypeInheritance>(fp, ctx, dbtypes);
 }
 
 
@@ -265,36 +300,82 @@ namespace
 
 	template <> std::string Read<std::string>(FILE* fp)
 	{
-		char data[1024];
-
-		// Clamp length to the available buffer size
+		// Read the whole string so that long names don't leave the file out of step
 		int len = Read<int>(fp);
-		len = len > sizeof(data) - 1 ? sizeof(data) - 1 : len;
+		std::string str(len > 0 ? len : 0, 0);
+		if (len > 0)
+			fread(&str[0], len, 1, fp);
+		return str;
+	}
+
+
+	//
+	// Bounds-checked reads from a mapped file, returning zero-initialised values and
+	// recording the failure when there isn't enough data left
+	//
+	struct MappedReader
+	{
+		MappedReader(const char* data, size_t size)
+			: pos(data)
+			, end(data + size)
+			, ok(true)
+		{
+		}
+
+		template <typename TYPE> TYPE Read()
+		{
+			TYPE val = TYPE();
+			const char* data = Skip(sizeof(val));
+			if (data != 0)
+				memcpy(&val, data, sizeof(val));
+			return val;
+		}
 
-		fread(data, len, 1, fp);
-		data[len] = 0;
-		return data;
+		const char* Skip(size_t size)
+		{
+			if (!ok || size > (size_t)(end - pos))
+			{
+				ok = false;
+				return 0;
+			}
+			const char* data = pos;
+			pos += size;
+			return data;
+		}
+
+		const char* pos;
+		const char* end;
+		bool ok;
+	};
+
+
+	template <> std::string MappedReader::Read<std::string>()
+	{
+		int len = Read<int>();
+		const char* text = Skip(len > 0 ? len : 0);
+		return text != 0 ? std::string(text, len > 0 ? len : 0) : std::string();
 	}
 
 
-	void CopyHashToName(const cldb::Database& db, char* dest, const char* source, int)
+	void CopyHashToName(const CopyContext& ctx, char* dest, const char* source, int)
 	{
 		// Write the name as looked up by the hash
 		cldb::u32 hash = *(cldb::u32*)source;
-		*(cldb::Name*)dest = db.GetName(hash);
+		*(cldb::Name*)dest = ctx.db.GetName(hash);
 	}
 
 
-	void CopyHashToString(const cldb::Database& db, char* dest, const char* source, int)
+	void CopyHashToString(const CopyContext& ctx, char* dest, const char* source, int)
 	{
-		// Write the name as looked up by the hash
+		// Write the text attribute as looked up by the hash
 		cldb::u32 hash = *(cldb::u32*)source;
-		*(std::string*)dest = g_TextAttributeMap[hash];
+		TextAttributeMap::const_iterator i = ctx.text_attributes.find(hash);
+		*(std::string*)dest = i != ctx.text_attributes.end() ? i->second : std::string();
 	}
 
 
 	template <typename TYPE>
-	void UnpackTable(const cldb::Database& db, std::vector<TYPE>& table, const cldb::meta::DatabaseType& type, const char* input)
+	void UnpackTable(const CopyContext& ctx, std::vector<TYPE>& table, const cldb::meta::DatabaseType& type, const char* input)
 	{
 		// Walk up through the inheritance hierarhcy
 		for (const cldb::meta::DatabaseType* cur_type = &type; cur_type; cur_type = cur_type->base_type)
@@ -313,9 +394,9 @@ namespace
 					// Perform strided copies depending on field type - pass information about the root type
 					switch (field.type)
 					{
-					case (cldb::meta::FIELD_TYPE_BASIC): CopyBasicFields(db, dest, source, table.size(), type.size, type.packed_size, field.size); break;
-					case (cldb::meta::FIELD_TYPE_NAME): CopyStridedData<CopyHashToName>(db, dest, source, table.size(), type.size, type.packed_size, field.size); break;
-					case (cldb::meta::FIELD_TYPE_STRING): CopyStridedData<CopyHashToString>(db, dest, source, table.size(), type.size, type.packed_size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_BASIC): CopyBasicFields(ctx, dest, source, table.size(), type.size, type.packed_size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_NAME): CopyStridedData<CopyHashToName>(ctx, dest, source, table.size(), type.size, type.packed_size, field.size); break;
+					case (cldb::meta::FIELD_TYPE_STRING): CopyStridedData<CopyHashToString>(ctx, dest, source, table.size(), type.size, type.packed_size, field.size); break;
 					default: break;
 					}
 				}
@@ -325,104 +406,266 @@ namespace
 
 
 	template <typename TYPE>
-	void ReadTable(FILE* fp, cldb::Database& db, const cldb::meta::DatabaseTypes& dbtypes)
+	void DecodeTable(const CopyContext& ctx, cldb::Database& db, const cldb::meta::DatabaseTypes& dbtypes, int table_size, const char* data)
 	{
-		// Create a big enough table dest
-		int table_size = Read<int>(fp);
+		// Unpack the binary table
 		std::vector<TYPE> table(table_size);
+		UnpackTable(ctx, table, dbtypes.GetType<TYPE>(), data);
 
-		if (table_size)
+		// Add to the database
+		for (size_t i = 0; i < table.size(); i++)
+			db.Add(table[i].name, table[i]);
+	}
+
+
+	template <typename TYPE>
+	void ReadTable(FILE* fp, const CopyContext& ctx, cldb::Database& db, const cldb::meta::DatabaseTypes& dbtypes)
+	{
+		int table_size = Read<int>(fp);
+
+		if (table_size > 0)
 		{
 			// Allocate enough memory to store the entire table in packed binary format and read it from the file
-			const cldb::meta::DatabaseType& type = dbtypes.GetType<TYPE>();
-			int packed_size = table_size * type.packed_size;
+			int packed_size = table_size * dbtypes.GetType<TYPE>().packed_size;
 			char* data = new char[packed_size];
 			fread(data, packed_size, 1, fp);
 
-			// Unpack the binary table
-			UnpackTable(db, table, type, data);
+			DecodeTable<TYPE>(ctx, db, dbtypes, table_size, data);
 			delete [] data;
-
-			// Add to the database
-			for (size_t i = 0; i < table.size(); i++)
-				db.Add(table[i].name, table[i]);
 		}
 	}
 
 
-	void ReadNameTable(FILE* fp, cldb::Database& db)
+	void ReadNameTable(FILE* fp, cldb::Database& db, unsigned int version)
 	{
 		// Read the table header
 		int nb_names = Read<int>(fp);
 
-		// Read and populate each name
+		// Read and populate each name, skipping its null terminator
 		for (int i = 0; i < nb_names; i++)
 		{
 			cldb::u32 hash = Read<cldb::u32>(fp);
 			std::string str = Read<std::string>(fp);
-			db.m_Names[hash] = cldb::Name(hash, str);
+			if (version != FILE_VERSION_UNTERMINATED_NAMES)
+				fgetc(fp);
+			db.AddName(hash, str.c_str());
 		}
 	}
 
 
-	void ReadTextAttributeTable(FILE* fp, const cldb::Database& db)
+	void ReadTextAttributeTable(FILE* fp, TextAttributeMap& text_attributes)
 	{
 		// Read the table header
 		int nb_text_attributes = Read<int>(fp);
 
 		// Read and populate the hash map
-		g_TextAttributeMap.clear();
 		for (int i = 0; i < nb_text_attributes; i++)
 		{
 			cldb::u32 hash = Read<cldb::u32>(fp);
 			std::string text = Read<std::string>(fp);
-			g_TextAttributeMap[hash] = text;
+			text_attributes[hash] = text;
+		}
+	}
+
+
+	//
+	// The location of a packed table within a mapped file, along with the function that decodes
+	// it into the database. Each table is added to a different store so they can be decoded in
+	// any order once the names and text attributes are known.
+	//
+	struct MappedTable
+	{
+		void (*decode)(const CopyContext&, cldb::Database&, const cldb::meta::DatabaseTypes&, int, const char*);
+		int table_size;
+		const char* data;
+		size_t packed_size;
+
+		bool operator < (const MappedTable& rhs) const
+		{
+			return packed_size > rhs.packed_size;
+		}
+	};
+
+
+	template <typename TYPE>
+	void LocateTable(MappedReader& reader, const cldb::meta::DatabaseTypes& dbtypes, std::vector<MappedTable>& tables)
+	{
+		int table_size = reader.Read<int>();
+		if (table_size > 0)
+		{
+			size_t packed_size = (size_t)table_size * dbtypes.GetType<TYPE>().packed_size;
+			MappedTable table = { DecodeTable<TYPE>, table_size, reader.Skip(packed_size), packed_size };
+			if (table.data != 0)
+				tables.push_back(table);
+		}
+	}
+
+
+	bool ReadUnterminatedNameTable(MappedReader& reader, cldb::Database& db)
+	{
+		// Copy each name into the pool as there's no null terminator to use in place
+		int nb_names = reader.Read<int>();
+		for (int i = 0; i < nb_names && reader.ok; i++)
+		{
+			cldb::u32 hash = reader.Read<cldb::u32>();
+			std::string str = reader.Read<std::string>();
+			if (reader.ok)
+				db.AddName(hash, str.c_str());
+		}
+		return reader.ok;
+	}
+
+
+	bool ReadMappedNameTable(MappedReader& reader, cldb::Database& db)
+	{
+		// Point each name at its null-terminated text within the file until the pool copies it
+		int nb_names = reader.Read<int>();
+		std::vector<cldb::Name> names;
+		names.reserve(nb_names > 0 ? nb_names : 0);
+		for (int i = 0; i < nb_names && reader.ok; i++)
+		{
+			cldb::u32 hash = reader.Read<cldb::u32>();
+			int len = reader.Read<int>();
+			const char* text = reader.Skip(len >= 0 ? len + 1 : 0);
+			if (text == 0 || len < 0 || text[len] != 0)
+				return false;
+			names.push_back(cldb::Name(hash, text));
+		}
+		if (!reader.ok)
+			return false;
+
+		db.m_NamePool->InternTable(names.empty() ? 0 : &names.front(), names.size());
+
+		// Names are written in hash order so each one can be added to the end of the map
+		for (size_t i = 0; i < names.size(); i++)
+			db.m_Names.insert(db.m_Names.end(), cldb::NameMap::value_type(names[i].hash, names[i]));
+
+		return true;
+	}
+
+
+	void ReadMappedTextAttributeTable(MappedReader& reader, TextAttributeMap& text_attributes)
+	{
+		int nb_text_attributes = reader.Read<int>();
+		for (int i = 0; i < nb_text_attributes && reader.ok; i++)
+		{
+			cldb::u32 hash = reader.Read<cldb::u32>();
+			text_attributes[hash] = reader.Read<std::string>();
 		}
 	}
 }
 
 
-bool cldb::ReadBinaryDatabase(const char* filename, Database& db)
+bool cldb::ReadBinaryDatabase(const char* filename, Database& db, unsigned int nb_threads)
 {
-	if (!IsBinaryDatabase(filename))
+	MappedFile file;
+	if (!file.Open(filename))
 	{
 		return false;
 	}
 
-	FILE* fp = fopen(filename, "rb");
+	// Check the header before anything else as this may be a text database
+	MappedReader reader(file.Data(), file.Size());
+	unsigned int header = reader.Read<unsigned int>();
+	unsigned int version = reader.Read<unsigned int>();
+	if (header != FILE_HEADER || !IsReadableVersion(version))
+	{
+		return false;
+	}
+
+	bool names_read = version == FILE_VERSION_UNTERMINATED_NAMES ?
+		ReadUnterminatedNameTable(reader, db) :
+		ReadMappedNameTable(reader, db);
+	if (!names_read)
+	{
+		return false;
+	}
+
+	cldb::meta::DatabaseTypes dbtypes;
+	TextAttributeMap text_attributes;
+	CopyContext ctx = { db, text_attributes };
+	ReadMappedTextAttributeTable(reader, text_attributes);
+
+	// Locate each table with explicit ordering
+	std::vector<MappedTable> tables;
+	LocateTable<cldb::Type>(reader, dbtypes, tables);
+	LocateTable<cldb::EnumConstant>(reader, dbtypes, tables);
+	LocateTable<cldb::Enum>(reader, dbtypes, tables);
+	LocateTable<cldb::Field>(reader, dbtypes, tables);
+	LocateTable<cldb::Function>(reader, dbtypes, tables);
+	LocateTable<cldb::Class>(reader, dbtypes, tables);
+	LocateTable<cldb::Template>(reader, dbtypes, tables);
+	LocateTable<cldb::TemplateType>(reader, dbtypes, tables);
+	LocateTable<cldb::Namespace>(reader, dbtypes, tables);
+	LocateTable<cldb::FlagAttribute>(reader, dbtypes, tables);
+	LocateTable<cldb::IntAttribute>(reader, dbtypes, tables);
+	LocateTable<cldb::FloatAttribute>(reader, dbtypes, tables);
+	LocateTable<cldb::PrimitiveAttribute>(reader, dbtypes, tables);
+	LocateTable<cldb::TextAttribute>(reader, dbtypes, tables);
+	LocateTable<cldb::ContainerInfo>(reader, dbtypes, tables);
+	LocateTable<cldb::TypeInheritance>(reader, dbtypes, tables);
+	if (!reader.ok)
+	{
+		return false;
+	}
 
-	// Discard the header
-	Read<unsigned int>(fp);
-	Read<unsigned int>(fp);
+	// Decode the largest tables first so that the threads finish at roughly the same time
+	std::sort(tables.begin(), tables.end());
+	std::atomic<size_t> next_table(0);
+	auto decode_tables = [&]() {
+		for (size_t i = next_table++; i < tables.size(); i = next_table++)
+			tables[i].decode(ctx, db, dbtypes, tables[i].table_size, tables[i].data);
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < nb_threads && i < tables.size(); i++)
+		threads.push_back(std::thread(decode_tables));
+	decode_tables();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	return true;
+}
+
+
+bool cldb::ReadBinaryDatabase(FILE* fp, Database& db)
+{
+	// Check the header in case this database is embedded in another file
+	unsigned int header = Read<unsigned int>(fp);
+	unsigned int version = Read<unsigned int>(fp);
+	if (header != FILE_HEADER || !IsReadableVersion(version))
+	{
+		return false;
+	}
 
 	// Read each table with explicit ordering
 	cldb::meta::DatabaseTypes dbtypes;
-	ReadNameTable(fp, db);
-	ReadTextAttributeTable(fp, db);
-	ReadTable<cldb::Type>(fp, db, dbtypes);
-	ReadTable<cldb::EnumConstant>(fp, db, dbtypes);
-	ReadTable<cldb::Enum>(fp, db, dbtypes);
-	ReadTable<cldb::Field>(fp, db, dbtypes);
-	ReadTable<cldb::Function>(fp, db, dbtypes);
-	ReadTable<cldb::Class>(fp, db, dbtypes);
-	ReadTable<cldb::Template>(fp, db, dbtypes);
-	ReadTable<cldb::TemplateType>(fp, db, dbtypes);
-	ReadTable<cldb::Namespace>(fp, db, dbtypes);
+	TextAttributeMap text_attributes;
+	CopyContext ctx = { db, text_attributes };
+	ReadNameTable(fp, db, version);
+	ReadTextAttributeTable(fp, text_attributes);
+	ReadTable<cldb::Type>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::EnumConstant>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Enum>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Field>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Function>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Class>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Template>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::TemplateType>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::Namespace>(fp, ctx, db, dbtypes);
 
 	// Read attribute tables with explicit ordering
-	ReadTable<cldb::FlagAttribute>(fp, db, dbtypes);
-	ReadTable<cldb::IntAttribute>(fp, db, dbtypes);
-	ReadTable<cldb::FloatAttribute>(fp, db, dbtypes);
-	ReadTable<cldb::PrimitiveAttribute>(fp, db, dbtypes);
-	ReadTable<cldb::TextAttribute>(fp, db, dbtypes);
+	ReadTable<cldb::FlagAttribute>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::IntAttribute>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::FloatAttribute>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::PrimitiveAttribute>(fp, ctx, db, dbtypes);
+	ReadTable<cldb::TextAttribute>(fp, ctx, db, dbtypes);
 
-	ReadTable<cldb::ContainerInfo>(fp, db, dbtypes);
+	ReadTable<cldb::ContainerInfo>(fp, ctx, db, dbtypes);
 
-	ReadTable<cldb::TypeInheritance>(fp, db, dbtypes);
+	ReadTable<cldb::TypeInheritance>(fp, ctx, db, dbtypes);
 
-	fclose(fp);
-
-	return true;
+	return !ferror(fp) && !feof(fp);
 }
 
 
@@ -436,7 +679,7 @@ bool cldb::IsBinaryDatabase(const char* filename)
 	// Read the header and check it
 	unsigned int header = Read<unsigned int>(fp);
 	unsigned int version = Read<unsigned int>(fp);
-	bool is_binary_db = header == FILE_HEADER && version == FILE_VERSION;
+	bool is_binary_db = header == FILE_HEADER && IsReadableVersion(version);
 
 	fclose(fp);
 	return is_binary_db;
@@ -13,11 +13,21 @@
 #pragma once
 
 
+#include <stdio.h>
+
+
 namespace cldb
 {
 	class Database;
 
 	void WriteBinaryDatabase(const char* filename, const Database& db);
-	bool ReadBinaryDatabase(const char* filename, Database& db);
+
+	// Reads the file in place from a memory mapping, decoding its tables on up to the given number of
+	// threads. Nothing refers to the mapping once this returns, so the file can then be rewritten.
+	bool ReadBinaryDatabase(const char* filename, Database& db, unsigned int nb_threads = 1);
 	bool IsBinaryDatabase(const char* filename);
+
+	// Variants for databases stored at the current position of an already open file
+	void WriteBinaryDatabase(FILE* fp, const Database& db);
+	bool ReadBinaryDatabase(FILE* fp, Database& db);
 }
\ No newline at end of file
@@ -22,6 +22,15 @@ cldb::meta::DatabaseTypes::DatabaseTypes()
 		DatabaseField(&cldb::Primitive::parent),
 	};
 
+	// Attributes are polymorphic, so their primitive fields are offset by the vtable pointer. The
+	// offsets are the same for all attribute types.
+	DatabaseField attribute_primitive_fields[] =
+	{
+		DatabaseField(static_cast<cldb::Primitive::Kind cldb::FlagAttribute::*>(&cldb::Primitive::kind)),
+		DatabaseField(static_cast<cldb::Name cldb::FlagAttribute::*>(&cldb::Primitive::name)),
+		DatabaseField(static_cast<cldb::Name cldb::FlagAttribute::*>(&cldb::Primitive::parent)),
+	};
+
 	DatabaseField type_fields[] =
 	{
 		DatabaseField(&cldb::Type::size),
@@ -109,11 +118,12 @@ cldb::meta::DatabaseTypes::DatabaseTypes()
 	m_NamespaceType.Type<cldb::Namespace>().Base(&m_PrimitiveType);
 
 	// Create descriptions of each attribute type
-	m_FlagAttributeType.Type<cldb::FlagAttribute>().Base(&m_PrimitiveType);
-	m_IntAttributeType.Type<cldb::IntAttribute>().Base(&m_PrimitiveType).Fields(int_attribute_fields);
-	m_FloatAttributeType.Type<cldb::FloatAttribute>().Base(&m_PrimitiveType).Fields(float_attribute_fields);
-	m_PrimitiveAttributeType.Type<cldb::PrimitiveAttribute>().Base(&m_PrimitiveType).Fields(primitive_attribute_fields);
-	m_TextAttributeType.Type<cldb::TextAttribute>().Base(&m_PrimitiveType).Fields(text_attribute_fields);
+	m_AttributePrimitiveType.Type<cldb::FlagAttribute>().Fields(attribute_primitive_fields);
+	m_FlagAttributeType.Type<cldb::FlagAttribute>().Base(&m_AttributePrimitiveType);
+	m_IntAttributeType.Type<cldb::IntAttribute>().Base(&m_AttributePrimitiveType).Fields(int_attribute_fields);
+	m_FloatAttributeType.Type<cldb::FloatAttribute>().Base(&m_AttributePrimitiveType).Fields(float_attribute_fields);
+	m_PrimitiveAttributeType.Type<cldb::PrimitiveAttribute>().Base(&m_AttributePrimitiveType).Fields(primitive_attribute_fields);
+	m_TextAttributeType.Type<cldb::TextAttribute>().Base(&m_AttributePrimitiveType).Fields(text_attribute_fields);
 
 	// Create descriptions of the container type
 	m_ContainerInfoType.Type<cldb::ContainerInfo>().Fields(container_info_fields);
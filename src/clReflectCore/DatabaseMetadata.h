@@ -190,6 +190,7 @@ namespace cldb
 			DatabaseType m_NamespaceType;
 
 			// All attribute type descriptions
+			DatabaseType m_AttributePrimitiveType;
 			DatabaseType m_FlagAttributeType;
 			DatabaseType m_IntAttributeType;
 			DatabaseType m_FloatAttributeType;
@@ -13,10 +13,13 @@
 
 #include "DatabaseTextSerialiser.h"
 #include "Database.h"
-#include "FileUtils.h"
+#include "MappedFile.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 
 namespace
@@ -25,242 +28,314 @@ namespace
 	const int CURRENT_VERSION = 1;
 
 
-	const char* HexStringFromName(cldb::Name name, const cldb::Database& db)
+	//
+	// Formats text into a large buffer that is written to the file in batches. Flush must
+	// be called before the file is closed.
+	//
+	class TextWriter
 	{
-		return itohex(name.hash);
-	}
+	public:
+		TextWriter(FILE* fp)
+			: m_File(fp)
+			, m_Buffer(BUFFER_SIZE)
+			, m_Pos(0)
+		{
+		}
+
+		void Write(const char* text)
+		{
+			Write(text, strlen(text));
+		}
+
+		void Write(const char* text, size_t length)
+		{
+			if (length > BUFFER_SIZE - m_Pos)
+			{
+				Flush();
+
+				// Text that won't fit in the buffer is written directly
+				if (length > BUFFER_SIZE)
+				{
+					fwrite(text, 1, length, m_File);
+					return;
+				}
+			}
+
+			memcpy(&m_Buffer[m_Pos], text, length);
+			m_Pos += length;
+		}
+
+		// Zero-padded to 8 digits
+		void WriteHex(cldb::u32 value)
+		{
+			char text[8];
+			for (int i = 7; i >= 0; i--)
+			{
+				text[i] = "0123456789abcdef"[value & 15];
+				value >>= 4;
+			}
+			Write(text, sizeof(text));
+		}
+
+		void WriteDecimal(cldb::u32 value)
+		{
+			char text[10];
+			char* tptr = text + sizeof(text);
+			do
+			{
+				*--tptr = '0' + value % 10;
+				value /= 10;
+			} while (value);
+			Write(tptr, text + sizeof(text) - tptr);
+		}
 
+		void Flush()
+		{
+			fwrite(&m_Buffer.front(), 1, m_Pos, m_File);
+			m_Pos = 0;
+		}
 
-	void WriteNamedRuler(FILE* fp, const char* text)
+	private:
+		static const size_t BUFFER_SIZE = 1024 * 1024;
+
+		FILE* m_File;
+		std::vector<char> m_Buffer;
+		size_t m_Pos;
+	};
+
+
+	void WriteNamedRuler(TextWriter& out, const char* text)
 	{
 		// Overwrite the '-' character with any text to keep the ruler width consistent
 		char ruler[] = "---- --------------------------------------------------------------------\n";
 		strcpy(ruler + 5, text);
 		ruler[5 + strlen(text)] = ' ';
-		fputs(ruler, fp);
+		out.Write(ruler);
 	}
 
 
-	void WriteRuler(FILE* fp)
+	void WriteRuler(TextWriter& out)
 	{
-		fputs("-------------------------------------------------------------------------\n", fp);
+		out.Write("-------------------------------------------------------------------------\n");
 	}
 
 
-	void WriteTableHeader(FILE* fp, const char* title, const char* headers)
+	void WriteTableHeader(TextWriter& out, const char* title, const char* headers)
 	{
-		WriteNamedRuler(fp, title);
-		fputs(headers, fp);
-		fputs("\n", fp);
-		WriteRuler(fp);
+		WriteNamedRuler(out, title);
+		out.Write(headers);
+		out.Write("\n");
+		WriteRuler(out);
 	}
 
 
-	void WriteTableFooter(FILE* fp)
+	void WriteTableFooter(TextWriter& out)
 	{
-		WriteRuler(fp);
-		fputs("\n\n", fp);
+		WriteRuler(out);
+		out.Write("\n\n");
 	}
 
 
-	void WriteName(FILE* fp, const cldb::Name& name, const cldb::Database& db)
+	void WriteName(TextWriter& out, const cldb::Name& name, const cldb::Database& db)
 	{
-		fputs(itohex(name.hash), fp);
-		fputs("\t", fp);
-		fputs(name.text.c_str(), fp);
+		out.WriteHex(name.hash);
+		out.Write("\t");
+		out.Write(name.text);
 	}
 
 
-	void WritePrimitive(FILE* fp, const cldb::Primitive& primitive, const cldb::Database& db)
+	void WritePrimitive(TextWriter& out, const cldb::Primitive& primitive, const cldb::Database& db)
 	{
-		fputs(HexStringFromName(primitive.name, db), fp);
-		fputs("\t", fp);
-		fputs(HexStringFromName(primitive.parent, db), fp);
+		out.WriteHex(primitive.name.hash);
+		out.Write("\t");
+		out.WriteHex(primitive.parent.hash);
 	}
 
 
-	void WriteType(FILE* fp, const cldb::Type& primitive, const cldb::Database& db)
+	void WriteType(TextWriter& out, const cldb::Type& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(itohex(primitive.size), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteHex(primitive.size);
 	}
 
 
-	void WriteClass(FILE* fp, const cldb::Class& primitive, const cldb::Database& db)
+	void WriteClass(TextWriter& out, const cldb::Class& primitive, const cldb::Database& db)
 	{
-		WriteType(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(primitive.is_class ? "\t1" : "\t0", fp);
+		WriteType(out, primitive, db);
+		out.Write("\t");
+		out.Write(primitive.is_class ? "\t1" : "\t0");
 	}
 
-    void WriteEnumScoped(FILE* fp, cldb::Enum::Scoped scoped)
+    void WriteEnumScoped(TextWriter& out, cldb::Enum::Scoped scoped)
     {
         switch (scoped)
         {
         case (cldb::Enum::Scoped::None):
-            fputs("n", fp);
+            out.Write("n");
             break;
         case (cldb::Enum::Scoped::Class):
-            fputs("c", fp);
+            out.Write("c");
             break;
         case (cldb::Enum::Scoped::Struct):
-            fputs("s", fp);
+            out.Write("s");
             break;
         }
     }
 
-    void WriteEnum(FILE* fp, const cldb::Enum& primitive, const cldb::Database& db)
+    void WriteEnum(TextWriter& out, const cldb::Enum& primitive, const cldb::Database& db)
     {
-        WriteType(fp, primitive, db);
-        fputs("\t", fp);
-        WriteEnumScoped(fp, primitive.scoped);
+        WriteType(out, primitive, db);
+        out.Write("\t");
+        WriteEnumScoped(out, primitive.scoped);
     }
 
-    void WriteEnumConstant(FILE* fp, const cldb::EnumConstant& primitive, const cldb::Database& db)
+    void WriteEnumConstant(TextWriter& out, const cldb::EnumConstant& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(itoa(primitive.value), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteDecimal(primitive.value);
 	}
 
 
-	void WriteQualifier(FILE* fp, const cldb::Qualifier& qualifier)
+	void WriteQualifier(TextWriter& out, const cldb::Qualifier& qualifier)
 	{
 		switch (qualifier.op)
 		{
-		case (cldb::Qualifier::VALUE): fputs("v", fp); break;
-		case (cldb::Qualifier::POINTER): fputs("p", fp); break;
-		case (cldb::Qualifier::REFERENCE): fputs("r", fp); break;
+		case (cldb::Qualifier::VALUE): out.Write("v"); break;
+		case (cldb::Qualifier::POINTER): out.Write("p"); break;
+		case (cldb::Qualifier::REFERENCE): out.Write("r"); break;
 		}
 
-		fputs(qualifier.is_const ? "\t1" : "\t0", fp);
+		out.Write(qualifier.is_const ? "\t1" : "\t0");
 	}
 
 
-	void WriteField(FILE* fp, const cldb::Field& primitive, const cldb::Database& db)
+	void WriteField(TextWriter& out, const cldb::Field& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(HexStringFromName(primitive.type, db), fp);
-		fputs("\t", fp);
-		WriteQualifier(fp, primitive.qualifier);
-		fputs("\t", fp);
-		fputs(itoa(primitive.offset), fp);
-		fputs("\t\t", fp);
-		fputs(itohex(primitive.parent_unique_id), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteHex(primitive.type.hash);
+		out.Write("\t");
+		WriteQualifier(out, primitive.qualifier);
+		out.Write("\t");
+		out.WriteDecimal(primitive.offset);
+		out.Write("\t\t");
+		out.WriteHex(primitive.parent_unique_id);
 	}
 
 
-	void WriteFunction(FILE* fp, const cldb::Function& primitive, const cldb::Database& db)
+	void WriteFunction(TextWriter& out, const cldb::Function& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(itohex(primitive.unique_id), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteHex(primitive.unique_id);
 	}
 
 
-	void WriteTemplateType(FILE* fp, const cldb::TemplateType& primitive, const cldb::Database& db)
+	void WriteTemplateType(TextWriter& out, const cldb::TemplateType& primitive, const cldb::Database& db)
 	{
-		WriteType(fp, primitive, db);
-		fputs("\t", fp);
+		WriteType(out, primitive, db);
+		out.Write("\t");
 
 		for (int i = 0; i < cldb::TemplateType::MAX_NB_ARGS; i++)
 		{
 			if (primitive.parameter_types[i].hash)
 			{
-				fputs(itohex(primitive.parameter_types[i].hash), fp);
-				fputs(primitive.parameter_ptrs[i] ? "\t1" : "\t0", fp);
-				fputs("\t", fp);
+				out.WriteHex(primitive.parameter_types[i].hash);
+				out.Write(primitive.parameter_ptrs[i] ? "\t1" : "\t0");
+				out.Write("\t");
 			}
 		}
 	}
 
 
-	void WriteIntAttribute(FILE* fp, const cldb::IntAttribute& primitive, const cldb::Database& db)
+	void WriteIntAttribute(TextWriter& out, const cldb::IntAttribute& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(itoa(primitive.value), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteDecimal(primitive.value);
 	}
 
 
-	void WriteFloatAttribute(FILE* fp, const cldb::FloatAttribute& primitive, const cldb::Database& db)
+	void WriteFloatAttribute(TextWriter& out, const cldb::FloatAttribute& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fprintf(fp, "%f", primitive.value);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		char text[64];
+		snprintf(text, sizeof(text), "%f", primitive.value);
+		out.Write(text);
 	}
 
 
-	void WritePrimitiveAttribute(FILE* fp, const cldb::PrimitiveAttribute& primitive, const cldb::Database& db)
+	void WritePrimitiveAttribute(TextWriter& out, const cldb::PrimitiveAttribute& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(itohex(primitive.value.hash), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.WriteHex(primitive.value.hash);
 	}
 
 
-	void WriteContainerInfo(FILE* fp, const cldb::ContainerInfo& ci, const cldb::Database& db)
+	void WriteContainerInfo(TextWriter& out, const cldb::ContainerInfo& ci, const cldb::Database& db)
 	{
-		fputs(HexStringFromName(ci.name, db), fp);
-		fputs("\t", fp);
-		fputs(HexStringFromName(ci.read_iterator_type, db), fp);
-		fputs("\t", fp);
-		fputs(HexStringFromName(ci.write_iterator_type, db), fp);
-		fputs("\t", fp);
-		fputs(itohex(ci.flags), fp);
-		fputs("\t", fp);
-		fputs(itohex(ci.count), fp);
+		out.WriteHex(ci.name.hash);
+		out.Write("\t");
+		out.WriteHex(ci.read_iterator_type.hash);
+		out.Write("\t");
+		out.WriteHex(ci.write_iterator_type.hash);
+		out.Write("\t");
+		out.WriteHex(ci.flags);
+		out.Write("\t");
+		out.WriteHex(ci.count);
 	}
 
-	void WriteTypeInheritance(FILE *fp, const cldb::TypeInheritance& ti, const cldb::Database& db)
+	void WriteTypeInheritance(TextWriter& out, const cldb::TypeInheritance& ti, const cldb::Database& db)
 	{
-		fputs(HexStringFromName(ti.name, db), fp);
-		fputs("\t", fp);
-		fputs(HexStringFromName(ti.derived_type, db), fp);
-		fputs("\t", fp);
-		fputs(HexStringFromName(ti.base_type, db), fp);
+		out.WriteHex(ti.name.hash);
+		out.Write("\t");
+		out.WriteHex(ti.derived_type.hash);
+		out.Write("\t");
+		out.WriteHex(ti.base_type.hash);
 	}
 
-	void WriteTextAttribute(FILE* fp, const cldb::TextAttribute& primitive, const cldb::Database& db)
+	void WriteTextAttribute(TextWriter& out, const cldb::TextAttribute& primitive, const cldb::Database& db)
 	{
-		WritePrimitive(fp, primitive, db);
-		fputs("\t", fp);
-		fputs(primitive.value.c_str(), fp);
+		WritePrimitive(out, primitive, db);
+		out.Write("\t");
+		out.Write(primitive.value.c_str());
 	}
 
 
 	template <typename TABLE_TYPE, typename PRINT_FUNC>
-	void WriteTable(FILE* fp, const cldb::Database& db, const TABLE_TYPE& table, PRINT_FUNC print_func, const char* title, const char* headers)
+	void WriteTable(TextWriter& out, const cldb::Database& db, const TABLE_TYPE& table, PRINT_FUNC print_func, const char* title, const char* headers)
 	{
-		WriteTableHeader(fp, title, headers);
+		WriteTableHeader(out, title, headers);
 		for (typename TABLE_TYPE::const_iterator i = table.begin(); i != table.end(); ++i)
 		{
-			print_func(fp, i->second, db);
-			fputs("\n", fp);
+			print_func(out, i->second, db);
+			out.Write("\n");
 		}
-		WriteTableFooter(fp);
+		WriteTableFooter(out);
 	}
 
 
 	template <typename TYPE, typename PRINT_FUNC>
-	void WritePrimitives(FILE* fp, const cldb::Database& db, PRINT_FUNC print_func, const char* title, const char* headers)
+	void WritePrimitives(TextWriter& out, const cldb::Database& db, PRINT_FUNC print_func, const char* title, const char* headers)
 	{
 		const cldb::DBMap<TYPE>& store = db.GetDBMap<TYPE>();
-		WriteTable(fp, db, store, print_func, title, headers);
+		WriteTable(out, db, store, print_func, title, headers);
 	}
 
 
-	void WriteNameTable(FILE* fp, const cldb::Database& db, const cldb::NameMap& table)
+	void WriteNameTable(TextWriter& out, const cldb::Database& db, const cldb::NameMap& table)
 	{
-		WriteTableHeader(fp, "Names", "Hash\t\tName");
+		WriteTableHeader(out, "Names", "Hash\t\tName");
 		for (cldb::NameMap::const_iterator i = table.begin(); i != table.end(); ++i)
 		{
-			WriteName(fp, i->second, db);
-			fputs("\n", fp);
+			WriteName(out, i->second, db);
+			out.Write("\n");
 		}
-		WriteTableFooter(fp);
+		WriteTableFooter(out);
 	}
 }
 
@@ -268,38 +343,40 @@ namespace
 void cldb::WriteTextDatabase(const char* filename, const Database& db)
 {
 	FILE* fp = fopen(filename, "w");
+	TextWriter out(fp);
 
 	// Write the header
-	fputs("\nclReflect Database\n", fp);
-	fputs("Format Version: ", fp);
-	fputs(itoa(CURRENT_VERSION), fp);
-	fputs("\n\n\n", fp);
+	out.Write("\nclReflect Database\n");
+	out.Write("Format Version: ");
+	out.WriteDecimal(CURRENT_VERSION);
+	out.Write("\n\n\n");
 
 	// Write the name table
-	WriteNameTable(fp, db, db.m_Names);
+	WriteNameTable(out, db, db.m_Names);
 
 	// Write all the primitive tables
-	WritePrimitives<Type>(fp, db, WriteType, "Types", "Name\t\tParent\t\tSize");
-	WritePrimitives<EnumConstant>(fp, db, WriteEnumConstant, "Enum Constants", "Name\t\tParent\t\tValue");
-    WritePrimitives<Enum>(fp, db, WriteEnum, "Enums", "Name\t\tParent\t\tSize\t\tScoped");
-    WritePrimitives<Field>(fp, db, WriteField, "Fields", "Name\t\tParent\t\tType\t\tMod\tCst\tOffs\tUID");
-	WritePrimitives<Function>(fp, db, WriteFunction, "Functions", "Name\t\tParent\t\tUID");
-	WritePrimitives<Class>(fp, db, WriteClass, "Classes", "Name\t\tParent\t\tSize\t\tBase\t\tIs Class");
-	WritePrimitives<Template>(fp, db, WritePrimitive, "Templates", "Name\t\tParent");
-	WritePrimitives<TemplateType>(fp, db, WriteTemplateType, "Template Types", "Name\t\tParent\t\tArgument type and pointer pairs");
-	WritePrimitives<Namespace>(fp, db, WritePrimitive, "Namespaces", "Name\t\tParent");
+	WritePrimitives<Type>(out, db, WriteType, "Types", "Name\t\tParent\t\tSize");
+	WritePrimitives<EnumConstant>(out, db, WriteEnumConstant, "Enum Constants", "Name\t\tParent\t\tValue");
+    WritePrimitives<Enum>(out, db, WriteEnum, "Enums", "Name\t\tParent\t\tSize\t\tScoped");
+    WritePrimitives<Field>(out, db, WriteField, "Fields", "Name\t\tParent\t\tType\t\tMod\tCst\tOffs\tUID");
+	WritePrimitives<Function>(out, db, WriteFunction, "Functions", "Name\t\tParent\t\tUID");
+	WritePrimitives<Class>(out, db, WriteClass, "Classes", "Name\t\tParent\t\tSize\t\tBase\t\tIs Class");
+	WritePrimitives<Template>(out, db, WritePrimitive, "Templates", "Name\t\tParent");
+	WritePrimitives<TemplateType>(out, db, WriteTemplateType, "Template Types", "Name\t\tParent\t\tArgument type and pointer pairs");
+	WritePrimitives<Namespace>(out, db, WritePrimitive, "Namespaces", "Name\t\tParent");
 
 	// Write the attribute tables
-	WritePrimitives<FlagAttribute>(fp, db, WritePrimitive, "Flag Attributes", "Name\t\tParent");
-	WritePrimitives<IntAttribute>(fp, db, WriteIntAttribute, "Int Attributes", "Name\t\tParent\t\tValue");
-	WritePrimitives<FloatAttribute>(fp, db, WriteFloatAttribute, "Float Attributes", "Name\t\tParent\t\tValue");
-	WritePrimitives<PrimitiveAttribute>(fp, db, WritePrimitiveAttribute, "Primitive Attributes", "Name\t\tParent\t\tValue");
-	WritePrimitives<TextAttribute>(fp, db, WriteTextAttribute, "Text Attributes", "Name\t\tParent\t\tValue");
+	WritePrimitives<FlagAttribute>(out, db, WritePrimitive, "Flag Attributes", "Name\t\tParent");
+	WritePrimitives<IntAttribute>(out, db, WriteIntAttribute, "Int Attributes", "Name\t\tParent\t\tValue");
+	WritePrimitives<FloatAttribute>(out, db, WriteFloatAttribute, "Float Attributes", "Name\t\tParent\t\tValue");
+	WritePrimitives<PrimitiveAttribute>(out, db, WritePrimitiveAttribute, "Primitive Attributes", "Name\t\tParent\t\tValue");
+	WritePrimitives<TextAttribute>(out, db, WriteTextAttribute, "Text Attributes", "Name\t\tParent\t\tValue");
 
-	WritePrimitives<ContainerInfo>(fp, db, WriteContainerInfo, "Containers", "Name\t\tRead\t\tWrite\t\tFlags\t\tCount");
+	WritePrimitives<ContainerInfo>(out, db, WriteContainerInfo, "Containers", "Name\t\tRead\t\tWrite\t\tFlags\t\tCount");
 
-	WritePrimitives<TypeInheritance>(fp, db, WriteTypeInheritance, "Inheritance", "Name\t\tDerived\t\tBase");
+	WritePrimitives<TypeInheritance>(out, db, WriteTypeInheritance, "Inheritance", "Name\t\tDerived\t\tBase");
 
+	out.Flush();
 	fclose(fp);
 }
 
@@ -307,39 +384,99 @@ void cldb::WriteTextDatabase(const char* filename, const Database& db)
 namespace
 {
 	//
-	// Simple wrapper class around strtok that remembers the delimiter and automatically
-	// continues where the last token parse left off.
+	// Splits a line into tab-separated tokens, treating runs of tabs as a single separator.
+	// Tokens are ranges within the line as the text being read isn't writable.
 	//
-	class StringTokeniser
+	class LineTokeniser
 	{
 	public:
-		StringTokeniser(char* text, const char* delimiter)
-			: m_Text(text)
-			, m_Delimiter(delimiter)
+		LineTokeniser(const char* line, const char* end)
+			: m_Text(line)
+			, m_End(end)
+			, m_Valid(true)
+		{
+		}
+
+		// False once a token has been read that isn't in the expected format
+		bool IsValid() const
 		{
+			return m_Valid;
 		}
 
-		const char* Get()
+		bool Get(const char*& token, const char*& token_end)
 		{
-			const char* token = strtok(m_Text, m_Delimiter);
-			m_Text = 0;
-			return token;
+			// Skip leading delimiters and mark the end of the input
+			while (m_Text != m_End && *m_Text == '\t')
+				m_Text++;
+			if (m_Text == m_End)
+				return false;
+
+			// memchr is vectorised by the C runtime so is the quickest way to find the end of long tokens
+			token = m_Text;
+			token_end = (const char*)memchr(m_Text, '\t', m_End - m_Text);
+			if (token_end == 0)
+				token_end = m_End;
+			m_Text = token_end;
+			return true;
 		}
 
-		// Helper for safely retrieving the next hex string token as an integer
+		// Helpers for safely retrieving the next token as an integer, returning zero if there are no more
 		cldb::u32 GetHexInt()
 		{
-			const char* token = Get();
-			if (token == 0)
+			const char* token;
+			const char* token_end;
+			if (!Get(token, token_end))
 				return 0;
-			return hextoi(token);
+
+			cldb::u32 val = 0;
+			for ( ; token != token_end; ++token)
+			{
+				char ch = *token;
+				if (ch >= '0' && ch <= '9')
+				{
+					val = val * 16 + (ch - '0');
+					continue;
+				}
+				ch |= 0x20;
+				if (ch < 'a' || ch > 'f')
+				{
+					m_Valid = false;
+					return 0;
+				}
+				val = val * 16 + (ch - 'a' + 10);
+			}
+			return val;
 		}
 		int GetInt()
 		{
-			const char* token = Get();
-			if (token == 0)
+			const char* token;
+			const char* token_end;
+			if (!Get(token, token_end))
 				return 0;
-			return atoi(token);
+
+			// Values written as unsigned wrap around to the signed value they came from
+			bool negative = *token == '-';
+			if (negative || *token == '+')
+				token++;
+			cldb::u32 val = 0;
+			for ( ; token != token_end && *token >= '0' && *token <= '9'; ++token)
+				val = val * 10 + (*token - '0');
+			return (int)(negative ? 0 - val : val);
+		}
+
+		// Returns the first character of the next token, or zero if there isn't one
+		char GetChar()
+		{
+			const char* token;
+			const char* token_end;
+			return Get(token, token_end) ? *token : 0;
+		}
+
+		std::string GetString()
+		{
+			const char* token;
+			const char* token_end;
+			return Get(token, token_end) ? std::string(token, token_end) : std::string();
 		}
 
 		// Automating the process of getting the common primitive data
@@ -350,28 +487,75 @@ namespace
 		}
 
 	private:
-		char* m_Text;
-		const char* m_Delimiter;
+		const char* m_Text;
+		const char* m_End;
+		bool m_Valid;
+	};
+
+
+	//
+	// Steps through the lines of text in memory, without their line endings
+	//
+	class LineReader
+	{
+	public:
+		LineReader(const char* text, size_t size)
+			: m_Text(text)
+			, m_End(text + size)
+		{
+		}
+
+		bool Next(const char*& line, const char*& line_end)
+		{
+			if (m_Text == m_End)
+				return false;
+
+			line = m_Text;
+			line_end = (const char*)memchr(m_Text, '\n', m_End - m_Text);
+			if (line_end == 0)
+			{
+				// The last line may not be terminated
+				line_end = m_End;
+				m_Text = m_End;
+			}
+			else
+			{
+				m_Text = line_end + 1;
+			}
+
+			// Files written on Windows have CRLF line endings
+			if (line_end != line && line_end[-1] == '\r')
+				line_end--;
+
+			return true;
+		}
+
+	private:
+		const char* m_Text;
+		const char* m_End;
 	};
 
 
-	void ParseName(char* line, cldb::Database& db)
+	bool StartsWith(const char* line, const char* line_end, const char* cmp, size_t cmp_length)
+	{
+		return (size_t)(line_end - line) >= cmp_length && memcmp(line, cmp, cmp_length) == 0;
+	}
+
+
+	void ParseName(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
 		cldb::u32 hash = tok.GetHexInt();
-		const char* name = tok.Get();
-		if (hash != 0 && name != 0)
+		std::string name = tok.GetString();
+		if (hash != 0 && !name.empty())
 		{
-			db.m_Names[hash] = cldb::Name(hash, name);
+			db.AddName(hash, name.c_str());
 		}
 	}
 
 
 	template <typename TYPE>
-	void ParsePrimitive(char* line, cldb::Database& db)
+	void ParsePrimitive(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -385,10 +569,8 @@ namespace
 	}
 
 
-	void ParseType(char* line, cldb::Database& db)
+	void ParseType(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -406,10 +588,8 @@ namespace
 	}
 
 
-	void ParseEnumConstant(char* line, cldb::Database& db)
+	void ParseEnumConstant(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -426,12 +606,10 @@ namespace
 		db.AddPrimitive(primitive);
 	}
 
-    cldb::Enum::Scoped ParseEnumScoped(StringTokeniser& tok)
+    cldb::Enum::Scoped ParseEnumScoped(LineTokeniser& tok)
     {
-        const char* mod = tok.Get();
-		
-        cldb::Enum::Scoped scoped;
-        switch (mod[0])
+        cldb::Enum::Scoped scoped = cldb::Enum::Scoped::None;
+        switch (tok.GetChar())
         {
         case ('n'):
             scoped = cldb::Enum::Scoped::None;
@@ -447,10 +625,8 @@ namespace
 		return scoped;
     }
 
-    void ParseEnum(char* line, cldb::Database& db)
+    void ParseEnum(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -468,28 +644,24 @@ namespace
 	}
 
 
-	cldb::Qualifier ParseQualifier(StringTokeniser& tok)
+	cldb::Qualifier ParseQualifier(LineTokeniser& tok)
 	{
-		const char* mod = tok.Get();
 		cldb::Qualifier qualifier;
-		switch (mod[0])
+		switch (tok.GetChar())
 		{
 		case ('v'): qualifier.op = cldb::Qualifier::VALUE; break;
 		case ('p'): qualifier.op = cldb::Qualifier::POINTER; break;
 		case ('r'): qualifier.op = cldb::Qualifier::REFERENCE; break;
 		}
 
-		const char* cst = tok.Get();
-		qualifier.is_const = cst[0] != '0';
+		qualifier.is_const = tok.GetChar() != '0';
 
 		return qualifier;
 	}
 
 
-	void ParseField(char* line, cldb::Database& db)
+	void ParseField(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -516,10 +688,8 @@ namespace
 	}
 
 
-	void ParseFunction(char* line, cldb::Database& db)
+	void ParseFunction(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -537,10 +707,8 @@ namespace
 	}
 
 
-	void ParseClass(char* line, cldb::Database& db)
+	void ParseClass(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -560,10 +728,8 @@ namespace
 	}
 
 
-	void ParseTemplateType(char* line, cldb::Database& db)
+	void ParseTemplateType(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -589,10 +755,8 @@ namespace
 	}
 
 
-	void ParseIntAttribute(char* line, cldb::Database& db)
+	void ParseIntAttribute(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -610,17 +774,15 @@ namespace
 	}
 
 
-	void ParseFloatAttribute(char* line, cldb::Database& db)
+	void ParseFloatAttribute(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
 
 		// Attribute parsing
 		float value = 0;
-		sscanf(tok.Get(), "%f", &value);
+		sscanf(tok.GetString().c_str(), "%f", &value);
 
 		// Add a new attribute to the database
 		cldb::FloatAttribute primitive(
@@ -632,10 +794,8 @@ namespace
 	}
 
 
-	void ParsePrimitiveAttribute(char* line, cldb::Database& db)
+	void ParsePrimitiveAttribute(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
@@ -653,31 +813,27 @@ namespace
 	}
 
 
-	void ParseTextAttribute(char* line, cldb::Database& db)
+	void ParseTextAttribute(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Primitive parsing
 		cldb::u32 name, parent;
 		tok.GetNameAndParent(name, parent);
 
 		// Attribute parsing
-		const char* value = tok.Get();
+		std::string value = tok.GetString();
 
 		// Add a new attribute to the database
 		cldb::TextAttribute primitive(
 			db.GetName(name),
 			db.GetName(parent),
-			value);
+			value.c_str());
 
 		db.AddPrimitive(primitive);
 	}
 
 
-	void ParseContainerInfo(char* line, cldb::Database& db)
+	void ParseContainerInfo(LineTokeniser& tok, cldb::Database& db)
 	{
-		StringTokeniser tok(line, "\t");
-
 		// Parse the container info
 		cldb::u32 name = tok.GetHexInt();
 		cldb::u32 read_iterator = tok.GetHexInt();
@@ -695,10 +851,8 @@ namespace
 		db.Add(ci.name, ci);
 	}
 
-	void ParseInheritance(char* line, cldb::Database&db)
+	void ParseInheritance(LineTokeniser& tok, cldb::Database&db)
 	{
-		StringTokeniser tok(line, "\t");
-		
 		// Parse the inheritance
 		cldb::u32 name = tok.GetHexInt();
 		cldb::u32 derived_type = tok.GetHexInt();
@@ -712,73 +866,146 @@ namespace
 		db.Add(ti.name, ti);
 	}
 
-	template <typename PARSE_FUNC>
-	void ParseTable(FILE* fp, char* line, cldb::Database& db, const char* table_name, PARSE_FUNC parse_func)
+	//
+	// Each table starts with a named ruler, followed by the column headers and another ruler
+	//
+	struct TableParser
+	{
+		const char* name;
+		void (*parse_func)(LineTokeniser&, cldb::Database&);
+	};
+
+
+	const TableParser g_TableParsers[] =
+	{
+		{ "Names", ParseName },
+		{ "Namespaces", ParsePrimitive<cldb::Namespace> },
+		{ "Types", ParseType },
+		{ "Enum Constants", ParseEnumConstant },
+		{ "Enums", ParseEnum },
+		{ "Fields", ParseField },
+		{ "Functions", ParseFunction },
+		{ "Templates", ParsePrimitive<cldb::Template> },
+		{ "Template Types", ParseTemplateType },
+		{ "Classes", ParseClass },
+		{ "Flag Attributes", ParsePrimitive<cldb::FlagAttribute> },
+		{ "Int Attributes", ParseIntAttribute },
+		{ "Float Attributes", ParseFloatAttribute },
+		{ "Primitive Attributes", ParsePrimitiveAttribute },
+		{ "Text Attributes", ParseTextAttribute },
+		{ "Containers", ParseContainerInfo },
+		{ "Inheritance", ParseInheritance },
+	};
+
+
+	const TableParser* FindTableParser(const char* line, const char* line_end)
+	{
+		// Match the table name between the leading dashes and the space that follows it
+		if (!StartsWith(line, line_end, "---- ", 5))
+			return 0;
+		line += 5;
+
+		for (size_t i = 0; i < sizeof(g_TableParsers) / sizeof(g_TableParsers[0]); i++)
+		{
+			const TableParser& parser = g_TableParsers[i];
+			size_t length = strlen(parser.name);
+			if (StartsWith(line, line_end, parser.name, length) && line + length != line_end && line[length] == ' ')
+				return &parser;
+		}
+
+		return 0;
+	}
+
+
+	bool ParseTable(LineReader& reader, cldb::Database& db, const TableParser& parser)
 	{
-		// Format the table header
-		char table_header[256] = "---- ";
-		strcat(table_header, table_name);
-		strcat(table_header, " ");
+		// Consume the column headers and ruler
+		const char* line;
+		const char* line_end;
+		if (!reader.Next(line, line_end) || !reader.Next(line, line_end))
+		{
+			return true;
+		}
 
-		// See if this is the required table and consumer the header
-		if (startswith(line, table_header))
+		// Loop reading all lines until the table completes
+		while (reader.Next(line, line_end))
 		{
-			if (ReadLine(fp) == 0)
+			if (StartsWith(line, line_end, "----", 4))
+			{
+				break;
+			}
+
+			LineTokeniser tok(line, line_end);
+			parser.parse_func(tok, db);
+			if (!tok.IsValid())
 			{
-				return;
+				return false;
 			}
-			if (ReadLine(fp) == 0)
+		}
+
+		return true;
+	}
+
+
+	bool IsTextDatabaseHeader(const char* text, size_t size)
+	{
+		// Parse the first few lines looking for the header
+		LineReader reader(text, size);
+		const char* line;
+		const char* line_end;
+		int line_index = 0;
+		bool is_text_db = true;
+		while (reader.Next(line, line_end))
+		{
+			if (StartsWith(line, line_end, "clReflect Database", 18))
 			{
-				return;
+				is_text_db = true;
 			}
 
-			// Loop reading all lines until the table completes
-			while (char* subline = ReadLine(fp))
+			// See if the version is readable
+			if (is_text_db && StartsWith(line, line_end, "Format Version: ", 16))
 			{
-				if (startswith(subline, "----"))
-				{
-					break;
-				}
+				std::string version(line + 16, line_end);
+				if (atoi(version.c_str()) != CURRENT_VERSION)
+					is_text_db = false;
 
-				parse_func(subline, db);
+				break;
+			}
+
+			if (line_index++ > 5)
+			{
+				break;
 			}
 		}
+
+		return is_text_db;
 	}
 }
 
 
 bool cldb::ReadTextDatabase(const char* filename, Database& db)
 {
-	if (!IsTextDatabase(filename))
+	MappedFile file;
+	if (!file.Open(filename) || !IsTextDatabaseHeader(file.Data(), file.Size()))
 	{
 		return false;
 	}
 
-	FILE* fp = fopen(filename, "r");
-
 	// Parse the tables in whatever order they arrive
-	while (char* line = ReadLine(fp))
-	{
-		ParseTable(fp, line, db, "Names", ParseName);
-		ParseTable(fp, line, db, "Namespaces", ParsePrimitive<cldb::Namespace>);
-		ParseTable(fp, line, db, "Types", ParseType);
-		ParseTable(fp, line, db, "Enum Constants", ParseEnumConstant);
-		ParseTable(fp, line, db, "Enums", ParseEnum);
-		ParseTable(fp, line, db, "Fields", ParseField);
-		ParseTable(fp, line, db, "Functions", ParseFunction);
-		ParseTable(fp, line, db, "Templates", ParsePrimitive<cldb::Template>);
-		ParseTable(fp, line, db, "Template Types", ParseTemplateType);
-		ParseTable(fp, line, db, "Classes", ParseClass);
-		ParseTable(fp, line, db, "Flag Attributes", ParsePrimitive<cldb::FlagAttribute>);
-		ParseTable(fp, line, db, "Int Attributes", ParseIntAttribute);
-		ParseTable(fp, line, db, "Float Attributes", ParseFloatAttribute);
-		ParseTable(fp, line, db, "Primitive Attributes", ParsePrimitiveAttribute);
-		ParseTable(fp, line, db, "Text Attributes", ParseTextAttribute);
-		ParseTable(fp, line, db, "Containers", ParseContainerInfo);
-		ParseTable(fp, line, db, "Inheritance", ParseInheritance);
+	LineReader reader(file.Data(), file.Size());
+	const char* line;
+	const char* line_end;
+	while (reader.Next(line, line_end))
+	{
+		if (const TableParser* parser = FindTableParser(line, line_end))
+		{
+			if (!ParseTable(reader, db, *parser))
+			{
+				return false;
+			}
+		}
 	}
 
-	fclose(fp);
 	return true;
 }
 
@@ -786,37 +1013,9 @@ bool cldb::ReadTextDatabase(const char* filename, Database& db)
 bool cldb::IsTextDatabase(const char* filename)
 {
 	// Not a database if it doesn't exist
-	FILE* fp = fopen(filename, "r");
-	if (fp == 0)
+	MappedFile file;
+	if (!file.Open(filename))
 		return false;
 
-	// Parse the first few lines looking for the header
-	int line_index = 0;
-	bool is_text_db = true;
-	while (char* line = ReadLine(fp))
-	{
-		if (startswith(line, "clReflect Database"))
-		{
-			is_text_db = true;
-		}
-
-		// See if the version is readable
-		if (is_text_db && startswith(line, "Format Version: "))
-		{
-			StringTokeniser tok(line, ":");
-			tok.Get();
-			if (tok.GetInt() != CURRENT_VERSION)
-				is_text_db = false;
-
-			break;
-		}
-
-		if (line_index++ > 5)
-		{
-			break;
-		}
-	}
-
-	fclose(fp);
-	return is_text_db;
+	return IsTextDatabaseHeader(file.Data(), file.Size());
 }
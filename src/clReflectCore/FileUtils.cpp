@@ -15,7 +15,8 @@
 
 char* ReadLine(FILE* fp)
 {
-	static char line[4096];
+	// Per-thread so that databases can be loaded concurrently
+	static thread_local char line[4096];
 
 	// Loop reading characters until EOF or EOL
 	int pos = 0;
@@ -47,7 +48,7 @@ char* ReadLine(FILE* fp)
 const char* itoa(unsigned int value)
 {
 	static const int MAX_SZ = 20;
-	static char text[MAX_SZ];
+	static thread_local char text[MAX_SZ];
 #ifdef _MSC_VER
 	return _itoa(value, text, 10);
 #else
@@ -60,7 +61,7 @@ const char* itoa(unsigned int value)
 const char* itohex(unsigned int value)
 {
 	static const int MAX_SZ = 9;
-	static char text[MAX_SZ];
+	static thread_local char text[MAX_SZ];
 
 	// Null terminate and start at the end
 	text[MAX_SZ - 1] = 0;
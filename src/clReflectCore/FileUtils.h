@@ -20,6 +20,7 @@
 #include <string>
 
 
+// stores destination buffer locally, per thread
 char* ReadLine(FILE* fp);
 
 
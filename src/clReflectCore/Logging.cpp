@@ -15,7 +15,9 @@
 #include <cassert>
 #include <cstdarg>
 #include <cstring>
+#include <atomic>
 #include <map>
+#include <mutex>
 
 
 namespace
@@ -37,6 +39,10 @@ namespace
 	};
 
 
+	// Where the calling thread's stdout logging goes when it's not stdout itself
+	thread_local FILE* g_ThreadStdout = 0;
+
+
 	//
 	// Outputs logged strings to stdout
 	//
@@ -45,7 +51,7 @@ namespace
 		void Log(const char* text)
 		{
 			// Doesn't append the '\n'
-			fputs(text, stdout);
+			fputs(text, g_ThreadStdout != 0 ? g_ThreadStdout : stdout);
 		}
 	};
 
@@ -129,7 +135,7 @@ namespace
 	struct StreamSet
 	{
 		StreamSet() : indent_depth(0) { }
-		int indent_depth;
+		std::atomic<int> indent_depth;
 		StreamArray streams;
 	};
 
@@ -147,6 +153,9 @@ namespace
 	typedef std::map<const char*, StreamSet> StreamMap;
 	StreamMap g_StreamMap;
 
+	// Stream handles are first looked up when each LOG is first reached, which can be on any thread
+	std::mutex g_StreamMapMutex;
+
 
 	void DeleteAllStreams()
 	{
@@ -171,6 +180,8 @@ namespace
 		// Ensure all streams are deleted on shutdown
 		atexit(DeleteAllStreams);
 
+		std::lock_guard<std::mutex> lock(g_StreamMapMutex);
+
 		// Iterate over every set tag
 		for (int i = 0; i < NB_TAG_BITS; i++)
 		{
@@ -232,8 +243,16 @@ void logging::SetLogToFile(const char* name, Tag tag, const char* filename)
 }
 
 
+void logging::SetThreadStdout(FILE* fp)
+{
+	g_ThreadStdout = fp;
+}
+
+
 logging::StreamHandle logging::GetStreamHandle(const char* name)
 {
+	// Entries are never removed so the handle stays valid once the lock is released
+	std::lock_guard<std::mutex> lock(g_StreamMapMutex);
 	return &g_StreamMap[name];
 }
 
@@ -259,11 +278,12 @@ void logging::Log(StreamHandle handle, Tag tag, bool do_prefix, const char* form
 		if (tag == TAG_INFO)
 		{
 			// Kick the prefix off with indent characters
-			for (int i = 0; i < stream_set->indent_depth; i++)
+			int indent_depth = stream_set->indent_depth;
+			for (int i = 0; i < indent_depth; i++)
 			{
 				prefix[i] = '\t';
 			}
-			prefix[stream_set->indent_depth] = 0;
+			prefix[indent_depth] = 0;
 		}
 
 		// Add any tag annotations
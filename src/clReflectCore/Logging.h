@@ -12,6 +12,9 @@
 #pragma once
 
 
+#include <stdio.h>
+
+
 namespace logging
 {
 	//
@@ -33,6 +36,13 @@ namespace logging
 	void SetLogToFile(const char* name, Tag tag, const char* filename);
 
 
+	//
+	// Send everything the calling thread logs to stdout to the given file instead, or back to
+	// stdout when null, so that threads serving different clients keep their output apart
+	//
+	void SetThreadStdout(FILE* fp);
+
+
 	//
 	// Get a pre-created stream handle
 	//
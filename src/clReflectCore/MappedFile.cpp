@@ -0,0 +1,140 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "MappedFile.h"
+
+#include <clcpp/clcpp.h>
+
+#if defined(CLCPP_USING_MSVC)
+
+// clang-format off
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+// clang-format on
+
+#else
+
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+#endif // CLCPP_USING_MSVC
+
+
+MappedFile::MappedFile()
+	: m_Data(0)
+	, m_Size(0)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+#if defined(CLCPP_USING_MSVC)
+
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// Zero-sized files can't be mapped
+	if (size.QuadPart != 0)
+	{
+		// The view keeps the file open once both handles are closed
+		HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping != 0)
+		{
+			m_Data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+		if (m_Data == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+	}
+
+	CloseHandle(file);
+	m_Size = (size_t)size.QuadPart;
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_Data != 0)
+		UnmapViewOfFile(m_Data);
+	m_Data = 0;
+	m_Size = 0;
+}
+
+
+#else
+
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// Zero-sized files can't be mapped
+	if (st.st_size != 0)
+	{
+		// The mapping keeps the file open once the descriptor is closed
+		void* data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+		m_Data = (const char*)data;
+	}
+
+	close(fd);
+	m_Size = st.st_size;
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_Data != 0)
+		munmap((char*)m_Data, m_Size);
+	m_Data = 0;
+	m_Size = 0;
+}
+
+
+#endif // CLCPP_USING_MSVC
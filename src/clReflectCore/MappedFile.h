@@ -0,0 +1,40 @@
+//
+// ===============================================================================
+// clReflect, MappedFile.h - Read-only memory mapping of an entire file.
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+
+#pragma once
+
+
+#include <stddef.h>
+
+
+//
+// Maps a file into memory so that its contents can be read in place, keeping the mapping
+// until destruction. Empty files have no data but still open successfully.
+//
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* filename);
+
+	const char* Data() const { return m_Data; }
+	size_t Size() const { return m_Size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator = (const MappedFile&);
+
+	void Close();
+
+	const char* m_Data;
+	size_t m_Size;
+};
@@ -0,0 +1,235 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Event
+    {
+        char phase;
+        unsigned int thread_id;
+        clcpp::uint64 start;
+        clcpp::uint64 duration;
+        clcpp::int64 value;
+        std::string name;
+        std::string detail;
+    };
+
+    struct TraceState
+    {
+        TraceState()
+            : enabled(false)
+            , fp(0)
+            , write_failed(false)
+            , nb_threads(0)
+        {
+        }
+
+        bool enabled;
+        std::string filename;
+        std::string process_name;
+        std::chrono::steady_clock::time_point start_time;
+
+        // Opened on the first flush, with events written as they're flushed
+        FILE* fp;
+        bool write_failed;
+
+        // Guards everything below
+        std::mutex mutex;
+        std::vector<Event> events;
+        unsigned int nb_threads;
+    };
+
+    TraceState& GetState()
+    {
+        static TraceState state;
+        return state;
+    }
+
+    unsigned int GetThreadID(TraceState& state)
+    {
+        // Small sequential IDs keep the viewer's track list ordered by thread creation
+        static thread_local unsigned int thread_id = 0;
+        if (thread_id == 0)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            thread_id = ++state.nb_threads;
+        }
+        return thread_id;
+    }
+
+    void AddEvent(Event& event)
+    {
+        TraceState& state = GetState();
+        event.thread_id = GetThreadID(state);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.events.push_back(std::move(event));
+    }
+
+    void WriteString(FILE* fp, const std::string& str)
+    {
+        fputc('"', fp);
+        for (size_t i = 0; i < str.length(); i++)
+        {
+            unsigned char c = str[i];
+            if (c == '"' || c == '\\')
+                fprintf(fp, "\\%c", c);
+            else if (c < 0x20)
+                fprintf(fp, "\\u%04x", c);
+            else
+                fputc(c, fp);
+        }
+        fputc('"', fp);
+    }
+
+    void WriteEvent(FILE* fp, const Event& event)
+    {
+        fprintf(fp, ",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"name\":", event.phase, event.thread_id,
+                (unsigned long long)event.start);
+        WriteString(fp, event.name);
+
+        if (event.phase == 'X')
+        {
+            fprintf(fp, ",\"dur\":%llu", (unsigned long long)event.duration);
+            if (event.detail != "")
+            {
+                fprintf(fp, ",\"args\":{\"detail\":");
+                WriteString(fp, event.detail);
+                fprintf(fp, "}");
+            }
+        }
+        else
+        {
+            fprintf(fp, ",\"args\":{");
+            WriteString(fp, event.detail);
+            fprintf(fp, ":%lld}", (long long)event.value);
+        }
+
+        fprintf(fp, "}");
+    }
+}
+
+void trace::Open(const char* filename, const char* process_name)
+{
+    TraceState& state = GetState();
+    state.filename = filename;
+    state.process_name = process_name;
+    state.start_time = std::chrono::steady_clock::now();
+    state.events.clear();
+    state.fp = 0;
+    state.write_failed = false;
+    state.enabled = true;
+}
+
+bool trace::IsEnabled()
+{
+    return GetState().enabled;
+}
+
+bool trace::Flush()
+{
+    TraceState& state = GetState();
+    if (!state.enabled)
+        return true;
+
+    // Take the events so that other threads can keep recording while they're written
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        events.swap(state.events);
+    }
+
+    if (state.fp == 0 && !state.write_failed)
+    {
+        state.fp = fopen(state.filename.c_str(), "wb");
+        if (state.fp == 0)
+        {
+            state.write_failed = true;
+        }
+        else
+        {
+            fprintf(state.fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            fprintf(state.fp, "{\"ph\":\"M\",\"pid\":1,\"tid\":1,\"name\":\"process_name\",\"args\":{\"name\":");
+            WriteString(state.fp, state.process_name);
+            fprintf(state.fp, "}}");
+        }
+    }
+
+    // Events are dropped if the file can't be written, rather than kept until Close
+    if (state.write_failed)
+        return false;
+
+    for (size_t i = 0; i < events.size(); i++)
+        WriteEvent(state.fp, events[i]);
+    if (fflush(state.fp) != 0)
+        state.write_failed = true;
+
+    return !state.write_failed;
+}
+
+bool trace::Close()
+{
+    TraceState& state = GetState();
+    if (!state.enabled)
+        return true;
+
+    Flush();
+    state.enabled = false;
+    if (state.fp == 0)
+        return false;
+
+    fprintf(state.fp, "\n]}\n");
+    bool closed = fclose(state.fp) == 0;
+    state.fp = 0;
+    return closed && !state.write_failed;
+}
+
+clcpp::uint64 trace::Now()
+{
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - GetState().start_time;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void trace::Span(const char* name, const char* detail, clcpp::uint64 start, clcpp::uint64 end)
+{
+    if (!IsEnabled())
+        return;
+
+    Event event;
+    event.phase = 'X';
+    event.start = start;
+    event.duration = end - start;
+    event.value = 0;
+    event.name = name;
+    if (detail != 0)
+        event.detail = detail;
+    AddEvent(event);
+}
+
+void trace::Counter(const char* name, const char* series, clcpp::int64 value)
+{
+    if (!IsEnabled())
+        return;
+
+    Event event;
+    event.phase = 'C';
+    event.start = Now();
+    event.duration = 0;
+    event.value = value;
+    event.name = name;
+    event.detail = series;
+    AddEvent(event);
+}
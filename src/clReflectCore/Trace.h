@@ -0,0 +1,83 @@
+//
+// ===============================================================================
+// clReflect, Trace.h - Span/counter recording for the offline tools, written out
+// in the Chrome trace-event format (load in chrome://tracing or Perfetto).
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#pragma once
+
+#include <clcpp/clcpp.h>
+
+namespace trace
+{
+    //
+    // Start recording events, to be written to the given file on Close. Until this is called
+    // all recording functions are a cheap no-op.
+    //
+    void Open(const char* filename, const char* process_name);
+    bool IsEnabled();
+
+    //
+    // Write the events recorded so far to disk and release them, continuing to record. Lets
+    // long-running processes keep memory use bounded. Returns false if the file couldn't be
+    // written.
+    //
+    bool Flush();
+
+    //
+    // Write all recorded events to disk and stop recording. Returns false if the file
+    // couldn't be written.
+    //
+    bool Close();
+
+    //
+    // Microseconds since trace start
+    //
+    clcpp::uint64 Now();
+
+    //
+    // Record a span of time, with an optional detail string (e.g. a filename) shown alongside.
+    // Safe to call from any thread; each thread gets its own track in the viewer.
+    //
+    void Span(const char* name, const char* detail, clcpp::uint64 start, clcpp::uint64 end);
+
+    //
+    // Record the value of a named series at the current time
+    //
+    void Counter(const char* name, const char* series, clcpp::int64 value);
+
+    //
+    // Records a span for the lifetime of the object
+    //
+    struct Scope
+    {
+        Scope(const char* name, const char* detail = 0)
+            : name(name)
+            , detail(detail)
+            , start(IsEnabled() ? Now() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (IsEnabled())
+                Span(name, detail, start, Now());
+        }
+
+        const char* name;
+        const char* detail;
+        clcpp::uint64 start;
+    };
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+//
+// Trace the remainder of the enclosing scope
+//
+#define TRACE_SCOPE(...) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
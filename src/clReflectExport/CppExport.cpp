@@ -20,12 +20,20 @@
 #include <clReflectCore/Database.h>
 #include <clReflectCore/FileUtils.h>
 #include <clReflectCore/Logging.h>
+#include <clReflectCore/Trace.h>
 
 #include <clcpp/clcpp.h>
 #include <clcpp/clcpp_internal.h>
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
+#include <thread>
 
 #if defined(CLCPP_USING_MSVC)
     #include <malloc.h>
@@ -59,13 +67,46 @@ namespace
         }
     };
 
+    // Independent export steps that can run across a number of threads. Tasks must only write
+    // to memory that no other task in the list touches and must not allocate from the export's
+    // StackAllocator, so that its layout, and the exported file, doesn't depend on scheduling.
+    class TaskList
+    {
+    public:
+        void Add(const std::function<void()>& task)
+        {
+            m_Tasks.push_back(task);
+        }
+
+        void Run(unsigned int nb_threads)
+        {
+            std::atomic<size_t> next_task(0);
+            auto run_tasks = [&]() {
+                for (size_t i = next_task++; i < m_Tasks.size(); i = next_task++)
+                    m_Tasks[i]();
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < nb_threads && i < m_Tasks.size(); i++)
+                threads.push_back(std::thread(run_tasks));
+            run_tasks();
+            for (size_t i = 0; i < threads.size(); i++)
+                threads[i].join();
+
+            m_Tasks.clear();
+        }
+
+    private:
+        std::vector<std::function<void()>> m_Tasks;
+    };
+
     void BuildNames(const cldb::Database& db, CppExport& cppexp)
     {
         // Allocate the name data
         unsigned int name_data_size = 0;
         for (cldb::NameMap::const_iterator i = db.m_Names.begin(); i != db.m_Names.end(); ++i)
         {
-            name_data_size += i->second.text.length() + 1;
+            name_data_size += strlen(i->second.text) + 1;
         }
         cppexp.db->name_text_data = cppexp.allocator.Alloc<char>(name_data_size);
 
@@ -76,8 +117,9 @@ namespace
             char* text_ptr = (char*)(cppexp.db->name_text_data + name_data_size);
             cppexp.name_map[i->first] = text_ptr;
             const cldb::Name& name = i->second;
-            strcpy(text_ptr, name.text.c_str());
-            name_data_size += name.text.length() + 1;
+            size_t size = strlen(name.text) + 1;
+            memcpy(text_ptr, name.text, size);
+            name_data_size += size;
         }
 
         // Build the in-memory name array
@@ -188,88 +230,218 @@ namespace
         dest.count = src.count;
     }
 
+    // Hashes of primitive names that aren't in the name map, gathered while copying primitives
+    // concurrently and added to the map with no text afterwards
+    class MissingNames
+    {
+    public:
+        void Add(unsigned int hash)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Hashes.push_back(hash);
+        }
+
+        void AddTo(CppExport::NameMap& name_map) const
+        {
+            for (size_t i = 0; i < m_Hashes.size(); i++)
+                name_map[m_Hashes[i]] = 0;
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<unsigned int> m_Hashes;
+    };
+
     template <typename CLDB_TYPE, typename CLCPP_TYPE>
-    void BuildCArray(CppExport& cppexp, clcpp::CArray<CLCPP_TYPE>& dest, const cldb::Database& db)
+    void BuildCArray(CppExport& cppexp, clcpp::CArray<CLCPP_TYPE>& dest, const cldb::Database& db, TaskList& tasks,
+                     MissingNames& missing_names)
     {
         // Allocate enough entries for all primitives
         const cldb::DBMap<CLDB_TYPE>& src = db.GetDBMap<CLDB_TYPE>();
         cppexp.allocator.Alloc(dest, src.size());
 
-        // Copy individually
-        int index = 0;
-        for (typename cldb::DBMap<CLDB_TYPE>::const_iterator i = src.begin(); i != src.end(); ++i)
-        {
-            CLCPP_TYPE& dest_prim = dest[index++];
-            const CLDB_TYPE& src_prim = i->second;
+        // Starting the iteration sorts the map so do that here, before other threads can see it
+        typename cldb::DBMap<CLDB_TYPE>::const_iterator first = src.begin();
 
-            // Early reference the text of the name for easier debugging
-            dest_prim.name.hash = src_prim.name.hash;
-            dest_prim.name.text = cppexp.name_map[src_prim.name.hash];
+        tasks.Add([&cppexp, &dest, &src, first, &missing_names]() {
+            // Copy individually
+            int index = 0;
+            for (typename cldb::DBMap<CLDB_TYPE>::const_iterator i = first; i != src.end(); ++i)
+            {
+                CLCPP_TYPE& dest_prim = dest[index++];
+                const CLDB_TYPE& src_prim = i->second;
+
+                // Early reference the text of the name for easier debugging
+                dest_prim.name.hash = src_prim.name.hash;
+                CppExport::NameMap::const_iterator name = cppexp.name_map.find(src_prim.name.hash);
+                dest_prim.name.text = name != cppexp.name_map.end() ? name->second : 0;
+                if (name == cppexp.name_map.end())
+                    missing_names.Add(src_prim.name.hash);
+
+                // Copy custom data
+                CopyObject(dest_prim, src_prim);
+            }
+        });
+    }
 
-            // Copy custom data
-            CopyObject(dest_prim, src_prim);
+    // Fields aren't fully-scoped so they're looked up by a hash of their name combined with their
+    // parent's, built in a reused buffer to avoid allocating a string per field
+    class FieldNameHasher
+    {
+    public:
+        unsigned int Hash(const clcpp::Field& field)
+        {
+            const char* parent_name = field.parent->name.text;
+            const char* field_name = field.name.text;
+            size_t parent_len = strlen(parent_name);
+            size_t field_len = strlen(field_name);
+
+            m_Buffer.resize(parent_len + field_len + 2);
+            memcpy(&m_Buffer[0], parent_name, parent_len);
+            memcpy(&m_Buffer[parent_len], "::", 2);
+            memcpy(&m_Buffer[parent_len + 2], field_name, field_len);
+            return clcpp::internal::HashData(&m_Buffer[0], (int)m_Buffer.size());
         }
+
+    private:
+        std::vector<char> m_Buffer;
+    };
+
+    template <typename TYPE>
+    void GetParentHashes(clcpp::CArray<TYPE>& parents, std::vector<unsigned int>& hashes)
+    {
+        for (unsigned int i = 0; i < parents.size; i++)
+            hashes[i] = parents[i].name.hash;
+    }
+    void GetParentHashes(clcpp::CArray<clcpp::Field>& parents, std::vector<unsigned int>& hashes)
+    {
+        FieldNameHasher hasher;
+        for (unsigned int i = 0; i < parents.size; i++)
+            hashes[i] = hasher.Hash(parents[i]);
     }
 
     template <typename PARENT_TYPE>
     struct ParentMap
     {
-        // Parent and ref-count
-        typedef std::pair<PARENT_TYPE*, int> EntryType;
-
-        // Hash to parent and ref-count
-        typedef std::multimap<unsigned int, EntryType> MapType;
-
-        // A range within the map
-        typedef typename MapType::iterator Iterator;
-        typedef std::pair<Iterator, Iterator> Range;
+        // All parents that share a hash, stored contiguously in the entries array
+        struct Group
+        {
+            unsigned int hash;
+            unsigned int first;
+            unsigned int count;
+        };
 
         template <typename TYPE>
         ParentMap(clcpp::CArray<TYPE>& parents)
+            : src_start(parents.data)
+            , src_end(parents.data + parents.size)
+        {
+            std::vector<unsigned int> hashes(parents.size);
+            GetParentHashes(parents, hashes);
+            Build(hashes);
+        }
+
+        const Group* Find(unsigned int hash) const
         {
-            // Create a lookup table from hash ID to parent and the number of references the parent has
-            for (unsigned int i = 0; i < parents.size; i++)
+            for (unsigned int slot = hash & slot_mask; ; slot = (slot + 1) & slot_mask)
             {
-                PARENT_TYPE& parent = parents[i];
-                map.insert(typename MapType::value_type(parent.name.hash, EntryType(&parent, 0)));
+                unsigned int group = slots[slot];
+                if (group == 0)
+                    return 0;
+                if (groups[group - 1].hash == hash)
+                    return &groups[group - 1];
             }
+        }
 
-            src_start = parents.data;
-            src_end = parents.data + parents.size;
+        // Returns the first parent added with the given hash
+        PARENT_TYPE* FindFirst(unsigned int hash) const
+        {
+            const Group* group = Find(hash);
+            return group ? Get(entries[group->first]) : 0;
         }
 
-        void ResetRefCount()
+        PARENT_TYPE* Get(unsigned int index) const
         {
-            for (typename MapType::iterator i = map.begin(); i != map.end(); ++i)
-                i->second.second = 0;
+            return const_cast<PARENT_TYPE*>(src_start) + index;
         }
 
-        MapType map;
+        // Open-addressed table of 1-based group indices, 0 is an empty slot
+        std::vector<unsigned int> slots;
+        unsigned int slot_mask;
+
+        // Groups in ascending hash order and the parent indices they refer to, in source order
+        std::vector<Group> groups;
+        std::vector<unsigned int> entries;
 
         // Record of the source array
         const PARENT_TYPE* src_start;
         const PARENT_TYPE* src_end;
-    };
 
-    // TODO: check if this specialization works
-    template <>
-    template <>
-    ParentMap<clcpp::Field>::ParentMap(clcpp::CArray<clcpp::Field>& parents)
-    {
-        // This specialisation creates a lookup table specific to fields. Given that field names are
-        // not fully-scoped, this makes it impossible to parent them unless their names are combined
-        // with their parent's.
-        for (unsigned int i = 0; i < parents.size; i++)
+    private:
+        void Build(const std::vector<unsigned int>& hashes)
         {
-            clcpp::Field& field = (clcpp::Field&)parents[i];
-            std::string field_name = std::string(field.parent->name.text) + "::" + std::string(field.name.text);
-            unsigned int field_hash = clcpp::internal::HashNameString(field_name.c_str());
-            map.insert(MapType::value_type(field_hash, EntryType(&field, 0)));
-        }
+            // Keep the table at most half full
+            unsigned int nb_slots = 16;
+            while (nb_slots < hashes.size() * 2)
+                nb_slots *= 2;
+            slots.resize(nb_slots, 0);
+            slot_mask = nb_slots - 1;
+
+            // Gather unique hashes and count the parents that share each one
+            std::vector<unsigned int> parent_groups(hashes.size());
+            for (unsigned int i = 0; i < hashes.size(); i++)
+            {
+                unsigned int hash = hashes[i];
+                unsigned int slot = hash & slot_mask;
+                while (slots[slot] != 0 && groups[slots[slot] - 1].hash != hash)
+                    slot = (slot + 1) & slot_mask;
 
-        src_start = parents.data;
-        src_end = parents.data + parents.size;
-    }
+                if (slots[slot] == 0)
+                {
+                    Group group = { hash, 0, 0 };
+                    groups.push_back(group);
+                    slots[slot] = (unsigned int)groups.size();
+                }
+                parent_groups[i] = slot;
+                groups[slots[slot] - 1].count++;
+            }
+
+            // Sort the groups by hash so that parent arrays get allocated in a stable order
+            std::vector<unsigned int> sorted(groups.size());
+            for (unsigned int i = 0; i < sorted.size(); i++)
+                sorted[i] = i;
+            std::sort(sorted.begin(), sorted.end(),
+                      [this](unsigned int a, unsigned int b) { return groups[a].hash < groups[b].hash; });
+            std::vector<unsigned int> remap(groups.size());
+            std::vector<Group> sorted_groups(groups.size());
+            for (unsigned int i = 0; i < sorted.size(); i++)
+            {
+                remap[sorted[i]] = i;
+                sorted_groups[i] = groups[sorted[i]];
+            }
+            groups.swap(sorted_groups);
+            for (unsigned int i = 0; i < nb_slots; i++)
+            {
+                if (slots[i] != 0)
+                    slots[i] = remap[slots[i] - 1] + 1;
+            }
+
+            // Prefix-sum the group counts and scatter the parent indices into place
+            unsigned int offset = 0;
+            for (unsigned int i = 0; i < groups.size(); i++)
+            {
+                groups[i].first = offset;
+                offset += groups[i].count;
+                groups[i].count = 0;
+            }
+            entries.resize(hashes.size());
+            for (unsigned int i = 0; i < hashes.size(); i++)
+            {
+                Group& group = groups[slots[parent_groups[i]] - 1];
+                entries[group.first + group.count++] = i;
+            }
+        }
+    };
 
     bool ParentAndChildMatch(const clcpp::Primitive&, const clcpp::Primitive&)
     {
@@ -280,83 +452,179 @@ namespace
         return parent.unique_id == child.parent_unique_id;
     }
 
-    template <typename PARENT_TYPE, typename CHILD_TYPE>
-    void Parent(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
-                clcpp::CArray<CHILD_TYPE*>& children, StackAllocator& allocator)
+    // Parents one array of children to one kind of parent, pointing the children at their parents
+    // and adding them to an array within each parent. This happens in stages so that passes over
+    // different children can match and fill concurrently, while all parent arrays are allocated
+    // on one thread in a fixed order.
+    class ParentPass
     {
-        parents.ResetRefCount();
+    public:
+        virtual ~ParentPass()
+        {
+        }
 
-        // Assign parents and count the references
-        for (unsigned int i = 0; i < children.size; i++)
+        // Assigns parents and counts the references
+        virtual void Match() = 0;
+
+        // Allocates the arrays in the parents
+        virtual void Allocate(StackAllocator& allocator) = 0;
+
+        // Fills in all the arrays
+        virtual void Fill() = 0;
+
+        // Passes over the same children have to match in the order they're added
+        const void* children_id;
+    };
+
+    // Parent index recorded for children that didn't match any parent
+    const unsigned int NO_PARENT = 0xFFFFFFFF;
+
+    template <typename PARENT_TYPE, typename CHILD_TYPE>
+    class ParentPassImpl : public ParentPass
+    {
+    public:
+        ParentPassImpl(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
+                       std::vector<CHILD_TYPE*>& children)
+            : m_Parents(parents)
+            , m_CArray(carray)
+            , m_NbRefs(parents.src_end - parents.src_start, 0)
         {
-            CHILD_TYPE* child = children[i];
+            m_Children.swap(children);
+            m_ChildParents.resize(m_Children.size(), NO_PARENT);
+        }
 
-            // Iterate over all matches
-            unsigned int hash = POINTER_TO_HASH(child->parent);
-            typename ParentMap<PARENT_TYPE>::Range range = parents.map.equal_range(hash);
-            for (typename ParentMap<PARENT_TYPE>::Iterator j = range.first; j != range.second; ++j)
+        void Match()
+        {
+            typedef typename ParentMap<PARENT_TYPE>::Group Group;
+            for (unsigned int i = 0; i < m_Children.size(); i++)
             {
-                typename ParentMap<PARENT_TYPE>::EntryType& parc = j->second;
-                if (ParentAndChildMatch(*parc.first, *child))
+                CHILD_TYPE* child = m_Children[i];
+
+                // Iterate over all matches
+                const Group* group = m_Parents.Find(POINTER_TO_HASH(child->parent));
+                if (group == 0)
+                    continue;
+                for (unsigned int j = group->first; j != group->first + group->count; j++)
                 {
-                    child->parent = parc.first;
-                    parc.second++;
-                    break;
+                    unsigned int index = m_Parents.entries[j];
+                    PARENT_TYPE* parent = m_Parents.Get(index);
+                    if (ParentAndChildMatch(*parent, *child))
+                    {
+                        child->parent = parent;
+                        m_ChildParents[i] = index;
+                        m_NbRefs[index]++;
+                        break;
+                    }
                 }
             }
         }
 
-        // Allocate the arrays in the parent
-        for (typename ParentMap<PARENT_TYPE>::Iterator i = parents.map.begin(); i != parents.map.end(); ++i)
+        void Allocate(StackAllocator& allocator)
         {
-            if (int nb_refs = i->second.second)
+            // Allocate in hash order and reuse the reference counts as write positions
+            for (unsigned int i = 0; i < m_Parents.entries.size(); i++)
             {
-                PARENT_TYPE& parent = *i->second.first;
-                allocator.Alloc((parent.*carray), nb_refs);
+                unsigned int index = m_Parents.entries[i];
+                if (unsigned int count = m_NbRefs[index])
+                {
+                    allocator.Alloc((m_Parents.Get(index)->*m_CArray), count);
+                    m_NbRefs[index] = 0;
+                }
+            }
+        }
 
-                // To save having to do any further lookups, store the count inside the array
-                // at the end
-                (parent.*carray)[nb_refs - 1] = 0;
+        void Fill()
+        {
+            // Only add children that were assigned a parent by this pass, as a later pass over the
+            // same children may have matched since
+            for (unsigned int i = 0; i < m_Children.size(); i++)
+            {
+                unsigned int index = m_ChildParents[i];
+                if (index != NO_PARENT)
+                    (m_Parents.Get(index)->*m_CArray)[m_NbRefs[index]++] = m_Children[i];
             }
         }
 
-        // Fill in all the arrays
-        for (unsigned int i = 0; i < children.size; i++)
+    private:
+        ParentMap<PARENT_TYPE>& m_Parents;
+        clcpp::CArray<const CHILD_TYPE*> PARENT_TYPE::*m_CArray;
+        std::vector<CHILD_TYPE*> m_Children;
+
+        // Index of the parent matched to each child and the reference count of each parent
+        std::vector<unsigned int> m_ChildParents;
+        std::vector<unsigned int> m_NbRefs;
+    };
+
+    class ParentPasses
+    {
+    public:
+        template <typename PARENT_TYPE, typename CHILD_TYPE>
+        void Add(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
+                 clcpp::CArray<CHILD_TYPE*>& children)
         {
-            CHILD_TYPE* child = children[i];
-            PARENT_TYPE* parent = (PARENT_TYPE*)child->parent;
+            std::vector<CHILD_TYPE*> children_ptrs(children.data, children.data + children.size);
+            Add(parents, carray, children_ptrs, children.data);
+        }
 
-            // Only process if the parent has been correctly assigned
-            if (parent >= parents.src_start && parent < parents.src_end)
+        template <typename PARENT_TYPE, typename CHILD_TYPE>
+        void Add(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
+                 clcpp::CArray<CHILD_TYPE>& children)
+        {
+            // Create an array of pointers to the children for the pass that acts on arrays of pointers
+            std::vector<CHILD_TYPE*> children_ptrs(children.size);
+            for (unsigned int i = 0; i < children.size; i++)
+                children_ptrs[i] = &children[i];
+            Add(parents, carray, children_ptrs, children.data);
+        }
+
+        void Run(StackAllocator& allocator, unsigned int nb_threads)
+        {
+            // Match each set of children on its own thread, keeping the order of their passes
+            TaskList tasks;
+            std::vector<const void*> children_ids;
+            for (size_t i = 0; i < m_Passes.size(); i++)
             {
-                // Locate the current constant count at the end of the array and add this constant
-                // to its parent
-                // TODO: check for 64-bit(we would only need this when CArray is bigger than ~2GB)
-                int nb_constants = (parent->*carray).size;
-                int cur_count = (int)((clcpp::pointer_type)(parent->*carray)[nb_constants - 1]);
-                (parent->*carray)[cur_count++] = child;
-
-                // When the last constant gets written, the constant count gets overwritten with
-                // the constant pointer and should no longer be updated
-                if (cur_count != nb_constants)
-                    (parent->*carray)[nb_constants - 1] = (CHILD_TYPE*)((clcpp::pointer_type)cur_count);
+                const void* children_id = m_Passes[i]->children_id;
+                if (std::find(children_ids.begin(), children_ids.end(), children_id) != children_ids.end())
+                    continue;
+                children_ids.push_back(children_id);
+
+                tasks.Add([this, children_id]() {
+                    for (size_t j = 0; j < m_Passes.size(); j++)
+                    {
+                        if (m_Passes[j]->children_id == children_id)
+                            m_Passes[j]->Match();
+                    }
+                });
             }
+            tasks.Run(nb_threads);
+
+            for (size_t i = 0; i < m_Passes.size(); i++)
+                m_Passes[i]->Allocate(allocator);
+
+            // Each pass fills a different array in its parents
+            for (size_t i = 0; i < m_Passes.size(); i++)
+            {
+                ParentPass* pass = m_Passes[i].get();
+                tasks.Add([pass]() { pass->Fill(); });
+            }
+            tasks.Run(nb_threads);
+
+            m_Passes.clear();
         }
-    }
 
-    template <typename PARENT_TYPE, typename CHILD_TYPE>
-    void Parent(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
-                clcpp::CArray<CHILD_TYPE>& children, StackAllocator& allocator)
-    {
-        // Create an array of pointers to the children and forward that to the Parent function
-        // that acts on arrays of pointers
-        Malloc malloc_allocator;
-        CArray<CHILD_TYPE*> children_ptrs(children.size, &malloc_allocator);
-        for (unsigned int i = 0; i < children_ptrs.size; i++)
-            children_ptrs[i] = &children[i];
+    private:
+        template <typename PARENT_TYPE, typename CHILD_TYPE>
+        void Add(ParentMap<PARENT_TYPE>& parents, clcpp::CArray<const CHILD_TYPE*>(PARENT_TYPE::*carray),
+                 std::vector<CHILD_TYPE*>& children_ptrs, const void* children_id)
+        {
+            ParentPass* pass = new ParentPassImpl<PARENT_TYPE, CHILD_TYPE>(parents, carray, children_ptrs);
+            pass->children_id = children_id;
+            m_Passes.push_back(std::unique_ptr<ParentPass>(pass));
+        }
 
-        Parent(parents, carray, children_ptrs, allocator);
-    }
+        std::vector<std::unique_ptr<ParentPass>> m_Passes;
+    };
 
     template <typename TYPE>
     void BuildAttributePtrArray(clcpp::CArray<clcpp::Attribute*>& dest, clcpp::CArray<TYPE>& src, int& pos)
@@ -520,9 +788,8 @@ namespace
                 else
                 {
                     // Parent the container to any fields
-                    ParentMap<clcpp::Field>::Iterator parent_field = field_parents.map.find(ci.name.hash);
-                    if (parent_field != field_parents.map.end())
-                        const_cast<clcpp::Field*>(parent_field->second.first)->ci = &ci;
+                    if (clcpp::Field* parent_field = field_parents.FindFirst(ci.name.hash))
+                        parent_field->ci = &ci;
                 }
             }
         }
@@ -537,8 +804,8 @@ namespace
              i != db.m_TypeInheritances.end(); ++i)
         {
             const cldb::TypeInheritance& inherit = i->second;
-            const char* base_type_str = inherit.base_type.text.c_str();
-            const char* derived_type_str = inherit.derived_type.text.c_str();
+            const char* base_type_str = inherit.base_type.text;
+            const char* derived_type_str = inherit.derived_type.text;
 
             const clcpp::Type* base_type = clcpp::FindPrimitive(cppexp.db->type_primitives, inherit.base_type.hash);
             if (base_type != 0)
@@ -719,6 +986,27 @@ namespace
             SortPrimitives(primitives[i]);
     }
 
+    // Number of primitives given to each task when a phase splits their array
+    const unsigned int PRIMITIVES_PER_TASK = 4096;
+
+    template <typename TYPE>
+    void AddSortTasks(TaskList& tasks, clcpp::CArray<TYPE>& primitives)
+    {
+        for (unsigned int start = 0; start < primitives.size; start += PRIMITIVES_PER_TASK)
+        {
+            unsigned int end = std::min(start + PRIMITIVES_PER_TASK, primitives.size);
+            tasks.Add([&primitives, start, end]() {
+                for (unsigned int i = start; i < end; i++)
+                    SortPrimitives(primitives[i]);
+            });
+        }
+    }
+    template <typename TYPE>
+    void AddSortTasks(TaskList& tasks, clcpp::CArray<const TYPE*>& primitives)
+    {
+        tasks.Add([&primitives]() { SortPrimitives(primitives); });
+    }
+
     void FindClassConstructors(CppExport& cppexp)
     {
         // Search each class method list for constructors and destructors
@@ -937,18 +1225,47 @@ namespace
         return 0;
     }
 
+    // Warnings from verifying a range of primitives, kept until all ranges have been verified
+    // so that they're logged in the same order however the work is split
+    class VerifyWarnings
+    {
+    public:
+        void Add(const char* format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            char buffer[512];
+#if defined(CLCPP_USING_MSVC)
+            vsnprintf_s(buffer, sizeof(buffer), _TRUNCATE, format, args);
+#else
+            vsnprintf(buffer, sizeof(buffer), format, args);
+#endif
+            va_end(args);
+            m_Warnings.push_back(buffer);
+        }
+
+        void Log() const
+        {
+            for (size_t i = 0; i < m_Warnings.size(); i++)
+                LOG(main, WARNING, "%s", m_Warnings[i].c_str());
+        }
+
+    private:
+        std::vector<std::string> m_Warnings;
+    };
+
     // Overloads for verifying the pointers of each primitive type
-    void VerifyPrimitive(CppExport& cppexp, const clcpp::Primitive& primitive)
+    void VerifyPrimitive(CppExport& cppexp, VerifyWarnings& warnings, const clcpp::Primitive& primitive)
     {
         // Note that the arrays within primitives are only populated if the parents of their
         // contents are valid so there is no need to check them for validity; only the
         // individual parent pointers.
         if (const char* unresolved = VerifyPtr(cppexp, primitive.parent))
-            LOG(main, WARNING, "Primitive '%s' couldn't find parent reference to '%s'\n", primitive.name.text, unresolved);
+            warnings.Add("Primitive '%s' couldn't find parent reference to '%s'\n", primitive.name.text, unresolved);
     }
-    void VerifyPrimitive(CppExport& cppexp, const clcpp::Field& primitive)
+    void VerifyPrimitive(CppExport& cppexp, VerifyWarnings& warnings, const clcpp::Field& primitive)
     {
-        VerifyPrimitive(cppexp, (clcpp::Primitive&)primitive);
+        VerifyPrimitive(cppexp, warnings, (clcpp::Primitive&)primitive);
 
         if (const char* unresolved = VerifyPtr(cppexp, primitive.type))
         {
@@ -958,11 +1275,11 @@ namespace
                 switch (primitive.parent->kind)
                 {
                 case (clcpp::Primitive::KIND_FUNCTION):
-                    LOG(main, WARNING, "Function parameter '%s' within '%s' couldn't find type reference to '%s'\n",
+                    warnings.Add("Function parameter '%s' within '%s' couldn't find type reference to '%s'\n",
                         primitive.name.text, primitive.parent->name.text, unresolved);
                     break;
                 case (clcpp::Primitive::KIND_CLASS):
-                    LOG(main, WARNING, "Class field '%s' within '%s' couldn't find type reference to '%s'\n", primitive.name.text,
+                    warnings.Add("Class field '%s' within '%s' couldn't find type reference to '%s'\n", primitive.name.text,
                         primitive.parent->name.text, unresolved);
                     break;
                 default:
@@ -971,64 +1288,80 @@ namespace
             }
             else
             {
-                LOG(main, WARNING, "Unparented field '%s' couldn't find type reference to '%s'\n", primitive.name.text,
+                warnings.Add("Unparented field '%s' couldn't find type reference to '%s'\n", primitive.name.text,
                     unresolved);
             }
         }
     }
-    void VerifyPrimitive(CppExport& cppexp, const clcpp::PrimitiveAttribute& primitive)
+    void VerifyPrimitive(CppExport& cppexp, VerifyWarnings& warnings, const clcpp::PrimitiveAttribute& primitive)
     {
         if (const char* unresolved = VerifyPtr(cppexp, primitive.primitive))
-            LOG(main, WARNING, "Attribute '%s' couldn't find primitive reference to '%s'\n", primitive.name.text, unresolved);
+            warnings.Add("Attribute '%s' couldn't find primitive reference to '%s'\n", primitive.name.text, unresolved);
     }
-    void VerifyPrimitive(CppExport& cppexp, const clcpp::Type& primitive)
+    void VerifyPrimitive(CppExport& cppexp, VerifyWarnings& warnings, const clcpp::Type& primitive)
     {
-        VerifyPrimitive(cppexp, (clcpp::Primitive&)primitive);
+        VerifyPrimitive(cppexp, warnings, (clcpp::Primitive&)primitive);
 
         // Report any warnings with unresolved base class types
         for (unsigned int i = 0; i < primitive.base_types.size; i++)
         {
             if (const char* unresolved = VerifyPtr(cppexp, primitive.base_types[i]))
-                LOG(main, WARNING, "Type '%s' couldn't find base type reference to '%s'\n", primitive.name.text, unresolved);
+                warnings.Add("Type '%s' couldn't find base type reference to '%s'\n", primitive.name.text, unresolved);
         }
     }
-    void VerifyPrimitive(CppExport& cppexp, const clcpp::TemplateType& primitive)
+    void VerifyPrimitive(CppExport& cppexp, VerifyWarnings& warnings, const clcpp::TemplateType& primitive)
     {
-        VerifyPrimitive(cppexp, (clcpp::Type&)primitive);
+        VerifyPrimitive(cppexp, warnings, (clcpp::Type&)primitive);
 
         for (int i = 0; i < clcpp::TemplateType::MAX_NB_ARGS; i++)
         {
             // Report any warnings with unresolved template parameter types
             if (const char* unresolved = VerifyPtr(cppexp, primitive.parameter_types[i]))
-                LOG(main, WARNING, "Template parameter within '%s' couldn't find type reference to '%s'\n", primitive.name.text,
+                warnings.Add("Template parameter within '%s' couldn't find type reference to '%s'\n", primitive.name.text,
                     unresolved);
         }
     }
 
     template <typename TYPE>
-    void VerifyPrimitives(CppExport& cppexp, const clcpp::CArray<TYPE>& primitives)
+    void AddVerifyTasks(CppExport& cppexp, TaskList& tasks, std::vector<VerifyWarnings>& warnings,
+                        const clcpp::CArray<TYPE>& primitives)
     {
         // Verifies all primitives in an array
-        for (unsigned int i = 0; i < primitives.size; i++)
-            VerifyPrimitive(cppexp, primitives[i]);
+        for (unsigned int start = 0; start < primitives.size; start += PRIMITIVES_PER_TASK)
+        {
+            unsigned int end = std::min(start + PRIMITIVES_PER_TASK, primitives.size);
+            size_t task_index = warnings.size();
+            warnings.push_back(VerifyWarnings());
+            tasks.Add([&cppexp, &warnings, &primitives, start, end, task_index]() {
+                for (unsigned int i = start; i < end; i++)
+                    VerifyPrimitive(cppexp, warnings[task_index], primitives[i]);
+            });
+        }
     }
 
     void VerifyPrimitives(CppExport& cppexp)
     {
-        VerifyPrimitives(cppexp, cppexp.db->types);
-        VerifyPrimitives(cppexp, cppexp.db->enum_constants);
-        VerifyPrimitives(cppexp, cppexp.db->enums);
-        VerifyPrimitives(cppexp, cppexp.db->fields);
-        VerifyPrimitives(cppexp, cppexp.db->functions);
-        VerifyPrimitives(cppexp, cppexp.db->classes);
-        VerifyPrimitives(cppexp, cppexp.db->templates);
-        VerifyPrimitives(cppexp, cppexp.db->template_types);
-        VerifyPrimitives(cppexp, cppexp.db->namespaces);
-        VerifyPrimitives(cppexp, cppexp.db->flag_attributes);
-        VerifyPrimitives(cppexp, cppexp.db->int_attributes);
-        VerifyPrimitives(cppexp, cppexp.db->float_attributes);
-        VerifyPrimitives(cppexp, cppexp.db->primitive_attributes);
-        VerifyPrimitives(cppexp, cppexp.db->text_attributes);
+        // Each task keeps its own warnings, which are logged in order once all tasks have run
+        std::vector<VerifyWarnings> warnings;
+        TaskList tasks;
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->types);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->enum_constants);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->enums);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->fields);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->functions);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->classes);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->templates);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->template_types);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->namespaces);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->flag_attributes);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->int_attributes);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->float_attributes);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->primitive_attributes);
+        AddVerifyTasks(cppexp, tasks, warnings, cppexp.db->text_attributes);
+        tasks.Run(cppexp.nb_threads);
+
+        for (size_t i = 0; i < warnings.size(); i++)
+            warnings[i].Log();
     }
 
     void RemoveInvalidFields(clcpp::CArray<const clcpp::Field*>& fields)
@@ -1088,35 +1421,53 @@ namespace
             RemoveInvalidFunctions(primitive.functions);
         }
     }
+
+    // Closes the current export phase in the trace and starts the next one
+    void EndPhase(const char* name, clcpp::uint64& phase_start)
+    {
+        clcpp::uint64 now = trace::Now();
+        trace::Span(name, 0, phase_start, now);
+        phase_start = now;
+    }
 }
 
 bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
 {
+    TRACE_SCOPE("BuildCppExport");
+    clcpp::uint64 phase_start = trace::Now();
+
     // Allocate the in-memory database
     cppexp.db = cppexp.allocator.Alloc<clcpp::internal::DatabaseMem>(1);
     cppexp.db->function_base_address = cppexp.function_base_address;
 
     // Build all the name data ready for the client to use and the exporter to debug with
     BuildNames(db, cppexp);
+    EndPhase("BuildNames", phase_start);
 
     // Generate a raw clcpp equivalent of the cldb database. At this point no primitives
     // will physically point to or contain each other, but they will reference each other
-    // using hash values aliased in their pointers.
-    BuildCArray<cldb::Type>(cppexp, cppexp.db->types, db);
-    BuildCArray<cldb::EnumConstant>(cppexp, cppexp.db->enum_constants, db);
-    BuildCArray<cldb::Enum>(cppexp, cppexp.db->enums, db);
-    BuildCArray<cldb::Field>(cppexp, cppexp.db->fields, db);
-    BuildCArray<cldb::Function>(cppexp, cppexp.db->functions, db);
-    BuildCArray<cldb::Class>(cppexp, cppexp.db->classes, db);
-    BuildCArray<cldb::Template>(cppexp, cppexp.db->templates, db);
-    BuildCArray<cldb::TemplateType>(cppexp, cppexp.db->template_types, db);
-    BuildCArray<cldb::Namespace>(cppexp, cppexp.db->namespaces, db);
-    BuildCArray<cldb::FlagAttribute>(cppexp, cppexp.db->flag_attributes, db);
-    BuildCArray<cldb::IntAttribute>(cppexp, cppexp.db->int_attributes, db);
-    BuildCArray<cldb::FloatAttribute>(cppexp, cppexp.db->float_attributes, db);
-    BuildCArray<cldb::PrimitiveAttribute>(cppexp, cppexp.db->primitive_attributes, db);
-    BuildCArray<cldb::TextAttribute>(cppexp, cppexp.db->text_attributes, db);
-    BuildCArray<cldb::ContainerInfo>(cppexp, cppexp.db->container_infos, db);
+    // using hash values aliased in their pointers. Arrays are allocated in order before
+    // being copied concurrently.
+    TaskList tasks;
+    MissingNames missing_names;
+    BuildCArray<cldb::Type>(cppexp, cppexp.db->types, db, tasks, missing_names);
+    BuildCArray<cldb::EnumConstant>(cppexp, cppexp.db->enum_constants, db, tasks, missing_names);
+    BuildCArray<cldb::Enum>(cppexp, cppexp.db->enums, db, tasks, missing_names);
+    BuildCArray<cldb::Field>(cppexp, cppexp.db->fields, db, tasks, missing_names);
+    BuildCArray<cldb::Function>(cppexp, cppexp.db->functions, db, tasks, missing_names);
+    BuildCArray<cldb::Class>(cppexp, cppexp.db->classes, db, tasks, missing_names);
+    BuildCArray<cldb::Template>(cppexp, cppexp.db->templates, db, tasks, missing_names);
+    BuildCArray<cldb::TemplateType>(cppexp, cppexp.db->template_types, db, tasks, missing_names);
+    BuildCArray<cldb::Namespace>(cppexp, cppexp.db->namespaces, db, tasks, missing_names);
+    BuildCArray<cldb::FlagAttribute>(cppexp, cppexp.db->flag_attributes, db, tasks, missing_names);
+    BuildCArray<cldb::IntAttribute>(cppexp, cppexp.db->int_attributes, db, tasks, missing_names);
+    BuildCArray<cldb::FloatAttribute>(cppexp, cppexp.db->float_attributes, db, tasks, missing_names);
+    BuildCArray<cldb::PrimitiveAttribute>(cppexp, cppexp.db->primitive_attributes, db, tasks, missing_names);
+    BuildCArray<cldb::TextAttribute>(cppexp, cppexp.db->text_attributes, db, tasks, missing_names);
+    BuildCArray<cldb::ContainerInfo>(cppexp, cppexp.db->container_infos, db, tasks, missing_names);
+    tasks.Run(cppexp.nb_threads);
+    missing_names.AddTo(cppexp.name_map);
+    EndPhase("BuildCArray", phase_start);
 
     // Now ensure all text data is pointing into the data to be memory mapped
     AssignAttributeText(cppexp);
@@ -1124,6 +1475,7 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
     // Generate a list of references to all type primitives so that runtime serialisation code
     // can quickly look them up.
     GatherTypePrimitives(cppexp);
+    EndPhase("GatherTypePrimitives", phase_start);
 
     // Create a set of parent maps
     ParentMap<clcpp::Enum> enum_parents(cppexp.db->enums);
@@ -1134,20 +1486,22 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
 
     // Construct the primitive scope hierarchy, pointing primitives at their parents
     // and adding them to the arrays within their parents.
-    Parent(enum_parents, &clcpp::Enum::constants, cppexp.db->enum_constants, cppexp.allocator);
-    Parent(function_parents, &clcpp::Function::parameters, cppexp.db->fields, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::enums, cppexp.db->enums, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::classes, cppexp.db->classes, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::methods, cppexp.db->functions, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::fields, cppexp.db->fields, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::templates, cppexp.db->templates, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::namespaces, cppexp.db->namespaces, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::types, cppexp.db->types, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::enums, cppexp.db->enums, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::classes, cppexp.db->classes, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::functions, cppexp.db->functions, cppexp.allocator);
-    Parent(namespace_parents, &clcpp::Namespace::templates, cppexp.db->templates, cppexp.allocator);
-    Parent(template_parents, &clcpp::Template::instances, cppexp.db->template_types, cppexp.allocator);
+    ParentPasses parent_passes;
+    parent_passes.Add(enum_parents, &clcpp::Enum::constants, cppexp.db->enum_constants);
+    parent_passes.Add(function_parents, &clcpp::Function::parameters, cppexp.db->fields);
+    parent_passes.Add(class_parents, &clcpp::Class::enums, cppexp.db->enums);
+    parent_passes.Add(class_parents, &clcpp::Class::classes, cppexp.db->classes);
+    parent_passes.Add(class_parents, &clcpp::Class::methods, cppexp.db->functions);
+    parent_passes.Add(class_parents, &clcpp::Class::fields, cppexp.db->fields);
+    parent_passes.Add(class_parents, &clcpp::Class::templates, cppexp.db->templates);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::namespaces, cppexp.db->namespaces);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::types, cppexp.db->types);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::enums, cppexp.db->enums);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::classes, cppexp.db->classes);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::functions, cppexp.db->functions);
+    parent_passes.Add(namespace_parents, &clcpp::Namespace::templates, cppexp.db->templates);
+    parent_passes.Add(template_parents, &clcpp::Template::instances, cppexp.db->template_types);
+    parent_passes.Run(cppexp.allocator, cppexp.nb_threads);
 
     // Construct field parents after the fields themselves have been parented so that
     // their parents can be used to construct their fully-scoped names
@@ -1157,10 +1511,12 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
     // a single pointer array
     clcpp::CArray<clcpp::Attribute*> attributes;
     BuildAttributePtrArray(cppexp, attributes);
-    Parent(enum_parents, &clcpp::Enum::attributes, attributes, cppexp.allocator);
-    Parent(field_parents, &clcpp::Field::attributes, attributes, cppexp.allocator);
-    Parent(function_parents, &clcpp::Function::attributes, attributes, cppexp.allocator);
-    Parent(class_parents, &clcpp::Class::attributes, attributes, cppexp.allocator);
+    parent_passes.Add(enum_parents, &clcpp::Enum::attributes, attributes);
+    parent_passes.Add(field_parents, &clcpp::Field::attributes, attributes);
+    parent_passes.Add(function_parents, &clcpp::Function::attributes, attributes);
+    parent_passes.Add(class_parents, &clcpp::Class::attributes, attributes);
+    parent_passes.Run(cppexp.allocator, cppexp.nb_threads);
+    EndPhase("Parent", phase_start);
 
     // Link up any references between primitives
     Link(cppexp.db->fields, &clcpp::Field::type, cppexp.db->type_primitives);
@@ -1172,18 +1528,21 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
 
     // Gather any unparented primitives into the root namespace
     BuildGlobalNamespace(cppexp);
+    EndPhase("Link", phase_start);
 
     // Sort any primitive pointer arrays in the database by name hash, ascending. This
     // is to allow fast O(logN) searching of the primitive arrays at runtime with a
     // binary search.
-    SortPrimitives(cppexp.db->enums);
-    SortPrimitives(cppexp.db->fields);
-    SortPrimitives(cppexp.db->functions);
-    SortPrimitives(cppexp.db->classes);
-    SortPrimitives(cppexp.db->templates);
-    SortPrimitives(cppexp.db->template_types);
-    SortPrimitives(cppexp.db->namespaces);
-    SortPrimitives(cppexp.db->type_primitives);
+    AddSortTasks(tasks, cppexp.db->enums);
+    AddSortTasks(tasks, cppexp.db->fields);
+    AddSortTasks(tasks, cppexp.db->functions);
+    AddSortTasks(tasks, cppexp.db->classes);
+    AddSortTasks(tasks, cppexp.db->templates);
+    AddSortTasks(tasks, cppexp.db->template_types);
+    AddSortTasks(tasks, cppexp.db->namespaces);
+    AddSortTasks(tasks, cppexp.db->type_primitives);
+    tasks.Run(cppexp.nb_threads);
+    EndPhase("SortPrimitives", phase_start);
 
     // Container infos need to be parented to their owners and their read/writer iterator
     // pointers need to be linked to their reflected types
@@ -1197,6 +1556,7 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
     // local searches can take advantage of clcpp::FindPrimitive.
     FindClassConstructors(cppexp);
     FindTemplateTypeConstructors(cppexp);
+    EndPhase("BuildClassInfo", phase_start);
 
     // For each attribute array in a primitive, calculate a 32-bit value that represents all
     // common flag attributes applied to that primitive.
@@ -1210,6 +1570,7 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
 
     // Ensure any primitive attributes have their pointers patched
     AssignPrimitiveAttributes(cppexp);
+    EndPhase("FlagAttributes", phase_start);
 
     // Primitives reference each other via their names (hash codes). This code first of all copies
     // hashes into the pointers and then patches them up via lookup. If the input database doesn't
@@ -1222,12 +1583,24 @@ bool BuildCppExport(const cldb::Database& db, CppExport& cppexp)
     // The memory for the primitives is left allocated, however this shouldn't be an issue
     // if you compile is without warnings!
     IsolateInvalidPrimitives(cppexp);
+    EndPhase("VerifyPrimitives", phase_start);
+
+    trace::Counter("CppExport", "classes", cppexp.db->classes.size);
+    trace::Counter("CppExport", "functions", cppexp.db->functions.size);
+    trace::Counter("CppExport", "fields", cppexp.db->fields.size);
+    trace::Counter("CppExport", "allocated_bytes", cppexp.allocator.GetAllocatedSize());
+    trace::Counter("CppExport", "committed_bytes", cppexp.allocator.GetCommittedSize());
+    LOG(main, INFO, "C++ export uses %u bytes (%u bytes committed)\n", cppexp.allocator.GetAllocatedSize(),
+        cppexp.allocator.GetCommittedSize());
 
     return true;
 }
 
 void SaveCppExport(CppExport& cppexp, const char* filename)
 {
+    TRACE_SCOPE("SaveCppExport", filename);
+    clcpp::uint64 phase_start = trace::Now();
+
     PtrRelocator relocator(cppexp.allocator.GetData(), cppexp.allocator.GetAllocatedSize());
 
     // The position of the data member within a CArray is fixed, independent of type
@@ -1419,6 +1792,7 @@ void SaveCppExport(CppExport& cppexp, const char* filename)
 
     // Make all pointers relative to the start address
     relocator.MakeRelative();
+    EndPhase("Relocation", phase_start);
 
     // Open the output file
     FILE* fp = fopen(filename, "wb");
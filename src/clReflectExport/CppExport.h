@@ -22,9 +22,10 @@ namespace cldb
 
 struct CppExport
 {
-    CppExport(clcpp::pointer_type function_base_address)
-        : allocator(5 * 1024 * 1024) // 5MB should do for now
+    CppExport(clcpp::pointer_type function_base_address, unsigned int nb_threads = 1)
+        : allocator(2048u * 1024 * 1024) // Only address space, memory is committed as the database grows
         , function_base_address(function_base_address)
+        , nb_threads(nb_threads > 0 ? nb_threads : 1)
         , db(0)
     {
     }
@@ -32,6 +33,10 @@ struct CppExport
     StackAllocator allocator;
 
     clcpp::pointer_type function_base_address;
+
+    // Threads used to run independent export steps, which doesn't change the output
+    unsigned int nb_threads;
+
     clcpp::internal::DatabaseMem* db;
 
     // Hash of names for easier debugging
@@ -16,6 +16,9 @@
 #include <clReflectCore/DatabaseBinarySerialiser.h>
 #include <clReflectCore/DatabaseTextSerialiser.h>
 #include <clReflectCore/Logging.h>
+#include <clReflectCore/Trace.h>
+
+#include <thread>
 
 int main(int argc, const char* argv[])
 {
@@ -29,26 +32,56 @@ int main(int argc, const char* argv[])
         return 1;
     }
 
+    // Function addresses come from either a map file or an ELF binary, each with their own base address
+    std::string map_file = args.GetProperty("-map");
+    std::string elf_file = args.GetProperty("-elf");
+    if (map_file != "" && elf_file != "")
+    {
+        LOG(main, ERROR, "Only one of -map and -elf can be specified\n");
+        return 1;
+    }
+
+    std::string trace_filename = args.GetProperty("-trace");
+    if (trace_filename != "")
+        trace::Open(trace_filename.c_str(), "clexport");
+
+    // Use every hardware thread, which may not be known
+    unsigned int nb_threads = std::thread::hardware_concurrency();
+    if (nb_threads == 0)
+        nb_threads = 1;
+
     // Try to load the database
     const char* input_filename = args[1].c_str();
     cldb::Database db;
-    if (!cldb::ReadBinaryDatabase(input_filename, db))
     {
-        if (!cldb::ReadTextDatabase(input_filename, db))
+        TRACE_SCOPE("ReadDatabase", input_filename);
+        if (!cldb::ReadBinaryDatabase(input_filename, db, nb_threads))
         {
-            LOG(main, ERROR, "Couldn't read '%s' as binary or text database - does it exist?\n", input_filename);
-            return 1;
+            if (!cldb::ReadTextDatabase(input_filename, db))
+            {
+                LOG(main, ERROR, "Couldn't read '%s' as binary or text database - does it exist?\n", input_filename);
+                return 1;
+            }
         }
     }
 
     // Add function address information from any specified map files
-    std::string map_file = args.GetProperty("-map");
     clcpp::pointer_type function_base_address = 0;
 
     if (map_file != "")
     {
         LOG(main, INFO, "Parsing map file: %s\n", map_file.c_str());
-        MapFileParser parser(db, map_file.c_str());
+        TRACE_SCOPE("MapFileParser", map_file.c_str());
+        MapFileParser parser(db, map_file.c_str(), nb_threads);
+        function_base_address = parser.m_PreferredLoadAddress;
+    }
+
+    // Or read them from the symbol tables of an ELF binary
+    else if (elf_file != "")
+    {
+        LOG(main, INFO, "Reading ELF symbols: %s\n", elf_file.c_str());
+        TRACE_SCOPE("ElfSymbolParser", elf_file.c_str());
+        ElfSymbolParser parser(db, elf_file.c_str());
         function_base_address = parser.m_PreferredLoadAddress;
     }
 
@@ -56,19 +89,28 @@ int main(int argc, const char* argv[])
     if (cpp_export != "")
     {
         // First build the C++ export representation
-        CppExport cppexp(function_base_address);
+        CppExport cppexp(function_base_address, nb_threads);
         if (!BuildCppExport(db, cppexp))
             return 1;
 
         // Pretty-print the result to the specified output file
         std::string cpp_log = args.GetProperty("-cpp_log");
         if (cpp_log != "")
+        {
+            TRACE_SCOPE("WriteCppExportAsText", cpp_log.c_str());
             WriteCppExportAsText(cppexp, cpp_log.c_str());
+        }
 
         // Save to disk
         // NOTE: After this point the CppExport object is useless (TODO: fix)
         SaveCppExport(cppexp, cpp_export.c_str());
     }
 
+    if (!trace::Close())
+    {
+        LOG(main, ERROR, "Couldn't write trace file '%s'\n", trace_filename.c_str());
+        return 1;
+    }
+
     return 0;
 }
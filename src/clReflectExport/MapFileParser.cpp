@@ -17,6 +17,7 @@
     #include <windows.h>
     #include <DbgHelp.h>
 // clang-format on
+    #include <mutex>
 
 #else
 
@@ -29,9 +30,15 @@
 #include <clReflectCore/Database.h>
 #include <clReflectCore/FileUtils.h>
 #include <clReflectCore/Logging.h>
+#include <clReflectCore/MappedFile.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace
 {
@@ -149,7 +156,7 @@ namespace
 
     bool IsVoidParameter(const cldb::Field& field)
     {
-        return field.qualifier.op == cldb::Qualifier::VALUE && field.type.text == "void";
+        return field.qualifier.op == cldb::Qualifier::VALUE && !strcmp(field.type.text, "void");
     }
 
     bool IsConstructFunction(const std::string& function_name)
@@ -381,6 +388,95 @@ namespace
         AddClassImplFunction(db, function_signature, function_address, false);
     }
 
+    // Reads lines from a memory-mapped map file the way ReadLine reads them from a file: lines are
+    // truncated to fit the buffer and a final line without a newline is ignored
+    class MapLineReader
+    {
+    public:
+        MapLineReader(const char* begin, const char* end)
+            : m_Pos(begin)
+            , m_End(end)
+        {
+        }
+
+        const char* ReadLine()
+        {
+            const char* eol = m_Pos != m_End ? (const char*)memchr(m_Pos, '\n', m_End - m_Pos) : 0;
+            if (eol == 0)
+            {
+                m_Pos = m_End;
+                return 0;
+            }
+
+            size_t length = std::min((size_t)(eol - m_Pos), sizeof(m_Line) - 1);
+            memcpy(m_Line, m_Pos, length);
+            m_Line[length] = 0;
+            m_Pos = eol + 1;
+            return m_Line;
+        }
+
+        // Start of the next line to be read
+        const char* GetPos() const
+        {
+            return m_Pos;
+        }
+
+    private:
+        const char* m_Pos;
+        const char* m_End;
+        char m_Line[4096];
+    };
+
+    // Splits the lines between begin and end into chunks that are parsed across a number of threads,
+    // appending the results to the vector in file order so that they can be added to the database the
+    // same way every time. Each thread parses with its own copy of the line parser so that any caches
+    // it keeps don't need to be shared.
+    template <typename LINE_PARSER>
+    void ParseLines(const char* begin, const char* end, unsigned int nb_threads, const LINE_PARSER& line_parser,
+                    std::vector<typename LINE_PARSER::Result>& results)
+    {
+        // Aim for a few chunks per thread to balance the load, ending each after a newline
+        nb_threads = std::max(nb_threads, 1u);
+        const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+        size_t chunk_size = std::max(MIN_CHUNK_SIZE, (size_t)(end - begin) / (nb_threads * 4));
+        std::vector<const char*> chunk_starts(1, begin);
+        while ((size_t)(end - chunk_starts.back()) > chunk_size)
+        {
+            const char* search = chunk_starts.back() + chunk_size;
+            const char* eol = (const char*)memchr(search, '\n', end - search);
+            if (eol == 0)
+                break;
+            chunk_starts.push_back(eol + 1);
+        }
+        chunk_starts.push_back(end);
+
+        size_t nb_chunks = chunk_starts.size() - 1;
+        std::vector<std::vector<typename LINE_PARSER::Result>> chunk_results(nb_chunks);
+        std::atomic<size_t> next_chunk(0);
+        auto parse_chunks = [&]() {
+            LINE_PARSER parser = line_parser;
+            for (size_t i = next_chunk++; i < nb_chunks; i = next_chunk++)
+            {
+                MapLineReader reader(chunk_starts[i], chunk_starts[i + 1]);
+                while (const char* line = reader.ReadLine())
+                    parser.ParseLine(line, chunk_results[i]);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < nb_threads && i < nb_chunks; i++)
+            threads.push_back(std::thread(parse_chunks));
+        parse_chunks();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+
+        for (size_t i = 0; i < nb_chunks; i++)
+        {
+            results.insert(results.end(), std::make_move_iterator(chunk_results[i].begin()),
+                           std::make_move_iterator(chunk_results[i].end()));
+        }
+    }
+
 // MSVC map parsing functions
 #if defined(CLCPP_USING_MSVC)
     bool InitialiseSymbolHandler()
@@ -441,87 +537,130 @@ namespace
         return function_address;
     }
 
-    void ParseMSVCMapFile(const char* filename, cldb::Database& db, clcpp::pointer_type& base_address)
+    // DbgHelp functions are single threaded so calls from the map file parsing threads are serialised
+    std::mutex g_DbgHelpMutex;
+
+    // A public symbol from the map file that may have an address to store in the database
+    struct MSVCMapSymbol
     {
-        if (!InitialiseSymbolHandler())
+        enum Kind
         {
-            return;
-        }
+            CONSTRUCT_FUNCTION,
+            DESTRUCT_FUNCTION,
+            GET_TYPE_FUNCTION,
+            GET_TYPE_NAME_HASH_FUNCTION,
+            FUNCTION
+        };
+
+        Kind kind;
+        std::string function_name;
+        std::string function_signature;
+
+        // The rest of the line, starting with the address
+        std::string address_field;
+    };
+
+    class MSVCMapLineParser
+    {
+    public:
+        typedef MSVCMapSymbol Result;
 
-        FILE* fp = fopen(filename, "rb");
-        if (fp == 0)
+        MSVCMapLineParser(const cldb::Database& db)
+            : m_DB(&db)
         {
-            return;
         }
 
-        bool public_symbols = false;
-        while (const char* line = ReadLine(fp))
+        void ParseLine(const char* line, std::vector<Result>& results)
         {
-            if (public_symbols)
+            char token[1024];
+
+            // Consume everything up to the function name
+            line = SkipWhitespace(line);
+            line = ConsumeToken(line, ' ', token, sizeof(token));
+            line = SkipWhitespace(line);
+            line = ConsumeToken(line, ' ', token, sizeof(token));
+
+            // Undecorate the symbol name alone and see if it's a known clcpp function
+            Symbol& symbol = m_Symbols[token];
+            if (!symbol.undecorated)
             {
-                char token[1024];
+                std::lock_guard<std::mutex> lock(g_DbgHelpMutex);
+                symbol.function_name = UndecorateFunctionName(token);
+                symbol.undecorated = true;
+            }
 
-                // Consume everything up to the function name
-                line = SkipWhitespace(line);
-                line = ConsumeToken(line, ' ', token, sizeof(token));
-                line = SkipWhitespace(line);
-                line = ConsumeToken(line, ' ', token, sizeof(token));
+            Result result;
+            const std::string& function_name = symbol.function_name;
+            if (IsConstructFunction(function_name))
+                result.kind = MSVCMapSymbol::CONSTRUCT_FUNCTION;
+            else if (IsDestructFunction(function_name))
+                result.kind = MSVCMapSymbol::DESTRUCT_FUNCTION;
+            else if (IsGetTypeFunction(function_name))
+                result.kind = MSVCMapSymbol::GET_TYPE_FUNCTION;
+            else if (IsGetTypeNameHashFunction(function_name))
+                result.kind = MSVCMapSymbol::GET_TYPE_NAME_HASH_FUNCTION;
+
+            // Otherwise see if it's a function in the database
+            else if (m_DB->GetFirstPrimitive<cldb::Function>(function_name.c_str()))
+                result.kind = MSVCMapSymbol::FUNCTION;
+            else
+                return;
 
-                // Undecorate the symbol name alone and see if it's a known clcpp function
-                std::string function_name = UndecorateFunctionName(token);
-                if (IsConstructFunction(function_name))
-                {
-                    std::string function_signature = UndecorateFunctionSignature(token);
-                    clcpp::pointer_type function_address = ParseAddressField(line, function_name.c_str());
-                    AddConstructFunction(db, function_signature, function_address);
-                }
-                else if (IsDestructFunction(function_name))
-                {
-                    std::string function_signature = UndecorateFunctionSignature(token);
-                    clcpp::pointer_type function_address = ParseAddressField(line, function_name.c_str());
-                    AddDestructFunction(db, function_signature, function_address);
-                }
-                else if (IsGetTypeFunction(function_name))
-                {
-                    clcpp::pointer_type function_address = ParseAddressField(line, function_name.c_str());
-                    AddGetTypeAddress(db, function_name, function_address, true);
-                }
-                else if (IsGetTypeNameHashFunction(function_name))
+            // Only functions that need their parameters matched need the full signature
+            if (result.kind == MSVCMapSymbol::CONSTRUCT_FUNCTION || result.kind == MSVCMapSymbol::DESTRUCT_FUNCTION ||
+                result.kind == MSVCMapSymbol::FUNCTION)
+            {
+                if (!symbol.has_signature)
                 {
-                    clcpp::pointer_type function_address = ParseAddressField(line, function_name.c_str());
-                    AddGetTypeAddress(db, function_name, function_address, false);
+                    std::lock_guard<std::mutex> lock(g_DbgHelpMutex);
+                    symbol.function_signature = UndecorateFunctionSignature(token);
+                    symbol.has_signature = true;
                 }
+                result.function_signature = symbol.function_signature;
+            }
 
-                // Otherwise see if it's a function in the database
-                else if (const cldb::Function* function = db.GetFirstPrimitive<cldb::Function>(function_name.c_str()))
-                {
-                    std::string function_signature = UndecorateFunctionSignature(token);
-                    clcpp::pointer_type function_address = ParseAddressField(line, function_name.c_str());
+            result.function_name = function_name;
+            result.address_field = line;
+            results.push_back(result);
+        }
+
+    private:
+        // Undecorated names of the symbols seen so far
+        struct Symbol
+        {
+            Symbol()
+                : undecorated(false)
+                , has_signature(false)
+            {
+            }
 
-                    bool is_this_call = false;
-                    const char* ptr = function_signature.c_str();
-                    size_t func_pos = function_signature.find(function_name);
+            std::string function_name;
+            std::string function_signature;
+            bool undecorated;
+            bool has_signature;
+        };
 
-                    if (func_pos == std::string::npos)
-                    {
-                        LOG(main, ERROR, "Couldn't locate function name in signature for '%s'", function_name.c_str());
-                        return;
-                    }
+        const cldb::Database* m_DB;
+        std::unordered_map<std::string, Symbol> m_Symbols;
+    };
 
-                    // Skip the return parameter as it can't be used to overload a function
-                    cldb::Field returnValue = MatchParameter(db, ptr, ptr + func_pos, is_this_call);
-                    AddFunctionAddress(db, function_name, function_signature, function_address, is_this_call,
-                                       returnValue.qualifier.is_const);
-                }
-            }
+    void ParseMSVCMapFile(const char* filename, cldb::Database& db, clcpp::pointer_type& base_address, unsigned int nb_threads)
+    {
+        if (!InitialiseSymbolHandler())
+        {
+            return;
+        }
 
-            // Look for the start of the public symbols descriptors
-            else if (strstr(line, "  Address"))
-            {
-                ReadLine(fp);
-                public_symbols = true;
-            }
+        MappedFile file;
+        if (!file.Open(filename))
+        {
+            ShutdownSymbolHandler();
+            return;
+        }
 
+        MapLineReader reader(file.Data(), file.Data() + file.Size());
+        while (const char* line = reader.ReadLine())
+        {
             // Parse the preferred load address
             if (base_address == 0 && strstr(line, "Preferred load address is "))
             {
@@ -535,8 +674,63 @@ namespace
                 base_address = hextoi(token);
     #endif
             }
+
+            // Look for the start of the public symbols descriptors
+            else if (strstr(line, "  Address"))
+            {
+                reader.ReadLine();
+                break;
+            }
+        }
+
+        // Undecorate and filter the public symbols on multiple threads
+        std::vector<MSVCMapSymbol> symbols;
+        ParseLines(reader.GetPos(), file.Data() + file.Size(), nb_threads, MSVCMapLineParser(db), symbols);
+
+        // Add their addresses to the database in map file order
+        for (size_t i = 0; i < symbols.size(); i++)
+        {
+            const MSVCMapSymbol& symbol = symbols[i];
+            const std::string& function_name = symbol.function_name;
+            const std::string& function_signature = symbol.function_signature;
+            clcpp::pointer_type function_address = ParseAddressField(symbol.address_field.c_str(), function_name.c_str());
+
+            switch (symbol.kind)
+            {
+            case (MSVCMapSymbol::CONSTRUCT_FUNCTION):
+                AddConstructFunction(db, function_signature, function_address);
+                break;
+            case (MSVCMapSymbol::DESTRUCT_FUNCTION):
+                AddDestructFunction(db, function_signature, function_address);
+                break;
+            case (MSVCMapSymbol::GET_TYPE_FUNCTION):
+                AddGetTypeAddress(db, function_name, function_address, true);
+                break;
+            case (MSVCMapSymbol::GET_TYPE_NAME_HASH_FUNCTION):
+                AddGetTypeAddress(db, function_name, function_address, false);
+                break;
+            case (MSVCMapSymbol::FUNCTION):
+            {
+                bool is_this_call = false;
+                const char* ptr = function_signature.c_str();
+                size_t func_pos = function_signature.find(function_name);
+
+                if (func_pos == std::string::npos)
+                {
+                    LOG(main, ERROR, "Couldn't locate function name in signature for '%s'", function_name.c_str());
+                    ShutdownSymbolHandler();
+                    return;
+                }
+
+                // Skip the return parameter as it can't be used to overload a function
+                cldb::Field returnValue = MatchParameter(db, ptr, ptr + func_pos, is_this_call);
+                AddFunctionAddress(db, function_name, function_signature, function_address, is_this_call,
+                                   returnValue.qualifier.is_const);
+                break;
+            }
+            }
         }
-        fclose(fp);
+
         ShutdownSymbolHandler();
     }
 #endif // CLCPP_USING_MSVC
@@ -685,9 +879,9 @@ namespace
                                      replace_stack);
     }
 
-    void ProcessFunctionItem(cldb::Database& db, const std::string& function_signature, clcpp::pointer_type function_address)
+    void ProcessFunctionItem(cldb::Database& db, const std::string& function_signature, const std::string& function_name,
+                             clcpp::pointer_type function_address)
     {
-        std::string function_name = ParseFunctionName(function_signature);
         if (function_name.size() == 0)
         {
             LOG(main, ERROR, "Cannot parse function name from function signature '%s'", function_signature.c_str());
@@ -744,54 +938,139 @@ namespace
         }
     }
 
-    void ParseMacGCCMapFile(FILE* fp, cldb::Database& db, clcpp::pointer_type& base_address)
+    // Demangled signatures and function names of the symbols seen so far, so that each symbol is
+    // demangled and parsed once however many times it's listed
+    class DemangleCache
     {
-        bool section_region = false;
-        bool symbol_region = false;
+    public:
+        struct Entry
+        {
+            Entry()
+                : address(0)
+            {
+            }
 
-        clcpp::pointer_type function_address;
-        clcpp::size_type function_size;
-        int file_id;
-        char segment_buffer[1024];
-        char signature_buffer[1024];
+            // Empty if the symbol couldn't be demangled or isn't a function
+            std::string signature;
+            std::string function_name;
+
+            // Address the symbol was last processed with
+            clcpp::pointer_type address;
+        };
 
-        while (const char* line = ReadLine(fp))
+        Entry& Get(const char* mangled_name)
         {
-            if (section_region)
+            std::pair<std::unordered_map<std::string, Entry>::iterator, bool> i =
+                m_Entries.insert(std::make_pair(std::string(mangled_name), Entry()));
+            Entry& entry = i.first->second;
+            if (!i.second)
+                return entry;
+
+            int status;
+            char* demangle_signature = abi::__cxa_demangle(mangled_name, 0, 0, &status);
+            if (status == 0)
             {
-                if (sscanf(line, "0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " 0x%" CLCPP_SIZE_TYPE_HEX_FORMAT " %s %s",
-                           &function_address, &function_size, segment_buffer, signature_buffer) == 4)
+                // Noisy symbols like "vtable for ArrayReadIterator" aren't needed
+                if (!strstr(demangle_signature, " for "))
                 {
-                    if (strcmp(signature_buffer, "__text") == 0)
-                    {
-                        base_address = function_address;
-                    }
+                    entry.signature = demangle_signature;
+                    entry.function_name = ParseFunctionName(entry.signature);
                 }
             }
-            else if (symbol_region)
+            if (demangle_signature != 0)
+            {
+                free(demangle_signature);
+            }
+
+            return entry;
+        }
+
+    private:
+        std::unordered_map<std::string, Entry> m_Entries;
+    };
+
+    // A demangled function symbol from a map file
+    struct GCCMapSymbol
+    {
+        std::string function_signature;
+        std::string function_name;
+        clcpp::pointer_type function_address;
+    };
+
+    void AddGCCMapSymbol(DemangleCache& demangle_cache, const char* mangled_name, clcpp::pointer_type function_address,
+                         std::vector<GCCMapSymbol>& results)
+    {
+        const DemangleCache::Entry& entry = demangle_cache.Get(mangled_name);
+        if (entry.signature.size() != 0)
+        {
+            GCCMapSymbol symbol = { entry.signature, entry.function_name, function_address };
+            results.push_back(symbol);
+        }
+    }
+
+    class MacGCCMapLineParser
+    {
+    public:
+        typedef GCCMapSymbol Result;
+
+        void ParseLine(const char* line, std::vector<Result>& results)
+        {
+            clcpp::pointer_type function_address;
+            clcpp::size_type function_size;
+            int file_id;
+            char signature_buffer[1024];
+
+            if (sscanf(line, "0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " 0x%" CLCPP_SIZE_TYPE_HEX_FORMAT " [%d] %1023s",
+                       &function_address, &function_size, &file_id, signature_buffer) == 4)
+            {
+                // Function names start with __
+                if (startswith(signature_buffer, "__"))
+                    AddGCCMapSymbol(m_DemangleCache, signature_buffer + 1, function_address, results);
+            }
+        }
+
+    private:
+        DemangleCache m_DemangleCache;
+    };
+
+    class LinuxGCCMapLineParser
+    {
+    public:
+        typedef GCCMapSymbol Result;
+
+        void ParseLine(const char* line, std::vector<Result>& results)
+        {
+            clcpp::pointer_type function_address;
+            char signature_buffer[1024];
+
+            if ((sscanf(line, " 0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " %1023s", &function_address, signature_buffer) == 2) &&
+                (signature_buffer[0] == '_'))
+                AddGCCMapSymbol(m_DemangleCache, signature_buffer, function_address, results);
+        }
+
+    private:
+        DemangleCache m_DemangleCache;
+    };
+
+    void ParseMacGCCMapFile(MapLineReader& reader, const char* end, std::vector<GCCMapSymbol>& symbols,
+                            clcpp::pointer_type& base_address, unsigned int nb_threads)
+    {
+        // Read up to the symbols, which are the last part of the map, looking for the start of the text section
+        bool section_region = false;
+        while (const char* line = reader.ReadLine())
+        {
+            if (section_region)
             {
-                if (sscanf(line, "0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " 0x%" CLCPP_SIZE_TYPE_HEX_FORMAT " [%d] %s",
-                           &function_address, &function_size, &file_id, signature_buffer) == 4)
+                clcpp::pointer_type section_address;
+                clcpp::size_type section_size;
+                char segment_buffer[1024];
+                char section_buffer[1024];
+                if (sscanf(line, "0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " 0x%" CLCPP_SIZE_TYPE_HEX_FORMAT " %1023s %1023s",
+                           &section_address, &section_size, segment_buffer, section_buffer) == 4)
                 {
-                    if (startswith(signature_buffer, "__"))
+                    if (strcmp(section_buffer, "__text") == 0)
                     {
-                        // function name starts with __
-                        int status;
-                        char* demangle_signature = abi::__cxa_demangle(signature_buffer + 1, 0, 0, &status);
-                        if (status == 0)
-                        {
-                            // In generated map some items are noisy data, for example:
-                            // "vtable for ArrayReadIterator"
-                            // We do not need such lines
-                            if (!strstr(demangle_signature, " for "))
-                            {
-                                ProcessFunctionItem(db, demangle_signature, function_address);
-                            }
-                        }
-                        if (demangle_signature != NULL)
-                        {
-                            free(demangle_signature);
-                        }
+                        base_address = section_address;
                     }
                 }
             }
@@ -799,95 +1078,368 @@ namespace
             if (strstr(line, "# Sections:"))
             {
                 // section region
-                ReadLine(fp);
+                reader.ReadLine();
                 section_region = true;
-                symbol_region = false;
             }
             else if (strstr(line, "# Symbols:"))
             {
                 // symbol region
-                ReadLine(fp);
-                section_region = false;
-                symbol_region = true;
+                reader.ReadLine();
+                ParseLines(reader.GetPos(), end, nb_threads, MacGCCMapLineParser(), symbols);
+                return;
             }
         }
     }
 
-    void ParseLinuxGCCMapFile(FILE* fp, cldb::Database& db, clcpp::pointer_type& base_address)
+    void ParseLinuxGCCMapFile(MapLineReader& reader, const char* end, std::vector<GCCMapSymbol>& symbols,
+                              clcpp::pointer_type& base_address, unsigned int nb_threads)
     {
-        bool text_region = false;
-
-        clcpp::pointer_type function_address, function_size;
-        char signature_buffer[1024];
-
-        while (const char* line = ReadLine(fp))
+        while (const char* line = reader.ReadLine())
         {
-            if (text_region)
-            {
-                if ((sscanf(line, " 0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " %s", &function_address, signature_buffer) == 2) &&
-                    (signature_buffer[0] == '_'))
-                {
-                    int status;
-                    char* demangle_signature = abi::__cxa_demangle(signature_buffer, 0, 0, &status);
-                    if (status == 0)
-                    {
-                        if (!strstr(demangle_signature, " for "))
-                        {
-                            ProcessFunctionItem(db, demangle_signature, function_address);
-                        }
-                    }
-                    if (demangle_signature != 0)
-                    {
-                        free(demangle_signature);
-                    }
-                }
-            }
-            else if (strstr(line, ".text") == line)
+            if (strstr(line, ".text") == line)
             {
+                clcpp::pointer_type section_address, section_size;
                 if (sscanf(line, ".text 0x%" CLCPP_POINTER_TYPE_HEX_FORMAT " 0x%" CLCPP_POINTER_TYPE_HEX_FORMAT,
-                           &function_address, &function_size) == 2)
+                           &section_address, &section_size) == 2)
                 {
-                    // text section start address
-                    base_address = function_address;
-                    text_region = true;
+                    // text section start address, after which all function symbols are listed
+                    base_address = section_address;
+                    ParseLines(reader.GetPos(), end, nb_threads, LinuxGCCMapLineParser(), symbols);
+                    return;
                 }
             }
         }
     }
 
-    void ParseGCCMapFile(const char* filename, cldb::Database& db, clcpp::pointer_type& base_address)
+    void ParseGCCMapFile(const char* filename, cldb::Database& db, clcpp::pointer_type& base_address, unsigned int nb_threads)
     {
-        FILE* fp = fopen(filename, "rb");
-        if (fp == 0)
+        MappedFile file;
+        if (!file.Open(filename))
         {
             return;
         }
 
-        const char* first_line = ReadLine(fp);
-        if (startswith(first_line, "# Path:"))
+        // Demangle the function symbols on multiple threads
+        const char* end = file.Data() + file.Size();
+        MapLineReader reader(file.Data(), end);
+        std::vector<GCCMapSymbol> symbols;
+        const char* first_line = reader.ReadLine();
+        if (first_line != 0 && startswith(first_line, "# Path:"))
         {
-            ParseMacGCCMapFile(fp, db, base_address);
+            ParseMacGCCMapFile(reader, end, symbols, base_address, nb_threads);
         }
-        else if (startswith(first_line, "Archive member included because of file (symbol)"))
+        else if (first_line != 0 && startswith(first_line, "Archive member included because of file (symbol)"))
         {
-            ParseLinuxGCCMapFile(fp, db, base_address);
+            ParseLinuxGCCMapFile(reader, end, symbols, base_address, nb_threads);
         }
         else
         {
             LOG(main, ERROR, "Unknown format of gcc map file!");
         }
 
-        fclose(fp);
+        // Add their addresses to the database in map file order
+        for (size_t i = 0; i < symbols.size(); i++)
+        {
+            const GCCMapSymbol& symbol = symbols[i];
+            ProcessFunctionItem(db, symbol.function_signature, symbol.function_name, symbol.function_address);
+        }
+    }
+
+    // Reads the section headers and symbol tables of a 32 or 64-bit little-endian ELF file in place,
+    // with bounds checks on everything that's read
+    class ElfFile
+    {
+    public:
+        struct Section
+        {
+            clcpp::uint64 addr;
+            clcpp::uint64 offset;
+            clcpp::uint64 size;
+            clcpp::uint64 entsize;
+            unsigned int name;
+            unsigned int type;
+            unsigned int link;
+        };
+
+        struct Symbol
+        {
+            clcpp::uint64 value;
+            const char* name;
+            unsigned int section_index;
+            unsigned char type;
+        };
+
+        static const unsigned int SHT_SYMTAB = 2;
+        static const unsigned int SHT_NOBITS = 8;
+        static const unsigned int SHT_DYNSYM = 11;
+        static const unsigned char STT_FUNC = 2;
+
+        ElfFile()
+            : m_Is64Bit(false)
+            , m_Ok(true)
+            , m_SectionHeaders(0)
+            , m_SectionHeaderSize(0)
+            , m_SectionNames()
+        {
+        }
+
+        bool Open(const char* filename)
+        {
+            if (!m_File.Open(filename))
+            {
+                LOG(main, ERROR, "Couldn't open ELF file '%s'\n", filename);
+                return false;
+            }
+
+            // Check the identification bytes
+            const unsigned char* ident = (const unsigned char*)m_File.Data();
+            if (m_File.Size() < 16 || memcmp(ident, "\x7f" "ELF", 4) != 0)
+            {
+                LOG(main, ERROR, "'%s' isn't an ELF file\n", filename);
+                return false;
+            }
+            if ((ident[4] != 1 && ident[4] != 2) || ident[5] != 1)
+            {
+                LOG(main, ERROR, "'%s' isn't a 32 or 64-bit little-endian ELF file\n", filename);
+                return false;
+            }
+            m_Is64Bit = ident[4] == 2;
+
+            // Locate the section headers
+            clcpp::uint64 shoff = m_Is64Bit ? Read<clcpp::uint64>(40) : Read<unsigned int>(32);
+            m_SectionHeaderSize = Read<unsigned short>(m_Is64Bit ? 58 : 46);
+            clcpp::uint64 shnum = Read<unsigned short>(m_Is64Bit ? 60 : 48);
+            unsigned int shstrndx = Read<unsigned short>(m_Is64Bit ? 62 : 50);
+            m_SectionHeaders = shoff;
+
+            // A zero offset means the file has no section headers, rather than any at the start of the file
+            if (m_Ok && shoff == 0)
+                return true;
+
+            if (!m_Ok || m_SectionHeaderSize < (m_Is64Bit ? 64 : 40))
+            {
+                LOG(main, ERROR, "'%s' has no valid section headers\n", filename);
+                return false;
+            }
+
+            // Section counts and the name table index that don't fit in the header are stored in the first section
+            if (shnum == 0 || shstrndx == 0xFFFF)
+            {
+                Section first = ReadSection(0);
+                if (shnum == 0)
+                    shnum = first.size;
+                if (shstrndx == 0xFFFF)
+                    shstrndx = first.link;
+            }
+
+            // Read all section headers up front
+            for (clcpp::uint64 i = 0; i < shnum && m_Ok; i++)
+                m_Sections.push_back(ReadSection(i));
+            if (!m_Ok || shstrndx >= m_Sections.size() || !IsStringTable(m_Sections[shstrndx]))
+            {
+                LOG(main, ERROR, "'%s' has corrupt section headers\n", filename);
+                return false;
+            }
+            m_SectionNames = m_Sections[shstrndx];
+
+            return true;
+        }
+
+        const std::vector<Section>& GetSections() const
+        {
+            return m_Sections;
+        }
+
+        const char* GetSectionName(const Section& section)
+        {
+            return ReadString(m_SectionNames, section.name);
+        }
+
+        // Calls the visitor with each symbol in a symbol table section, returning false if the table is corrupt
+        template <typename VISITOR>
+        bool VisitSymbols(const Section& section, VISITOR& visitor)
+        {
+            unsigned int symbol_size = m_Is64Bit ? 24 : 16;
+            if (section.entsize < symbol_size || section.link >= m_Sections.size() || !IsStringTable(m_Sections[section.link]))
+                return false;
+            const Section& names = m_Sections[section.link];
+
+            for (clcpp::uint64 i = 0; i < section.size / section.entsize; i++)
+            {
+                clcpp::uint64 offset = section.offset + i * section.entsize;
+                Symbol symbol;
+                unsigned int name = Read<unsigned int>(offset);
+                unsigned char info = Read<unsigned char>(offset + (m_Is64Bit ? 4 : 12));
+                symbol.section_index = Read<unsigned short>(offset + (m_Is64Bit ? 6 : 14));
+                symbol.value = m_Is64Bit ? Read<clcpp::uint64>(offset + 8) : Read<unsigned int>(offset + 4);
+                symbol.type = info & 0xF;
+                symbol.name = ReadString(names, name);
+                if (!m_Ok)
+                    return false;
+
+                visitor(symbol);
+            }
+
+            return true;
+        }
+
+    private:
+        template <typename TYPE>
+        TYPE Read(clcpp::uint64 offset)
+        {
+            TYPE value = 0;
+            if (offset > m_File.Size() || m_File.Size() - offset < sizeof(TYPE))
+                m_Ok = false;
+            else
+                memcpy(&value, m_File.Data() + offset, sizeof(TYPE));
+            return value;
+        }
+
+        Section ReadSection(clcpp::uint64 index)
+        {
+            clcpp::uint64 offset = m_SectionHeaders + index * m_SectionHeaderSize;
+            Section section;
+            section.name = Read<unsigned int>(offset);
+            section.type = Read<unsigned int>(offset + 4);
+            if (m_Is64Bit)
+            {
+                section.addr = Read<clcpp::uint64>(offset + 16);
+                section.offset = Read<clcpp::uint64>(offset + 24);
+                section.size = Read<clcpp::uint64>(offset + 32);
+                section.link = Read<unsigned int>(offset + 40);
+                section.entsize = Read<clcpp::uint64>(offset + 56);
+            }
+            else
+            {
+                section.addr = Read<unsigned int>(offset + 12);
+                section.offset = Read<unsigned int>(offset + 16);
+                section.size = Read<unsigned int>(offset + 20);
+                section.link = Read<unsigned int>(offset + 24);
+                section.entsize = Read<unsigned int>(offset + 36);
+            }
+
+            // Sections without file contents have no data to check
+            if (section.type != SHT_NOBITS && !IsInFile(section))
+                m_Ok = false;
+            return section;
+        }
+
+        bool IsInFile(const Section& section) const
+        {
+            return section.offset <= m_File.Size() && m_File.Size() - section.offset >= section.size;
+        }
+
+        bool IsStringTable(const Section& section) const
+        {
+            // Sections without file contents have an offset and size that aren't checked when they're read
+            return section.type != SHT_NOBITS && IsInFile(section);
+        }
+
+        const char* ReadString(const Section& table, clcpp::uint64 offset)
+        {
+            // The string must be terminated within its table, which must lie within the file
+            if (!IsStringTable(table) || offset >= table.size)
+            {
+                m_Ok = false;
+                return "";
+            }
+            const char* text = m_File.Data() + table.offset + offset;
+            if (memchr(text, 0, table.size - offset) == 0)
+            {
+                m_Ok = false;
+                return "";
+            }
+            return text;
+        }
+
+        MappedFile m_File;
+        bool m_Is64Bit;
+        bool m_Ok;
+
+        clcpp::uint64 m_SectionHeaders;
+        unsigned int m_SectionHeaderSize;
+        std::vector<Section> m_Sections;
+        Section m_SectionNames;
+    };
+
+    // Adds the addresses of all reflected functions defined in a symbol table
+    struct ElfSymbolVisitor
+    {
+        void operator()(const ElfFile::Symbol& symbol)
+        {
+            // Only mangled names can be matched to reflected functions
+            if (symbol.type != ElfFile::STT_FUNC || symbol.section_index == 0 || symbol.value == 0 ||
+                !startswith(symbol.name, "_Z"))
+                return;
+
+            // Skip symbols that have already been added with this address, such as those listed in
+            // both the static and dynamic symbol tables
+            DemangleCache::Entry& entry = demangle_cache.Get(symbol.name);
+            clcpp::pointer_type function_address = (clcpp::pointer_type)symbol.value;
+            if (entry.signature.size() == 0 || entry.address == function_address)
+                return;
+            entry.address = function_address;
+
+            ProcessFunctionItem(db, entry.signature, entry.function_name, function_address);
+        }
+
+        cldb::Database& db;
+        DemangleCache& demangle_cache;
+    };
+
+    void ParseElfSymbols(const char* filename, cldb::Database& db, clcpp::pointer_type& base_address)
+    {
+        ElfFile elf;
+        if (!elf.Open(filename))
+            return;
+
+        // Record the start of the code section as the base address, as the map file parser does
+        const std::vector<ElfFile::Section>& sections = elf.GetSections();
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            if (!strcmp(elf.GetSectionName(sections[i]), ".text"))
+            {
+                base_address = (clcpp::pointer_type)sections[i].addr;
+                break;
+            }
+        }
+
+        DemangleCache demangle_cache;
+        ElfSymbolVisitor visitor = { db, demangle_cache };
+        bool found_symbols = false;
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            const ElfFile::Section& section = sections[i];
+            if (section.type == ElfFile::SHT_SYMTAB || section.type == ElfFile::SHT_DYNSYM)
+            {
+                found_symbols = true;
+                if (!elf.VisitSymbols(section, visitor))
+                    LOG(main, ERROR, "Symbol table '%s' in '%s' is corrupt\n", elf.GetSectionName(section), filename);
+            }
+        }
+
+        if (!found_symbols)
+            LOG(main, WARNING, "No symbol tables found in '%s', has it been stripped?\n", filename);
     }
 #endif // CLCPP_USING_GNUC
 }
 
-MapFileParser::MapFileParser(cldb::Database& db, const char* filename)
+MapFileParser::MapFileParser(cldb::Database& db, const char* filename, unsigned int nb_threads)
     : m_PreferredLoadAddress(0)
 {
 #if defined(CLCPP_USING_MSVC)
-    ParseMSVCMapFile(filename, db, m_PreferredLoadAddress);
+    ParseMSVCMapFile(filename, db, m_PreferredLoadAddress, nb_threads);
 #else
-    ParseGCCMapFile(filename, db, m_PreferredLoadAddress);
+    ParseGCCMapFile(filename, db, m_PreferredLoadAddress, nb_threads);
 #endif // CLCPP_USING_MSVC
 }
+
+ElfSymbolParser::ElfSymbolParser(cldb::Database& db, const char* filename)
+    : m_PreferredLoadAddress(0)
+{
+#if defined(CLCPP_USING_GNUC)
+    ParseElfSymbols(filename, db, m_PreferredLoadAddress);
+#else
+    LOG(main, ERROR, "Reading ELF symbol tables isn't supported on this platform\n");
+#endif // CLCPP_USING_GNUC
+}
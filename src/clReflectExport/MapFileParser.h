@@ -1,9 +1,9 @@
 
 //
 // ===============================================================================
-// clReflect, MapFileParser.h - Parsing of MAP files output from a link stage
-// and storing of the addresses in the offline Reflection Database for reflected
-// functions.
+// clReflect, MapFileParser.h - Parsing of MAP files output from a link stage, or
+// the symbol tables of ELF binaries, and storing of the addresses in the offline
+// Reflection Database for reflected functions.
 // -------------------------------------------------------------------------------
 // Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
 // Released under MIT License (see LICENSE file)
@@ -19,9 +19,24 @@ namespace cldb
     class Database;
 }
 
+//
+// Map files are split into chunks of lines that are parsed on multiple threads, with the results
+// added to the database in map file order.
+//
 struct MapFileParser
 {
 public:
-    MapFileParser(cldb::Database& db, const char* filename);
+    MapFileParser(cldb::Database& db, const char* filename, unsigned int nb_threads = 1);
+    clcpp::pointer_type m_PreferredLoadAddress;
+};
+
+//
+// Reads function addresses from the symbol tables of an ELF executable or shared library directly,
+// as an alternative to parsing the map file output by the linker.
+//
+struct ElfSymbolParser
+{
+public:
+    ElfSymbolParser(cldb::Database& db, const char* filename);
     clcpp::pointer_type m_PreferredLoadAddress;
 };
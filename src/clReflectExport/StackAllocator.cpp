@@ -0,0 +1,115 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "StackAllocator.h"
+
+#include <clReflectCore/Logging.h>
+
+#include <cstdlib>
+
+#if defined(CLCPP_USING_MSVC)
+
+// clang-format off
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+// clang-format on
+
+#else
+
+    #include <sys/mman.h>
+
+#endif // CLCPP_USING_MSVC
+
+namespace
+{
+    // Pages are committed in large steps to keep the number of system calls down
+    const unsigned int COMMIT_SIZE = 1024 * 1024;
+
+    // Smallest reservation worth trying when address space is short on 32-bit builds
+    const unsigned int MIN_RESERVE_SIZE = 16 * 1024 * 1024;
+
+#if defined(CLCPP_USING_MSVC)
+
+    char* ReserveMemory(unsigned int size)
+    {
+        return (char*)VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+    }
+
+    bool CommitMemory(char* data, unsigned int size)
+    {
+        return VirtualAlloc(data, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+    }
+
+    void ReleaseMemory(char* data, unsigned int)
+    {
+        VirtualFree(data, 0, MEM_RELEASE);
+    }
+
+#else
+
+    char* ReserveMemory(unsigned int size)
+    {
+        // Inaccessible pages don't count towards the commit charge until made writable
+        void* data = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return data != MAP_FAILED ? (char*)data : 0;
+    }
+
+    bool CommitMemory(char* data, unsigned int size)
+    {
+        return mprotect(data, size, PROT_READ | PROT_WRITE) == 0;
+    }
+
+    void ReleaseMemory(char* data, unsigned int size)
+    {
+        munmap(data, size);
+    }
+
+#endif // CLCPP_USING_MSVC
+}
+
+StackAllocator::StackAllocator(unsigned int reserve_size)
+    : m_Data(0)
+    , m_ReservedSize(0)
+    , m_CommittedSize(0)
+    , m_Offset(0)
+{
+    // Settle for less address space if the full range isn't available
+    reserve_size = (reserve_size + COMMIT_SIZE - 1) / COMMIT_SIZE * COMMIT_SIZE;
+    while (m_Data == 0 && reserve_size >= MIN_RESERVE_SIZE)
+    {
+        m_Data = ReserveMemory(reserve_size);
+        if (m_Data == 0)
+            reserve_size /= 2;
+    }
+
+    if (m_Data == 0)
+    {
+        LOG(main, ERROR, "Couldn't reserve address space for the C++ export\n");
+        abort();
+    }
+    m_ReservedSize = reserve_size;
+}
+
+StackAllocator::~StackAllocator()
+{
+    ReleaseMemory(m_Data, m_ReservedSize);
+}
+
+void StackAllocator::Commit(unsigned int size)
+{
+    // Commit everything from the end of the last commit, rounded up to the commit granularity
+    unsigned int committed_size = size <= m_ReservedSize - COMMIT_SIZE ? (size + COMMIT_SIZE - 1) / COMMIT_SIZE * COMMIT_SIZE : m_ReservedSize;
+    if (size > m_ReservedSize || size < m_Offset ||
+        !CommitMemory(m_Data + m_CommittedSize, committed_size - m_CommittedSize))
+    {
+        LOG(main, ERROR, "C++ export overflowed its %u byte stack allocator\n", m_ReservedSize);
+        abort();
+    }
+    m_CommittedSize = committed_size;
+}
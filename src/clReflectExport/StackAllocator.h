@@ -90,29 +90,25 @@ inline bool is_builtin<clcpp::uint64>()
 //
 // The requirements of this class are that you can grow the data buffer without
 // invalidating previously allocated pointers. Obviously, wrapping something like
-// std::vector won't work in this case. For now I'm just pre-allocating the worst
-// case amount of memory and returning pointers from within that. However, if these
-// databases get bigger it might be worth using VirtualAlloc to reserve a large
-// contiguous set of pages which are committed on demand. Before that, though: the
-// database really shouldn't be any bigger than a couple of megabytes!
+// std::vector won't work in this case. Instead a large contiguous range of address
+// space is reserved up front and pages are committed on demand as allocations reach
+// them, so memory use follows the size of the database.
 //
 class StackAllocator
 {
 public:
-    StackAllocator(int size)
-        : m_Data(new char[size])
-        , m_Size(size)
-        , m_Offset(0)
-    {
-    }
+    StackAllocator(unsigned int reserve_size);
+    ~StackAllocator();
 
     template <typename TYPE>
     TYPE* Alloc(unsigned int count)
     {
         // Allocate the required amount of bytes
         TYPE* data = (TYPE*)(m_Data + m_Offset);
-        m_Offset += count * sizeof(TYPE);
-        assert(m_Offset <= m_Size && "Stack allocator overflowed");
+        unsigned int offset = m_Offset + count * sizeof(TYPE);
+        if (offset > m_CommittedSize)
+            Commit(offset);
+        m_Offset = offset;
 
         // Default construct non-builtin types
         if (!is_builtin<TYPE>())
@@ -141,15 +137,28 @@ public:
     }
     unsigned int GetSize() const
     {
-        return m_Size;
+        return m_ReservedSize;
     }
     unsigned int GetAllocatedSize() const
     {
         return m_Offset;
     }
 
+    // Memory actually in use by the allocator, which is the allocated size rounded up to the next commit
+    unsigned int GetCommittedSize() const
+    {
+        return m_CommittedSize;
+    }
+
 private:
+    StackAllocator(const StackAllocator&);
+    StackAllocator& operator = (const StackAllocator&);
+
+    // Commits enough pages to cover the given size, failing hard if the reserved range is exhausted
+    void Commit(unsigned int size);
+
     char* m_Data;
-    unsigned int m_Size;
+    unsigned int m_ReservedSize;
+    unsigned int m_CommittedSize;
     unsigned int m_Offset;
 };
@@ -204,7 +204,7 @@ namespace
 		{
 			const cldb::Namespace& db_ns = i->second;
 			Namespace ns;
-			ns.name = db_ns.name.text.c_str();
+			ns.name = db_ns.name.text;
 			ns.parent = db_ns.parent.hash;
 			namespaces[db_ns.name.hash] = ns;
 		}
@@ -241,7 +241,7 @@ namespace
 			if (j != namespaces.end())
 			{
 				Primitive prim;
-				prim.name = db_cls.name.text.c_str();
+				prim.name = db_cls.name.text;
 				prim.hash = db_cls.name.hash;
 				prim.parent = db_cls.parent.hash;
 				prim.type = db_cls.is_class ? PT_Class : PT_Struct;
@@ -260,7 +260,7 @@ namespace
 			if (j != namespaces.end())
 			{
 				Primitive prim;
-				prim.name = db_en.name.text.c_str();
+				prim.name = db_en.name.text;
 				prim.hash = db_en.name.hash;
 				prim.parent = db_en.parent.hash;
 
@@ -291,7 +291,7 @@ namespace
 		{
 			const cldb::Type& db_type = i->second;
 			Primitive prim;
-			prim.name = db_type.name.text.c_str();
+			prim.name = db_type.name.text;
 			prim.hash = db_type.name.hash;
 			prim.type = PT_Type;
 			global_ns.types.push_back(prim);
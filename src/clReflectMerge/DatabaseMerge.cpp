@@ -9,15 +9,21 @@
 //
 
 #include "DatabaseMerge.h"
+#include "MergeProvenance.h"
 
 #include <clReflectCore/Database.h>
+#include <clReflectCore/DatabaseBinarySerialiser.h>
+#include <clReflectCore/DatabaseTextSerialiser.h>
 #include <clReflectCore/Logging.h>
+#include <clReflectCore/Trace.h>
+
+#include <memory>
+#include <thread>
+#include <unordered_map>
 
 
 namespace
 {
-	const char* g_FilenameMergingDB = 0;
-
 	template <typename TYPE>
 	void MergeUniques(cldb::Database &dest_db, const cldb::Database &src_db)
 	{
@@ -35,7 +41,7 @@ namespace
 		}
 	}
 
-    void MergeClasses(cldb::Database& dest_db, const cldb::Database& src_db)
+    void MergeClasses(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename, bool log_warnings)
     {
         cldb::DBMap<cldb::Class> &dest_map = dest_db.GetDBMap<cldb::Class>();
         const cldb::DBMap<cldb::Class>& src_map = src_db.GetDBMap<cldb::Class>();
@@ -62,11 +68,11 @@ namespace
 
 				// This has to be the same class included multiple times in different translation units
 				// Ensure that their descriptions match up as best as possible at this point
-				else if (dst_class.size != cldb::Class::FORWARD_DECL_SIZE && src_class.size != cldb::Class::FORWARD_DECL_SIZE &&
-						dst_class.size != src_class.size)
+				else if (log_warnings && dst_class.size != cldb::Class::FORWARD_DECL_SIZE &&
+						src_class.size != cldb::Class::FORWARD_DECL_SIZE && dst_class.size != src_class.size)
 				{
 					LOG(main, WARNING, "Class %s differs in size during merge (source file %s)\n",
-						dst_class.name.text.c_str(), g_FilenameMergingDB);
+						dst_class.name.text, filename);
 				}
 			}
 		}
@@ -78,79 +84,304 @@ namespace
 		cldb::DBMap<TYPE>& dest_map = dest_db.GetDBMap<TYPE>();
 		const cldb::DBMap<TYPE>& src_map = src_db.GetDBMap<TYPE>();
 
-		// Unconditionally add primitives that don't already exist
+		// Add primitives that don't already exist, looking them up by content rather than comparing
+		// against every primitive of the same name
         for (typename cldb::DBMap<TYPE>::const_iterator src = src_map.begin(); src != src_map.end(); ++src)
         {
-			typename cldb::DBMap<TYPE>::const_iterator dest = dest_map.find(src->first);
-			if (dest == dest_map.end())
-			{
+			if (dest_map.find_equal(src->second) == dest_map.end())
 				dest_db.AddPrimitive(src->second);
+		}
+	}
+
+}
+
+
+void MergeDatabases(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename, bool log_warnings)
+{
+	TRACE_SCOPE("MergeDatabases", filename);
+
+	// Merge name maps, which can be copied directly as the pooled text is shared
+	assert(dest_db.m_NamePool == src_db.m_NamePool && "Merged databases must share a name pool");
+	dest_db.m_Names.insert(src_db.m_Names.begin(), src_db.m_Names.end());
+
+	// The symbol names for these primitives can't be overloaded
+	{
+		TRACE_SCOPE("MergeUniques", filename);
+		MergeUniques<cldb::Namespace>(dest_db, src_db);
+		MergeUniques<cldb::Type>(dest_db, src_db);
+		MergeUniques<cldb::Enum>(dest_db, src_db);
+		MergeUniques<cldb::Template>(dest_db, src_db);
+
+		// Class/template type symbol names can't be overloaded but extra checks can be used to make sure
+		// the same primitive isn't violating the One Definition Rule
+		MergeUniques<cldb::TemplateType>(dest_db, src_db);
+	}
+
+	{
+		TRACE_SCOPE("MergeClasses", filename);
+		MergeClasses(dest_db, src_db, filename, log_warnings);
+	}
+
+	{
+		TRACE_SCOPE("MergeOverloads", filename);
+
+		// Add enum constants as if they are overloadable
+		// NOTE: Technically don't need to do this enum constants are scoped. However, I might change
+		// that in future so this code will become useful.
+		MergeOverloads<cldb::EnumConstant>(dest_db, src_db);
+
+		// Functions can be overloaded so rely on their unique id to merge them
+		MergeOverloads<cldb::Function>(dest_db, src_db);
+
+		// Field names aren't scoped and hence overloadable. They are parented to unique functions so that will
+		// be the key deciding factor in whether fields should be merged or not.
+		MergeOverloads<cldb::Field>(dest_db, src_db);
+
+		// Attributes are not scoped and are shared to save runtime memory so all of these are overloadable
+		MergeOverloads<cldb::FlagAttribute>(dest_db, src_db);
+		MergeOverloads<cldb::IntAttribute>(dest_db, src_db);
+		MergeOverloads<cldb::FloatAttribute>(dest_db, src_db);
+		MergeOverloads<cldb::PrimitiveAttribute>(dest_db, src_db);
+		MergeOverloads<cldb::TextAttribute>(dest_db, src_db);
+	}
+
+	// Merge uniquely named non-primitives
+	{
+		TRACE_SCOPE("MergeUniques", filename);
+		MergeUniques<cldb::ContainerInfo>(dest_db, src_db);
+		MergeUniques<cldb::TypeInheritance>(dest_db, src_db);
+	}
+}
+
+
+bool ReadDatabase(const char* filename, cldb::Database& db, unsigned int nb_threads)
+{
+	TRACE_SCOPE("ReadDatabase", filename);
+	return cldb::ReadBinaryDatabase(filename, db, nb_threads) || cldb::ReadTextDatabase(filename, db);
+}
+
+
+namespace
+{
+	// Merges the database read from the input file with the given index, recording where its entries
+	// came from if provenance is required
+	void MergeDatabaseFile(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename, cldb::u32 input_index,
+		Provenance* provenance, bool log_warnings)
+	{
+		MergeDatabases(dest_db, src_db, filename, log_warnings);
+
+		if (provenance != 0)
+		{
+			Provenance input_provenance;
+			BuildInputProvenance(input_provenance, src_db, input_index);
+			MergeProvenance(*provenance, dest_db, input_provenance, src_db);
+		}
+	}
+
+
+	// Enough of a class to reproduce the size mismatch warnings of a sequential merge
+	struct DefinedClass
+	{
+		cldb::u32 hash;
+		clcpp::size_type size;
+	};
+
+
+	//
+	// A contiguous range of input files read and merged in order by a single thread
+	//
+	struct MergeChunk
+	{
+		MergeChunk()
+			: db(0)
+			, provenance(0)
+			, first(0)
+			, end(0)
+			, nb_read_threads(1)
+			, failed_index(0)
+		{
+		}
+
+		cldb::Database* db;
+		Provenance* provenance;
+		size_t first;
+		size_t end;
+
+		// Threads left over when there are fewer chunks than threads help with reading each input
+		unsigned int nb_read_threads;
+
+		// The first input that couldn't be read, or 'end' if all inputs were read
+		size_t failed_index;
+
+		// All defined classes of each input, in the order MergeClasses visits them
+		std::vector<std::vector<DefinedClass>> defined_classes;
+	};
+
+
+	void MergeChunkInputs(MergeChunk& chunk, const std::vector<std::string>& filenames)
+	{
+		chunk.failed_index = chunk.end;
+		chunk.defined_classes.resize(chunk.end - chunk.first);
+
+		for (size_t i = chunk.first; i < chunk.end; i++)
+		{
+			const char* filename = filenames[i].c_str();
+			cldb::Database loaded_db(chunk.db->m_NamePool);
+			if (!ReadDatabase(filename, loaded_db, chunk.nb_read_threads))
+			{
+				chunk.failed_index = i;
+				return;
 			}
 
-			else
+			// Record defined classes before merging away the information the warnings need
+			std::vector<DefinedClass>& defined_classes = chunk.defined_classes[i - chunk.first];
+			const cldb::DBMap<cldb::Class>& classes = loaded_db.GetDBMap<cldb::Class>();
+			for (cldb::DBMap<cldb::Class>::const_iterator j = classes.begin(); j != classes.end(); ++j)
 			{
-				// A primitive of the same name exists so double-check all existing entries for a matching primitives before adding
-				bool add = true;
-				typename cldb::DBMap<TYPE>::const_range dest_range = dest_map.equal_range(src->first);
-				for (typename cldb::DBMap<TYPE>::const_iterator i = dest_range.first; i != dest_range.second; ++i)
+				if (j->second.size != cldb::Class::FORWARD_DECL_SIZE)
 				{
-					if (i->second.Equals(src->second))
+					DefinedClass defined_class = { j->first, j->second.size };
+					defined_classes.push_back(defined_class);
+				}
+			}
+
+			MergeDatabaseFile(*chunk.db, loaded_db, filename, i, chunk.provenance, false);
+		}
+	}
+
+
+	void LogClassSizeWarnings(const std::vector<MergeChunk>& chunks, const std::vector<std::string>& filenames, size_t end)
+	{
+		// A sequential merge keeps the first defined version of a class and warns whenever a later
+		// definition differs in size from it. Each chunk has also kept its first definition, so that
+		// is where the name reported with the warning comes from.
+		struct FirstDefinition
+		{
+			clcpp::size_type size;
+			size_t chunk_index;
+		};
+		std::unordered_map<cldb::u32, FirstDefinition> first_definitions;
+
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			const MergeChunk& chunk = chunks[i];
+			for (size_t j = chunk.first; j < chunk.end && j < end; j++)
+			{
+				const std::vector<DefinedClass>& defined_classes = chunk.defined_classes[j - chunk.first];
+				for (size_t k = 0; k < defined_classes.size(); k++)
+				{
+					const DefinedClass& defined_class = defined_classes[k];
+
+					FirstDefinition first_definition = { defined_class.size, i };
+					std::pair<std::unordered_map<cldb::u32, FirstDefinition>::iterator, bool> result =
+						first_definitions.insert(std::make_pair(defined_class.hash, first_definition));
+
+					if (!result.second && result.first->second.size != defined_class.size)
 					{
-						add = false;
-						break;
+						const MergeChunk& first_chunk = chunks[result.first->second.chunk_index];
+						const cldb::Class& dst_class = first_chunk.db->GetDBMap<cldb::Class>().find(defined_class.hash)->second;
+						LOG(main, WARNING, "Class %s differs in size during merge (source file %s)\n",
+							dst_class.name.text, filenames[j].c_str());
 					}
 				}
-
-				if (add)
-					dest_db.AddPrimitive(src->second);
 			}
 		}
 	}
 
+
+	bool MergeDatabaseFilesParallel(cldb::Database& dest_db, const std::vector<std::string>& filenames, size_t nb_chunks,
+		unsigned int nb_threads, Provenance* provenance)
+	{
+		// Split the inputs into contiguous chunks, with the first merging straight into the destination
+		std::vector<std::unique_ptr<cldb::Database>> chunk_dbs(nb_chunks);
+		std::vector<std::unique_ptr<Provenance>> chunk_provenances(nb_chunks);
+		std::vector<MergeChunk> chunks(nb_chunks);
+		for (size_t i = 0; i < nb_chunks; i++)
+		{
+			if (i != 0)
+			{
+				chunk_dbs[i].reset(new cldb::Database(dest_db.m_NamePool));
+				if (provenance != 0)
+					chunk_provenances[i].reset(new Provenance);
+			}
+			chunks[i].db = i == 0 ? &dest_db : chunk_dbs[i].get();
+			chunks[i].provenance = i == 0 ? provenance : chunk_provenances[i].get();
+			chunks[i].first = filenames.size() * i / nb_chunks;
+			chunks[i].end = filenames.size() * (i + 1) / nb_chunks;
+			chunks[i].nb_read_threads = nb_threads / nb_chunks;
+		}
+
+		// Read and merge all chunks concurrently
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < nb_chunks; i++)
+			threads.push_back(std::thread(MergeChunkInputs, std::ref(chunks[i]), std::cref(filenames)));
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+
+		// Warnings are reported in input order, as far as the first input that couldn't be read
+		size_t failed_index = filenames.size();
+		for (size_t i = 0; i < nb_chunks && failed_index == filenames.size(); i++)
+		{
+			if (chunks[i].failed_index != chunks[i].end)
+				failed_index = chunks[i].failed_index;
+		}
+		LogClassSizeWarnings(chunks, filenames, failed_index);
+		if (failed_index != filenames.size())
+		{
+			LOG(main, ERROR, "Couldn't read '%s' as binary or text database - does it exist?", filenames[failed_index].c_str());
+			return false;
+		}
+
+		// Merging keeps the first unique primitive and the first of any equal overloads, so merging neighbouring
+		// chunks pairwise up a binary tree gives the same database as merging each input in turn
+		for (size_t stride = 1; stride < nb_chunks; stride *= 2)
+		{
+			TRACE_SCOPE("MergeTreeLevel");
+			threads.clear();
+			for (size_t i = 0; i + stride < nb_chunks; i += stride * 2)
+			{
+				threads.push_back(std::thread([&chunks, &chunk_dbs, &chunk_provenances, i, stride]() {
+					MergeChunk& dest = chunks[i];
+					MergeChunk& src = chunks[i + stride];
+					MergeDatabases(*dest.db, *src.db, 0, false);
+					if (dest.provenance != 0)
+						MergeProvenance(*dest.provenance, *dest.db, *src.provenance, *src.db);
+					chunk_dbs[i + stride].reset();
+					chunk_provenances[i + stride].reset();
+				}));
+			}
+			for (size_t i = 0; i < threads.size(); i++)
+				threads[i].join();
+		}
+
+		return true;
+	}
 }
 
 
-void MergeDatabases(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename)
+bool MergeDatabaseFiles(cldb::Database& dest_db, const std::vector<std::string>& filenames, unsigned int nb_threads,
+	Provenance* provenance)
 {
-	g_FilenameMergingDB = filename;
+	// No point using more threads than there are inputs
+	size_t nb_chunks = nb_threads < filenames.size() ? nb_threads : filenames.size();
+	if (nb_chunks > 1)
+		return MergeDatabaseFilesParallel(dest_db, filenames, nb_chunks, nb_threads, provenance);
 
-	// Merge name maps
-	for (cldb::NameMap::const_iterator i = src_db.m_Names.begin(); i != src_db.m_Names.end(); ++i)
-		dest_db.GetName(i->second.text.c_str());
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		const char* filename = filenames[i].c_str();
 
-	// The symbol names for these primitives can't be overloaded
-	MergeUniques<cldb::Namespace>(dest_db, src_db);
-	MergeUniques<cldb::Type>(dest_db, src_db);
-	MergeUniques<cldb::Enum>(dest_db, src_db);
-	MergeUniques<cldb::Template>(dest_db, src_db);
-
-	// Class/template type symbol names can't be overloaded but extra checks can be used to make sure
-	// the same primitive isn't violating the One Definition Rule
-	MergeUniques<cldb::TemplateType>(dest_db, src_db);
-    MergeClasses(dest_db, src_db);
-
-    // Add enum constants as if they are overloadable
-	// NOTE: Technically don't need to do this enum constants are scoped. However, I might change
-	// that in future so this code will become useful.
-	MergeOverloads<cldb::EnumConstant>(dest_db, src_db);
-
-	// Functions can be overloaded so rely on their unique id to merge them
-	MergeOverloads<cldb::Function>(dest_db, src_db);
-
-	// Field names aren't scoped and hence overloadable. They are parented to unique functions so that will
-	// be the key deciding factor in whether fields should be merged or not.
-	MergeOverloads<cldb::Field>(dest_db, src_db);
-
-	// Attributes are not scoped and are shared to save runtime memory so all of these are overloadable
-	MergeOverloads<cldb::FlagAttribute>(dest_db, src_db);
-	MergeOverloads<cldb::IntAttribute>(dest_db, src_db);
-	MergeOverloads<cldb::FloatAttribute>(dest_db, src_db);
-	MergeOverloads<cldb::PrimitiveAttribute>(dest_db, src_db);
-	MergeOverloads<cldb::TextAttribute>(dest_db, src_db);
+		// Try to load the database
+		cldb::Database loaded_db(dest_db.m_NamePool);
+		if (!ReadDatabase(filename, loaded_db, nb_threads))
+		{
+			LOG(main, ERROR, "Couldn't read '%s' as binary or text database - does it exist?", filename);
+			return false;
+		}
 
-	// Merge uniquely named non-primitives
-	MergeUniques<cldb::ContainerInfo>(dest_db, src_db);
-	MergeUniques<cldb::TypeInheritance>(dest_db, src_db);
+		// Merge into the main one
+		MergeDatabaseFile(dest_db, loaded_db, filename, i, provenance, true);
+	}
 
-	g_FilenameMergingDB = 0;
+	return true;
 }
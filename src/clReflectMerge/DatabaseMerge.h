@@ -9,10 +9,32 @@
 //
 
 
+#include <string>
+#include <vector>
+
+
 namespace cldb
 {
 	class Database;
 }
 
+class Provenance;
+
 
-void MergeDatabases(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename);
+void MergeDatabases(cldb::Database& dest_db, const cldb::Database& src_db, const char* filename, bool log_warnings = true);
+
+
+//
+// Reads a database file, trying the binary format before the text format. Binary databases
+// can be decoded on more than one thread.
+//
+bool ReadDatabase(const char* filename, cldb::Database& db, unsigned int nb_threads = 1);
+
+
+//
+// Reads each database file and merges them in order into an empty destination database. The work
+// can be spread over multiple threads, with the result and any warnings identical to those of a
+// single thread. Returns false if any of the files couldn't be read.
+//
+bool MergeDatabaseFiles(cldb::Database& dest_db, const std::vector<std::string>& filenames, unsigned int nb_threads,
+	Provenance* provenance = 0);
@@ -0,0 +1,836 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "IncrementalMerge.h"
+#include "DatabaseMerge.h"
+#include "MergeProvenance.h"
+
+#include <clReflectCore/Database.h>
+#include <clReflectCore/DatabaseBinarySerialiser.h>
+#include <clReflectCore/Logging.h>
+#include <clReflectCore/Trace.h>
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+
+namespace
+{
+	// 'clms'
+	const unsigned int STATE_FILE_HEADER = 0x736d6c63;
+	const unsigned int STATE_FILE_VERSION = 3;
+
+
+	//
+	// Identifies the contents of an input file without having to parse it
+	//
+	struct InputFingerprint
+	{
+		InputFingerprint()
+			: size(0)
+			, mtime(0)
+			, hash(0)
+		{
+		}
+
+		// The modification time only decides whether the contents need hashing again, so touching
+		// a file without changing it doesn't cause it to be merged again
+		bool operator == (const InputFingerprint& rhs) const
+		{
+			return filename == rhs.filename && size == rhs.size && hash == rhs.hash;
+		}
+
+		std::string filename;
+		cldb::u32 size;
+		clcpp::uint64 mtime;
+		cldb::u32 hash;
+	};
+
+
+	bool GetFileTimes(const char* filename, clcpp::uint64& size, clcpp::uint64& mtime)
+	{
+	#if defined(CLCPP_USING_MSVC)
+		struct _stat64 st;
+		if (_stat64(filename, &st) != 0)
+			return false;
+	#else
+		struct stat st;
+		if (stat(filename, &st) != 0)
+			return false;
+	#endif
+		size = st.st_size;
+		mtime = st.st_mtime;
+		return true;
+	}
+
+
+	InputFingerprint FingerprintFile(const std::string& filename, const InputFingerprint* previous, clcpp::uint64 state_mtime,
+		bool& hashed)
+	{
+		// Files that can't be read are left with an empty fingerprint, to be reported when they fail to merge
+		InputFingerprint fingerprint;
+		fingerprint.filename = filename;
+		hashed = true;
+		clcpp::uint64 size = 0, mtime = 0;
+		if (!GetFileTimes(filename.c_str(), size, mtime))
+			return fingerprint;
+
+		// Reuse the hash from the previous merge if the size and modification time haven't changed. Files
+		// modified in the same second that the state was written may have changed again after they were
+		// hashed without moving their time on, so are always hashed.
+		if (previous != 0 && previous->size == size && previous->mtime == mtime && mtime < state_mtime)
+		{
+			hashed = false;
+			return *previous;
+		}
+
+		FILE* fp = fopen(filename.c_str(), "rb");
+		if (fp == 0)
+			return fingerprint;
+
+		std::vector<char> data(size > 0 ? (size_t)size : 0);
+		if (size > 0 && fread(&data.front(), 1, (size_t)size, fp) == (size_t)size)
+		{
+			fingerprint.size = (cldb::u32)size;
+			fingerprint.mtime = mtime;
+			fingerprint.hash = clcpp::internal::HashData(&data.front(), (int)size);
+		}
+
+		fclose(fp);
+		return fingerprint;
+	}
+
+
+	//
+	// Everything needed to update the result of a merge
+	//
+	struct MergeState
+	{
+		// The previous merge shares the name pool of the database being updated
+		MergeState(const std::shared_ptr<cldb::NamePool>& name_pool)
+			: db(name_pool)
+		{
+		}
+
+		std::vector<InputFingerprint> inputs;
+		cldb::Database db;
+		Provenance provenance;
+
+		// Modification time of the state file, after which its fingerprints can't be trusted
+		clcpp::uint64 mtime = 0;
+	};
+
+
+	bool ReadMergeState(const char* filename, MergeState& state)
+	{
+		TRACE_SCOPE("ReadMergeState", filename);
+
+		FILE* fp = fopen(filename, "rb");
+		if (fp == 0)
+			return false;
+
+		bool read = false;
+		cldb::u32 header[3] = { 0 };
+		if (fread(header, sizeof(header), 1, fp) == 1 && header[0] == STATE_FILE_HEADER && header[1] == STATE_FILE_VERSION)
+		{
+			read = true;
+
+			// Read the fingerprint of each input in the order they were merged
+			state.inputs.resize(header[2]);
+			for (size_t i = 0; i < state.inputs.size() && read; i++)
+			{
+				InputFingerprint& input = state.inputs[i];
+				cldb::u32 length = 0;
+				read = fread(&length, sizeof(length), 1, fp) == 1 && length < 0x10000;
+				if (read)
+				{
+					input.filename.resize(length);
+					read = (length == 0 || fread(&input.filename[0], length, 1, fp) == 1) &&
+						fread(&input.size, sizeof(input.size), 1, fp) == 1 &&
+						fread(&input.mtime, sizeof(input.mtime), 1, fp) == 1 &&
+						fread(&input.hash, sizeof(input.hash), 1, fp) == 1;
+				}
+			}
+
+			read = read && cldb::ReadBinaryDatabase(fp, state.db) && ReadProvenance(fp, state.provenance, state.db, header[2]);
+		}
+
+		fclose(fp);
+
+		clcpp::uint64 size = 0;
+		return read && GetFileTimes(filename, size, state.mtime);
+	}
+
+
+	bool WriteMergeState(const char* filename, const std::vector<InputFingerprint>& inputs, const cldb::Database& db,
+		const Provenance& provenance)
+	{
+		TRACE_SCOPE("WriteMergeState", filename);
+
+		// Write to a temporary file first so that an interrupted write can't leave behind a state
+		// that doesn't match the merged database
+		std::string temp_filename = std::string(filename) + ".tmp";
+		FILE* fp = fopen(temp_filename.c_str(), "wb");
+		if (fp == 0)
+			return false;
+
+		cldb::u32 header[3] = { STATE_FILE_HEADER, STATE_FILE_VERSION, (cldb::u32)inputs.size() };
+		fwrite(header, sizeof(header), 1, fp);
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			const InputFingerprint& input = inputs[i];
+			cldb::u32 length = input.filename.length();
+			fwrite(&length, sizeof(length), 1, fp);
+			fwrite(input.filename.c_str(), length, 1, fp);
+			fwrite(&input.size, sizeof(input.size), 1, fp);
+			fwrite(&input.mtime, sizeof(input.mtime), 1, fp);
+			fwrite(&input.hash, sizeof(input.hash), 1, fp);
+		}
+
+		cldb::WriteBinaryDatabase(fp, db);
+		WriteProvenance(fp, provenance);
+
+		bool written = !ferror(fp);
+		written = fclose(fp) == 0 && written;
+		remove(filename);
+		return written && rename(temp_filename.c_str(), filename) == 0;
+	}
+
+
+	template <MergeKind KIND> struct KindTag
+	{
+	};
+
+
+	//
+	// Mapping of the inputs of the previous merge to the current inputs
+	//
+	struct UpdateContext
+	{
+		UpdateContext(const MergeState& old_state, const std::vector<std::string>& filenames)
+			: old_db(old_state.db)
+			, old_provenance(old_state.provenance)
+			, filenames(filenames)
+			, inputs(filenames.size())
+			, identity(false)
+		{
+		}
+
+		const cldb::Database* GetInput(cldb::u32 index)
+		{
+			// Unchanged inputs are only read when a value they provide can't be found in the previous merge
+			if (inputs[index] == 0)
+			{
+				std::unique_ptr<cldb::Database> db(new cldb::Database(old_db.m_NamePool));
+				if (!ReadDatabase(filenames[index].c_str(), *db))
+					return 0;
+				inputs[index] = std::move(db);
+			}
+			return inputs[index].get();
+		}
+
+		// Provenance of an entry from the previous merge, moved to the current input indices and
+		// without any inputs that have since changed
+		InputSet RemapInputs(const InputSet& old_inputs) const
+		{
+			InputSet inputs;
+			old_inputs.ForEach([this, &inputs](cldb::u32 index) {
+				if (!old_changed[index])
+					inputs.Add(old_to_new[index]);
+			});
+			return inputs;
+		}
+
+		// Does a changed input contribute to an entry from the previous merge?
+		bool IsTouched(const InputSet& old_inputs) const
+		{
+			for (size_t i = 0; i < old_changed_list.size(); i++)
+			{
+				if (old_inputs.Contains(old_changed_list[i]))
+					return true;
+			}
+			return false;
+		}
+
+		// The current index of the input that first contributed to an entry in the previous merge, if
+		// that input is unchanged and so the value it provided is still correct
+		int KeptInput(const InputSet& old_inputs) const
+		{
+			if (old_inputs.Empty() || old_changed[old_inputs.First()])
+				return -1;
+			return old_to_new[old_inputs.First()];
+		}
+
+		const cldb::Database& old_db;
+		const Provenance& old_provenance;
+		const std::vector<std::string>& filenames;
+
+		// Current index of each previous input, or -1 if it has been removed
+		std::vector<int> old_to_new;
+
+		// Previous inputs that have been modified or removed
+		std::vector<bool> old_changed;
+		std::vector<cldb::u32> old_changed_list;
+
+		// Current inputs that have been modified or added, all of which are read up-front
+		std::vector<bool> changed;
+		std::vector<cldb::u32> changed_list;
+
+		// Databases read from the current inputs
+		std::vector<std::unique_ptr<cldb::Database>> inputs;
+
+		// True if the inputs are the same as before, in which case provenance needs no remapping
+		bool identity;
+	};
+
+
+	template <typename TYPE>
+	const TYPE* FindFirst(const cldb::Database& db, cldb::u32 key)
+	{
+		typedef typename DatabaseStore<TYPE>::MapType MapType;
+		const MapType& store = DatabaseStore<TYPE>::Get(db);
+		typename MapType::const_iterator i = store.find(key);
+		return i != store.end() ? &i->second : 0;
+	}
+
+
+	const cldb::Class* FindClass(const cldb::Database& db, cldb::u32 key, bool definition)
+	{
+		cldb::DBMap<cldb::Class>::const_range range = db.m_Classes.equal_range(key);
+		for (cldb::DBMap<cldb::Class>::const_iterator i = range.first; i != range.second; ++i)
+		{
+			if (!definition || i->second.size != cldb::Class::FORWARD_DECL_SIZE)
+				return &i->second;
+		}
+		return 0;
+	}
+
+
+	template <typename TYPE, typename ITERATOR, typename MAP_TYPE>
+	bool ResolveKey(UpdateContext& ctx, cldb::u32 key, ITERATOR old_begin, ITERATOR old_end, ProvenanceMap::const_iterator old_prov,
+		MAP_TYPE& store, ProvenanceMap& prov_map, KindTag<MERGE_UNIQUE>)
+	{
+		EntryProvenance entry;
+		int kept = -1;
+		if (old_begin != old_end)
+		{
+			entry.inputs = ctx.RemapInputs(old_prov->second.inputs);
+			kept = ctx.KeptInput(old_prov->second.inputs);
+		}
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			if (FindFirst<TYPE>(*ctx.inputs[ctx.changed_list[i]], key))
+				entry.inputs.Add(ctx.changed_list[i]);
+		}
+		if (entry.inputs.Empty())
+			return true;
+
+		// The first input to contribute the key provides the value. Names are the same in every input.
+		cldb::u32 first = entry.inputs.First();
+		const TYPE* value = 0;
+		if (!ctx.changed[first] && old_begin != old_end && ((int)first == kept || std::is_same<TYPE, cldb::Name>::value))
+		{
+			value = &old_begin->second;
+		}
+		else if (const cldb::Database* db = ctx.GetInput(first))
+		{
+			value = FindFirst<TYPE>(*db, key);
+		}
+		if (value == 0)
+			return false;
+
+		store.insert(typename MAP_TYPE::value_type(key, *value));
+		prov_map.insert(prov_map.end(), ProvenanceMap::value_type(key, entry));
+		return true;
+	}
+
+
+	template <typename TYPE, typename ITERATOR, typename MAP_TYPE>
+	bool ResolveKey(UpdateContext& ctx, cldb::u32 key, ITERATOR old_begin, ITERATOR old_end, ProvenanceMap::const_iterator old_prov,
+		MAP_TYPE& store, ProvenanceMap& prov_map, KindTag<MERGE_CLASS>)
+	{
+		EntryProvenance entry;
+		int kept = -1;
+		if (old_begin != old_end)
+		{
+			const EntryProvenance& old_entry = old_prov->second;
+			entry.inputs = ctx.RemapInputs(old_entry.inputs);
+			entry.defined = ctx.RemapInputs(old_entry.defined);
+			kept = ctx.KeptInput(old_entry.defined.Empty() ? old_entry.inputs : old_entry.defined);
+		}
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			const cldb::Database& db = *ctx.inputs[ctx.changed_list[i]];
+			if (FindClass(db, key, false))
+				entry.inputs.Add(ctx.changed_list[i]);
+			if (FindClass(db, key, true))
+				entry.defined.Add(ctx.changed_list[i]);
+		}
+		if (entry.inputs.Empty())
+			return true;
+
+		// The first definition wins, falling back to the first forward declaration
+		bool use_definition = !entry.defined.Empty();
+		cldb::u32 first = use_definition ? entry.defined.First() : entry.inputs.First();
+		const cldb::Class* value = 0;
+		if (!ctx.changed[first] && (int)first == kept)
+		{
+			value = &old_begin->second;
+		}
+		else if (const cldb::Database* db = ctx.GetInput(first))
+		{
+			value = FindClass(*db, key, use_definition);
+		}
+		if (value == 0)
+			return false;
+
+		store.insert(typename MAP_TYPE::value_type(key, *value));
+		prov_map.insert(prov_map.end(), ProvenanceMap::value_type(key, entry));
+		return true;
+	}
+
+
+	template <typename TYPE>
+	struct OverloadCandidate
+	{
+		OverloadCandidate(const TYPE* value)
+			: value(value)
+			, kept(-1)
+			, old_position(0)
+			, changed_input(-1)
+			, changed_position(0)
+			, first(0)
+			, position(0)
+		{
+		}
+
+		const TYPE* value;
+		InputSet inputs;
+
+		// Previous provenance, if the primitive was in the previous merge
+		int kept;
+		size_t old_position;
+
+		// Position within the first changed input to contain the primitive
+		int changed_input;
+		size_t changed_position;
+
+		// Sort order of the resolved primitives
+		cldb::u32 first;
+		size_t position;
+	};
+
+
+	template <typename TYPE>
+	const TYPE& CandidateValue(const OverloadCandidate<TYPE>& candidate)
+	{
+		return *candidate.value;
+	}
+	template <typename TYPE>
+	const TYPE& CandidateValue(const TYPE* value)
+	{
+		return *value;
+	}
+
+
+	// Returns the first of the values with the content hash that Equals the value, or values.size() if there is none
+	template <typename TYPE, typename VALUE_TYPE>
+	size_t FindEqual(const std::unordered_multimap<cldb::u32, size_t>& index, cldb::u32 hash, const TYPE& value,
+		const std::vector<VALUE_TYPE>& values)
+	{
+		size_t first = values.size();
+		typedef std::unordered_multimap<cldb::u32, size_t>::const_iterator Iterator;
+		std::pair<Iterator, Iterator> range = index.equal_range(hash);
+		for (Iterator i = range.first; i != range.second; ++i)
+		{
+			if (i->second < first && CandidateValue(values[i->second]).Equals(value))
+				first = i->second;
+		}
+		return first;
+	}
+
+
+	template <typename TYPE>
+	bool CandidateOrder(const OverloadCandidate<TYPE>* a, const OverloadCandidate<TYPE>* b)
+	{
+		return a->first != b->first ? a->first < b->first : a->position < b->position;
+	}
+
+
+	template <typename TYPE, typename ITERATOR, typename MAP_TYPE>
+	bool ResolveKey(UpdateContext& ctx, cldb::u32 key, ITERATOR old_begin, ITERATOR old_end, ProvenanceMap::const_iterator old_prov,
+		MAP_TYPE& store, ProvenanceMap& prov_map, KindTag<MERGE_OVERLOAD>)
+	{
+		// Start with the primitives from the previous merge, indexed by their content so that matching
+		// doesn't have to compare every pair of overloads
+		std::vector<OverloadCandidate<TYPE>> candidates;
+		std::unordered_multimap<cldb::u32, size_t> candidate_index;
+		for (ITERATOR i = old_begin; i != old_end; ++i, ++old_prov)
+		{
+			OverloadCandidate<TYPE> candidate(&i->second);
+			candidate.inputs = ctx.RemapInputs(old_prov->second.inputs);
+			candidate.kept = ctx.KeptInput(old_prov->second.inputs);
+			candidate.old_position = candidates.size();
+			candidate_index.insert(std::make_pair(i->second.ContentHash(), candidates.size()));
+			candidates.push_back(candidate);
+		}
+
+		// Match the distinct primitives of each changed input against them, adding any new ones
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			cldb::u32 input = ctx.changed_list[i];
+			typename cldb::DBMap<TYPE>::const_range range = ctx.inputs[input]->GetDBMap<TYPE>().equal_range(key);
+			size_t position = 0;
+			for (typename cldb::DBMap<TYPE>::const_iterator j = range.first; j != range.second; ++j)
+			{
+				cldb::u32 hash = j->second.ContentHash();
+				size_t k = FindEqual(candidate_index, hash, j->second, candidates);
+				if (k == candidates.size())
+				{
+					candidate_index.insert(std::make_pair(hash, k));
+					candidates.push_back(OverloadCandidate<TYPE>(&j->second));
+				}
+
+				OverloadCandidate<TYPE>& candidate = candidates[k];
+				if (candidate.inputs.Contains(input))
+					continue;
+				candidate.inputs.Add(input);
+				if (candidate.changed_input == -1)
+				{
+					candidate.changed_input = input;
+					candidate.changed_position = position;
+				}
+				position++;
+			}
+		}
+
+		// Primitives are ordered by the first input to contain them, then by their order within that input.
+		// That order is known for changed inputs and is kept from the previous merge for unchanged inputs,
+		// unless a primitive has fallen to an unchanged input from one that has changed.
+		std::vector<OverloadCandidate<TYPE>*> sorted;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			OverloadCandidate<TYPE>& candidate = candidates[i];
+			if (candidate.inputs.Empty())
+				continue;
+
+			candidate.first = candidate.inputs.First();
+			candidate.position = ctx.changed[candidate.first] ? candidate.changed_position : candidate.old_position;
+			sorted.push_back(&candidate);
+		}
+		std::sort(sorted.begin(), sorted.end(), CandidateOrder<TYPE>);
+
+		for (size_t i = 0; i < sorted.size(); )
+		{
+			// Find the group of primitives first contained by the same input
+			size_t end = i + 1;
+			bool fallen = (int)sorted[i]->first != sorted[i]->kept;
+			for (; end < sorted.size() && sorted[end]->first == sorted[i]->first; end++)
+				fallen |= (int)sorted[end]->first != sorted[end]->kept;
+
+			if (fallen && end - i > 1 && !ctx.changed[sorted[i]->first])
+			{
+				// Order by the position of each primitive in the input
+				const cldb::Database* db = ctx.GetInput(sorted[i]->first);
+				if (db == 0)
+					return false;
+				typename cldb::DBMap<TYPE>::const_range range = db->GetDBMap<TYPE>().equal_range(key);
+				std::vector<const TYPE*> values;
+				std::unordered_multimap<cldb::u32, size_t> value_index;
+				for (typename cldb::DBMap<TYPE>::const_iterator k = range.first; k != range.second; ++k)
+				{
+					value_index.insert(std::make_pair(k->second.ContentHash(), values.size()));
+					values.push_back(&k->second);
+				}
+				for (size_t j = i; j < end; j++)
+				{
+					size_t position = FindEqual(value_index, sorted[j]->value->ContentHash(), *sorted[j]->value, values);
+					if (position == values.size())
+						return false;
+					sorted[j]->position = position;
+				}
+				std::sort(sorted.begin() + i, sorted.begin() + end, CandidateOrder<TYPE>);
+			}
+
+			i = end;
+		}
+
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			store.insert(typename MAP_TYPE::value_type(key, *sorted[i]->value));
+			EntryProvenance entry;
+			entry.inputs = std::move(sorted[i]->inputs);
+			prov_map.insert(prov_map.end(), ProvenanceMap::value_type(key, entry));
+		}
+
+		return true;
+	}
+
+
+	template <typename TYPE>
+	bool UpdateStore(UpdateContext& ctx, cldb::Database& db, Provenance& provenance)
+	{
+		typedef typename DatabaseStore<TYPE>::MapType MapType;
+		const MapType& old_store = DatabaseStore<TYPE>::Get(ctx.old_db);
+		const ProvenanceMap& old_prov_map = ctx.old_provenance.GetMap<TYPE>();
+		MapType& store = DatabaseStore<TYPE>::Get(db);
+		ProvenanceMap& prov_map = provenance.GetMap<TYPE>();
+
+		// Gather all keys that changed inputs contribute to, before or after their change
+		std::vector<cldb::u32> touched_keys;
+		for (ProvenanceMap::const_iterator i = old_prov_map.begin(); i != old_prov_map.end(); ++i)
+		{
+			if (ctx.IsTouched(i->second.inputs))
+				touched_keys.push_back(i->first);
+		}
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			const MapType& input_store = DatabaseStore<TYPE>::Get(*ctx.inputs[ctx.changed_list[i]]);
+			for (typename MapType::const_iterator j = input_store.begin(); j != input_store.end(); ++j)
+				touched_keys.push_back(j->first);
+		}
+		std::sort(touched_keys.begin(), touched_keys.end());
+		touched_keys.erase(std::unique(touched_keys.begin(), touched_keys.end()), touched_keys.end());
+
+		// Walk both in key order, copying the entries of untouched keys and resolving touched keys again
+		typename MapType::const_iterator old_entry = old_store.begin();
+		ProvenanceMap::const_iterator old_prov = old_prov_map.begin();
+		std::vector<cldb::u32>::const_iterator touched = touched_keys.begin();
+		while (old_entry != old_store.end() || touched != touched_keys.end())
+		{
+			cldb::u32 key;
+			if (old_entry == old_store.end() || (touched != touched_keys.end() && *touched < old_entry->first))
+				key = *touched;
+			else
+				key = old_entry->first;
+
+			typename MapType::const_iterator old_end = old_entry;
+			ProvenanceMap::const_iterator old_prov_end = old_prov;
+			for (; old_end != old_store.end() && old_end->first == key; ++old_end)
+				++old_prov_end;
+
+			if (touched != touched_keys.end() && *touched == key)
+			{
+				if (!ResolveKey<TYPE>(ctx, key, old_entry, old_end, old_prov, store, prov_map, KindTag<MergeKindOf<TYPE>::value>()))
+					return false;
+				++touched;
+			}
+			else
+			{
+				for (; old_entry != old_end; ++old_entry, ++old_prov)
+				{
+					EntryProvenance entry = old_prov->second;
+					if (!ctx.identity)
+					{
+						entry.inputs = ctx.RemapInputs(old_prov->second.inputs);
+						entry.defined = ctx.RemapInputs(old_prov->second.defined);
+					}
+					store.insert(*old_entry);
+					prov_map.insert(prov_map.end(), ProvenanceMap::value_type(key, entry));
+				}
+			}
+
+			old_entry = old_end;
+			old_prov = old_prov_end;
+		}
+
+		return true;
+	}
+
+
+	struct StoreUpdater
+	{
+		template <typename TYPE> void Visit()
+		{
+			if (ok)
+			{
+				TRACE_SCOPE("UpdateStore");
+				ok = UpdateStore<TYPE>(ctx, db, provenance);
+			}
+		}
+
+		UpdateContext& ctx;
+		cldb::Database& db;
+		Provenance& provenance;
+		bool ok;
+	};
+
+
+	void LogClassSizeWarnings(const UpdateContext& ctx, const cldb::Database& db, const Provenance& provenance)
+	{
+		// Only the changed inputs are compared against the class definitions that win the merge
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			cldb::u32 input = ctx.changed_list[i];
+			const cldb::DBMap<cldb::Class>& classes = ctx.inputs[input]->m_Classes;
+			for (cldb::DBMap<cldb::Class>::const_iterator j = classes.begin(); j != classes.end(); ++j)
+			{
+				if (j->second.size == cldb::Class::FORWARD_DECL_SIZE)
+					continue;
+
+				const cldb::Class& dst_class = db.m_Classes.find(j->first)->second;
+				const EntryProvenance& entry = provenance.m_Classes.find(j->first)->second;
+				if (entry.defined.First() != input && dst_class.size != j->second.size)
+				{
+					LOG(main, WARNING, "Class %s differs in size during merge (source file %s)\n",
+						dst_class.name.text, ctx.filenames[input].c_str());
+				}
+			}
+		}
+	}
+
+
+	enum UpdateResult
+	{
+		UPDATE_FAILED,
+		UPDATE_UNCHANGED,
+		UPDATE_MERGED,
+	};
+
+
+	UpdateResult UpdateMerge(MergeState& old_state, const std::vector<InputFingerprint>& inputs, const std::vector<std::string>& filenames,
+		cldb::Database& dest_db, Provenance& dest_provenance)
+	{
+		TRACE_SCOPE("UpdateMerge");
+		UpdateContext ctx(old_state, filenames);
+
+		// Match the previous inputs to the current ones, which must be in the same relative order
+		std::unordered_map<std::string, cldb::u32> input_indices;
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			if (!input_indices.insert(std::make_pair(inputs[i].filename, (cldb::u32)i)).second)
+			{
+				LOG(main, INFO, "Full merge: inputs are listed more than once\n");
+				return UPDATE_FAILED;
+			}
+		}
+
+		ctx.old_to_new.resize(old_state.inputs.size(), -1);
+		ctx.old_changed.resize(old_state.inputs.size(), true);
+		ctx.changed.resize(inputs.size(), true);
+		int last_index = -1;
+		for (size_t i = 0; i < old_state.inputs.size(); i++)
+		{
+			std::unordered_map<std::string, cldb::u32>::const_iterator j = input_indices.find(old_state.inputs[i].filename);
+			if (j == input_indices.end())
+				continue;
+
+			if ((int)j->second < last_index)
+			{
+				LOG(main, INFO, "Full merge: inputs have been reordered\n");
+				return UPDATE_FAILED;
+			}
+			last_index = j->second;
+
+			ctx.old_to_new[i] = j->second;
+			ctx.old_changed[i] = !(old_state.inputs[i] == inputs[j->second]);
+			ctx.changed[j->second] = ctx.old_changed[i];
+		}
+
+		for (size_t i = 0; i < ctx.old_changed.size(); i++)
+		{
+			if (ctx.old_changed[i])
+				ctx.old_changed_list.push_back(i);
+		}
+		for (size_t i = 0; i < ctx.changed.size(); i++)
+		{
+			if (ctx.changed[i])
+				ctx.changed_list.push_back(i);
+		}
+
+		ctx.identity = old_state.inputs.size() == inputs.size();
+		for (size_t i = 0; i < ctx.old_to_new.size() && ctx.identity; i++)
+			ctx.identity = ctx.old_to_new[i] == (int)i;
+
+		// Nothing to do if all inputs are the same as last time
+		if (ctx.old_changed_list.empty() && ctx.changed_list.empty())
+		{
+			dest_db = std::move(old_state.db);
+			dest_provenance = std::move(old_state.provenance);
+			return UPDATE_UNCHANGED;
+		}
+
+		LOG(main, INFO, "Incremental merge: %d of %d inputs changed\n", (int)ctx.changed_list.size(), (int)inputs.size());
+
+		// Read all changed inputs, leaving the full merge to report any that can't be read
+		for (size_t i = 0; i < ctx.changed_list.size(); i++)
+		{
+			if (ctx.GetInput(ctx.changed_list[i]) == 0)
+				return UPDATE_FAILED;
+		}
+
+		// A failure here means an unchanged input no longer matches its fingerprint
+		cldb::Database db(dest_db.m_NamePool);
+		Provenance provenance;
+		StoreUpdater updater = { ctx, db, provenance, true };
+		VisitDatabaseStores(updater);
+		if (!updater.ok)
+		{
+			LOG(main, INFO, "Full merge: inputs changed during the merge\n");
+			return UPDATE_FAILED;
+		}
+
+		LogClassSizeWarnings(ctx, db, provenance);
+
+		dest_db = std::move(db);
+		dest_provenance = std::move(provenance);
+		return UPDATE_MERGED;
+	}
+}
+
+
+bool IncrementalMergeDatabaseFiles(cldb::Database& dest_db, const std::vector<std::string>& filenames, unsigned int nb_threads,
+	const char* state_filename)
+{
+	// Try to update the previous merge
+	std::vector<InputFingerprint> inputs(filenames.size());
+	bool rehashed = false;
+	Provenance provenance;
+	UpdateResult result = UPDATE_FAILED;
+	{
+		std::unique_ptr<MergeState> old_state(new MergeState(dest_db.m_NamePool));
+		bool have_state = ReadMergeState(state_filename, *old_state);
+		if (!have_state)
+			LOG(main, INFO, "Full merge: no usable merge state in '%s'\n", state_filename);
+
+		// Only inputs that have been modified since the previous merge are hashed
+		{
+			TRACE_SCOPE("FingerprintInputs");
+			std::unordered_map<std::string, const InputFingerprint*> previous;
+			if (have_state)
+			{
+				for (size_t i = 0; i < old_state->inputs.size(); i++)
+					previous[old_state->inputs[i].filename] = &old_state->inputs[i];
+			}
+			for (size_t i = 0; i < filenames.size(); i++)
+			{
+				std::unordered_map<std::string, const InputFingerprint*>::const_iterator j = previous.find(filenames[i]);
+				bool hashed = false;
+				inputs[i] = FingerprintFile(filenames[i], j == previous.end() ? 0 : j->second, old_state->mtime, hashed);
+				rehashed |= hashed;
+			}
+		}
+
+		if (have_state)
+			result = UpdateMerge(*old_state, inputs, filenames, dest_db, provenance);
+	}
+
+	if (result == UPDATE_FAILED && !MergeDatabaseFiles(dest_db, filenames, nb_threads, &provenance))
+		return false;
+
+	// An unchanged merge still records new modification times so that their inputs aren't hashed again
+	if ((result != UPDATE_UNCHANGED || rehashed) && !WriteMergeState(state_filename, inputs, dest_db, provenance))
+		LOG(main, WARNING, "Couldn't write merge state '%s'\n", state_filename);
+
+	return true;
+}
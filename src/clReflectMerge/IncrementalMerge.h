@@ -0,0 +1,35 @@
+//
+// ===============================================================================
+// clReflect, IncrementalMerge.h - Updating a merged Reflection Database with
+// only the inputs that have changed since the last merge.
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+
+namespace cldb
+{
+	class Database;
+}
+
+
+//
+// Merges the database files into an empty destination database, starting from the result of the
+// previous merge recorded in the state file. Inputs whose contents have changed, or that have been
+// added or removed, are merged again and everything else is reused, giving the same database as a
+// full merge. The state file records the merged database along with the inputs that contributed
+// each of its entries, and the size and modification time of each input so that only those that
+// have been modified are read to check their contents. A full merge is made if the state is missing or can't be used, for example
+// because the inputs have been reordered. Returns false if any of the files couldn't be read.
+//
+bool IncrementalMergeDatabaseFiles(cldb::Database& dest_db, const std::vector<std::string>& filenames, unsigned int nb_threads,
+	const char* state_filename);
@@ -9,17 +9,24 @@
 //
 
 #include "DatabaseMerge.h"
+#include "IncrementalMerge.h"
 #include "CodeGen.h"
 
+#include <clReflectExport/CppExport.h>
+#include <clReflectExport/MapFileParser.h>
+
 #include <clReflectCore/Arguments.h>
 #include <clReflectCore/Logging.h>
 #include <clReflectCore/Database.h>
 #include <clReflectCore/DatabaseTextSerialiser.h>
 #include <clReflectCore/DatabaseBinarySerialiser.h>
+#include <clReflectCore/Trace.h>
 
 
 #include <clcpp/clcpp.h>
 
+#include <stdlib.h>
+
 
 int main(int argc, const char* argv[])
 {
@@ -33,42 +40,132 @@ int main(int argc, const char* argv[])
 		return 1;
 	}
 
+	// The text database output is optional when exporting directly, in which case the first argument is a flag
+	const char* output_filename = args[1][0] != '-' ? args[1].c_str() : 0;
+
 	// Parse flags and mark where the file list starts
-	size_t arg_start = 2;
+	size_t arg_start = output_filename != 0 ? 2 : 1;
 	std::string cpp_codegen = args.GetProperty("-cpp_codegen");
 	if (cpp_codegen != "")
 		arg_start += 2;
     std::string h_codegen = args.GetProperty("-h_codegen");
     if (h_codegen != "")
         arg_start += 2;
-
-    cldb::Database db;
-	for (size_t i = arg_start; i < args.Count(); i++)
+	std::string trace_filename = args.GetProperty("-trace");
+	if (trace_filename != "")
 	{
-		const char* filename = args[i].c_str();
+		arg_start += 2;
+		trace::Open(trace_filename.c_str(), "clmerge");
+	}
 
-		// Try to load the database
-		cldb::Database loaded_db;
-		if (!cldb::ReadBinaryDatabase(filename, loaded_db))
+	unsigned int nb_merge_threads = 1;
+	std::string nb_threads = args.GetProperty("-j");
+	if (nb_threads != "")
+	{
+		arg_start += 2;
+		char* end = 0;
+		long value = strtol(nb_threads.c_str(), &end, 10);
+		if (end == nb_threads.c_str() || *end != 0 || value < 1)
 		{
-			if (!cldb::ReadTextDatabase(filename, loaded_db))
-			{
-				LOG(main, ERROR, "Couldn't read '%s' as binary or text database - does it exist?", filename);
-				return 1;
-			}
+			LOG(main, ERROR, "Invalid thread count '%s' for -j, expecting a number of at least 1\n", nb_threads.c_str());
+			return 1;
 		}
+		nb_merge_threads = (unsigned int)value;
+	}
+	std::string state_filename = args.GetProperty("-incremental");
+	if (state_filename != "")
+		arg_start += 2;
+	std::string cpp_export = args.GetProperty("-cpp");
+	if (cpp_export != "")
+		arg_start += 2;
+	std::string map_file = args.GetProperty("-map");
+	if (map_file != "")
+		arg_start += 2;
+	std::string elf_file = args.GetProperty("-elf");
+	if (elf_file != "")
+		arg_start += 2;
+	std::string cpp_log = args.GetProperty("-cpp_log");
+	if (cpp_log != "")
+		arg_start += 2;
 
-		// Merge into the main oent
-		MergeDatabases(db, loaded_db, filename);
+	if (output_filename == 0 && cpp_export == "")
+	{
+		LOG(main, ERROR, "No output database specified\n");
+		return 1;
+	}
+	if (map_file != "" && elf_file != "")
+	{
+		LOG(main, ERROR, "Only one of -map and -elf can be specified\n");
+		return 1;
+	}
+
+	// Read and merge all input databases
+	std::vector<std::string> filenames;
+	for (size_t i = arg_start; i < args.Count(); i++)
+		filenames.push_back(args[i]);
+    cldb::Database db;
+	if (state_filename != "")
+	{
+		if (!IncrementalMergeDatabaseFiles(db, filenames, nb_merge_threads, state_filename.c_str()))
+			return 1;
+	}
+	else if (!MergeDatabaseFiles(db, filenames, nb_merge_threads))
+	{
+		return 1;
 	}
 
 	// Save the result
-	const char* output_filename = args[1].c_str();
-	cldb::WriteTextDatabase(output_filename, db);
+	if (output_filename != 0)
+	{
+		TRACE_SCOPE("WriteTextDatabase", output_filename);
+		cldb::WriteTextDatabase(output_filename, db);
+	}
 
 	// Generate any required C++ code
     if (cpp_codegen != "" || h_codegen != "")
+    {
+        TRACE_SCOPE("GenMergedCppImpl");
         GenMergedCppImpl(cpp_codegen.c_str(), h_codegen.c_str(), db);
+    }
+
+	// Export the merged database as clexport would, without writing and reading back the text database
+	if (cpp_export != "")
+	{
+		// Add function address information from any specified map file or ELF binary
+		clcpp::pointer_type function_base_address = 0;
+		if (map_file != "")
+		{
+			LOG(main, INFO, "Parsing map file: %s\n", map_file.c_str());
+			TRACE_SCOPE("MapFileParser", map_file.c_str());
+			MapFileParser parser(db, map_file.c_str(), nb_merge_threads);
+			function_base_address = parser.m_PreferredLoadAddress;
+		}
+		else if (elf_file != "")
+		{
+			LOG(main, INFO, "Reading ELF symbols: %s\n", elf_file.c_str());
+			TRACE_SCOPE("ElfSymbolParser", elf_file.c_str());
+			ElfSymbolParser parser(db, elf_file.c_str());
+			function_base_address = parser.m_PreferredLoadAddress;
+		}
+
+		CppExport cppexp(function_base_address, nb_merge_threads);
+		if (!BuildCppExport(db, cppexp))
+			return 1;
+
+		if (cpp_log != "")
+		{
+			TRACE_SCOPE("WriteCppExportAsText", cpp_log.c_str());
+			WriteCppExportAsText(cppexp, cpp_log.c_str());
+		}
+
+		SaveCppExport(cppexp, cpp_export.c_str());
+	}
+
+	if (!trace::Close())
+	{
+		LOG(main, ERROR, "Couldn't write trace file '%s'\n", trace_filename.c_str());
+		return 1;
+	}
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,325 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "MergeProvenance.h"
+
+#include <clReflectCore/Trace.h>
+
+#include <unordered_map>
+
+
+bool InputSet::Contains(cldb::u32 index) const
+{
+	// Binary search for the number of ranges that start at or before the index
+	size_t lo = 0, hi = m_Ranges.size() / 2;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (m_Ranges[mid * 2] <= index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo != 0 && index <= m_Ranges[lo * 2 - 1];
+}
+
+
+void InputSet::Add(cldb::u32 index)
+{
+	// Inputs are mostly added in ascending order, extending or starting the last range
+	if (m_Ranges.empty() || index > m_Ranges.back() + 1)
+	{
+		m_Ranges.push_back(index);
+		m_Ranges.push_back(index);
+	}
+	else if (index == m_Ranges.back() + 1)
+	{
+		m_Ranges.back() = index;
+	}
+	else if (!Contains(index))
+	{
+		InputSet single;
+		single.Add(index);
+		Add(single);
+	}
+}
+
+
+void InputSet::Add(const InputSet& other)
+{
+	if (other.Empty())
+		return;
+
+	// Quick append when all the other indices come after these
+	if (Empty() || other.First() > m_Ranges.back() + 1)
+	{
+		m_Ranges.insert(m_Ranges.end(), other.m_Ranges.begin(), other.m_Ranges.end());
+		return;
+	}
+
+	// Merge both range lists in order of their first index, joining any that overlap or touch
+	std::vector<cldb::u32> ranges;
+	ranges.reserve(m_Ranges.size() + other.m_Ranges.size());
+	size_t i = 0, j = 0;
+	while (i < m_Ranges.size() || j < other.m_Ranges.size())
+	{
+		const cldb::u32* range;
+		if (j == other.m_Ranges.size() || (i < m_Ranges.size() && m_Ranges[i] < other.m_Ranges[j]))
+		{
+			range = &m_Ranges[i];
+			i += 2;
+		}
+		else
+		{
+			range = &other.m_Ranges[j];
+			j += 2;
+		}
+
+		if (!ranges.empty() && range[0] <= ranges.back() + 1)
+		{
+			if (range[1] > ranges.back())
+				ranges.back() = range[1];
+		}
+		else
+		{
+			ranges.push_back(range[0]);
+			ranges.push_back(range[1]);
+		}
+	}
+
+	m_Ranges.swap(ranges);
+}
+
+
+void InputSet::Write(FILE* fp) const
+{
+	cldb::u32 nb_ranges = m_Ranges.size() / 2;
+	fwrite(&nb_ranges, sizeof(nb_ranges), 1, fp);
+	if (nb_ranges)
+		fwrite(&m_Ranges.front(), sizeof(cldb::u32), m_Ranges.size(), fp);
+}
+
+
+bool InputSet::Read(FILE* fp, cldb::u32 nb_inputs)
+{
+	// Guard against corrupt counts before allocating
+	cldb::u32 nb_ranges = 0;
+	if (fread(&nb_ranges, sizeof(nb_ranges), 1, fp) != 1 || nb_ranges > nb_inputs)
+		return false;
+
+	m_Ranges.resize(nb_ranges * 2);
+	if (nb_ranges != 0 && fread(&m_Ranges.front(), sizeof(cldb::u32), m_Ranges.size(), fp) != m_Ranges.size())
+		return false;
+
+	// Ranges must be ascending and separate
+	for (size_t i = 0; i < m_Ranges.size(); i += 2)
+	{
+		if (m_Ranges[i] > m_Ranges[i + 1] || m_Ranges[i + 1] >= nb_inputs || (i != 0 && m_Ranges[i] <= m_Ranges[i - 1] + 1))
+			return false;
+	}
+
+	return true;
+}
+
+
+namespace
+{
+	template <MergeKind KIND> struct KindTag
+	{
+	};
+
+
+	template <typename TYPE> bool IsClassDefinition(const TYPE&)
+	{
+		return false;
+	}
+	bool IsClassDefinition(const cldb::Class& class_prim)
+	{
+		return class_prim.size != cldb::Class::FORWARD_DECL_SIZE;
+	}
+
+
+	struct InputProvenanceBuilder
+	{
+		template <typename TYPE> void Visit()
+		{
+			typedef typename DatabaseStore<TYPE>::MapType MapType;
+			const MapType& store = DatabaseStore<TYPE>::Get(db);
+			ProvenanceMap& map = prov.GetMap<TYPE>();
+
+			for (typename MapType::const_iterator i = store.begin(); i != store.end(); ++i)
+			{
+				EntryProvenance entry;
+				entry.inputs.Add(input_index);
+				if (IsClassDefinition(i->second))
+					entry.defined.Add(input_index);
+				map.insert(map.end(), ProvenanceMap::value_type(i->first, entry));
+			}
+		}
+
+		Provenance& prov;
+		const cldb::Database& db;
+		cldb::u32 input_index;
+	};
+
+
+	template <typename MAP_TYPE, MergeKind KIND>
+	void MergeMapProvenance(ProvenanceMap& dest_prov, const MAP_TYPE&, const ProvenanceMap& src_prov, const MAP_TYPE&, KindTag<KIND>)
+	{
+		// All source entries with the same key were merged into a single destination entry
+		for (ProvenanceMap::const_iterator src = src_prov.begin(); src != src_prov.end(); ++src)
+		{
+			ProvenanceMap::iterator dest = dest_prov.find(src->first);
+			if (dest == dest_prov.end())
+				dest = dest_prov.insert(ProvenanceMap::value_type(src->first, EntryProvenance()));
+
+			dest->second.inputs.Add(src->second.inputs);
+			dest->second.defined.Add(src->second.defined);
+		}
+	}
+
+
+	template <typename MAP_TYPE>
+	void MergeMapProvenance(ProvenanceMap& dest_prov, const MAP_TYPE& dest_map, const ProvenanceMap& src_prov, const MAP_TYPE& src_map, KindTag<MERGE_OVERLOAD>)
+	{
+		std::unordered_map<const void*, ProvenanceMap::iterator> dest_entries;
+
+		typename MAP_TYPE::const_iterator src = src_map.begin();
+		ProvenanceMap::const_iterator src_entry = src_prov.begin();
+		while (src != src_map.end())
+		{
+			// Map all destination primitives with this key to their provenance entries, adding entries
+			// to keep up with any primitives the merge appended
+			cldb::u32 key = src->first;
+			ProvenanceMap::iterator dest_entry = dest_prov.lower_bound(key);
+			dest_entries.clear();
+			for (typename MAP_TYPE::const_iterator dest = dest_map.find(key); dest != dest_map.end(); ++dest)
+			{
+				if (dest_entry == dest_prov.end() || dest_entry->first != key)
+					dest_entry = dest_prov.insert(dest_entry, ProvenanceMap::value_type(key, EntryProvenance()));
+				dest_entries[&dest->second] = dest_entry++;
+			}
+
+			// Add each source primitive's inputs to the entry of the equal destination primitive
+			for ( ; src != src_map.end() && src->first == key; ++src, ++src_entry)
+			{
+				typename MAP_TYPE::const_iterator dest = dest_map.find_equal(src->second);
+				dest_entries[&dest->second]->second.inputs.Add(src_entry->second.inputs);
+			}
+		}
+	}
+
+
+	struct ProvenanceMerger
+	{
+		template <typename TYPE> void Visit()
+		{
+			MergeMapProvenance(dest_prov.GetMap<TYPE>(), DatabaseStore<TYPE>::Get(dest_db), src_prov.GetMap<TYPE>(),
+				DatabaseStore<TYPE>::Get(src_db), KindTag<MergeKindOf<TYPE>::value>());
+		}
+
+		Provenance& dest_prov;
+		const cldb::Database& dest_db;
+		const Provenance& src_prov;
+		const cldb::Database& src_db;
+	};
+
+
+	struct ProvenanceWriter
+	{
+		template <typename TYPE> void Visit()
+		{
+			const ProvenanceMap& map = prov.GetMap<TYPE>();
+			cldb::u32 nb_entries = map.size();
+			fwrite(&nb_entries, sizeof(nb_entries), 1, fp);
+
+			// Only classes make use of the defined set
+			for (ProvenanceMap::const_iterator i = map.begin(); i != map.end(); ++i)
+			{
+				i->second.inputs.Write(fp);
+				if (MergeKindOf<TYPE>::value == MERGE_CLASS)
+					i->second.defined.Write(fp);
+			}
+		}
+
+		FILE* fp;
+		const Provenance& prov;
+	};
+
+
+	struct ProvenanceReader
+	{
+		template <typename TYPE> void Visit()
+		{
+			typedef typename DatabaseStore<TYPE>::MapType MapType;
+			const MapType& store = DatabaseStore<TYPE>::Get(db);
+			ProvenanceMap& map = prov.GetMap<TYPE>();
+
+			// There must be an entry for each database entry, which provides its key
+			cldb::u32 nb_entries = 0;
+			if (!ok || fread(&nb_entries, sizeof(nb_entries), 1, fp) != 1 || nb_entries != store.size())
+			{
+				ok = false;
+				return;
+			}
+
+			for (typename MapType::const_iterator i = store.begin(); i != store.end(); ++i)
+			{
+				EntryProvenance entry;
+				if (!entry.inputs.Read(fp, nb_inputs) ||
+					(MergeKindOf<TYPE>::value == MERGE_CLASS && !entry.defined.Read(fp, nb_inputs)))
+				{
+					ok = false;
+					return;
+				}
+				map.insert(map.end(), ProvenanceMap::value_type(i->first, std::move(entry)));
+			}
+		}
+
+		FILE* fp;
+		Provenance& prov;
+		const cldb::Database& db;
+		cldb::u32 nb_inputs;
+		bool ok;
+	};
+}
+
+
+void BuildInputProvenance(Provenance& prov, const cldb::Database& db, cldb::u32 input_index)
+{
+	TRACE_SCOPE("BuildInputProvenance");
+
+	InputProvenanceBuilder builder = { prov, db, input_index };
+	VisitDatabaseStores(builder);
+}
+
+
+void MergeProvenance(Provenance& dest_prov, const cldb::Database& dest_db, const Provenance& src_prov, const cldb::Database& src_db)
+{
+	TRACE_SCOPE("MergeProvenance");
+
+	ProvenanceMerger merger = { dest_prov, dest_db, src_prov, src_db };
+	VisitDatabaseStores(merger);
+}
+
+
+void WriteProvenance(FILE* fp, const Provenance& prov)
+{
+	ProvenanceWriter writer = { fp, prov };
+	VisitDatabaseStores(writer);
+}
+
+
+bool ReadProvenance(FILE* fp, Provenance& prov, const cldb::Database& db, cldb::u32 nb_inputs)
+{
+	ProvenanceReader reader = { fp, prov, db, nb_inputs, true };
+	VisitDatabaseStores(reader);
+	return reader.ok;
+}
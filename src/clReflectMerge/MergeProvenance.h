@@ -0,0 +1,217 @@
+//
+// ===============================================================================
+// clReflect, MergeProvenance.h - Record of the input databases that contributed
+// each entry of a merged database, for updating it incrementally.
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+
+#pragma once
+
+
+#include <clReflectCore/Database.h>
+
+#include <stdio.h>
+
+
+//
+// An ascending set of input database indices. Stored as a list of [first, last] ranges, as
+// primitives declared in headers tend to be contributed by runs of neighbouring inputs.
+//
+class InputSet
+{
+public:
+	bool Empty() const
+	{
+		return m_Ranges.empty();
+	}
+
+	cldb::u32 First() const
+	{
+		return m_Ranges.front();
+	}
+
+	bool Contains(cldb::u32 index) const;
+
+	void Add(cldb::u32 index);
+	void Add(const InputSet& other);
+
+	// Calls func(index) for each index in ascending order
+	template <typename FUNC> void ForEach(FUNC func) const
+	{
+		for (size_t i = 0; i < m_Ranges.size(); i += 2)
+		{
+			for (cldb::u32 j = m_Ranges[i]; j <= m_Ranges[i + 1]; j++)
+				func(j);
+		}
+	}
+
+	void Write(FILE* fp) const;
+
+	// Fails if the file is truncated or any index is out of range
+	bool Read(FILE* fp, cldb::u32 nb_inputs);
+
+private:
+	// Pairs of first and last index
+	std::vector<cldb::u32> m_Ranges;
+};
+
+
+struct EntryProvenance
+{
+	// Inputs containing this entry's key or, for overloadable primitives, an equal primitive
+	InputSet inputs;
+
+	// Inputs with a class definition, rather than a forward declaration
+	InputSet defined;
+};
+
+
+//
+// One entry for each entry in the matching store of the merged database, in the same order.
+//
+typedef std::multimap<cldb::u32, EntryProvenance> ProvenanceMap;
+
+
+//
+// How entries with the same key from different inputs are combined during a merge
+//
+enum MergeKind
+{
+	// The first input to contribute the key wins
+	MERGE_UNIQUE,
+
+	// The first input to define the class wins, falling back to the first forward declaration
+	MERGE_CLASS,
+
+	// All distinct primitives are kept in the order they're first seen
+	MERGE_OVERLOAD,
+};
+
+template <typename TYPE> struct MergeKindOf { static const MergeKind value = MERGE_OVERLOAD; };
+template <> struct MergeKindOf<cldb::Name> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::Namespace> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::Type> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::Enum> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::Template> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::TemplateType> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::ContainerInfo> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::TypeInheritance> { static const MergeKind value = MERGE_UNIQUE; };
+template <> struct MergeKindOf<cldb::Class> { static const MergeKind value = MERGE_CLASS; };
+
+
+//
+// Uniform access to the name map and primitive stores of a database, keyed by entry type
+//
+template <typename TYPE> struct DatabaseStore
+{
+	typedef cldb::DBMap<TYPE> MapType;
+	static MapType& Get(cldb::Database& db) { return db.GetDBMap<TYPE>(); }
+	static const MapType& Get(const cldb::Database& db) { return db.GetDBMap<TYPE>(); }
+};
+template <> struct DatabaseStore<cldb::Name>
+{
+	typedef cldb::NameMap MapType;
+	static MapType& Get(cldb::Database& db) { return db.m_Names; }
+	static const MapType& Get(const cldb::Database& db) { return db.m_Names; }
+};
+
+
+//
+// Provenance of every name and primitive in a merged database
+//
+class Provenance
+{
+public:
+	// Only the specialisations for each primitive store below are defined
+	template <typename TYPE> ProvenanceMap& GetMap();
+	template <typename TYPE> const ProvenanceMap& GetMap() const
+	{
+		return const_cast<Provenance*>(this)->GetMap<TYPE>();
+	}
+
+	ProvenanceMap m_Names;
+	ProvenanceMap m_Namespaces;
+	ProvenanceMap m_Types;
+	ProvenanceMap m_Templates;
+	ProvenanceMap m_TemplateTypes;
+	ProvenanceMap m_Classes;
+	ProvenanceMap m_Enums;
+	ProvenanceMap m_EnumConstants;
+	ProvenanceMap m_Functions;
+	ProvenanceMap m_Fields;
+	ProvenanceMap m_FlagAttributes;
+	ProvenanceMap m_IntAttributes;
+	ProvenanceMap m_FloatAttributes;
+	ProvenanceMap m_PrimitiveAttributes;
+	ProvenanceMap m_TextAttributes;
+	ProvenanceMap m_ContainerInfos;
+	ProvenanceMap m_TypeInheritances;
+};
+
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Name>() { return m_Names; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Namespace>() { return m_Namespaces; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Type>() { return m_Types; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Template>() { return m_Templates; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::TemplateType>() { return m_TemplateTypes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Class>() { return m_Classes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Enum>() { return m_Enums; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::EnumConstant>() { return m_EnumConstants; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Function>() { return m_Functions; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::Field>() { return m_Fields; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::FlagAttribute>() { return m_FlagAttributes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::IntAttribute>() { return m_IntAttributes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::FloatAttribute>() { return m_FloatAttributes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::PrimitiveAttribute>() { return m_PrimitiveAttributes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::TextAttribute>() { return m_TextAttributes; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::ContainerInfo>() { return m_ContainerInfos; }
+template <> inline ProvenanceMap& Provenance::GetMap<cldb::TypeInheritance>() { return m_TypeInheritances; }
+
+
+//
+// Calls func.template Visit<TYPE>() for the name map and each primitive store, in serialisation order
+//
+template <typename FUNC> void VisitDatabaseStores(FUNC& func)
+{
+	func.template Visit<cldb::Name>();
+	func.template Visit<cldb::Type>();
+	func.template Visit<cldb::EnumConstant>();
+	func.template Visit<cldb::Enum>();
+	func.template Visit<cldb::Field>();
+	func.template Visit<cldb::Function>();
+	func.template Visit<cldb::Class>();
+	func.template Visit<cldb::Template>();
+	func.template Visit<cldb::TemplateType>();
+	func.template Visit<cldb::Namespace>();
+	func.template Visit<cldb::FlagAttribute>();
+	func.template Visit<cldb::IntAttribute>();
+	func.template Visit<cldb::FloatAttribute>();
+	func.template Visit<cldb::PrimitiveAttribute>();
+	func.template Visit<cldb::TextAttribute>();
+	func.template Visit<cldb::ContainerInfo>();
+	func.template Visit<cldb::TypeInheritance>();
+}
+
+
+//
+// Provenance of a single input database, where every entry is contributed by the input itself
+//
+void BuildInputProvenance(Provenance& prov, const cldb::Database& db, cldb::u32 input_index);
+
+
+//
+// Adds the provenance of a source database that has just been merged into the destination,
+// matching each source entry to the destination entry it was merged with
+//
+void MergeProvenance(Provenance& dest_prov, const cldb::Database& dest_db, const Provenance& src_prov, const cldb::Database& src_db);
+
+
+//
+// Serialisation of provenance alongside the database it describes, which is needed on load to
+// key the entries
+//
+void WriteProvenance(FILE* fp, const Provenance& prov);
+bool ReadProvenance(FILE* fp, Provenance& prov, const cldb::Database& db, cldb::u32 nb_inputs);
@@ -16,6 +16,7 @@
 
 #include <clReflectCore/FileUtils.h>
 #include <clReflectCore/Logging.h>
+#include <clReflectCore/Trace.h>
 
 // clang\ast\decltemplate.h(1484) : warning C4345: behavior change: an object of POD type constructed with an initializer of the
 // form () will be default-initialized
@@ -33,6 +34,7 @@
 #include <llvm/IR/Attributes.h>
 
 #include <stdarg.h>
+#include <string.h>
 
 namespace
 {
@@ -287,7 +289,7 @@ namespace
             // Log the creation of this new instance
             LOG(ast, INFO, "class %s", type_name_str.c_str());
             for (size_t i = 0; i < base_names.size(); i++)
-                LOG_APPEND(ast, INFO, (i == 0) ? " : %s" : ", %s", base_names[i].text.c_str());
+                LOG_APPEND(ast, INFO, (i == 0) ? " : %s" : ", %s", base_names[i].text);
             LOG_NEWLINE(ast);
 
             db.AddPrimitive(type);
@@ -442,7 +444,7 @@ namespace
         typename cldb::DBMap<TYPE>::const_iterator i = store.find(attribute->name.hash);
         if (i == store.end() || !i->second.Equals(*attribute))
         {
-            LOG(ast, INFO, "attribute %s\n", attribute->name.text.c_str());
+            LOG(ast, INFO, "attribute %s\n", attribute->name.text);
             db.AddPrimitive(*attribute);
         }
     }
@@ -529,7 +531,7 @@ namespace
             int line = presumed_loc.getLine();
 
             // Parse all attributes in the text
-            for (cldb::Attribute* attribute : ::ParseAttributes(db, attribute_text.str().c_str(), filename, line))
+            for (cldb::Attribute* attribute : consumer.GetAttributeCache().Parse(db, attribute_text.str().c_str(), filename, line))
             {
                 attributes.push_back({annotate_attr, attribute});
             }
@@ -571,7 +573,7 @@ namespace
                     if (name_hash == reflect_hash || name_hash == reflect_part_hash || name_hash == noreflect_hash)
                     {
                         Status().Print(location, srcmgr,
-                                       va("'%s' attribute unexpected and ignored", attribute->name.text.c_str()));
+                                       va("'%s' attribute unexpected and ignored", attribute->name.text));
                     }
                 }
 
@@ -628,8 +630,6 @@ ASTConsumer::ASTConsumer(cldb::Database& db, const ReflectionSpecs& rspecs, cons
     , m_ReflectionSpecs(rspecs)
     , m_AllowReflect(false)
 {
-    LOG_TO_STDOUT(warnings, INFO);
-
     if (ast_log != "")
         LOG_TO_FILE(ast, ALL, ast_log.c_str());
 }
@@ -640,6 +640,7 @@ void ASTConsumer::WalkTranlationUnit(clang::ASTContext* ast_context, clang::Tran
 
     // Root namespace
     cldb::Name parent_name;
+    m_DeclKindCounts.clear();
 
     // Iterate over every named declaration
     for (clang::DeclContext::decl_iterator i = tu_decl->decls_begin(); i != tu_decl->decls_end(); ++i)
@@ -663,6 +664,9 @@ void ASTConsumer::WalkTranlationUnit(clang::ASTContext* ast_context, clang::Tran
             break;
         }
     }
+
+    for (std::map<std::string, unsigned int>::const_iterator i = m_DeclKindCounts.begin(); i != m_DeclKindCounts.end(); ++i)
+        trace::Counter("Decls", i->first.c_str(), i->second);
 }
 
 void ASTConsumer::AddDecl(clang::NamedDecl* decl, const std::string& parent_name, const clang::ASTRecordLayout* layout)
@@ -692,6 +696,9 @@ void ASTConsumer::AddDecl(clang::NamedDecl* decl, const std::string& parent_name
     // attribute is specified
     if (m_AllowReflect || result == PAR_ReflectPartial)
     {
+        if (trace::IsEnabled())
+            m_DeclKindCounts[decl->getDeclKindName()]++;
+
         clang::Decl::Kind kind = decl->getKind();
         switch (kind)
         {
@@ -841,7 +848,7 @@ void ASTConsumer::AddClassDecl(clang::NamedDecl* decl, const std::string& name,
             class_ptr->size = layout.getSize().getQuantity();
 
             for (size_t i = 0; i < base_names.size(); i++)
-                LOG_APPEND(ast, INFO, (i == 0) ? " : %s" : ", %s", base_names[i].text.c_str());
+                LOG_APPEND(ast, INFO, (i == 0) ? " : %s" : ", %s", base_names[i].text);
             LOG_NEWLINE(ast);
 
             // Populate class contents
@@ -972,9 +979,9 @@ void ASTConsumer::AddFieldDecl(clang::NamedDecl* decl, const std::string& name,
         return;
     }
 
-    LOG(ast, INFO, "Field: %s%s%s %s\n", field.qualifier.is_const ? "const " : "", field.type.text.c_str(),
+    LOG(ast, INFO, "Field: %s%s%s %s\n", field.qualifier.is_const ? "const " : "", field.type.text,
         field.qualifier.op == cldb::Qualifier::POINTER ? "*" : field.qualifier.op == cldb::Qualifier::REFERENCE ? "&" : "",
-        field.name.text.c_str());
+        field.name.text);
     m_DB.AddPrimitive(field);
 }
 
@@ -1080,10 +1087,10 @@ void ASTConsumer::MakeFunction(clang::NamedDecl* decl, const std::string& functi
     LOG_PUSH_INDENT(ast);
 
     // Only add the return parameter if it's non-void
-    if (return_parameter.type.text != "void")
+    if (strcmp(return_parameter.type.text, "void") != 0)
     {
         LOG(ast, INFO, "Returns: %s%s%s\n", return_parameter.qualifier.is_const ? "const " : "",
-            return_parameter.type.text.c_str(),
+            return_parameter.type.text,
             return_parameter.qualifier.op == cldb::Qualifier::POINTER
                 ? "*"
                 : return_parameter.qualifier.op == cldb::Qualifier::REFERENCE ? "&" : "");
@@ -1097,9 +1104,9 @@ void ASTConsumer::MakeFunction(clang::NamedDecl* decl, const std::string& functi
     // Add the parameters
     for (std::vector<cldb::Field>::iterator i = parameters.begin(); i != parameters.end(); ++i)
     {
-        LOG(ast, INFO, "%s%s%s %s\n", i->qualifier.is_const ? "const " : "", i->type.text.c_str(),
+        LOG(ast, INFO, "%s%s%s %s\n", i->qualifier.is_const ? "const " : "", i->type.text,
             i->qualifier.op == cldb::Qualifier::POINTER ? "*" : i->qualifier.op == cldb::Qualifier::REFERENCE ? "&" : "",
-            i->name.text.c_str());
+            i->name.text);
         m_DB.AddPrimitive(*i);
     }
 
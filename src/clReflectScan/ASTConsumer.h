@@ -9,8 +9,12 @@
 // ===============================================================================
 //
 
+#include "AttributeParser.h"
+
 #include "clReflectCore/Database.h"
 
+#include <map>
+
 class ReflectionSpecs;
 
 namespace clang
@@ -42,6 +46,10 @@ public:
     {
         return m_ReflectionSpecs;
     }
+    AttributeCache& GetAttributeCache()
+    {
+        return m_AttributeCache;
+    }
 
 private:
     void AddDecl(clang::NamedDecl* decl, const std::string& parent_name, const clang::ASTRecordLayout* layout);
@@ -65,4 +73,9 @@ private:
     const ReflectionSpecs& m_ReflectionSpecs;
 
     bool m_AllowReflect;
+
+    AttributeCache m_AttributeCache;
+
+    // Number of reflected declarations of each kind in the current translation unit, for tracing
+    std::map<std::string, unsigned int> m_DeclKindCounts;
 };
@@ -19,9 +19,16 @@
 
 namespace
 {
-    // Error reporting feedback
-    const char* g_Filename = 0;
-    int g_Line = 0;
+    // Error reporting feedback, kept for each thread scanning
+    thread_local const char* g_Filename = 0;
+    thread_local int g_Line = 0;
+    thread_local bool g_HadWarning = false;
+
+    void Warning(const char* message)
+    {
+        LOG(warnings, INFO, "%s(%d) : warning - %s\n", g_Filename, g_Line, message);
+        g_HadWarning = true;
+    }
 
     enum TokenType
     {
@@ -53,8 +60,9 @@ namespace
 
         const char* GetText() const
         {
-            // Copy locally to a static string and return that after null terminating
-            static char text[1024];
+            // Copy locally to a static string and return that after null terminating, one for each
+            // thread as the server scans on several
+            static thread_local char text[1024];
             int l = length >= sizeof(text) ? sizeof(text) - 1 : length;
             strncpy(text, ptr, l);
             text[l] = 0;
@@ -82,7 +90,7 @@ namespace
             return text + 1;
         }
 
-        LOG(warnings, INFO, "%s(%d) : warning - String not terminated correctly\n", g_Filename, g_Line);
+        Warning("String not terminated correctly");
         return 0;
     }
 
@@ -115,7 +123,7 @@ namespace
                 // Prevent multiple occurrences
                 if (type != TOKEN_INT)
                 {
-                    LOG(warnings, INFO, "%s(%d) : warning - invalid integer representation\n", g_Filename, g_Line);
+                    Warning("invalid integer representation");
                     return 0;
                 }
 
@@ -185,7 +193,7 @@ namespace
 
                 else
                 {
-                    LOG(warnings, INFO, "%s(%d) : warning - Invalid character in attribute\n", g_Filename, g_Line);
+                    Warning("Invalid character in attribute");
                     text = 0;
                 }
             }
@@ -280,7 +288,7 @@ namespace
         const Token* attribute_name = ExpectNext(tokens, pos, TOKEN_SYMBOL);
         if (attribute_name == 0)
         {
-            LOG(warnings, INFO, "%s(%d) : warning - Symbol expected in attribute\n", g_Filename, g_Line);
+            Warning("Symbol expected in attribute");
             return false;
         }
 
@@ -289,7 +297,7 @@ namespace
         {
             if (pos >= tokens.size())
             {
-                LOG(warnings, INFO, "%s(%d) : warning - Value expected at the end of the attribute\n", g_Filename, g_Line);
+                Warning("Value expected at the end of the attribute");
                 return false;
             }
 
@@ -313,7 +321,7 @@ namespace
                 AddTextAttribute(db, attributes, attribute_name, val);
                 break;
             default:
-                LOG(warnings, INFO, "%s(%d) : warning - Value expected for attribute assignment\n", g_Filename, g_Line);
+                Warning("Value expected for attribute assignment");
                 return false;
             }
         }
@@ -354,14 +362,78 @@ namespace
 
         return attributes;
     }
+
+    cldb::Attribute* CloneAttribute(const cldb::Attribute* attribute)
+    {
+        switch (attribute->kind)
+        {
+        case (cldb::Primitive::KIND_FLAG_ATTRIBUTE):
+            return new cldb::FlagAttribute(*(const cldb::FlagAttribute*)attribute);
+        case (cldb::Primitive::KIND_INT_ATTRIBUTE):
+            return new cldb::IntAttribute(*(const cldb::IntAttribute*)attribute);
+        case (cldb::Primitive::KIND_FLOAT_ATTRIBUTE):
+            return new cldb::FloatAttribute(*(const cldb::FloatAttribute*)attribute);
+        case (cldb::Primitive::KIND_PRIMITIVE_ATTRIBUTE):
+            return new cldb::PrimitiveAttribute(*(const cldb::PrimitiveAttribute*)attribute);
+        case (cldb::Primitive::KIND_TEXT_ATTRIBUTE):
+            return new cldb::TextAttribute(*(const cldb::TextAttribute*)attribute);
+        default:
+            return 0;
+        }
+    }
 }
 
 std::vector<cldb::Attribute*> ParseAttributes(cldb::Database& db, const char* text, const char* filename, int line)
 {
     g_Filename = filename;
     g_Line = line;
+    g_HadWarning = false;
 
     // Make things a little simpler by lexing all tokens at once before parsing
     std::vector<Token> tokens = Lexer(text);
     return Parser(db, tokens);
 }
+
+AttributeCache::AttributeCache()
+    : m_NbHits(0)
+    , m_NbMisses(0)
+{
+}
+
+AttributeCache::~AttributeCache()
+{
+    for (CacheMap::iterator i = m_Cache.begin(); i != m_Cache.end(); ++i)
+    {
+        for (size_t j = 0; j < i->second.size(); j++)
+            delete i->second[j];
+    }
+}
+
+std::vector<cldb::Attribute*> AttributeCache::Parse(cldb::Database& db, const char* text, const char* filename, int line)
+{
+    std::vector<cldb::Attribute*> attributes;
+
+    CacheMap::const_iterator i = m_Cache.find(text);
+    if (i != m_Cache.end())
+    {
+        m_NbHits++;
+        attributes.reserve(i->second.size());
+        for (size_t j = 0; j < i->second.size(); j++)
+            attributes.push_back(CloneAttribute(i->second[j]));
+        return attributes;
+    }
+
+    m_NbMisses++;
+    attributes = ParseAttributes(db, text, filename, line);
+
+    // Text that generated warnings is parsed every time so that each use site gets reported
+    if (!g_HadWarning)
+    {
+        std::vector<cldb::Attribute*>& cached = m_Cache[text];
+        cached.reserve(attributes.size());
+        for (size_t j = 0; j < attributes.size(); j++)
+            cached.push_back(CloneAttribute(attributes[j]));
+    }
+
+    return attributes;
+}
@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace cldb
@@ -20,3 +22,34 @@ namespace cldb
 }
 
 std::vector<cldb::Attribute*> ParseAttributes(cldb::Database& db, const char* text, const char* filename, int line);
+
+//
+// The same annotation text tends to be applied to many declarations (e.g. through clcpp_push_attr), so
+// parsed results are kept against the raw text and copied out on a repeat. As attribute names are added
+// to the database during parsing, a cache must only be used with one database.
+//
+class AttributeCache
+{
+public:
+    AttributeCache();
+    ~AttributeCache();
+
+    // Same as ParseAttributes, with the caller owning the returned attributes
+    std::vector<cldb::Attribute*> Parse(cldb::Database& db, const char* text, const char* filename, int line);
+
+    unsigned int GetNbHits() const
+    {
+        return m_NbHits;
+    }
+    unsigned int GetNbMisses() const
+    {
+        return m_NbMisses;
+    }
+
+private:
+    typedef std::unordered_map<std::string, std::vector<cldb::Attribute*>> CacheMap;
+    CacheMap m_Cache;
+
+    unsigned int m_NbHits;
+    unsigned int m_NbMisses;
+};
@@ -10,13 +10,16 @@
 
 #include "ASTConsumer.h"
 #include "ReflectionSpecs.h"
+#include "ScanServer.h"
 
 #include "clReflectCore/Database.h"
 #include "clReflectCore/DatabaseBinarySerialiser.h"
 #include "clReflectCore/DatabaseTextSerialiser.h"
 #include "clReflectCore/Logging.h"
+#include "clReflectCore/Trace.h"
 
 #include "clang/AST/ASTContext.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
@@ -24,6 +27,7 @@
 #include <llvm/Support/TargetSelect.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 namespace
@@ -51,18 +55,26 @@ namespace
     class ReflectConsumer : public clang::ASTConsumer
     {
     public:
-        ReflectConsumer(ParseTUHandler handler)
+        ReflectConsumer(ParseTUHandler handler, llvm::StringRef file)
             : m_handler(handler)
+            , m_file(file.str())
+            , m_parse_start(trace::Now())
         {
         }
 
         void HandleTranslationUnit(clang::ASTContext& context)
         {
+            // The consumer is created just before parsing starts
+            trace::Span("Parse", m_file.c_str(), m_parse_start, trace::Now());
+
+            TRACE_SCOPE("Reflect", m_file.c_str());
             m_handler(context, context.getTranslationUnitDecl());
         }
 
     private:
         ParseTUHandler m_handler;
+        std::string m_file;
+        clcpp::uint64 m_parse_start;
     };
 
     // Frontend action to create the ReflectConsumer
@@ -76,7 +88,7 @@ namespace
 
         std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance& compiler, llvm::StringRef file)
         {
-            return std::unique_ptr<clang::ASTConsumer>(new ReflectConsumer(m_handler));
+            return std::unique_ptr<clang::ASTConsumer>(new ReflectConsumer(m_handler, file));
         }
 
     private:
@@ -99,6 +111,99 @@ namespace
         factory->handler = handler;
         return std::unique_ptr<clang::tooling::FrontendActionFactory>(factory);
     }
+
+    // Clock readings taken at the end of each stage, for the rough profiling info
+    struct ScanTimes
+    {
+        float parsing = 0;
+        float specs = 0;
+        float build = 0;
+        float end = 0;
+
+        unsigned int attribute_cache_hits = 0;
+        unsigned int attribute_cache_misses = 0;
+    };
+
+    int Scan(clang::tooling::ClangTool& tool, const std::string& output, const std::string& spec_log,
+             const std::string& ast_log, ScanTimes& times, std::vector<const clang::FileEntry*>* used_files = nullptr)
+    {
+        ReflectionSpecs reflection_specs(spec_log);
+        cldb::Database db;
+        ASTConsumer ast_consumer(db, reflection_specs, ast_log);
+
+        if (tool.run(NewReflectFrontendActionFactory([&](clang::ASTContext& context, clang::TranslationUnitDecl* tu_decl) {
+                        // Measures parsing and creation of the AST
+                        times.parsing = clock();
+
+                        // Record every file the translation unit loaded
+                        if (used_files != nullptr)
+                        {
+                            const clang::SourceManager& source_manager = context.getSourceManager();
+                            for (auto i = source_manager.fileinfo_begin(); i != source_manager.fileinfo_end(); ++i)
+                                used_files->push_back(i->first);
+                        }
+
+                        // Gather reflection specs for the translation unit
+                        {
+                            TRACE_SCOPE("Specs");
+                            reflection_specs.Gather(tu_decl);
+                        }
+
+                        times.specs = clock();
+
+                        // On the second pass, build the reflection database
+                        TRACE_SCOPE("Walk");
+                        db.AddBaseTypePrimitives();
+                        ast_consumer.WalkTranlationUnit(&context, tu_decl);
+                    }).get()) != 0)
+        {
+            return 1;
+        }
+
+        times.build = clock();
+        times.attribute_cache_hits = ast_consumer.GetAttributeCache().GetNbHits();
+        times.attribute_cache_misses = ast_consumer.GetAttributeCache().GetNbMisses();
+
+        // Add all the container specs
+        const ReflectionSpecContainer::MapType& container_specs = reflection_specs.GetContainerSpecs();
+        for (ReflectionSpecContainer::MapType::const_iterator i = container_specs.begin(); i != container_specs.end(); ++i)
+        {
+            const ReflectionSpecContainer& c = i->second;
+            db.AddContainerInfo(i->first, c.read_iterator_type, c.write_iterator_type, c.has_key);
+        }
+
+        // Write to a text/binary database depending upon extension
+        if (output != "")
+        {
+            TRACE_SCOPE("WriteDatabase", output.c_str());
+            WriteDatabase(db, output);
+        }
+
+        times.end = clock();
+        return 0;
+    }
+
+    bool WriteTrace(const std::string& filename)
+    {
+        if (!trace::Close())
+        {
+            LOG(main, ERROR, "Couldn't write trace file '%s'\n", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool IsServerMode(int argc, const char* argv[])
+    {
+        // Needs to be known before option parsing as the server takes no source files
+        for (int i = 1; i < argc && strcmp(argv[i], "--") != 0; i++)
+        {
+            if (strcmp(argv[i], "-server") == 0 || strcmp(argv[i], "--server") == 0 ||
+                strncmp(argv[i], "-server=", 8) == 0 || strncmp(argv[i], "--server=", 9) == 0)
+                return true;
+        }
+        return false;
+    }
 }
 
 int main(int argc, const char* argv[])
@@ -106,6 +211,9 @@ int main(int argc, const char* argv[])
     float start = clock();
 
     LOG_TO_STDOUT(main, ALL);
+    LOG_TO_STDOUT(warnings, INFO);
+    LOG_TO_STDOUT(spec, WARNING);
+    LOG_TO_STDOUT(spec, ERROR);
 
     // Command-line options
     static llvm::cl::OptionCategory ToolCategoryOption("clreflect options");
@@ -117,73 +225,85 @@ int main(int argc, const char* argv[])
     static llvm::cl::opt<std::string> Output("output", llvm::cl::desc("Specify database output file, depending on extension"),
                                              ToolCategory, llvm::cl::value_desc("filename"));
     static llvm::cl::opt<bool> Timing("timing", llvm::cl::desc("Print some rough timing info"), ToolCategory);
+    static llvm::cl::opt<std::string> Server("server",
+                                             llvm::cl::desc("Stay resident, serving scan requests on a Unix-domain socket"),
+                                             ToolCategory, llvm::cl::value_desc("socket"));
+    static llvm::cl::opt<std::string> Trace("trace", llvm::cl::desc("Write Chrome trace-event profiling info to a JSON file"),
+                                            ToolCategory, llvm::cl::value_desc("filename"));
 
     // Parse command-line options
-    auto options_parser = clang::tooling::CommonOptionsParser::create(argc, argv, ToolCategoryOption, llvm::cl::OneOrMore);
+    bool server_mode = IsServerMode(argc, argv);
+    auto options_parser = clang::tooling::CommonOptionsParser::create(argc, argv, ToolCategoryOption,
+                                                                      server_mode ? llvm::cl::ZeroOrMore : llvm::cl::OneOrMore);
     if (!options_parser)
     {
         return 1;
     }
 
+    if (Trace != "")
+    {
+        trace::Open(Trace.c_str(), "clscan");
+    }
+    clcpp::uint64 trace_prologue_start = trace::Now();
+
     // Initialize inline ASM parsing
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmParser();
 
+    // Each request carries its own file, compiler flags and output, sharing the file manager
+    // of the server with other requests from the same working directory
+    if (server_mode)
+    {
+        int result = RunScanServer(Server, [](const ScanRequest& request, ScanContext& context) {
+            int result;
+            {
+                TRACE_SCOPE("ScanRequest", request.input_filename.c_str());
+                clang::tooling::FixedCompilationDatabase compilations(request.working_directory, request.compiler_args);
+                clang::tooling::ClangTool tool(compilations, {request.input_filename},
+                                               std::make_shared<clang::PCHContainerOperations>(), context.fs,
+                                               context.files);
+
+                // Diagnostics are collected for the client rather than written to the server's stderr
+                clang::TextDiagnosticPrinter diagnostics(*context.diagnostics, new clang::DiagnosticOptions());
+                tool.setDiagnosticConsumer(&diagnostics);
+
+                ScanTimes times;
+                result = Scan(tool, request.output_filename, "", "", times, &context.used_files);
+            }
+
+            // Write out each request's events so they don't accumulate while the server is resident
+            trace::Flush();
+            return result;
+        });
+        return WriteTrace(Trace) ? result : 1;
+    }
+
     // Create the clang tool that parses the input files
     clang::tooling::ClangTool tool(options_parser->getCompilations(), options_parser->getSourcePathList());
 
     float prologue = clock();
+    trace::Span("Prologue", 0, trace_prologue_start, trace::Now());
 
-    ReflectionSpecs reflection_specs(ReflectionSpecLog);
-    cldb::Database db;
-    ASTConsumer ast_consumer(db, reflection_specs, ASTLog);
-
-    float parsing, specs;
-
-    if (tool.run(NewReflectFrontendActionFactory([&](clang::ASTContext& context, clang::TranslationUnitDecl* tu_decl) {
-                    // Measures parsing and creation of the AST
-                    parsing = clock();
-
-                    // Gather reflection specs for the translation unit
-                    reflection_specs.Gather(tu_decl);
-
-                    specs = clock();
-
-                    // On the second pass, build the reflection database
-                    db.AddBaseTypePrimitives();
-                    ast_consumer.WalkTranlationUnit(&context, tu_decl);
-                }).get()) != 0)
+    ScanTimes times;
+    int result = Scan(tool, Output, ReflectionSpecLog, ASTLog, times);
+    if (!WriteTrace(Trace) || result != 0)
     {
         return 1;
     }
 
-    float build = clock();
-
-    // Add all the container specs
-    const ReflectionSpecContainer::MapType& container_specs = reflection_specs.GetContainerSpecs();
-    for (ReflectionSpecContainer::MapType::const_iterator i = container_specs.begin(); i != container_specs.end(); ++i)
-    {
-        const ReflectionSpecContainer& c = i->second;
-        db.AddContainerInfo(i->first, c.read_iterator_type, c.write_iterator_type, c.has_key);
-    }
-
-    // Write to a text/binary database depending upon extension
-    if (Output != "")
-    {
-        WriteDatabase(db, Output);
-    }
-
-    float end = clock();
-
     // Print some rough profiling info
     if (Timing)
     {
         printf("Prologue:   %.3f\n", (prologue - start) / CLOCKS_PER_SEC);
-        printf("Parsing:    %.3f\n", (parsing - prologue) / CLOCKS_PER_SEC);
-        printf("Specs:      %.3f\n", (specs - parsing) / CLOCKS_PER_SEC);
-        printf("Building:   %.3f\n", (build - specs) / CLOCKS_PER_SEC);
-        printf("Database:   %.3f\n", (end - build) / CLOCKS_PER_SEC);
-        printf("Total time: %.3f\n", (end - start) / CLOCKS_PER_SEC);
+        printf("Parsing:    %.3f\n", (times.parsing - prologue) / CLOCKS_PER_SEC);
+        printf("Specs:      %.3f\n", (times.specs - times.parsing) / CLOCKS_PER_SEC);
+        printf("Building:   %.3f\n", (times.build - times.specs) / CLOCKS_PER_SEC);
+        printf("Database:   %.3f\n", (times.end - times.build) / CLOCKS_PER_SEC);
+        printf("Total time: %.3f\n", (times.end - start) / CLOCKS_PER_SEC);
+
+        unsigned int nb_lookups = times.attribute_cache_hits + times.attribute_cache_misses;
+        printf("Attribute cache: %u/%u hits (%.1f%%)\n", times.attribute_cache_hits, nb_lookups,
+               nb_lookups ? 100.0f * times.attribute_cache_hits / nb_lookups : 0.0f);
     }
 
     return 0;
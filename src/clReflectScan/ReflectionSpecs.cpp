@@ -66,9 +66,6 @@ namespace
 
 ReflectionSpecs::ReflectionSpecs(const std::string& spec_log)
 {
-    LOG_TO_STDOUT(spec, WARNING);
-    LOG_TO_STDOUT(spec, ERROR);
-
     if (spec_log != "")
         LOG_TO_FILE(spec, ALL, spec_log.c_str());
 }
@@ -0,0 +1,691 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#include "ScanServer.h"
+#include "ScanServerProtocol.h"
+
+#include <clReflectCore/Logging.h>
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/FileSystemOptions.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    // Clang is normally run on the main thread, which has a much larger stack than threads get by default
+    // on some platforms
+    const size_t WORKER_STACK_SIZE = 8 * 1024 * 1024;
+
+    // Memory each worker can keep the results of previous scans in, dropping the least recently used first
+    const size_t MAX_CACHED_RESULTS_SIZE = 256 * 1024 * 1024;
+
+    // The state of a path on disk, for noticing when it changes
+    struct PathState
+    {
+        PathState()
+            : exists(false)
+            , size(0)
+        {
+        }
+
+        bool operator==(const PathState& rhs) const
+        {
+            return exists == rhs.exists && size == rhs.size && mtime == rhs.mtime;
+        }
+        bool operator!=(const PathState& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        bool exists;
+        uint64_t size;
+        llvm::sys::TimePoint<> mtime;
+    };
+
+    typedef std::map<std::string, PathState> PathStateMap;
+
+    PathState GetPathState(llvm::vfs::FileSystem& fs, const llvm::Twine& path)
+    {
+        PathState state;
+        llvm::ErrorOr<llvm::vfs::Status> status = fs.status(path);
+        if (status)
+        {
+            state.exists = true;
+            state.size = status->getSize();
+            state.mtime = status->getLastModificationTime();
+        }
+        return state;
+    }
+
+    bool ArePathsStale(llvm::vfs::FileSystem& fs, const PathStateMap& paths)
+    {
+        for (const auto& path : paths)
+        {
+            if (GetPathState(fs, path.first) != path.second)
+                return true;
+        }
+        return false;
+    }
+
+    bool IsFileUnchanged(const PathState& state, const clang::FileEntry* entry)
+    {
+        // The file manager only records modification times to the second
+        return state.exists && state.size == (uint64_t)entry->getSize() &&
+               llvm::sys::toTimeT(state.mtime) == entry->getModificationTime();
+    }
+
+    bool AreFilesStale(llvm::vfs::FileSystem& fs, const clang::FileEntry* const* entries, size_t nb_entries)
+    {
+        // Any cached file that has changed on disk since it was first seen invalidates the whole
+        // cache. Builds tend to touch a handful of files between runs, making this a rare event
+        // relative to the number of requests served.
+        for (size_t i = 0; i < nb_entries; i++)
+        {
+            const clang::FileEntry* entry = entries[i];
+            if (entry != nullptr && !IsFileUnchanged(GetPathState(fs, entry->getName()), entry))
+                return true;
+        }
+
+        return false;
+    }
+
+    //
+    // Passes lookups through to the disk, recording the state of each directory that a path is looked
+    // up in when it's first used. Creating, removing or renaming a file changes the modification time of
+    // its directory, so checking these directories catches any include that would now be found somewhere
+    // else. That includes new headers that shadow others further down the include path, which the file
+    // manager would otherwise keep answering from its cache of failed lookups.
+    //
+    class RecordingFileSystem : public llvm::vfs::ProxyFileSystem
+    {
+    public:
+        explicit RecordingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+            : ProxyFileSystem(fs)
+            , m_Directories(std::make_shared<PathStateMap>())
+        {
+        }
+
+        llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine& path) override
+        {
+            RecordParent(path);
+            return ProxyFileSystem::status(path);
+        }
+
+        llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine& path) override
+        {
+            RecordParent(path);
+            return ProxyFileSystem::openFileForRead(path);
+        }
+
+        llvm::vfs::directory_iterator dir_begin(const llvm::Twine& dir, std::error_code& ec) override
+        {
+            // Listing a directory depends on everything in it
+            llvm::SmallString<256> absolute;
+            dir.toVector(absolute);
+            makeAbsolute(absolute);
+            Record(absolute.str().str());
+            return ProxyFileSystem::dir_begin(dir, ec);
+        }
+
+        // The directories recorded so far, which results share until more are recorded
+        std::shared_ptr<const PathStateMap> GetDirectories() const
+        {
+            return m_Directories;
+        }
+
+    private:
+        void RecordParent(const llvm::Twine& path)
+        {
+            llvm::SmallString<256> absolute;
+            path.toVector(absolute);
+            makeAbsolute(absolute);
+            llvm::StringRef parent = llvm::sys::path::parent_path(absolute);
+            if (!parent.empty())
+                Record(parent.str());
+        }
+
+        void Record(const std::string& dir)
+        {
+            if (m_Directories->count(dir) != 0)
+                return;
+
+            // Recorded before the lookup is made so that any change after it is seen
+            if (m_Directories.use_count() > 1)
+                m_Directories = std::make_shared<PathStateMap>(*m_Directories);
+            (*m_Directories)[dir] = GetPathState(getUnderlyingFS(), dir);
+        }
+
+        std::shared_ptr<PathStateMap> m_Directories;
+    };
+
+    // Collects everything the calling thread logs to stdout while in scope
+    struct CaptureStdout
+    {
+        CaptureStdout(std::string& text)
+            : text(text)
+            , buffer(nullptr)
+            , size(0)
+        {
+            fp = open_memstream(&buffer, &size);
+            logging::SetThreadStdout(fp);
+        }
+
+        ~CaptureStdout()
+        {
+            logging::SetThreadStdout(nullptr);
+            if (fp != nullptr)
+            {
+                fclose(fp);
+                text.assign(buffer, size);
+            }
+            free(buffer);
+        }
+
+        std::string& text;
+        char* buffer;
+        size_t size;
+        FILE* fp;
+    };
+
+    bool ReadFile(const std::string& filename, std::string& data)
+    {
+        FILE* fp = fopen(filename.c_str(), "rb");
+        if (fp == nullptr)
+            return false;
+
+        char buffer[64 * 1024];
+        size_t size;
+        data.clear();
+        while ((size = fread(buffer, 1, sizeof(buffer), fp)) != 0)
+            data.append(buffer, size);
+
+        bool read = !ferror(fp);
+        fclose(fp);
+        return read;
+    }
+
+    bool WriteFile(const std::string& filename, const std::string& data)
+    {
+        FILE* fp = fopen(filename.c_str(), "wb");
+        if (fp == nullptr)
+            return false;
+
+        bool written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+        return fclose(fp) == 0 && written;
+    }
+
+    std::string GetRequestKey(const ScanRequest& request)
+    {
+        // Different compiler arguments can include different files, and the output's extension decides its format
+        std::string key = request.input_filename;
+        key += '\0';
+        key += request.output_filename;
+        for (const std::string& arg : request.compiler_args)
+        {
+            key += '\0';
+            key += arg;
+        }
+        return key;
+    }
+
+    // A connected client waiting for its request to be served, which owns the descriptors until it's replied to
+    struct PendingRequest
+    {
+        PendingRequest()
+            : client_fd(-1)
+            , out_fd(-1)
+            , err_fd(-1)
+        {
+        }
+
+        int client_fd;
+        int out_fd;
+        int err_fd;
+        ScanRequest request;
+    };
+
+    void ReplyToClient(const PendingRequest& pending, const std::string& out_text, const std::string& err_text, int exit_code)
+    {
+        // Output is passed on once the request completes so that concurrent requests can't interleave theirs
+        if (pending.out_fd != -1 && !out_text.empty())
+            scanserver::WriteAll(pending.out_fd, out_text.data(), out_text.size());
+        if (pending.err_fd != -1 && !err_text.empty())
+            scanserver::WriteAll(pending.err_fd, err_text.data(), err_text.size());
+        scanserver::WriteU32(pending.client_fd, exit_code);
+
+        if (pending.out_fd != -1)
+            close(pending.out_fd);
+        if (pending.err_fd != -1)
+            close(pending.err_fd);
+        close(pending.client_fd);
+    }
+
+    // A successful scan, kept to be written again while the files it loaded and the directories that had
+    // been searched when it was made are unchanged
+    struct CachedResult
+    {
+        CachedResult()
+            : last_used(0)
+        {
+        }
+
+        size_t Size() const
+        {
+            return database.size() + out_text.size() + err_text.size();
+        }
+
+        std::string database;
+        std::string out_text;
+        std::string err_text;
+        PathStateMap files;
+        std::shared_ptr<const PathStateMap> directories;
+        unsigned int last_used;
+    };
+
+    //
+    // Serves the requests from one working directory in the order they arrive. Each worker has its own
+    // thread and file manager so that requests from different directories are scanned concurrently
+    // without sharing anything that clang caches.
+    //
+    class Worker
+    {
+    public:
+        Worker(const std::string& working_directory, const ScanRequestHandler& handler)
+            : nb_requests(0)
+            , nb_file_manager_resets(0)
+            , nb_reused_results(0)
+            , m_WorkingDirectory(working_directory)
+            , m_Handler(handler)
+            , m_Started(false)
+            , m_Stopping(false)
+            , m_Clock(0)
+            , m_CachedResultsSize(0)
+        {
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+            m_Started = pthread_create(&m_Thread, &attr, ThreadMain, this) == 0;
+            pthread_attr_destroy(&attr);
+        }
+
+        ~Worker()
+        {
+            Stop();
+        }
+
+        void Push(const PendingRequest& pending)
+        {
+            // Serve on the calling thread if there isn't one of our own
+            if (!m_Started)
+            {
+                ServeAndReply(pending);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Queue.push_back(pending);
+            }
+            m_Ready.notify_one();
+        }
+
+        // Finishes any requests already queued before the thread exits
+        void Stop()
+        {
+            if (!m_Started)
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_Ready.notify_one();
+            pthread_join(m_Thread, nullptr);
+            m_Started = false;
+        }
+
+        // Only to be read once stopped
+        unsigned int nb_requests;
+        unsigned int nb_file_manager_resets;
+        unsigned int nb_reused_results;
+
+    private:
+        static void* ThreadMain(void* data)
+        {
+            ((Worker*)data)->Run();
+            return nullptr;
+        }
+
+        void Run()
+        {
+            while (true)
+            {
+                PendingRequest pending;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Ready.wait(lock, [this] { return m_Stopping || !m_Queue.empty(); });
+                    if (m_Queue.empty())
+                        return;
+                    pending = m_Queue.front();
+                    m_Queue.pop_front();
+                }
+
+                ServeAndReply(pending);
+            }
+        }
+
+        void ServeAndReply(const PendingRequest& pending)
+        {
+            std::string out_text, err_text;
+            int exit_code = Serve(pending.request, out_text, err_text);
+            ReplyToClient(pending, out_text, err_text, exit_code);
+        }
+
+        int Serve(const ScanRequest& client_request, std::string& out_text, std::string& err_text)
+        {
+            nb_requests++;
+
+            // The output is written by this process so it's resolved against the request's working directory
+            // here, with the file system resolving everything clang opens
+            ScanRequest request = client_request;
+            if (request.output_filename != "")
+            {
+                llvm::SmallString<256> output(request.output_filename);
+                llvm::sys::fs::make_absolute(m_WorkingDirectory, output);
+                request.output_filename = output.str().str();
+            }
+
+            std::string request_key = GetRequestKey(request);
+            if (ReuseResult(request, request_key, out_text, err_text))
+                return 0;
+
+            int exit_code = 1;
+            ScanContext context;
+            {
+                CaptureStdout capture(out_text);
+                if (!PrepareFileManager(request_key))
+                    return 1;
+
+                llvm::raw_string_ostream diagnostics(err_text);
+                context.fs = m_FS;
+                context.files = m_Files;
+                context.diagnostics = &diagnostics;
+                exit_code = m_Handler(request, context);
+                diagnostics.flush();
+            }
+
+            // Failed scans may not have recorded everything they loaded
+            if (exit_code != 0)
+            {
+                m_RequestFiles.erase(request_key);
+                return exit_code;
+            }
+
+            m_RequestFiles[request_key] = context.used_files;
+            CacheResult(request, request_key, context.used_files, out_text, err_text);
+            return 0;
+        }
+
+        bool PrepareFileManager(const std::string& request_key)
+        {
+            if (m_Files != nullptr && !IsFileManagerStale(request_key))
+                return true;
+
+            // Each worker gets a view of the disk with its own working directory as requests from other
+            // directories are served at the same time
+            llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> disk(llvm::vfs::createPhysicalFileSystem().release());
+            if (!llvm::sys::path::is_absolute(m_WorkingDirectory) || disk->setCurrentWorkingDirectory(m_WorkingDirectory))
+            {
+                LOG(main, ERROR, "Couldn't use working directory '%s'\n", m_WorkingDirectory.c_str());
+                return false;
+            }
+
+            clang::FileSystemOptions options;
+            options.WorkingDir = m_WorkingDirectory;
+            m_Disk = disk;
+            m_FS = new RecordingFileSystem(disk);
+            m_Files = new clang::FileManager(options, m_FS);
+            m_RequestFiles.clear();
+            nb_file_manager_resets++;
+            return true;
+        }
+
+        bool IsFileManagerStale(const std::string& request_key)
+        {
+            // A file added, removed or renamed in any directory that has been searched can change where an
+            // include is found, whichever request first searched for it
+            if (ArePathsStale(*m_Disk, *m_FS->GetDirectories()))
+                return true;
+
+            // Repeated requests check only the files they used before, as none of them can include anything
+            // new without changing themselves. Files used by new requests aren't known so all are checked.
+            auto i = m_RequestFiles.find(request_key);
+            if (i != m_RequestFiles.end())
+                return AreFilesStale(*m_Disk, i->second.data(), i->second.size());
+
+            llvm::SmallVector<const clang::FileEntry*, 1024> entries;
+            m_Files->GetUniqueIDMapping(entries);
+            return AreFilesStale(*m_Disk, entries.data(), entries.size());
+        }
+
+        bool ReuseResult(const ScanRequest& request, const std::string& request_key, std::string& out_text,
+                         std::string& err_text)
+        {
+            auto i = m_CachedResults.find(request_key);
+            if (i == m_CachedResults.end())
+                return false;
+
+            // Results are only reused while everything they were made from is the same, otherwise they're
+            // scanned again and replaced
+            CachedResult& result = i->second;
+            if (ArePathsStale(*m_Disk, result.files) || ArePathsStale(*m_Disk, *result.directories) ||
+                (request.output_filename != "" && !WriteFile(request.output_filename, result.database)))
+            {
+                DropResult(i);
+                return false;
+            }
+
+            out_text = result.out_text;
+            err_text = result.err_text;
+            result.last_used = ++m_Clock;
+            nb_reused_results++;
+            return true;
+        }
+
+        void CacheResult(const ScanRequest& request, const std::string& request_key,
+                         const std::vector<const clang::FileEntry*>& used_files, const std::string& out_text,
+                         const std::string& err_text)
+        {
+            CachedResult result;
+            if (request.output_filename != "" && !ReadFile(request.output_filename, result.database))
+                return;
+
+            // Files that changed while they were being scanned aren't recorded as they were read
+            for (const clang::FileEntry* entry : used_files)
+            {
+                if (entry == nullptr)
+                    continue;
+
+                llvm::SmallString<256> path(entry->getName());
+                m_Disk->makeAbsolute(path);
+                PathState state = GetPathState(*m_Disk, path);
+                if (!IsFileUnchanged(state, entry))
+                    return;
+                result.files[path.str().str()] = state;
+            }
+
+            result.directories = m_FS->GetDirectories();
+            result.out_text = out_text;
+            result.err_text = err_text;
+            result.last_used = ++m_Clock;
+            if (result.Size() > MAX_CACHED_RESULTS_SIZE)
+                return;
+
+            // Make room by dropping the least recently used results
+            auto existing = m_CachedResults.find(request_key);
+            if (existing != m_CachedResults.end())
+                DropResult(existing);
+            while (m_CachedResultsSize + result.Size() > MAX_CACHED_RESULTS_SIZE)
+            {
+                auto oldest = m_CachedResults.begin();
+                for (auto j = m_CachedResults.begin(); j != m_CachedResults.end(); ++j)
+                {
+                    if (j->second.last_used < oldest->second.last_used)
+                        oldest = j;
+                }
+                DropResult(oldest);
+            }
+
+            m_CachedResultsSize += result.Size();
+            m_CachedResults[request_key] = std::move(result);
+        }
+
+        void DropResult(std::map<std::string, CachedResult>::iterator i)
+        {
+            m_CachedResultsSize -= i->second.Size();
+            m_CachedResults.erase(i);
+        }
+
+        std::string m_WorkingDirectory;
+        const ScanRequestHandler& m_Handler;
+
+        pthread_t m_Thread;
+        bool m_Started;
+
+        // Requests waiting for the thread
+        std::mutex m_Mutex;
+        std::condition_variable m_Ready;
+        std::deque<PendingRequest> m_Queue;
+        bool m_Stopping;
+
+        // Shared between requests so that header stats, directory lookups and include path misses are only
+        // paid once while nothing changes
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> m_Disk;
+        llvm::IntrusiveRefCntPtr<RecordingFileSystem> m_FS;
+        llvm::IntrusiveRefCntPtr<clang::FileManager> m_Files;
+
+        // The files each request loaded the last time it was served, keyed by the request, so that only
+        // those need checking when it's repeated. The entries are owned by the file manager.
+        std::map<std::string, std::vector<const clang::FileEntry*>> m_RequestFiles;
+
+        std::map<std::string, CachedResult> m_CachedResults;
+        unsigned int m_Clock;
+        size_t m_CachedResultsSize;
+    };
+}
+
+int RunScanServer(const std::string& socket_path, ScanRequestHandler handler)
+{
+    int listen_fd = scanserver::Listen(socket_path);
+    if (listen_fd == -1)
+    {
+        LOG(main, ERROR, "Couldn't listen on socket '%s'\n", socket_path.c_str());
+        return 1;
+    }
+
+    // A client disappearing before its reply is written shouldn't take the server down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    LOG(main, INFO, "clscan server listening on '%s'\n", socket_path.c_str());
+
+    // Workers are created by the first request from each working directory
+    std::map<std::string, std::unique_ptr<Worker>> workers;
+    PendingRequest shutdown_request;
+    bool running = true;
+    while (running)
+    {
+        PendingRequest pending;
+        pending.client_fd = accept(listen_fd, 0, 0);
+        if (pending.client_fd == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG(main, ERROR, "Failed to accept connection on socket '%s'\n", socket_path.c_str());
+            break;
+        }
+
+        std::vector<std::string> strings;
+        if (!scanserver::ReceiveDescriptors(pending.client_fd, pending.out_fd, pending.err_fd) ||
+            !scanserver::ReadStrings(pending.client_fd, strings))
+        {
+            ReplyToClient(pending, "", "", 1);
+        }
+
+        // An empty request is a shutdown request, answered once the requests already received are complete
+        else if (strings.empty())
+        {
+            shutdown_request = pending;
+            running = false;
+        }
+
+        else if (strings.size() >= 3)
+        {
+            pending.request.working_directory = strings[0];
+            pending.request.input_filename = strings[1];
+            pending.request.output_filename = strings[2];
+            pending.request.compiler_args.assign(strings.begin() + 3, strings.end());
+
+            std::unique_ptr<Worker>& worker = workers[pending.request.working_directory];
+            if (worker == nullptr)
+                worker.reset(new Worker(pending.request.working_directory, handler));
+            worker->Push(pending);
+        }
+
+        else
+        {
+            // Requests need at least a working directory, input and output
+            std::string out_text;
+            {
+                CaptureStdout capture(out_text);
+                LOG(main, ERROR, "Malformed scan request with %u strings, expecting at least 3\n",
+                    (unsigned int)strings.size());
+            }
+            ReplyToClient(pending, out_text, "", 1);
+        }
+    }
+
+    // Stop taking connections before waiting for the workers
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    unsigned int nb_requests = 0, nb_file_manager_resets = 0, nb_reused_results = 0;
+    for (auto& worker : workers)
+    {
+        worker.second->Stop();
+        nb_requests += worker.second->nb_requests;
+        nb_file_manager_resets += worker.second->nb_file_manager_resets;
+        nb_reused_results += worker.second->nb_reused_results;
+    }
+    workers.clear();
+
+    if (shutdown_request.client_fd != -1)
+        ReplyToClient(shutdown_request, "", "", 0);
+
+    LOG(main, INFO, "clscan server shut down after %u requests (%u file cache resets, %u results reused)\n", nb_requests,
+        nb_file_manager_resets, nb_reused_results);
+    return 0;
+}
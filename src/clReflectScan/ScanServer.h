@@ -0,0 +1,65 @@
+//
+// ===============================================================================
+// clReflect, ScanServer.h - Resident clscan process that accepts scan requests
+// over a local Unix-domain socket, keeping clang file caches warm between them.
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#pragma once
+
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+    class FileManager;
+    class FileEntry;
+}
+
+namespace llvm
+{
+    class raw_ostream;
+    namespace vfs
+    {
+        class FileSystem;
+    }
+}
+
+struct ScanRequest
+{
+    std::string working_directory;
+    std::string input_filename;
+    std::string output_filename;
+    std::vector<std::string> compiler_args;
+};
+
+// What a request is scanned with. The file system and file manager are shared by all requests from the same
+// working directory, with the file system resolving relative paths against that directory so that the
+// process working directory is never changed.
+struct ScanContext
+{
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs;
+    llvm::IntrusiveRefCntPtr<clang::FileManager> files;
+
+    // Where clang diagnostics are written to be passed on to the client
+    llvm::raw_ostream* diagnostics;
+
+    // Filled with the files that the translation unit loaded
+    std::vector<const clang::FileEntry*> used_files;
+};
+
+// Scans the requested file, writing the output file relative to the working directory and returning the
+// clscan exit code. Called from the worker thread of the request's working directory.
+typedef std::function<int(const ScanRequest&, ScanContext&)> ScanRequestHandler;
+
+// Serves requests until a client asks for shutdown, with a worker thread for each working directory so that
+// requests from different directories are scanned concurrently. The reflection databases of successful scans
+// are kept in memory and written again, along with their output, when the same request is repeated while
+// none of the files it loaded or the directories its includes were searched in have changed.
+int RunScanServer(const std::string& socket_path, ScanRequestHandler handler);
@@ -0,0 +1,217 @@
+//
+// ===============================================================================
+// clReflect, ScanServerProtocol.h - Wire format shared by the persistent clscan
+// server and its thin client, carried over a local Unix-domain socket.
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//
+// A request is sent as:
+//
+//    1. A single byte carrying the client's stdout/stderr descriptors as SCM_RIGHTS ancillary data
+//       so that warnings and clang diagnostics appear in the client's output, not the server's.
+//    2. A string count followed by each length-prefixed string: working directory, input filename,
+//       output filename and then all compiler arguments. A count of zero asks the server to exit
+//       once the requests it has already received are complete.
+//
+// The server writes the request's output to the descriptors once it completes, so that requests
+// served concurrently don't interleave, and then replies with the exit code clscan would have
+// returned for the same command-line.
+//
+namespace scanserver
+{
+    inline bool WriteAll(int fd, const void* data, size_t size)
+    {
+        const char* ptr = (const char*)data;
+        while (size)
+        {
+            ssize_t written = write(fd, ptr, size);
+            if (written <= 0)
+                return false;
+            ptr += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    inline bool ReadAll(int fd, void* data, size_t size)
+    {
+        char* ptr = (char*)data;
+        while (size)
+        {
+            ssize_t nb_read = read(fd, ptr, size);
+            if (nb_read <= 0)
+                return false;
+            ptr += nb_read;
+            size -= nb_read;
+        }
+        return true;
+    }
+
+    inline bool WriteU32(int fd, unsigned int value)
+    {
+        return WriteAll(fd, &value, sizeof(value));
+    }
+
+    inline bool ReadU32(int fd, unsigned int& value)
+    {
+        return ReadAll(fd, &value, sizeof(value));
+    }
+
+    inline bool WriteStrings(int fd, const std::vector<std::string>& strings)
+    {
+        if (!WriteU32(fd, strings.size()))
+            return false;
+        for (size_t i = 0; i < strings.size(); i++)
+        {
+            if (!WriteU32(fd, strings[i].length()) || !WriteAll(fd, strings[i].c_str(), strings[i].length()))
+                return false;
+        }
+        return true;
+    }
+
+    inline bool ReadStrings(int fd, std::vector<std::string>& strings)
+    {
+        // Guard against garbage from something that isn't a clscan client
+        const unsigned int max_nb_strings = 64 * 1024;
+        const unsigned int max_string_length = 1024 * 1024;
+
+        unsigned int nb_strings;
+        if (!ReadU32(fd, nb_strings) || nb_strings > max_nb_strings)
+            return false;
+
+        strings.resize(nb_strings);
+        for (unsigned int i = 0; i < nb_strings; i++)
+        {
+            unsigned int length;
+            if (!ReadU32(fd, length) || length > max_string_length)
+                return false;
+            strings[i].resize(length);
+            if (length && !ReadAll(fd, &strings[i][0], length))
+                return false;
+        }
+        return true;
+    }
+
+    inline bool SendDescriptors(int fd, int out_fd, int err_fd)
+    {
+        int fds[2] = { out_fd, err_fd };
+        char byte = 0;
+        iovec iov;
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+
+        char control[CMSG_SPACE(sizeof(fds))];
+        memset(control, 0, sizeof(control));
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        return sendmsg(fd, &msg, 0) == 1;
+    }
+
+    inline bool ReceiveDescriptors(int fd, int& out_fd, int& err_fd)
+    {
+        int fds[2] = { -1, -1 };
+        char byte;
+        iovec iov;
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+
+        char control[CMSG_SPACE(sizeof(fds))];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, 0) != 1)
+            return false;
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == 0 || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+            return false;
+
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        out_fd = fds[0];
+        err_fd = fds[1];
+        return true;
+    }
+
+    inline bool MakeSocketAddress(const std::string& path, sockaddr_un& addr)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.length() >= sizeof(addr.sun_path))
+            return false;
+        strcpy(addr.sun_path, path.c_str());
+        return true;
+    }
+
+    inline int Connect(const std::string& path)
+    {
+        sockaddr_un addr;
+        if (!MakeSocketAddress(path, addr))
+            return -1;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1)
+            return -1;
+
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    inline int Listen(const std::string& path)
+    {
+        sockaddr_un addr;
+        if (!MakeSocketAddress(path, addr))
+            return -1;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1)
+            return -1;
+
+        // Remove any stale socket left behind by a server that didn't shut down cleanly
+        unlink(path.c_str());
+
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+}
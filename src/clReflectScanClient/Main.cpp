@@ -0,0 +1,97 @@
+//
+// ===============================================================================
+// clReflect
+// -------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 Don Williamson & clReflect Authors (see AUTHORS file)
+// Released under MIT License (see LICENSE file)
+// ===============================================================================
+//
+
+//
+// Thin client that forwards a single scan to a resident 'clscan --server' process.
+// It deliberately links nothing from clang/llvm so that starting it costs next to nothing.
+//
+//    clscanclient <socket> <input.cpp> --output <output.csv> [-- <compiler args>]
+//    clscanclient <socket> --shutdown
+//
+
+#include <clReflectScan/ScanServerProtocol.h>
+
+#include <clReflectCore/Logging.h>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, const char* argv[])
+{
+    LOG_TO_STDOUT(main, ALL);
+
+    if (argc < 3)
+    {
+        LOG(main, ERROR, "Not enough arguments\n");
+        return 1;
+    }
+
+    std::string socket_path = argv[1];
+
+    // Build the request: working directory, input, output and then the compiler arguments
+    std::vector<std::string> request;
+    bool shutdown = false;
+    std::string input_filename, output_filename;
+    std::vector<std::string> compiler_args;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            compiler_args.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else if (strcmp(argv[i], "--shutdown") == 0 || strcmp(argv[i], "-shutdown") == 0)
+            shutdown = true;
+        else if ((strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-output") == 0) && i + 1 < argc)
+            output_filename = argv[++i];
+        else
+            input_filename = argv[i];
+    }
+
+    if (!shutdown)
+    {
+        if (input_filename == "")
+        {
+            LOG(main, ERROR, "No input file specified\n");
+            return 1;
+        }
+
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) == 0)
+        {
+            LOG(main, ERROR, "Couldn't get the current working directory\n");
+            return 1;
+        }
+
+        request.push_back(cwd);
+        request.push_back(input_filename);
+        request.push_back(output_filename);
+        request.insert(request.end(), compiler_args.begin(), compiler_args.end());
+    }
+
+    int fd = scanserver::Connect(socket_path);
+    if (fd == -1)
+    {
+        LOG(main, ERROR, "Couldn't connect to clscan server on '%s'\n", socket_path.c_str());
+        return 1;
+    }
+
+    // Hand over stdout/stderr so that the server's output is interleaved correctly with ours
+    unsigned int exit_code = 1;
+    if (!scanserver::SendDescriptors(fd, STDOUT_FILENO, STDERR_FILENO) || !scanserver::WriteStrings(fd, request) ||
+        !scanserver::ReadU32(fd, exit_code))
+    {
+        LOG(main, ERROR, "Lost connection to clscan server on '%s'\n", socket_path.c_str());
+        exit_code = 1;
+    }
+
+    close(fd);
+    return exit_code;
+}
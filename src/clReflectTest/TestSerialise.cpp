@@ -69,15 +69,130 @@ namespace Stuff
 
 
 #include <stdio.h>
+#include <string.h>
+
+
+namespace
+{
+	// The reflection walker that saved versioned binary before types were compiled to plans, kept to check
+	// that plans write the same data. Only handles the built-in types, enums and classes in Stuff.
+	void WalkerSaveObject(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type);
+
+
+	void WalkerSaveClass(clutl::WriteBuffer& out, const char* object, const clcpp::Class* class_type)
+	{
+		// Each field is in a chunk of its type hash, name hash and data size
+		for (unsigned int i = 0; i < class_type->fields.size; i++)
+		{
+			const clcpp::Field* field = class_type->fields[i];
+			if ((field->flag_attributes & attrFlag_Transient) != 0)
+				continue;
+
+			unsigned int header[3] = { field->type->name.hash, field->name.hash, 0 };
+			out.Write(header, sizeof(header));
+			unsigned int data_start = out.GetBytesWritten();
+			WalkerSaveObject(out, object + field->offset, field->type);
+			*(unsigned int*)(out.GetData() + data_start - sizeof(unsigned int)) = out.GetBytesWritten() - data_start;
+		}
+
+		// Base classes follow at the same address
+		for (unsigned int i = 0; i < class_type->base_types.size; i++)
+			WalkerSaveClass(out, object, class_type->base_types[i]->AsClass());
+	}
+
+
+	void WalkerSaveObject(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type)
+	{
+		switch (type->kind)
+		{
+		case (clcpp::Primitive::KIND_TYPE):
+			out.Write(object, type->size);
+			break;
+
+		case (clcpp::Primitive::KIND_ENUM):
+		{
+			// Enums are written as the name hash of the constant with their value
+			const clcpp::Enum* enum_type = type->AsEnum();
+			unsigned int hash = 0;
+			for (unsigned int i = 0; i < enum_type->constants.size; i++)
+			{
+				if (enum_type->constants[i]->value == *(const int*)object)
+				{
+					hash = enum_type->constants[i]->name.hash;
+					break;
+				}
+			}
+			out.Write(&hash, sizeof(hash));
+			break;
+		}
+
+		case (clcpp::Primitive::KIND_CLASS):
+			WalkerSaveClass(out, object, type->AsClass());
+			break;
+
+		default:
+			break;
+		}
+	}
+
+
+	void WalkerSave(clutl::WriteBuffer& out, const void* object, const clcpp::Type* type)
+	{
+		// The object is in an unnamed chunk of its type
+		unsigned int header[3] = { type->name.hash, 0, 0 };
+		out.Write(header, sizeof(header));
+		WalkerSaveObject(out, (const char*)object, type);
+		*(unsigned int*)(out.GetData() + sizeof(unsigned int) * 2) = out.GetBytesWritten() - sizeof(header);
+	}
+
+
+	bool SameData(const clutl::WriteBuffer& a, const clutl::WriteBuffer& b)
+	{
+		return a.GetBytesWritten() == b.GetBytesWritten() && memcmp(a.GetData(), b.GetData(), a.GetBytesWritten()) == 0;
+	}
+
+
+	bool operator == (const Stuff::DerivedStruct& a, const Stuff::DerivedStruct& b)
+	{
+		return a.be == b.be && a.v0 == b.v0 && a.v1 == b.v1 &&
+			a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w && a.e == b.e &&
+			a.n.a == b.n.a && a.n.b == b.n.b && a.n.c == b.n.c &&
+			a.n.d == b.n.d && a.n.e == b.n.e && a.n.f == b.n.f &&
+			a.n.g == b.n.g && a.n.h == b.n.h && a.n.i == b.n.i;
+	}
+}
 
 
 void TestSerialise(clcpp::Database& db)
 {
+	const clcpp::Type* type = clcpp::GetType<Stuff::DerivedStruct>();
+
 	clutl::WriteBuffer write_buffer;
 
 	Stuff::DerivedStruct src;
-	clutl::SaveVersionedBinary(write_buffer, &src, clcpp::GetType<Stuff::DerivedStruct>());
+	src.be = Stuff::VAL_A;
+	src.v0 = -0.25;
+	src.n.i = -7;
+	clutl::SaveVersionedBinary(write_buffer, &src, type);
 	clutl::ReadBuffer read_buffer(write_buffer);
 	Stuff::DerivedStruct dest(Stuff::NO_INIT);
-	clutl::LoadVersionedBinary(read_buffer, &dest, clcpp::GetType<Stuff::DerivedStruct>());
+	clutl::LoadVersionedBinary(read_buffer, &dest, type);
+
+	// Plans should write the same data as the reflection walker, whether or not they're cached between saves
+	clutl::WriteBuffer walker_buffer;
+	WalkerSave(walker_buffer, &src, type);
+	printf("VBIN PLAN %s\n", SameData(write_buffer, walker_buffer) ? "PASS!" : "FAIL!");
+	clutl::SerialisePlanCache plans;
+	for (int i = 0; i < 2; i++)
+	{
+		clutl::WriteBuffer cached_buffer;
+		clutl::SaveVersionedBinary(cached_buffer, &src, type, plans);
+		printf("VBIN CACHED PLAN %s\n", SameData(cached_buffer, walker_buffer) ? "PASS!" : "FAIL!");
+	}
+
+	// Loading should fill in the fields of the base and nested classes, with the cache reusing plans from the saves
+	Stuff::DerivedStruct cached_dest(Stuff::NO_INIT);
+	clutl::ReadBuffer cached_read_buffer(write_buffer);
+	clutl::LoadVersionedBinary(cached_read_buffer, &cached_dest, type, plans);
+	printf("VBIN LOAD %s\n", dest == src && cached_dest == src ? "PASS!" : "FAIL!");
 }
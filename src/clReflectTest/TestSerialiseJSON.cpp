@@ -9,7 +9,9 @@
 //
 
 #include <clcpp/clcpp.h>
+#include <clcpp/Containers.h>
 #include <clutl/Serialise.h>
+#include <clutl/JSONLexer.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -38,14 +40,14 @@ namespace
 		write_buffer.Write(test, strlen(test));
 		clutl::ReadBuffer read_buffer(write_buffer);
 
-		clutl::JSONError error = clutl::LoadJSON(read_buffer, 0, (clcpp::Type*)0);
+		clutl::JSONError error = clutl::LoadJSON(read_buffer, 0, (clcpp::Type*)0, 0);
 		if (error.code == clutl::JSONError::NONE)
 		{
 			printf("PASS\n");
 		}
 		else
 		{
-			printf("FAIL (%d, %d): ", error.line, error.column);
+			printf("FAIL (%u, %llu): ", error.line, (unsigned long long)error.column);
 
 			switch (error.code)
 			{
@@ -56,10 +58,42 @@ namespace
 			case (clutl::JSONError::INVALID_KEYWORD): printf("INVALID_KEYWORD\n"); break;
 			case (clutl::JSONError::INVALID_ESCAPE_SEQUENCE): printf("INVALID_ESCAPE_SEQUENCE\n"); break;
 			case (clutl::JSONError::UNEXPECTED_TOKEN): printf("UNEXPECTED_TOKEN\n"); break;
+			case (clutl::JSONError::MISSING_ARRAY_LENGTH): printf("MISSING_ARRAY_LENGTH\n"); break;
 			default: break;
 			}
 		}
 	}
+
+
+	// Streams text from a read buffer a few bytes at a time
+	struct ChunkedStream : public clutl::IJSONStream
+	{
+		ChunkedStream(clutl::ReadBuffer& in)
+			: in(in)
+		{
+		}
+
+		unsigned int Read(void* dest, unsigned int size)
+		{
+			if (size > in.GetBytesRemaining())
+				size = in.GetBytesRemaining();
+			in.Read(dest, size);
+			return size;
+		}
+
+		clutl::ReadBuffer& in;
+	};
+
+
+	// Runs parallel jobs one after the other on the calling thread
+	struct InlineJobs : public clutl::IParallelFor
+	{
+		void Run(void (*job)(void* data, unsigned int index), void* data, unsigned int count)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				job(data, i);
+		}
+	};
 }
 
 
@@ -336,6 +370,385 @@ namespace jsontest
 			return true;
 		}
 	};
+
+
+	// A minimal dynamic array of built-in types and structs, which its iterators size from its template argument
+	template <typename TYPE>
+	struct Array
+	{
+		Array()
+			: data(0)
+			, size(0)
+		{
+		}
+
+		~Array()
+		{
+			delete [] data;
+		}
+
+		TYPE& operator [] (int index)
+		{
+			return ((TYPE*)data)[index];
+		}
+
+		char* data;
+		int size;
+	};
+
+
+	class ArrayReadIterator : public clcpp::IReadIterator
+	{
+	public:
+		void Initialise(const clcpp::Primitive* primitive, const void* container_object, clcpp::ReadIterator& storage)
+		{
+			const clcpp::TemplateType* type = ((const clcpp::Type*)primitive)->AsTemplateType();
+			const Array<char>& array = *(const Array<char>*)container_object;
+			storage.m_ValueType = type->parameter_types[0];
+			storage.m_Count = array.size;
+			m_Data = array.data;
+			m_ElementSize = storage.m_ValueType->size;
+		}
+
+		clcpp::ContainerKeyValue GetKeyValue() const
+		{
+			clcpp::ContainerKeyValue kv;
+			kv.value = m_Data;
+			return kv;
+		}
+
+		void MoveNext()
+		{
+			m_Data += m_ElementSize;
+		}
+
+	private:
+		const char* m_Data;
+		clcpp::size_type m_ElementSize;
+	};
+
+
+	class ArrayWriteIterator : public clcpp::IWriteIterator
+	{
+	public:
+		void Initialise(const clcpp::Primitive* primitive, void* container_object, clcpp::WriteIterator& storage, int count)
+		{
+			// Replace the array contents with zeroed elements
+			const clcpp::TemplateType* type = ((const clcpp::Type*)primitive)->AsTemplateType();
+			Array<char>& array = *(Array<char>*)container_object;
+			storage.m_ValueType = type->parameter_types[0];
+			storage.m_Count = count;
+			m_ElementSize = storage.m_ValueType->size;
+			delete [] array.data;
+			array.data = new char[count * m_ElementSize]();
+			array.size = count;
+			m_Data = array.data;
+		}
+
+		void* AddEmpty()
+		{
+			void* value = m_Data;
+			m_Data += m_ElementSize;
+			return value;
+		}
+
+		void* AddEmpty(void*)
+		{
+			return AddEmpty();
+		}
+
+	private:
+		char* m_Data;
+		clcpp::size_type m_ElementSize;
+	};
+
+
+	struct ArrayFields
+	{
+		Array<int> ints;
+		Array<double> doubles;
+		Array<int> empty;
+		Array<NestedStruct> structs;
+	};
+}
+
+clcpp_impl_class(jsontest::ArrayReadIterator)
+clcpp_impl_class(jsontest::ArrayWriteIterator)
+clcpp_container_iterators(jsontest::Array, jsontest::ArrayReadIterator, jsontest::ArrayWriteIterator, nokey)
+
+
+namespace
+{
+	template <typename TYPE>
+	bool ElementsEqual(jsontest::Array<TYPE>& a, jsontest::Array<TYPE>& b)
+	{
+		if (a.size != b.size)
+			return false;
+		for (int i = 0; i < a.size; i++)
+		{
+			if (!(a[i] == b[i]))
+				return false;
+		}
+		return true;
+	}
+
+
+	bool ArraysEqual(jsontest::ArrayFields& a, jsontest::ArrayFields& b)
+	{
+		return ElementsEqual(a.ints, b.ints) && ElementsEqual(a.doubles, b.doubles) && ElementsEqual(a.empty, b.empty) &&
+			ElementsEqual(a.structs, b.structs);
+	}
+
+
+	clutl::JSONError LoadArrayFields(const char* text, jsontest::ArrayFields& fields, const clcpp::Type* type)
+	{
+		clutl::WriteBuffer write_buffer;
+		write_buffer.Write(text, strlen(text));
+		clutl::ReadBuffer read_buffer(write_buffer);
+		return clutl::LoadJSON(read_buffer, &fields, type, 0);
+	}
+
+
+	void TestDecimal(clcpp::Database& db, const char* name, const char* text, double expected)
+	{
+		// Decimals must load as the nearest double, bit for bit
+		const clcpp::Type* type = db.GetType(db.GetName("jsontest::ArrayFields").hash);
+		jsontest::ArrayFields fields;
+		clutl::JSONError error = LoadArrayFields(text, fields, type);
+
+		if (error.code == clutl::JSONError::NONE && fields.doubles.size == 1 && memcmp(&fields.doubles[0], &expected, sizeof(expected)) == 0)
+			printf("%s PASS!\n", name);
+		else
+			printf("%s FAIL!\n", name);
+	}
+
+
+	void TestArrayLengths(clcpp::Database& db)
+	{
+		const clcpp::Type* type = db.GetType(db.GetName("jsontest::ArrayFields").hash);
+		jsontest::ArrayFields a;
+		a.ints.data = new char[100 * sizeof(int)];
+		a.ints.size = 100;
+		for (int i = 0; i < a.ints.size; i++)
+			a.ints[i] = i * 7 - 300;
+		a.doubles.data = new char[3 * sizeof(double)];
+		a.doubles.size = 3;
+		a.doubles[0] = 0.1;
+		a.doubles[1] = -2.5e300;
+		a.doubles[2] = 3;
+
+		// Saved lengths size the containers up-front, with empty arrays written without one
+		clutl::WriteBuffer length_write_buffer;
+		clutl::SaveJSON(length_write_buffer, &a, type, 0, clutl::JSONFlags::EMIT_ARRAY_LENGTHS, 0);
+		clutl::ReadBuffer length_read_buffer(length_write_buffer);
+		jsontest::ArrayFields b;
+		clutl::JSONError length_error = clutl::LoadJSON(length_read_buffer, &b, type, 0);
+		length_write_buffer.WriteChar(0);
+		const char* length_text = length_write_buffer.GetData();
+
+		if (length_error.code == clutl::JSONError::NONE && strstr(length_text, "[#100,") != 0 && strstr(length_text, "\"empty\":[]") != 0 && ArraysEqual(a, b))
+			printf("ARRAY LENGTHS PASS!\n");
+		else
+			printf("ARRAY LENGTHS FAIL!\n");
+
+		// Arrays of built-in types without lengths are parsed once into the staging buffer
+		clutl::WriteBuffer staged_write_buffer;
+		clutl::SaveJSON(staged_write_buffer, &a, type, 0, 0, 0);
+		clutl::ReadBuffer staged_read_buffer(staged_write_buffer);
+		jsontest::ArrayFields c;
+		clutl::JSONError staged_error = clutl::LoadJSON(staged_read_buffer, &c, type, 0);
+
+		if (staged_error.code == clutl::JSONError::NONE && ArraysEqual(a, c))
+			printf("ARRAY STAGING PASS!\n");
+		else
+			printf("ARRAY STAGING FAIL!\n");
+
+		// Lengths that don't match the elements are rejected before anything is allocated
+		jsontest::ArrayFields d;
+		clutl::JSONError hostile_error = LoadArrayFields("{ \"ints\" : [ #2000000000, 1 ] }", d, type);
+		jsontest::ArrayFields e;
+		clutl::JSONError short_error = LoadArrayFields("{ \"ints\" : [ #3, 1, 2 ] }", e, type);
+
+		if (hostile_error.code == clutl::JSONError::UNEXPECTED_TOKEN && d.ints.size == 0 &&
+			short_error.code == clutl::JSONError::UNEXPECTED_TOKEN && e.ints.size == 0)
+			printf("ARRAY LENGTH LIMIT PASS!\n");
+		else
+			printf("ARRAY LENGTH LIMIT FAIL!\n");
+	}
+
+
+	void TestLargeObjects(clcpp::Database& db)
+	{
+		const clcpp::Type* type = db.GetType(db.GetName("jsontest::ArrayFields").hash);
+		const int depth = 100000;
+
+		// Nesting is parsed without recursion, so deeply nested values of unknown fields are skipped without
+		// overflowing the stack
+		clutl::WriteBuffer nested_write_buffer;
+		nested_write_buffer.WriteStr("{ \"unknown\" : ");
+		for (int i = 0; i < depth; i++)
+			nested_write_buffer.WriteStr(i & 1 ? "{ \"a\" : " : "[ ");
+		nested_write_buffer.WriteChar('1');
+		for (int i = depth - 1; i >= 0; i--)
+			nested_write_buffer.WriteStr(i & 1 ? " }" : " ]");
+		nested_write_buffer.WriteStr(", \"ints\" : [ 1, 2 ] }");
+		clutl::ReadBuffer nested_read_buffer(nested_write_buffer);
+		jsontest::ArrayFields a;
+		clutl::JSONError nested_error = clutl::LoadJSON(nested_read_buffer, &a, type, 0);
+
+		if (nested_error.code == clutl::JSONError::NONE && a.ints.size == 2 && a.ints[0] == 1 && a.ints[1] == 2)
+			printf("DEEP NESTING PASS!\n");
+		else
+			printf("DEEP NESTING FAIL!\n");
+
+		// The same nesting left unterminated reports the missing value at the end of the data
+		clutl::WriteBuffer unterminated_write_buffer;
+		unterminated_write_buffer.WriteStr("{ \"unknown\" : ");
+		for (int i = 0; i < depth; i++)
+			unterminated_write_buffer.WriteStr("[ ");
+		clutl::ReadBuffer unterminated_read_buffer(unterminated_write_buffer);
+		clutl::JSONError unterminated_error = clutl::LoadJSON(unterminated_read_buffer, 0, (clcpp::Type*)0, 0);
+
+		if (unterminated_error.code == clutl::JSONError::UNEXPECTED_TOKEN &&
+			unterminated_error.position == unterminated_write_buffer.GetBytesWritten())
+			printf("DEEP NESTING ERROR PASS!\n");
+		else
+			printf("DEEP NESTING ERROR FAIL!\n");
+
+		// Large flat objects of unknown members are skipped up to the known fields
+		clutl::WriteBuffer flat_write_buffer;
+		flat_write_buffer.WriteChar('{');
+		for (int i = 0; i < depth; i++)
+		{
+			char member[32];
+			sprintf(member, "\"m%d\" : %d, ", i, i);
+			flat_write_buffer.WriteStr(member);
+		}
+		flat_write_buffer.WriteStr("\"ints\" : [ 3 ] }");
+		clutl::ReadBuffer flat_read_buffer(flat_write_buffer);
+		jsontest::ArrayFields b;
+		clutl::JSONError flat_error = clutl::LoadJSON(flat_read_buffer, &b, type, 0);
+
+		if (flat_error.code == clutl::JSONError::NONE && b.ints.size == 1 && b.ints[0] == 3)
+			printf("FLAT OBJECT PASS!\n");
+		else
+			printf("FLAT OBJECT FAIL!\n");
+	}
+
+
+	void TestStreamedArrays(clcpp::Database& db)
+	{
+		const clcpp::Type* type = db.GetType(db.GetName("jsontest::ArrayFields").hash);
+		const unsigned int chunk_size = 256;
+		jsontest::ArrayFields a;
+		a.structs.data = new char[20000 * sizeof(jsontest::NestedStruct)];
+		a.structs.size = 20000;
+		for (int i = 0; i < a.structs.size; i++)
+		{
+			a.structs[i].x = i * 0.25f;
+			a.structs[i].y = -i * 3.5;
+			a.structs[i].z = (char)i;
+		}
+
+		// Arrays of structs saved with their lengths are streamed without buffering more than the first chunks
+		clutl::WriteBuffer length_write_buffer;
+		clutl::SaveJSON(length_write_buffer, &a, type, 0, clutl::JSONFlags::EMIT_ARRAY_LENGTHS, 0);
+		clutl::ReadBuffer length_read_buffer(length_write_buffer);
+		ChunkedStream length_stream(length_read_buffer);
+		clutl::JSONContext length_ctx(length_stream, chunk_size);
+		jsontest::ArrayFields b;
+		clutl::JSONError length_error = clutl::LoadJSON(length_ctx, &b, type, 0);
+
+		if (length_error.code == clutl::JSONError::NONE && ArraysEqual(a, b) && length_ctx.GetStreamCapacity() <= chunk_size * 2)
+			printf("STREAM STRUCT ARRAY PASS!\n");
+		else
+			printf("STREAM STRUCT ARRAY FAIL!\n");
+
+		// Without lengths they'd have to be kept in memory to be counted, so they're skipped and reported
+		clutl::WriteBuffer counted_write_buffer;
+		clutl::SaveJSON(counted_write_buffer, &a, type, 0, 0, 0);
+		clutl::ReadBuffer counted_read_buffer(counted_write_buffer);
+		ChunkedStream counted_stream(counted_read_buffer);
+		clutl::JSONContext counted_ctx(counted_stream, chunk_size);
+		jsontest::ArrayFields c;
+		clutl::JSONError counted_error = clutl::LoadJSON(counted_ctx, &c, type, 0);
+
+		if (counted_error.code == clutl::JSONError::MISSING_ARRAY_LENGTH && c.structs.size == 0 &&
+			counted_ctx.GetStreamCapacity() <= chunk_size * 2)
+			printf("STREAM STRUCT ARRAY LENGTH PASS!\n");
+		else
+			printf("STREAM STRUCT ARRAY LENGTH FAIL!\n");
+	}
+
+
+	void TestParallelArrays(clcpp::Database& db)
+	{
+		const clcpp::Type* type = db.GetType(db.GetName("jsontest::Array<int>").hash);
+		InlineJobs jobs;
+
+		// Enough elements to be split into several batches, the last of them partial
+		jsontest::Array<int> a;
+		a.data = new char[200 * sizeof(int)];
+		a.size = 200;
+		for (int i = 0; i < a.size; i++)
+			a[i] = i * 13 - 1000;
+
+		clutl::WriteBuffer batch_write_buffer;
+		clutl::SaveJSON(batch_write_buffer, &a, type, 0, 0, 0);
+		clutl::ReadBuffer batch_read_buffer(batch_write_buffer);
+		jsontest::Array<int> b;
+		clutl::JSONError batch_error = clutl::LoadJSONArray(batch_read_buffer, &b, type, 0, jobs);
+
+		if (batch_error.code == clutl::JSONError::NONE && ElementsEqual(a, b))
+			printf("PARALLEL BATCHES PASS!\n");
+		else
+			printf("PARALLEL BATCHES FAIL!\n");
+
+		// Saved lengths are skipped before the elements are split
+		clutl::WriteBuffer length_write_buffer;
+		clutl::SaveJSON(length_write_buffer, &a, type, 0, clutl::JSONFlags::EMIT_ARRAY_LENGTHS, 0);
+		clutl::ReadBuffer length_read_buffer(length_write_buffer);
+		jsontest::Array<int> c;
+		clutl::JSONError length_error = clutl::LoadJSONArray(length_read_buffer, &c, type, 0, jobs);
+
+		if (length_error.code == clutl::JSONError::NONE && strncmp(length_write_buffer.GetData(), "[#200,", 6) == 0 && ElementsEqual(a, c))
+			printf("PARALLEL LENGTHS PASS!\n");
+		else
+			printf("PARALLEL LENGTHS FAIL!\n");
+
+		// Errors in later batches are located in the whole text, with each element here on its own line after the '['
+		const int bad_element = 70;
+		clutl::WriteBuffer error_write_buffer;
+		error_write_buffer.WriteChar('[');
+		unsigned int error_position = 0;
+		for (int i = 0; i < 100; i++)
+		{
+			if (i != 0)
+				error_write_buffer.WriteChar(',');
+			error_write_buffer.WriteChar('\n');
+			if (i == bad_element)
+			{
+				error_position = error_write_buffer.GetBytesWritten();
+				error_write_buffer.WriteChar('x');
+			}
+			else
+			{
+				char element[16];
+				sprintf(element, "%d", i);
+				error_write_buffer.WriteStr(element);
+			}
+		}
+		error_write_buffer.WriteChar(']');
+		clutl::ReadBuffer error_read_buffer(error_write_buffer);
+		jsontest::Array<int> d;
+		clutl::JSONError error = clutl::LoadJSONArray(error_read_buffer, &d, type, 0, jobs);
+
+		if (error.code == clutl::JSONError::UNEXPECTED_CHARACTER && error.position == error_position &&
+			error.line == bad_element + 2 && error.column == 1)
+			printf("PARALLEL ERROR PASS!\n");
+		else
+			printf("PARALLEL ERROR FAIL!\n");
+	}
 }
 
 
@@ -344,6 +757,8 @@ void TestSerialiseJSON(clcpp::Database& db)
 	Test("EmptyObject", "{ }");
 	Test("NestedEmptyObjects", "{ \"nested\" : { } }");
 	Test("EmptyArrayObject", "{ \"nested\" : [ ] }");
+	Test("ArrayLength", "{ \"array\" : [ #3, 1, 2, 3 ] }");
+	Test("EmptyArrayLength", "{ \"array\" : [ #0 ] }");
 
 	Test("String", "{ \"string\" : \"val\" }");
 	Test("Integer", "{ \"integer\" : 123 }");
@@ -376,6 +791,10 @@ void TestSerialiseJSON(clcpp::Database& db)
 	Test("NegDecimalE9", "{ \"decimal\" : -123.123E4 }");
 	Test("NegDecimalE10", "{ \"decimal\" : -123.123E+4 }");
 	Test("NegDecimalE11", "{ \"decimal\" : -123.123E-4 }");
+	TestDecimal(db, "DECIMAL LONG MANTISSA", "{ \"doubles\" : [ 3.14159265358979323846264338327950288 ] }", 3.14159265358979323846);
+	TestDecimal(db, "DECIMAL SUBNORMAL", "{ \"doubles\" : [ 4.9406564584124654e-324 ] }", 4.9406564584124654e-324);
+	TestDecimal(db, "DECIMAL HALF-WAY", "{ \"doubles\" : [ 9007199254740993 ] }", 9007199254740992.0);
+	TestDecimal(db, "DECIMAL ABOVE HALF-WAY", "{ \"doubles\" : [ 9007199254740993.00000000000000000001 ] }", 9007199254740994.0);
 
 	Test("EscapeSequences", "{ \"string\" : \" \\\" \\\\ \\/ \\b \\f \\n \\r \\t \\u0123 \" }");
 
@@ -412,15 +831,88 @@ void TestSerialiseJSON(clcpp::Database& db)
 	Test("ErrorFalseInvalidKeyword", "{ \"value\" : fal ");
 	Test("ErrorNullInvalidKeyword", "{ \"value\" : nu ");
 
+	Test("ArrayLengthErrorNoDigits", "{ \"array\" : [ # ] }");
+	Test("ArrayLengthErrorNoComma", "{ \"array\" : [ #2 1, 2 ] }");
+
 	clutl::WriteBuffer write_buffer;
 	jsontest::AllFields a;
-	clutl::SaveJSON(write_buffer, &a, clcpp::GetType<jsontest::AllFields>(), 0, clutl::JSONFlags::EMIT_HEX_FLOATS);
+	clutl::SaveJSON(write_buffer, &a, clcpp::GetType<jsontest::AllFields>(), 0, clutl::JSONFlags::EMIT_HEX_FLOATS, 0);
 	clutl::ReadBuffer read_buffer(write_buffer);
 	jsontest::AllFields b(jsontest::NO_INIT);
-	clutl::LoadJSON(read_buffer, &b, clcpp::GetType<jsontest::AllFields>());
+	clutl::LoadJSON(read_buffer, &b, clcpp::GetType<jsontest::AllFields>(), 0);
 
 	if (a == b)
 		printf("STRUCT PASS!\n");
 	else
 		printf("STRUCT FAIL!\n");
+
+	// Floats written as shortest decimals must read back exactly
+	clutl::WriteBuffer decimal_write_buffer;
+	clutl::SaveJSON(decimal_write_buffer, &a, clcpp::GetType<jsontest::AllFields>(), 0, 0, 0);
+	clutl::ReadBuffer decimal_read_buffer(decimal_write_buffer);
+	jsontest::AllFields c(jsontest::NO_INIT);
+	clutl::LoadJSON(decimal_read_buffer, &c, clcpp::GetType<jsontest::AllFields>(), 0);
+
+	if (a == c)
+		printf("DECIMAL STRUCT PASS!\n");
+	else
+		printf("DECIMAL STRUCT FAIL!\n");
+
+	// Streaming the text in small chunks must give the same result
+	clutl::ReadBuffer stream_read_buffer(decimal_write_buffer);
+	ChunkedStream stream(stream_read_buffer);
+	clutl::JSONContext stream_ctx(stream, 7);
+	jsontest::AllFields d(jsontest::NO_INIT);
+	clutl::LoadJSON(stream_ctx, &d, clcpp::GetType<jsontest::AllFields>(), 0);
+
+	if (a == d)
+		printf("STREAM STRUCT PASS!\n");
+	else
+		printf("STREAM STRUCT FAIL!\n");
+
+	// Query a few fields, including ones from a base and a nested struct
+	clcpp::int64 f14 = 0;
+	double nested1_y = 0;
+	int base_a = 0;
+	clutl::JSONQuery query(clcpp::GetType<jsontest::AllFields>(), 0);
+	query.AddField("f14", &f14);
+	query.AddField("nested1.y", &nested1_y);
+	query.AddField("a", &base_a);
+	clutl::ReadBuffer query_read_buffer(decimal_write_buffer);
+	clutl::JSONError query_error = query.Run(query_read_buffer);
+
+	if (query_error.code == clutl::JSONError::NONE && query.GetNbFound() == 3 && f14 == a.f14 && nested1_y == a.nested1.y && base_a == a.a)
+		printf("QUERY PASS!\n");
+	else
+		printf("QUERY FAIL!\n");
+
+	// Values that aren't queried are still lexed, reporting malformed ones as loading does
+	const char* malformed_text = "{ \"unknown\" : [ 1, { \"a\" : @@ } ], \"f14\" : 2 }";
+	clutl::WriteBuffer malformed_write_buffer;
+	malformed_write_buffer.Write(malformed_text, strlen(malformed_text));
+	clutl::ReadBuffer malformed_read_buffer(malformed_write_buffer);
+	clutl::JSONQuery malformed_query(clcpp::GetType<jsontest::AllFields>(), 0);
+	malformed_query.AddField("f14", &f14);
+	clutl::JSONError malformed_error = malformed_query.Run(malformed_read_buffer);
+
+	if (malformed_error.code == clutl::JSONError::UNEXPECTED_CHARACTER && malformed_error.position == (clcpp::uint64)(strchr(malformed_text, '@') - malformed_text))
+		printf("QUERY MALFORMED PASS!\n");
+	else
+		printf("QUERY MALFORMED FAIL!\n");
+
+	// Types that aren't containers are loaded on the calling thread by the parallel loader
+	clutl::ReadBuffer parallel_read_buffer(decimal_write_buffer);
+	InlineJobs jobs;
+	jsontest::AllFields e(jsontest::NO_INIT);
+	clutl::JSONError parallel_error = clutl::LoadJSONArray(parallel_read_buffer, &e, clcpp::GetType<jsontest::AllFields>(), 0, jobs);
+
+	if (parallel_error.code == clutl::JSONError::NONE && a == e)
+		printf("PARALLEL STRUCT PASS!\n");
+	else
+		printf("PARALLEL STRUCT FAIL!\n");
+
+	TestArrayLengths(db);
+	TestParallelArrays(db);
+	TestLargeObjects(db);
+	TestStreamedArrays(db);
 }
@@ -28,6 +28,10 @@ extern "C" int _snprintf(char* dest, unsigned int n, const char* fmt, ...);
 extern "C" int snprintf(char* dest, unsigned int n, const char* fmt, ...);
 #endif
 
+// Standard C library functions, convert string to double/single-precision number
+extern "C" double strtod(const char* s00, char** se);
+extern "C" float strtof(const char* s00, char** se);
+
 static void SetupTypeDispatchLUT();
 
 namespace
@@ -79,11 +83,6 @@ namespace
     // JSON Parser & reflection-based object construction
     // ----------------------------------------------------------------------------------------------------
 
-    void ParserValue(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                     clcpp::Qualifier::Operator op, const clcpp::Field* field, unsigned int transient_flags);
-    void ParserObject(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                      unsigned int transient_flags);
-
     clutl::JSONToken Expect(clutl::JSONContext& ctx, clutl::JSONToken& t, clutl::JSONTokenType type)
     {
         // Check the tokens match
@@ -236,340 +235,2190 @@ namespace
         }
     }
 
-    int ParserElements(clutl::JSONContext& ctx, clutl::JSONToken& t, clcpp::WriteIterator* writer, const clcpp::Type* type,
-                       clcpp::Qualifier::Operator op, unsigned int transient_flags)
+    void ParserLiteralValue(const clutl::JSONToken& t, int integer, char* object, const clcpp::Type* type,
+                            clcpp::Qualifier::Operator op)
+    {
+        if (t.IsValid())
+        {
+            LoadInteger(integer, object, type, op);
+        }
+    }
+
+    //
+    // A field that can be loaded from a JSON object member, with everything needed to find and load it
+    //
+    struct FieldDispatch
+    {
+        const clcpp::Field* field = nullptr;
+        unsigned int hash = 0;
+        int offset = 0;
+
+        // Name used to match member keys without hashing them
+        const char* name = nullptr;
+        int nameLength = -1;
+
+        // Loaders for fields of built-in type, called directly with number tokens
+        LoadIntegerFunc loadInteger = nullptr;
+        LoadDecimalFunc loadDecimal = nullptr;
+
+        // Fields expected to follow this one when the object is saved in field array or declaration order
+        const FieldDispatch* nextSaved = nullptr;
+        const FieldDispatch* nextDeclared = nullptr;
+    };
+
+    unsigned int MixFieldHash(unsigned int hash, unsigned int displacement)
+    {
+        hash = (hash ^ (displacement * 0x9E3779B9)) * 0x85EBCA6B;
+        return hash ^ (hash >> 16);
+    }
+
+    //
+    // All loadable fields of a class and its bases for a set of transient flags, built the first time an
+    // object of the class is parsed. Fields are placed with a two-level perfect hash: the name hash selects
+    // a bucket, whose displacement mixes the hashes of its fields into their own slots, so that finding a
+    // field only needs to check one slot.
+    //
+    struct ClassDispatch
+    {
+        ClassDispatch() = default;
+        ClassDispatch(const ClassDispatch&) = delete;
+        ClassDispatch& operator=(const ClassDispatch&) = delete;
+
+        ~ClassDispatch()
+        {
+            delete[] slots;
+            delete[] displacements;
+        }
+
+        FieldDispatch* Find(unsigned int hash) const
+        {
+            unsigned int displacement = displacements[hash % nbBuckets];
+            FieldDispatch& slot = slots[MixFieldHash(hash, displacement) % nbSlots];
+            return slot.field != nullptr && slot.hash == hash ? &slot : nullptr;
+        }
+
+        const clcpp::Class* classType = nullptr;
+        unsigned int transientFlags = 0;
+
+        FieldDispatch* slots = nullptr;
+        unsigned int nbSlots = 0;
+        unsigned short* displacements = nullptr;
+        unsigned int nbBuckets = 0;
+
+        // Fields expected first in each save order
+        const FieldDispatch* firstSaved = nullptr;
+        const FieldDispatch* firstDeclared = nullptr;
+    };
+
+    unsigned int CountFieldsRecursive(const clcpp::Type* type)
+    {
+        unsigned int nb_fields = type->kind == clcpp::Primitive::KIND_CLASS ? type->AsClass()->fields.size : 0;
+        for (unsigned int i = 0; i < type->base_types.size; i++)
+        {
+            nb_fields += CountFieldsRecursive(type->base_types[i]);
+        }
+        return nb_fields;
+    }
+
+    void GatherFieldsRecursive(const clcpp::Type* type, const clcpp::Field** fields, unsigned int& nb_fields, bool by_offset)
+    {
+        // Gather fields in the order they're searched and saved: the class first, followed by its bases
+        if (type->kind == clcpp::Primitive::KIND_CLASS)
+        {
+            const clcpp::CArray<const clcpp::Field*>& class_fields = type->AsClass()->fields;
+            for (unsigned int i = 0; i < class_fields.size; i++)
+            {
+                // Insertion sort by offset to recover declaration order
+                unsigned int j = nb_fields++;
+                for (; by_offset && j > nb_fields - 1 - i && fields[j - 1]->offset > class_fields[i]->offset; j--)
+                {
+                    fields[j] = fields[j - 1];
+                }
+                fields[j] = class_fields[i];
+            }
+        }
+
+        for (unsigned int i = 0; i < type->base_types.size; i++)
+        {
+            GatherFieldsRecursive(type->base_types[i], fields, nb_fields, by_offset);
+        }
+    }
+
+    bool PlaceFields(ClassDispatch& dispatch, const clcpp::Field** fields, unsigned int nb_fields)
+    {
+        unsigned int nb_buckets = dispatch.nbBuckets;
+        for (unsigned int i = 0; i < dispatch.nbSlots; i++)
+        {
+            dispatch.slots[i].field = nullptr;
+        }
+
+        // Counting sort the fields by bucket
+        unsigned int* bucket_starts = new unsigned int[nb_buckets + 1];
+        const clcpp::Field** bucket_fields = new const clcpp::Field*[nb_fields];
+        unsigned int max_bucket_size = 0;
+        for (unsigned int i = 0; i <= nb_buckets; i++)
+        {
+            bucket_starts[i] = 0;
+        }
+        for (unsigned int i = 0; i < nb_fields; i++)
+        {
+            bucket_starts[fields[i]->name.hash % nb_buckets + 1]++;
+        }
+        for (unsigned int i = 0; i < nb_buckets; i++)
+        {
+            max_bucket_size = bucket_starts[i + 1] > max_bucket_size ? bucket_starts[i + 1] : max_bucket_size;
+            bucket_starts[i + 1] += bucket_starts[i];
+        }
+        for (unsigned int i = 0; i < nb_fields; i++)
+        {
+            bucket_fields[bucket_starts[fields[i]->name.hash % nb_buckets]++] = fields[i];
+        }
+        for (unsigned int i = nb_buckets; i > 0; i--)
+        {
+            bucket_starts[i] = bucket_starts[i - 1];
+        }
+        bucket_starts[0] = 0;
+
+        // Place the biggest buckets first while there are plenty of free slots
+        bool placed = true;
+        unsigned int* bucket_slots = new unsigned int[max_bucket_size + 1];
+        for (unsigned int size = max_bucket_size; placed && size > 0; size--)
+        {
+            for (unsigned int bucket = 0; placed && bucket < nb_buckets; bucket++)
+            {
+                unsigned int start = bucket_starts[bucket];
+                if (bucket_starts[bucket + 1] - start != size)
+                {
+                    continue;
+                }
+
+                // Search for a displacement that puts each field of the bucket in a distinct, free slot
+                placed = false;
+                for (unsigned int displacement = 0; !placed && displacement < 0x10000; displacement++)
+                {
+                    placed = true;
+                    for (unsigned int i = 0; placed && i < size; i++)
+                    {
+                        unsigned int slot = MixFieldHash(bucket_fields[start + i]->name.hash, displacement) % dispatch.nbSlots;
+                        placed = dispatch.slots[slot].field == nullptr;
+                        for (unsigned int j = 0; placed && j < i; j++)
+                        {
+                            placed = bucket_slots[j] != slot;
+                        }
+                        bucket_slots[i] = slot;
+                    }
+
+                    if (placed)
+                    {
+                        dispatch.displacements[bucket] = static_cast<unsigned short>(displacement);
+                        for (unsigned int i = 0; i < size; i++)
+                        {
+                            dispatch.slots[bucket_slots[i]].field = bucket_fields[start + i];
+                        }
+                    }
+                }
+            }
+        }
+
+        delete[] bucket_slots;
+        delete[] bucket_fields;
+        delete[] bucket_starts;
+        return placed;
+    }
+
+    void LinkFields(ClassDispatch& dispatch, const clcpp::Field** fields, unsigned int nb_fields, bool declared)
+    {
+        // Chain together the fields that were placed, skipping any that are hidden or transient
+        FieldDispatch* last = nullptr;
+        for (unsigned int i = 0; i < nb_fields; i++)
+        {
+            FieldDispatch* field = dispatch.Find(fields[i]->name.hash);
+            if (field == nullptr || field->field != fields[i])
+            {
+                continue;
+            }
+
+            const FieldDispatch*& next = last == nullptr ? (declared ? dispatch.firstDeclared : dispatch.firstSaved)
+                                                         : (declared ? last->nextDeclared : last->nextSaved);
+            next = field;
+            last = field;
+        }
+    }
+
+    ClassDispatch* BuildClassDispatch(const clcpp::Class* class_type, unsigned int transient_flags)
+    {
+        ClassDispatch* dispatch = new ClassDispatch;
+        dispatch->classType = class_type;
+        dispatch->transientFlags = transient_flags;
+
+        // Gather all fields in both save orders
+        unsigned int nb_fields = CountFieldsRecursive(class_type);
+        const clcpp::Field** saved = new const clcpp::Field*[nb_fields * 3 + 1];
+        const clcpp::Field** declared = saved + nb_fields;
+        const clcpp::Field** loadable = declared + nb_fields;
+        unsigned int nb_saved = 0, nb_declared = 0, nb_loadable = 0;
+        GatherFieldsRecursive(class_type, saved, nb_saved, false);
+        GatherFieldsRecursive(class_type, declared, nb_declared, true);
+
+        // Fields hide any of the same name in base classes, which are searched after them, while transient
+        // fields hide themselves
+        for (unsigned int i = 0; i < nb_fields; i++)
+        {
+            const clcpp::Field* field = saved[i];
+            unsigned int j = 0;
+            while (j < i && saved[j]->name.hash != field->name.hash)
+            {
+                j++;
+            }
+            if (j == i && (field->flag_attributes & transient_flags) == 0)
+            {
+                loadable[nb_loadable++] = field;
+            }
+        }
+
+        // Grow the slot count until the fields can be placed
+        dispatch->nbBuckets = nb_loadable / 2 + 1;
+        dispatch->displacements = new unsigned short[dispatch->nbBuckets];
+        for (unsigned int nb_slots = nb_loadable + nb_loadable / 4 + 1; ; nb_slots += nb_slots / 4 + 1)
+        {
+            delete[] dispatch->slots;
+            dispatch->slots = new FieldDispatch[nb_slots];
+            dispatch->nbSlots = nb_slots;
+            if (PlaceFields(*dispatch, loadable, nb_loadable))
+            {
+                break;
+            }
+        }
+
+        // Fill in the placed fields
+        for (unsigned int i = 0; i < dispatch->nbSlots; i++)
+        {
+            FieldDispatch& slot = dispatch->slots[i];
+            const clcpp::Field* field = slot.field;
+            if (field == nullptr)
+            {
+                continue;
+            }
+
+            slot.hash = field->name.hash;
+            slot.offset = field->offset;
+            slot.name = field->name.text;
+            if (slot.name != nullptr)
+            {
+                for (slot.nameLength = 0; slot.name[slot.nameLength] != 0; slot.nameLength++)
+                {
+                }
+            }
+
+            // Only built-in types can skip the checks for custom loading and transient classes
+            if (field->type != nullptr && field->type->kind == clcpp::Primitive::KIND_TYPE &&
+                field->qualifier.op != clcpp::Qualifier::POINTER)
+            {
+                const TypeDispatch& type_dispatch = g_TypeDispatchLUT[GetTypeDispatchIndex(field->type->name.hash)];
+                slot.loadInteger = type_dispatch.loadInteger;
+                slot.loadDecimal = type_dispatch.loadDecimal;
+            }
+        }
+
+        LinkFields(*dispatch, saved, nb_saved, false);
+        LinkFields(*dispatch, declared, nb_declared, true);
+
+        delete[] saved;
+        return dispatch;
+    }
+
+    //
+    // Class dispatch tables built during a parse, found by class and transient flags. The tables point
+    // into the database the classes came from, so they're only kept for the lifetime of a parser.
+    //
+    class ClassDispatchCache
+    {
+    public:
+        ClassDispatchCache() = default;
+        ClassDispatchCache(const ClassDispatchCache&) = delete;
+        ClassDispatchCache& operator=(const ClassDispatchCache&) = delete;
+
+        ~ClassDispatchCache()
+        {
+            for (unsigned int i = 0; i < m_Capacity; i++)
+            {
+                delete m_Table[i];
+            }
+            delete[] m_Table;
+        }
+
+        const ClassDispatch* Get(const clcpp::Class* class_type, unsigned int transient_flags)
+        {
+            // Keep the table at most half full
+            if ((m_Size + 1) * 2 > m_Capacity)
+            {
+                Grow();
+            }
+
+            unsigned int index = Index(class_type, transient_flags);
+            while (ClassDispatch* dispatch = m_Table[index])
+            {
+                if (dispatch->classType == class_type && dispatch->transientFlags == transient_flags)
+                {
+                    return dispatch;
+                }
+                index = (index + 1) & (m_Capacity - 1);
+            }
+
+            m_Table[index] = BuildClassDispatch(class_type, transient_flags);
+            m_Size++;
+            return m_Table[index];
+        }
+
+    private:
+        unsigned int Index(const clcpp::Class* class_type, unsigned int transient_flags) const
+        {
+            unsigned int hash = static_cast<unsigned int>(reinterpret_cast<clcpp::pointer_type>(class_type) >> 4);
+            return ((hash ^ transient_flags) * 0x9E3779B9) & (m_Capacity - 1);
+        }
+
+        void Grow()
+        {
+            ClassDispatch** old_table = m_Table;
+            unsigned int old_capacity = m_Capacity;
+            m_Capacity = m_Capacity != 0 ? m_Capacity * 2 : 16;
+            m_Table = new ClassDispatch*[m_Capacity];
+            for (unsigned int i = 0; i < m_Capacity; i++)
+            {
+                m_Table[i] = nullptr;
+            }
+
+            // Reinsert all existing tables
+            for (unsigned int i = 0; i < old_capacity; i++)
+            {
+                if (ClassDispatch* dispatch = old_table[i])
+                {
+                    unsigned int index = Index(dispatch->classType, dispatch->transientFlags);
+                    while (m_Table[index] != nullptr)
+                    {
+                        index = (index + 1) & (m_Capacity - 1);
+                    }
+                    m_Table[index] = dispatch;
+                }
+            }
+            delete[] old_table;
+        }
+
+        ClassDispatch** m_Table = nullptr;
+        unsigned int m_Capacity = 0;
+        unsigned int m_Size = 0;
+    };
+
+    bool KeyMatches(const clutl::JSONToken& key, const FieldDispatch* field)
+    {
+        if (field == nullptr || field->nameLength != key.length)
+        {
+            return false;
+        }
+        for (int i = 0; i < key.length; i++)
+        {
+            if (key.val.string[i] != field->name[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //
+    // An object or array that's in the middle of being parsed. Rather than recursing for each nested
+    // value, the parser keeps these on an explicit stack and records in each where to resume once the
+    // value it's waiting on has been parsed.
+    //
+    struct ParserFrame
+    {
+        enum State
+        {
+            // Waiting on the value of an object member
+            OBJECT_MEMBER,
+
+            // Waiting on the key or value object of a dictionary entry
+            DICTIONARY_KEY,
+            DICTIONARY_VALUE,
+
+            // Waiting on an array element while counting them ahead of allocating a container
+            ARRAY_COUNT,
+
+            // Waiting on an array element
+            ARRAY_ELEMENT,
+
+            // Waiting on an array element that's being parsed into the staging buffer
+            ARRAY_STAGE,
+        };
+
+        State state = OBJECT_MEMBER;
+
+        // Set until the first member or element is parsed by the run loop, rather than by the caller that
+        // pushed the frame, so that nesting grows the frame stack and not the call stack
+        bool begin = true;
+
+        // The object or container being loaded, null if the value is being skipped
+        char* object = nullptr;
+        const clcpp::Type* type = nullptr;
+
+        // Objects nested in values need their closing brace consuming after they've been parsed
+        bool expect_rbrace = false;
+
+        // Loadable fields of the class being parsed and the ones expected to be parsed next
+        const ClassDispatch* dispatch = nullptr;
+        const FieldDispatch* next_saved = nullptr;
+        const FieldDispatch* next_declared = nullptr;
+
+        // Container being written to, with array element types or dictionary key data
+        clcpp::WriteIterator writer;
+        const clcpp::Type* element_type = nullptr;
+        clcpp::Qualifier::Operator element_op = clcpp::Qualifier::VALUE;
+        int count = 0;
+        char key_data[128];
+
+        // Element count read from the start of the array, if it was saved with one
+        int length = -1;
+
+        // Where staged elements start in the staging buffer and their size
+        unsigned int staging_start = 0;
+        unsigned int element_size = 0;
+    };
+
+    //
+    // Frames are allocated in blocks that are kept as the stack shrinks and grows, so that they never
+    // move while the values they point to are being parsed. The stack is only bounded by available
+    // heap memory.
+    //
+    class ParserStack
+    {
+    public:
+        ParserStack()
+            : m_FirstBlock(nullptr)
+            , m_Block(nullptr)
+            , m_BlockSize(0)
+            , m_Size(0)
+        {
+        }
+
+        ~ParserStack()
+        {
+            while (m_Size != 0)
+            {
+                Pop();
+            }
+
+            while (m_FirstBlock != nullptr)
+            {
+                Block* next = m_FirstBlock->next;
+                delete m_FirstBlock;
+                m_FirstBlock = next;
+            }
+        }
+
+        ParserFrame& Push()
+        {
+            if (m_Block == nullptr || m_BlockSize == FRAMES_PER_BLOCK)
+            {
+                // Move onto the next block, allocating it the first time the stack grows this deep
+                Block* next = m_Block != nullptr ? m_Block->next : m_FirstBlock;
+                if (next == nullptr)
+                {
+                    next = new Block;
+                    next->prev = m_Block;
+                    next->next = nullptr;
+                    if (m_Block != nullptr)
+                    {
+                        m_Block->next = next;
+                    }
+                    else
+                    {
+                        m_FirstBlock = next;
+                    }
+                }
+                m_Block = next;
+                m_BlockSize = 0;
+            }
+
+            ParserFrame* frame = m_Block->Frame(m_BlockSize++);
+            clcpp::internal::CallConstructor(frame);
+            m_Size++;
+            return *frame;
+        }
+
+        void Pop()
+        {
+            clcpp::internal::CallDestructor(&Top());
+            m_Size--;
+            if (--m_BlockSize == 0 && m_Block->prev != nullptr)
+            {
+                m_Block = m_Block->prev;
+                m_BlockSize = FRAMES_PER_BLOCK;
+            }
+        }
+
+        ParserFrame& Top()
+        {
+            return *m_Block->Frame(m_BlockSize - 1);
+        }
+
+        bool IsEmpty() const
+        {
+            return m_Size == 0;
+        }
+
+    private:
+        static const unsigned int FRAMES_PER_BLOCK = 16;
+
+        struct Block
+        {
+            ParserFrame* Frame(unsigned int index)
+            {
+                return reinterpret_cast<ParserFrame*>(data) + index;
+            }
+
+            Block* prev;
+            Block* next;
+            clcpp::uint64 data[(sizeof(ParserFrame) * FRAMES_PER_BLOCK + 7) / 8];
+        };
+
+        Block* m_FirstBlock;
+        Block* m_Block;
+        unsigned int m_BlockSize;
+        unsigned int m_Size;
+    };
+
+    class Parser
+    {
+    public:
+        Parser(clutl::JSONContext& ctx, unsigned int transient_flags)
+            : m_Ctx(ctx)
+            , m_TransientFlags(transient_flags)
+        {
+            m_Token = LexerNextToken(ctx);
+        }
+
+        void LoadObject(char* object, const clcpp::Type* type)
+        {
+            ParseObject(object, type, false);
+            Run();
+        }
+
+        void LoadValue(char* object, const clcpp::Type* type, clcpp::Qualifier::Operator op, const clcpp::Field* field)
+        {
+            ParseValue(object, type, op, field);
+            Run();
+        }
+
+        // The token following the last value loaded
+        const clutl::JSONToken& GetToken() const
+        {
+            return m_Token;
+        }
+
+        // Load a run of comma-separated array elements into objects that have already been allocated, leaving the
+        // separator after the last as the current token. Null objects are skipped.
+        void LoadElements(char* const* objects, unsigned int count, const clcpp::Type* type, clcpp::Qualifier::Operator op)
+        {
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (objects[i] != nullptr)
+                {
+                    ParseValue(objects[i], type, op, nullptr);
+                }
+                else
+                {
+                    ParseValue(nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr);
+                }
+                Run();
+
+                // As when loading the whole array, it ends at the first element not followed by a comma
+                if (m_Token.type != clutl::JSON_TOKEN_COMMA)
+                {
+                    if (m_Token.type != clutl::JSON_TOKEN_RBRACKET)
+                    {
+                        m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                    }
+                    return;
+                }
+                if (i + 1 < count)
+                {
+                    m_Token = LexerNextToken(m_Ctx);
+                }
+            }
+        }
+
+    private:
+        void Run()
+        {
+            // Keep resuming the innermost frame until all of them have been parsed
+            while (!m_Stack.IsEmpty())
+            {
+                ParserFrame& frame = m_Stack.Top();
+                if (frame.begin)
+                {
+                    frame.begin = false;
+                    if (frame.state == ParserFrame::OBJECT_MEMBER)
+                    {
+                        ParsePair(frame);
+                    }
+                    else if (frame.state == ParserFrame::DICTIONARY_VALUE)
+                    {
+                        ParseDictionaryEntry(frame);
+                    }
+                    else
+                    {
+                        ParseElement(frame);
+                    }
+                    continue;
+                }
+
+                switch (frame.state)
+                {
+                case ParserFrame::OBJECT_MEMBER:
+                    if (m_Token.type == clutl::JSON_TOKEN_COMMA)
+                    {
+                        m_Token = LexerNextToken(m_Ctx);
+                        ParsePair(frame);
+                    }
+                    else
+                    {
+                        EndObject(frame);
+                    }
+                    break;
+
+                case ParserFrame::DICTIONARY_KEY: {
+                    // Key/value separator
+                    if (!Expect(clutl::JSON_TOKEN_COLON).IsValid())
+                    {
+                        EndObject(frame);
+                        break;
+                    }
+
+                    // Allocate space for new data and parse it
+                    void* value_data = frame.writer.AddEmpty(frame.key_data);
+                    frame.state = ParserFrame::DICTIONARY_VALUE;
+                    ParseObject(static_cast<char*>(value_data), frame.writer.m_ValueType, true);
+                    break;
+                }
+
+                case ParserFrame::DICTIONARY_VALUE:
+                    if (m_Token.type == clutl::JSON_TOKEN_COMMA)
+                    {
+                        m_Token = LexerNextToken(m_Ctx);
+                    }
+                    ParseDictionaryEntry(frame);
+                    break;
+
+                case ParserFrame::ARRAY_COUNT:
+                    if (m_Token.type == clutl::JSON_TOKEN_COMMA)
+                    {
+                        m_Token = LexerNextToken(m_Ctx);
+                        ParseElement(frame);
+                    }
+                    else
+                    {
+                        // Rewind and allocate the container now that the element count is known
+                        m_Ctx.PopState(m_Token);
+                        frame.writer.Initialise(frame.type->AsTemplateType(), frame.object, frame.count);
+                        BeginElements(frame);
+                    }
+                    break;
+
+                case ParserFrame::ARRAY_ELEMENT:
+                    if (m_Token.type == clutl::JSON_TOKEN_COMMA)
+                    {
+                        m_Token = LexerNextToken(m_Ctx);
+                        ParseElement(frame);
+                    }
+                    else
+                    {
+                        if (frame.length >= 0 && frame.count != frame.length)
+                        {
+                            m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                        }
+                        m_Stack.Pop();
+                        Expect(clutl::JSON_TOKEN_RBRACKET);
+                    }
+                    break;
+
+                case ParserFrame::ARRAY_STAGE:
+                    if (m_Token.type == clutl::JSON_TOKEN_COMMA)
+                    {
+                        m_Token = LexerNextToken(m_Ctx);
+                        ParseElement(frame);
+                    }
+                    else
+                    {
+                        EndStaging(frame);
+                        m_Stack.Pop();
+                        Expect(clutl::JSON_TOKEN_RBRACKET);
+                    }
+                    break;
+                }
+            }
+        }
+
+        clutl::JSONToken Expect(clutl::JSONTokenType type)
+        {
+            return ::Expect(m_Ctx, m_Token, type);
+        }
+
+        // Parses scalar values immediately, pushing a frame for objects and arrays
+        void ParseValue(char* object, const clcpp::Type* type, clcpp::Qualifier::Operator op, const clcpp::Field* field)
+        {
+            bool transient = false;
+            if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
+            {
+                const clcpp::Class* class_type = type->AsClass();
+
+                // Does this class have a custom load function?
+                if ((class_type->flag_attributes & attrFlag_CustomLoad) != 0)
+                {
+                    // Look it up
+                    static unsigned int hash = clcpp::internal::HashNameString("load_json");
+                    if (const clcpp::Attribute* attr = clcpp::FindPrimitive(class_type->attributes, hash))
+                    {
+                        const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
+
+                        // Call it and return immediately
+                        clcpp::CallFunction(static_cast<const clcpp::Function*>(name_attr->primitive), clcpp::ByRef(m_Token),
+                                            object);
+                        m_Token = LexerNextToken(m_Ctx);
+                        return;
+                    }
+                }
+
+                // Record whether the value needs skipping because the class is transient
+                transient = (class_type->flag_attributes & m_TransientFlags) != 0;
+            }
+
+            switch (m_Token.type)
+            {
+            case clutl::JSON_TOKEN_STRING:
+                // Strings are only valid until the next token is lexed
+                ParserString(m_Token, object, type);
+                m_Token = LexerNextToken(m_Ctx);
+                break;
+            case clutl::JSON_TOKEN_INTEGER:
+                return ParserInteger(Expect(clutl::JSON_TOKEN_INTEGER), object, type, op);
+            case clutl::JSON_TOKEN_DECIMAL:
+                return ParserDecimal(Expect(clutl::JSON_TOKEN_DECIMAL), object, type);
+            case clutl::JSON_TOKEN_LBRACE:
+                if (type != nullptr && !transient)
+                {
+                    ParseObject(object, type, true);
+                }
+                else
+                {
+                    ParseObject(nullptr, nullptr, true);
+                }
+                break;
+            case clutl::JSON_TOKEN_LBRACKET:
+                return ParseArray(object, type, field);
+            case clutl::JSON_TOKEN_TRUE:
+                return ParserLiteralValue(Expect(clutl::JSON_TOKEN_TRUE), 1, object, type, op);
+            case clutl::JSON_TOKEN_FALSE:
+                return ParserLiteralValue(Expect(clutl::JSON_TOKEN_FALSE), 0, object, type, op);
+            case clutl::JSON_TOKEN_NULL:
+                return ParserLiteralValue(Expect(clutl::JSON_TOKEN_NULL), 0, object, type, op);
+
+            default:
+                m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                break;
+            }
+        }
+
+        void ParseObject(char* object, const clcpp::Type* type, bool expect_rbrace)
+        {
+            // Empty objects have nothing to parse or post-load
+            if (!Expect(clutl::JSON_TOKEN_LBRACE).IsValid() || m_Token.type == clutl::JSON_TOKEN_RBRACE)
+            {
+                if (expect_rbrace)
+                {
+                    Expect(clutl::JSON_TOKEN_RBRACE);
+                }
+                return;
+            }
+
+            ParserFrame& frame = m_Stack.Push();
+            frame.object = object;
+            frame.type = type;
+            frame.expect_rbrace = expect_rbrace;
+
+            // If we're parsing an object and the target type has a container info, this is a dictionary
+            if (type != nullptr && type->ci != nullptr)
+            {
+                // Create the writer with an unknown count
+                frame.writer.Initialise(type, object, 0);
+                frame.state = ParserFrame::DICTIONARY_VALUE;
+            }
+            else
+            {
+                if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
+                {
+                    frame.dispatch = m_ClassDispatch.Get(type->AsClass(), m_TransientFlags);
+                    frame.next_saved = frame.dispatch->firstSaved;
+                    frame.next_declared = frame.dispatch->firstDeclared;
+                }
+            }
+        }
+
+        void ParsePair(ParserFrame& frame)
+        {
+            frame.state = ParserFrame::OBJECT_MEMBER;
+
+            // Get the field name, which is only valid until the next token is lexed
+            const clutl::JSONToken& name = m_Token;
+            if (name.type != clutl::JSON_TOKEN_STRING)
+            {
+                m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                return;
+            }
+
+            // Lookup the field in the parent class, if the type is class, leaving out transient fields
+            // We want to continue parsing even if there's a mismatch, to skip the invalid data
+            const FieldDispatch* field = nullptr;
+            if (frame.dispatch != nullptr)
+            {
+                // Objects are usually saved with their fields in order so check the expected ones before
+                // hashing the name
+                if (KeyMatches(name, frame.next_saved))
+                {
+                    field = frame.next_saved;
+                }
+                else if (KeyMatches(name, frame.next_declared))
+                {
+                    field = frame.next_declared;
+                }
+                else
+                {
+                    field = frame.dispatch->Find(clcpp::internal::HashData(name.val.string, name.length));
+                }
+
+                if (field != nullptr)
+                {
+                    frame.next_saved = field->nextSaved;
+                    frame.next_declared = field->nextDeclared;
+                }
+            }
+
+            m_Token = LexerNextToken(m_Ctx);
+            if (!Expect(clutl::JSON_TOKEN_COLON).IsValid())
+            {
+                return;
+            }
+
+            // Parse or skip the field if it's unknown, storing numbers in built-in fields directly
+            if (field != nullptr)
+            {
+                char* object = frame.object + field->offset;
+                if (m_Token.type == clutl::JSON_TOKEN_INTEGER && field->loadInteger != nullptr)
+                {
+                    field->loadInteger(object, m_Token.val.integer);
+                    m_Token = LexerNextToken(m_Ctx);
+                }
+                else if (m_Token.type == clutl::JSON_TOKEN_DECIMAL && field->loadDecimal != nullptr)
+                {
+                    field->loadDecimal(object, m_Token.val.decimal);
+                    m_Token = LexerNextToken(m_Ctx);
+                }
+                else
+                {
+                    ParseValue(object, field->field->type, field->field->qualifier.op, field->field);
+                }
+            }
+            else
+            {
+                ParseValue(nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr);
+            }
+        }
+
+        void ParseDictionaryEntry(ParserFrame& frame)
+        {
+            // Loop until closing right brace found
+            if (!m_Token.IsValid() || m_Token.type == clutl::JSON_TOKEN_RBRACE)
+            {
+                EndObject(frame);
+                return;
+            }
+
+            // Parse the key, storing the value in the frame
+            clcpp::internal::Assert(frame.writer.m_KeyType->size < sizeof(frame.key_data));
+            frame.state = ParserFrame::DICTIONARY_KEY;
+            ParseValue(frame.key_data, frame.writer.m_KeyType, clcpp::Qualifier::VALUE, nullptr);
+        }
+
+        void EndObject(ParserFrame& frame)
+        {
+            // Release any dictionary writer before post-loading
+            char* object = frame.object;
+            const clcpp::Type* type = frame.type;
+            bool expect_rbrace = frame.expect_rbrace;
+            m_Stack.Pop();
+
+            if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
+            {
+                const clcpp::Class* class_type = type->AsClass();
+
+                // Run any attached post-load functions
+                if ((class_type->flag_attributes & attrFlag_PostLoad) != 0)
+                {
+                    static unsigned int hash = clcpp::internal::HashNameString("post_load");
+                    if (const clcpp::Attribute* attr = clcpp::FindPrimitive(class_type->attributes, hash))
+                    {
+                        const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
+                        if (name_attr->primitive != nullptr)
+                        {
+                            clcpp::CallFunction(static_cast<const clcpp::Function*>(name_attr->primitive), object);
+                        }
+                    }
+                }
+            }
+
+            if (expect_rbrace)
+            {
+                Expect(clutl::JSON_TOKEN_RBRACE);
+            }
+        }
+
+        void ParseArray(char* object, const clcpp::Type* type, const clcpp::Field* field)
+        {
+            if (!Expect(clutl::JSON_TOKEN_LBRACKET).IsValid())
+            {
+                return;
+            }
+
+            // Arrays saved with EMIT_ARRAY_LENGTHS lead with their element count
+            int length = -1;
+            if (m_Token.type == clutl::JSON_TOKEN_LENGTH)
+            {
+                length = static_cast<int>(m_Token.val.integer);
+                m_Token = LexerNextToken(m_Ctx);
+                if (m_Token.type != clutl::JSON_TOKEN_RBRACKET && !Expect(clutl::JSON_TOKEN_COMMA).IsValid())
+                {
+                    return;
+                }
+            }
+
+            // Stop at counts the lexer rejected rather than parsing on into the elements
+            if (!m_Token.IsValid())
+            {
+                return;
+            }
+
+            // Empty array?
+            if (m_Token.type == clutl::JSON_TOKEN_RBRACKET)
+            {
+                if (length > 0)
+                {
+                    m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                }
+                m_Token = LexerNextToken(m_Ctx);
+                return;
+            }
+
+            ParserFrame& frame = m_Stack.Push();
+            frame.object = object;
+            frame.type = type;
+            frame.length = length;
+
+            if (field != nullptr && field->ci != nullptr)
+            {
+                // Fields are fixed array iterators
+                frame.writer.Initialise(field, object);
+            }
+
+            else if (type != nullptr && type->ci != nullptr)
+            {
+                // Template types are dynamic container iterators that need to know their element count up-front.
+                // Parse elements that can be copied bytewise into the staging buffer and copy them into the
+                // container once they've been counted, so that any saved length is checked before it's used.
+                if (BeginStaging(frame))
+                {
+                    return;
+                }
+
+                // Class elements are loaded in place, trusting the saved length to size the container
+                else if (length >= 0)
+                {
+                    frame.writer.Initialise(type->AsTemplateType(), object, length);
+                }
+
+                // Counting would keep the whole array in memory, so streamed elements are skipped without a length
+                else if (m_Ctx.IsStreamed())
+                {
+                    m_Ctx.SetError(clutl::JSONError::MISSING_ARRAY_LENGTH);
+                }
+
+                else
+                {
+                    // Otherwise do a pre-pass on the array to count the number of elements
+                    // Really not very efficient for big collections of large objects
+                    m_Ctx.PushState(m_Token);
+                    frame.state = ParserFrame::ARRAY_COUNT;
+                    return;
+                }
+            }
+
+            BeginElements(frame);
+        }
+
+        bool BeginStaging(ParserFrame& frame)
+        {
+            // Elements are parsed as the container's first template argument
+            if (frame.object == nullptr || frame.type->kind != clcpp::Primitive::KIND_TEMPLATE_TYPE)
+            {
+                return false;
+            }
+            const clcpp::TemplateType* template_type = frame.type->AsTemplateType();
+            const clcpp::Type* element_type = template_type->parameter_types[0];
+            if (element_type == nullptr)
+            {
+                return false;
+            }
+
+            // Only pointers, built-in types and enums can be copied bytewise
+            bool element_is_ptr = template_type->parameter_ptrs[0];
+            if (!element_is_ptr && (element_type->ci != nullptr || (element_type->kind != clcpp::Primitive::KIND_TYPE &&
+                                                                     element_type->kind != clcpp::Primitive::KIND_ENUM)))
+            {
+                return false;
+            }
+
+            // The write iterator can't be queried for its element type until it's initialised, so check that the
+            // container stores the argument with an empty one, counting the elements instead if it doesn't
+            clcpp::WriteIterator probe;
+            probe.Initialise(frame.type, frame.object, 0);
+            if (!probe.IsInitialised() || probe.m_KeyType != nullptr || probe.m_ValueType != element_type ||
+                probe.m_ValueIsPtr != element_is_ptr)
+            {
+                return false;
+            }
+
+            frame.element_type = element_type;
+            frame.element_op = element_is_ptr ? clcpp::Qualifier::POINTER : clcpp::Qualifier::VALUE;
+            frame.element_size = element_is_ptr ? sizeof(void*) : static_cast<unsigned int>(element_type->size);
+            frame.staging_start = m_Staging.GetBytesWritten();
+            frame.state = ParserFrame::ARRAY_STAGE;
+            return true;
+        }
+
+        void EndStaging(ParserFrame& frame)
+        {
+            // Copy the staged elements into the container, leaving it untouched if they don't match the saved length
+            if (frame.length >= 0 && frame.count != frame.length)
+            {
+                m_Ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+            }
+            else
+            {
+                frame.writer.Initialise(frame.type->AsTemplateType(), frame.object, frame.count);
+                const char* staged = m_Staging.GetData() + frame.staging_start;
+                for (int i = 0; i < frame.count; i++)
+                {
+                    char* element = static_cast<char*>(frame.writer.AddEmpty());
+                    for (unsigned int j = 0; j < frame.element_size; j++)
+                    {
+                        element[j] = *staged++;
+                    }
+                }
+            }
+
+            // Release the staged elements for reuse
+            m_Staging.SeekRel(-static_cast<int>(m_Staging.GetBytesWritten() - frame.staging_start));
+        }
+
+        void BeginElements(ParserFrame& frame)
+        {
+            if (frame.writer.IsInitialised())
+            {
+                frame.element_type = frame.writer.m_ValueType;
+                frame.element_op = frame.writer.m_ValueIsPtr ? clcpp::Qualifier::POINTER : clcpp::Qualifier::VALUE;
+            }
+
+            frame.state = ParserFrame::ARRAY_ELEMENT;
+            frame.count = 0;
+            frame.begin = true;
+        }
+
+        void ParseElement(ParserFrame& frame)
+        {
+            // Elements are skipped while counting
+            if (frame.state == ParserFrame::ARRAY_COUNT)
+            {
+                frame.count++;
+                ParseValue(nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr);
+            }
+            else if (frame.state == ParserFrame::ARRAY_STAGE)
+            {
+                // Zero each element, as the container would, in case there's no value to load
+                frame.count++;
+                char* element = static_cast<char*>(m_Staging.Alloc(frame.element_size));
+                for (unsigned int i = 0; i < frame.element_size; i++)
+                {
+                    element[i] = 0;
+                }
+
+                // The staging buffer can move as it grows so objects and arrays, which have nowhere to be
+                // loaded within these element types, are skipped
+                if (m_Token.type == clutl::JSON_TOKEN_LBRACE || m_Token.type == clutl::JSON_TOKEN_LBRACKET)
+                {
+                    ParseValue(nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr);
+                }
+                else
+                {
+                    ParseValue(element, frame.element_type, frame.element_op, nullptr);
+                }
+            }
+            else
+            {
+                // Elements are counted to check the saved length, with any beyond it skipped
+                frame.count++;
+                if (frame.writer.IsInitialised() && (frame.length < 0 || frame.count <= frame.length))
+                {
+                    ParseValue(static_cast<char*>(frame.writer.AddEmpty()), frame.element_type, frame.element_op, nullptr);
+                }
+                else
+                {
+                    ParseValue(nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr);
+                }
+            }
+        }
+
+        clutl::JSONContext& m_Ctx;
+        clutl::JSONToken m_Token;
+        unsigned int m_TransientFlags;
+        ParserStack m_Stack;
+        ClassDispatchCache m_ClassDispatch;
+
+        // Growable buffer for array elements that are parsed before their container is allocated
+        clutl::WriteBuffer m_Staging;
+    };
+}
+
+CLCPP_API clutl::JSONError clutl::LoadJSON(ReadBuffer& in, void* object, const clcpp::Type* type, unsigned int transient_flags)
+{
+    clutl::JSONContext ctx(in);
+    return LoadJSON(ctx, object, type, transient_flags);
+}
+
+CLCPP_API clutl::JSONError clutl::LoadJSON(clutl::JSONContext& ctx, void* object, const clcpp::Type* type,
+                                           unsigned int transient_flags)
+{
+    SetupTypeDispatchLUT();
+    Parser parser(ctx, transient_flags);
+    parser.LoadObject(static_cast<char*>(object), type);
+    return ctx.GetError();
+}
+
+CLCPP_API clutl::JSONError clutl::LoadJSON(clutl::JSONContext& ctx, void* object, const clcpp::Field* field,
+                                           unsigned int transient_flags)
+{
+    SetupTypeDispatchLUT();
+    Parser parser(ctx, transient_flags);
+    parser.LoadValue(static_cast<char*>(object), field->type, field->qualifier.op, field);
+    return ctx.GetError();
+}
+
+namespace
+{
+    // ----------------------------------------------------------------------------------------------------
+    // JSON field queries
+    // ----------------------------------------------------------------------------------------------------
+
+    // A field on the path to one or more queried fields
+    struct QueryNode
+    {
+        unsigned int nameHash;
+        const clcpp::Field* field;
+
+        // Where to load the field if it's queried, rather than being on the way to others
+        void* dest;
+
+        // Indices of the first field within this one and the next field in the same class, with zero
+        // marking the end as the root class is never either
+        unsigned int firstChild;
+        unsigned int nextSibling;
+
+        bool found;
+    };
+
+    QueryNode* GetQueryNodes(const clutl::WriteBuffer& nodes)
+    {
+        return reinterpret_cast<QueryNode*>(const_cast<char*>(nodes.GetData()));
+    }
+
+    // Returns the index of the field within the parent with the given name, or zero if there isn't one
+    unsigned int FindQueryNode(const QueryNode* nodes, unsigned int parent, unsigned int name_hash)
+    {
+        for (unsigned int i = nodes[parent].firstChild; i != 0; i = nodes[i].nextSibling)
+        {
+            if (nodes[i].nameHash == name_hash)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    const clcpp::Field* FindField(const clcpp::Class* class_type, unsigned int name_hash)
+    {
+        if (const clcpp::Field* field = clcpp::FindPrimitive(class_type->fields, name_hash))
+        {
+            return field;
+        }
+
+        for (unsigned int i = 0; i < class_type->base_types.size; i++)
+        {
+            const clcpp::Type* base_type = class_type->base_types[i];
+            if (base_type->kind == clcpp::Primitive::KIND_CLASS)
+            {
+                if (const clcpp::Field* field = FindField(base_type->AsClass(), name_hash))
+                {
+                    return field;
+                }
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Classes that can be walked into by a query path, returning null for any other field types
+    const clcpp::Class* GetQueryClass(const clcpp::Type* type, const clcpp::Field* field)
+    {
+        if (type->kind != clcpp::Primitive::KIND_CLASS || type->ci != nullptr)
+        {
+            return nullptr;
+        }
+        if (field != nullptr && (field->ci != nullptr || field->qualifier.op != clcpp::Qualifier::VALUE))
+        {
+            return nullptr;
+        }
+        return type->AsClass();
+    }
+
+    // Skips the value at the read position by matching brackets and stepping over strings, leaving the read
+    // position at the comma or bracket that follows it
+    bool SkipValue(clutl::JSONContext& ctx)
+    {
+        int depth = 0;
+        while (true)
+        {
+            // Streamed text only needs keeping from here on
+            ctx.SkipWhitespace();
+            ctx.BeginToken();
+            if (ctx.ReadOverflows(0))
+            {
+                return false;
+            }
+
+            switch (ctx.PeekChar())
+            {
+            case '\"':
+                ctx.ConsumeChar();
+                while (true)
+                {
+                    ctx.ConsumeStringChars();
+                    if (ctx.ReadOverflows(0))
+                    {
+                        return false;
+                    }
+                    if (ctx.PeekChar() == '\"')
+                    {
+                        break;
+                    }
+
+                    // Step over the backslash and the character it escapes
+                    if (ctx.ReadOverflows(1))
+                    {
+                        return false;
+                    }
+                    ctx.ConsumeChars(2);
+                }
+                ctx.ConsumeChar();
+                break;
+
+            case '{':
+            case '[':
+                depth++;
+                ctx.ConsumeChar();
+                break;
+
+            case '}':
+            case ']':
+                if (depth == 0)
+                {
+                    return true;
+                }
+                depth--;
+                ctx.ConsumeChar();
+                break;
+
+            case ',':
+                if (depth == 0)
+                {
+                    return true;
+                }
+                ctx.ConsumeChar();
+                break;
+
+            default:
+                ctx.ConsumeChar();
+                break;
+            }
+        }
+    }
+
+    // Skips a value by lexing its tokens and matching brackets, returning the token that follows it. Malformed
+    // tokens are reported as they are when loading, although the order of tokens within brackets isn't checked.
+    clutl::JSONToken LexValue(clutl::JSONContext& ctx)
     {
-        int count = 0;
-
-        while (true)
+        int depth = 0;
+        do
         {
-            count++;
-
-            // Expect a value first
-            if (writer != nullptr)
+            clutl::JSONToken t = LexerNextToken(ctx);
+            switch (t.type)
             {
-                ParserValue(ctx, t, static_cast<char*>(writer->AddEmpty()), type, op, nullptr, transient_flags);
+            case clutl::JSON_TOKEN_NONE:
+                // Malformed tokens have already been reported by the lexer, leaving the end of the data
+                ctx.SetError(clutl::JSONError::UNEXPECTED_END_OF_DATA);
+                return t;
+
+            case clutl::JSON_TOKEN_LBRACE:
+            case clutl::JSON_TOKEN_LBRACKET:
+                depth++;
+                break;
+
+            case clutl::JSON_TOKEN_RBRACE:
+            case clutl::JSON_TOKEN_RBRACKET:
+                depth--;
+                break;
+
+            case clutl::JSON_TOKEN_COMMA:
+            case clutl::JSON_TOKEN_COLON:
+            case clutl::JSON_TOKEN_LENGTH:
+                // Separators can only be within brackets
+                if (depth == 0)
+                {
+                    ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                    return clutl::JSONToken();
+                }
+                break;
+
+            default:
+                break;
             }
-            else
+
+            // Closing more brackets than were opened means the value is missing
+            if (depth < 0)
             {
-                ParserValue(ctx, t, nullptr, nullptr, op, nullptr, transient_flags);
+                ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                return clutl::JSONToken();
             }
+        } while (depth != 0);
+
+        return LexerNextToken(ctx);
+    }
 
-            if (t.type != clutl::JSON_TOKEN_COMMA)
+    struct QueryRunner
+    {
+        // Walks the members of an object, returning false on error or once all fields have been found. As
+        // with loading, the root object ends at the first member that doesn't follow a comma.
+        bool WalkObject(unsigned int parent, bool expect_rbrace)
+        {
+            clutl::JSONToken t = LexerNextToken(ctx);
+            if (t.type != clutl::JSON_TOKEN_LBRACE)
             {
-                break;
+                ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                return false;
             }
 
             t = LexerNextToken(ctx);
+            if (t.type == clutl::JSON_TOKEN_RBRACE)
+            {
+                return true;
+            }
+
+            while (true)
+            {
+                // Match the key before moving on, while its text is still valid
+                if (t.type != clutl::JSON_TOKEN_STRING)
+                {
+                    ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                    return false;
+                }
+                unsigned int index = FindQueryNode(nodes, parent, clcpp::internal::HashData(t.val.string, t.length));
+                QueryNode* child = index != 0 ? nodes + index : nullptr;
+                if (LexerNextToken(ctx).type != clutl::JSON_TOKEN_COLON)
+                {
+                    ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                    return false;
+                }
+
+                if (child != nullptr && child->dest != nullptr)
+                {
+                    // Load queried fields, only counting them the first time they're found
+                    Parser parser(ctx, transient_flags);
+                    const clcpp::Field* field = child->field;
+                    parser.LoadValue(static_cast<char*>(child->dest), field->type, field->qualifier.op, field);
+                    if (ctx.GetError().code != clutl::JSONError::NONE)
+                    {
+                        return false;
+                    }
+                    if (!child->found)
+                    {
+                        child->found = true;
+                        if (++nb_found == nb_fields)
+                        {
+                            return false;
+                        }
+                    }
+                    t = parser.GetToken();
+                }
+                else
+                {
+                    // Walk into objects on the way to queried fields, skipping everything else
+                    ctx.SkipWhitespace();
+                    if (child != nullptr && !ctx.ReadOverflows(0) && ctx.PeekChar() == '{')
+                    {
+                        if (!WalkObject(index, true))
+                        {
+                            return false;
+                        }
+                        t = LexerNextToken(ctx);
+                    }
+                    else
+                    {
+                        t = LexValue(ctx);
+                        if (ctx.GetError().code != clutl::JSONError::NONE)
+                        {
+                            return false;
+                        }
+                    }
+                }
+
+                if (t.type != clutl::JSON_TOKEN_COMMA)
+                {
+                    if (expect_rbrace && t.type != clutl::JSON_TOKEN_RBRACE)
+                    {
+                        ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
+                        return false;
+                    }
+                    return true;
+                }
+                t = LexerNextToken(ctx);
+            }
         }
 
-        return count;
-    }
+        clutl::JSONContext& ctx;
+        QueryNode* nodes;
+        unsigned int transient_flags;
+        unsigned int nb_fields;
+        unsigned int nb_found;
+    };
+}
+
+clutl::JSONQuery::JSONQuery(const clcpp::Type* type, unsigned int transient_flags)
+    : m_Type(type)
+    , m_TransientFlags(transient_flags)
+{
+    QueryNode* root = static_cast<QueryNode*>(m_Nodes.Alloc(sizeof(QueryNode)));
+    root->nameHash = 0;
+    root->field = nullptr;
+    root->dest = nullptr;
+    root->firstChild = 0;
+    root->nextSibling = 0;
+    root->found = false;
+}
 
-    void ParserArray(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                     const clcpp::Field* field, unsigned int transient_flags)
+bool clutl::JSONQuery::AddField(const char* path, void* dest)
+{
+    // Check the path leads to a field before adding anything for it
+    const clcpp::Class* class_type = GetQueryClass(m_Type, nullptr);
+    const char* segment = path;
+    while (true)
     {
-        if (!Expect(ctx, t, clutl::JSON_TOKEN_LBRACKET).IsValid())
+        const char* end = segment;
+        while (*end != 0 && *end != '.')
         {
-            return;
+            end++;
         }
 
-        // Empty array?
-        if (t.type == clutl::JSON_TOKEN_RBRACKET)
+        if (class_type == nullptr)
         {
-            t = LexerNextToken(ctx);
-            return;
+            return false;
+        }
+        const clcpp::Field* field = FindField(class_type, clcpp::internal::HashData(segment, end - segment));
+        if (field == nullptr || (field->flag_attributes & m_TransientFlags) != 0)
+        {
+            return false;
         }
 
-        // TODO: Save a field specifying container size. This makes hand-authored JSON a little
-        //       trickier but massively speeds up the general case of game read/written JSON.
-        //       Could make a fallback case for when no container size is specified.
-
-        clcpp::WriteIterator writer;
-        if (field != nullptr && field->ci != nullptr)
+        if (*end == 0)
         {
-            // Fields are fixed array iterators
-            writer.Initialise(field, object);
+            break;
         }
+        class_type = GetQueryClass(field->type, field);
+        segment = end + 1;
+    }
 
-        else if (type != nullptr && type->ci != nullptr)
+    // Add nodes for each field on the path that's not shared with an existing one
+    unsigned int parent = 0;
+    class_type = m_Type->AsClass();
+    segment = path;
+    while (true)
+    {
+        const char* end = segment;
+        while (*end != 0 && *end != '.')
         {
-            // Do a pre-pass on the array to count the number of elements
-            // Really not very efficient for big collections of large objects
-            ctx.PushState(t);
-            int array_count = ParserElements(ctx, t, nullptr, nullptr, clcpp::Qualifier::VALUE, transient_flags);
-            ctx.PopState(t);
+            end++;
+        }
 
-            // Template types are dynamic container iterators
-            writer.Initialise(type->AsTemplateType(), object, array_count);
+        unsigned int name_hash = clcpp::internal::HashData(segment, end - segment);
+        unsigned int index = FindQueryNode(GetQueryNodes(m_Nodes), parent, name_hash);
+        if (index == 0)
+        {
+            // Link in as the first field of the parent
+            index = m_Nodes.GetBytesWritten() / sizeof(QueryNode);
+            QueryNode* child = static_cast<QueryNode*>(m_Nodes.Alloc(sizeof(QueryNode)));
+            child->nameHash = name_hash;
+            child->field = FindField(class_type, name_hash);
+            child->dest = nullptr;
+            child->firstChild = 0;
+            child->nextSibling = GetQueryNodes(m_Nodes)[parent].firstChild;
+            child->found = false;
+            GetQueryNodes(m_Nodes)[parent].firstChild = index;
         }
 
-        if (writer.IsInitialised())
+        // Fields can either be loaded or walked into, but not both
+        QueryNode& node = GetQueryNodes(m_Nodes)[index];
+        if (node.dest != nullptr)
         {
-            ParserElements(ctx, t, &writer, writer.m_ValueType,
-                           writer.m_ValueIsPtr ? clcpp::Qualifier::POINTER : clcpp::Qualifier::VALUE, transient_flags);
+            return false;
         }
-        else
+        if (*end == 0)
         {
-            ParserElements(ctx, t, nullptr, nullptr, clcpp::Qualifier::VALUE, transient_flags);
+            if (node.firstChild != 0)
+            {
+                return false;
+            }
+            node.dest = dest;
+            m_NbFields++;
+            return true;
         }
 
-        Expect(ctx, t, clutl::JSON_TOKEN_RBRACKET);
+        class_type = GetQueryClass(node.field->type, node.field);
+        parent = index;
+        segment = end + 1;
     }
+}
 
-    void ParserLiteralValue(const clutl::JSONToken& t, int integer, char* object, const clcpp::Type* type,
-                            clcpp::Qualifier::Operator op)
+clutl::JSONError clutl::JSONQuery::Run(ReadBuffer& in)
+{
+    clutl::JSONContext ctx(in);
+    return Run(ctx);
+}
+
+clutl::JSONError clutl::JSONQuery::Run(JSONContext& ctx)
+{
+    SetupTypeDispatchLUT();
+
+    QueryNode* nodes = GetQueryNodes(m_Nodes);
+    unsigned int nb_nodes = m_Nodes.GetBytesWritten() / sizeof(QueryNode);
+    for (unsigned int i = 0; i < nb_nodes; i++)
     {
-        if (t.IsValid())
-        {
-            LoadInteger(integer, object, type, op);
-        }
+        nodes[i].found = false;
+    }
+
+    QueryRunner runner = { ctx, nodes, m_TransientFlags, m_NbFields, 0 };
+    if (m_NbFields != 0)
+    {
+        runner.WalkObject(0, false);
     }
+    m_NbFound = runner.nb_found;
+
+    return ctx.GetError();
+}
+
+namespace
+{
+    // ----------------------------------------------------------------------------------------------------
+    // Parallel array loading
+    // ----------------------------------------------------------------------------------------------------
+
+    // Enough elements to share the cost of creating a parser for each job
+    const unsigned int ELEMENTS_PER_BATCH = 64;
+
+    // Where the text of an array element lies, with the line it starts on for locating errors
+    struct ArrayElementText
+    {
+        unsigned int start;
+        unsigned int line;
+        clcpp::uint64 linePosition;
 
-    void ParserValue(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                     clcpp::Qualifier::Operator op, const clcpp::Field* field, unsigned int transient_flags)
+        // Position of the comma or closing bracket that follows the element
+        unsigned int end;
+    };
+
+    // Splits the array at the read position into the text of its elements, returning false if there's no array
+    // or the text ends before it does, or its saved length is malformed or doesn't match the elements found.
+    bool SplitArray(clutl::JSONContext& ctx, const clutl::ReadBuffer& in, clutl::WriteBuffer& elements)
     {
-        bool transient = false;
-        if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
+        int length = -1;
+        if (LexerNextToken(ctx).type != clutl::JSON_TOKEN_LBRACKET)
         {
-            const clcpp::Class* class_type = type->AsClass();
+            return false;
+        }
 
-            // Does this class have a custom load function?
-            if ((class_type->flag_attributes & attrFlag_CustomLoad) != 0)
+        // Lex any saved length without lexing the first element
+        ctx.SkipWhitespace();
+        if (ctx.ReadOverflows(0))
+        {
+            return false;
+        }
+        if (ctx.PeekChar() == '#')
+        {
+            length = static_cast<int>(LexerNextToken(ctx).val.integer);
+            ctx.SkipWhitespace();
+            if (ctx.GetError().code != clutl::JSONError::NONE || ctx.ReadOverflows(0) ||
+                (ctx.PeekChar() != ',' && ctx.PeekChar() != ']'))
+            {
+                return false;
+            }
+            if (ctx.PeekChar() == ',')
             {
-                // Look it up
-                static unsigned int hash = clcpp::internal::HashNameString("load_json");
-                if (const clcpp::Attribute* attr = clcpp::FindPrimitive(class_type->attributes, hash))
+                ctx.ConsumeChar();
+                ctx.SkipWhitespace();
+                if (ctx.ReadOverflows(0))
                 {
-                    const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
-
-                    // Call it and return immediately
-                    clcpp::CallFunction(static_cast<const clcpp::Function*>(name_attr->primitive), clcpp::ByRef(t), object);
-                    t = LexerNextToken(ctx);
-                    return;
+                    return false;
                 }
             }
+        }
 
-            // Record whether the value needs skipping because the class is transient
-            transient = (class_type->flag_attributes & transient_flags) != 0;
+        // Empty array?
+        if (ctx.PeekChar() == ']')
+        {
+            ctx.ConsumeChar();
+            return length <= 0;
         }
 
-        switch (t.type)
+        while (true)
         {
-        case clutl::JSON_TOKEN_STRING:
-            return ParserString(Expect(ctx, t, clutl::JSON_TOKEN_STRING), object, type);
-        case clutl::JSON_TOKEN_INTEGER:
-            return ParserInteger(Expect(ctx, t, clutl::JSON_TOKEN_INTEGER), object, type, op);
-        case clutl::JSON_TOKEN_DECIMAL:
-            return ParserDecimal(Expect(ctx, t, clutl::JSON_TOKEN_DECIMAL), object, type);
-        case clutl::JSON_TOKEN_LBRACE: {
-            if (type != nullptr && !transient)
+            ctx.SkipWhitespace();
+            ArrayElementText* element = static_cast<ArrayElementText*>(elements.Alloc(sizeof(ArrayElementText)));
+            element->start = in.GetBytesRead();
+            element->line = ctx.GetLine();
+            element->linePosition = ctx.GetLinePosition();
+            if (!SkipValue(ctx))
             {
-                ParserObject(ctx, t, object, type, transient_flags);
+                return false;
             }
-            else
+            element->end = in.GetBytesRead();
+
+            // Anything but a comma ends the array, leaving the parser to report what's unexpected
+            char separator = ctx.PeekChar();
+            ctx.ConsumeChar();
+            if (separator != ',')
             {
-                ParserObject(ctx, t, nullptr, nullptr, transient_flags);
+                return length < 0 || static_cast<unsigned int>(length) == elements.GetBytesWritten() / sizeof(ArrayElementText);
             }
-
-            Expect(ctx, t, clutl::JSON_TOKEN_RBRACE);
-            break;
         }
-        case clutl::JSON_TOKEN_LBRACKET:
-            return ParserArray(ctx, t, object, type, field, transient_flags);
-        case clutl::JSON_TOKEN_TRUE:
-            return ParserLiteralValue(Expect(ctx, t, clutl::JSON_TOKEN_TRUE), 1, object, type, op);
-        case clutl::JSON_TOKEN_FALSE:
-            return ParserLiteralValue(Expect(ctx, t, clutl::JSON_TOKEN_FALSE), 0, object, type, op);
-        case clutl::JSON_TOKEN_NULL:
-            return ParserLiteralValue(Expect(ctx, t, clutl::JSON_TOKEN_NULL), 0, object, type, op);
+    }
 
-        default:
-            ctx.SetError(clutl::JSONError::UNEXPECTED_TOKEN);
-            break;
+    struct ArrayLoad
+    {
+        const clutl::ReadBuffer* in;
+        const ArrayElementText* elements;
+        unsigned int nbElements;
+
+        // Where to load each element, or null to skip it
+        char* const* objects;
+        const clcpp::Type* elementType;
+        clcpp::Qualifier::Operator elementOp;
+
+        unsigned int transientFlags;
+
+        // The first error in each batch, located in the whole text
+        clutl::JSONError* errors;
+    };
+
+    void LoadArrayBatch(void* data, unsigned int index)
+    {
+        const ArrayLoad& load = *static_cast<const ArrayLoad*>(data);
+        unsigned int first = index * ELEMENTS_PER_BATCH;
+        unsigned int last = first + ELEMENTS_PER_BATCH < load.nbElements ? first + ELEMENTS_PER_BATCH : load.nbElements;
+
+        // Parse the text from the first element up to and including the separator after the last
+        const ArrayElementText& first_element = load.elements[first];
+        unsigned int start = first_element.start;
+        clutl::ReadBuffer in(load.in->ReadAt(start), load.elements[last - 1].end + 1 - start);
+        clutl::JSONContext ctx(in);
+        Parser parser(ctx, load.transientFlags);
+        parser.LoadElements(load.objects + first, last - first, load.elementType, load.elementOp);
+
+        clutl::JSONError error = ctx.GetError();
+        if (error.code != clutl::JSONError::NONE)
+        {
+            error.position += start;
+            if (error.line == 1)
+            {
+                error.column = error.position - first_element.linePosition;
+            }
+            error.line += first_element.line - 1;
         }
+        load.errors[index] = error;
     }
+}
+
+CLCPP_API clutl::JSONError clutl::LoadJSONArray(ReadBuffer& in, void* object, const clcpp::Type* type,
+                                                unsigned int transient_flags, IParallelFor& parallel)
+{
+    SetupTypeDispatchLUT();
 
-    const clcpp::Field* FindFieldsRecursive(const clcpp::Type* type, unsigned int hash)
+    // Only dynamic containers can be allocated once their elements have been counted
+    unsigned int in_start = in.GetBytesRead();
+    if (type->ci != nullptr && type->kind == clcpp::Primitive::KIND_TEMPLATE_TYPE)
     {
-        // Check fields if this is a class
-        const clcpp::Field* field = nullptr;
-        if (type->kind == clcpp::Primitive::KIND_CLASS)
+        clutl::JSONContext ctx(in);
+        clutl::WriteBuffer element_buffer;
+        if (SplitArray(ctx, in, element_buffer))
         {
-            field = clcpp::FindPrimitive(type->AsClass()->fields, hash);
-        }
+            const ArrayElementText* elements = reinterpret_cast<const ArrayElementText*>(element_buffer.GetData());
+            unsigned int nb_elements = element_buffer.GetBytesWritten() / sizeof(ArrayElementText);
 
-        if (field == nullptr)
-        {
-            // Search up through the inheritance hierarchy
-            for (unsigned int i = 0; i < type->base_types.size; i++)
+            // Lex on past the array, as the parser does
+            LexerNextToken(ctx);
+            clutl::JSONError error = ctx.GetError();
+            if (nb_elements == 0)
             {
-                field = FindFieldsRecursive(type->base_types[i], hash);
-                if (field != nullptr)
+                return error;
+            }
+
+            // Allocate every element up-front
+            clcpp::WriteIterator writer;
+            writer.Initialise(type->AsTemplateType(), object, nb_elements);
+            char** objects = new char*[nb_elements];
+            for (unsigned int i = 0; i < nb_elements; i++)
+            {
+                objects[i] = writer.IsInitialised() ? static_cast<char*>(writer.AddEmpty()) : nullptr;
+            }
+
+            unsigned int nb_batches = (nb_elements + ELEMENTS_PER_BATCH - 1) / ELEMENTS_PER_BATCH;
+            ArrayLoad load;
+            load.in = &in;
+            load.elements = elements;
+            load.nbElements = nb_elements;
+            load.objects = objects;
+            load.elementType = writer.IsInitialised() ? writer.m_ValueType : nullptr;
+            load.elementOp = writer.m_ValueIsPtr ? clcpp::Qualifier::POINTER : clcpp::Qualifier::VALUE;
+            load.transientFlags = transient_flags;
+            load.errors = new clutl::JSONError[nb_batches];
+            parallel.Run(LoadArrayBatch, &load, nb_batches);
+
+            // Batches are in text order so the first to fail has the first error of any element, which can only
+            // precede one found after the array
+            for (unsigned int i = 0; i < nb_batches; i++)
+            {
+                if (load.errors[i].code != clutl::JSONError::NONE)
                 {
+                    error = load.errors[i];
                     break;
                 }
             }
+
+            delete[] load.errors;
+            delete[] objects;
+            return error;
         }
 
-        return field;
+        // Rewind to load on this thread, reporting the error where the parser finds it
+        in.SeekRel(static_cast<int>(in_start) - static_cast<int>(in.GetBytesRead()));
     }
 
-    void ParserPair(clutl::JSONContext& ctx, clutl::JSONToken& t, char*& object, const clcpp::Type*& type,
-                    unsigned int transient_flags)
+    clutl::JSONContext ctx(in);
+    Parser parser(ctx, transient_flags);
+    parser.LoadValue(static_cast<char*>(object), type, clcpp::Qualifier::VALUE, nullptr);
+    return ctx.GetError();
+}
+
+namespace
+{
+    // ----------------------------------------------------------------------------------------------------
+    // Shortest round-trip decimal formatting
+    // ----------------------------------------------------------------------------------------------------
+
+    // An unpacked floating point value with a 64-bit significand, valued f * 2^e
+    struct DiyFp
     {
-        // Get the field name
-        clutl::JSONToken name = Expect(ctx, t, clutl::JSON_TOKEN_STRING);
-        if (!name.IsValid())
+        DiyFp() = default;
+        DiyFp(clcpp::uint64 f_, int e_)
+            : f(f_)
+            , e(e_)
         {
-            return;
         }
 
-        // Lookup the field in the parent class, if the type is class
-        // We want to continue parsing even if there's a mismatch, to skip the invalid data
-        const clcpp::Field* field = nullptr;
-        if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
-        {
-            const clcpp::Class* class_type = type->AsClass();
-            unsigned int field_hash = clcpp::internal::HashData(name.val.string, name.length);
-
-            field = FindFieldsRecursive(class_type, field_hash);
-
-            // Don't load values for transient fields
-            if (field != nullptr && (field->flag_attributes & transient_flags) != 0)
-            {
-                field = nullptr;
-            }
-        }
+        clcpp::uint64 f = 0;
+        int e = 0;
+    };
 
-        if (!Expect(ctx, t, clutl::JSON_TOKEN_COLON).IsValid())
+    DiyFp Normalise(DiyFp v)
+    {
+        while ((v.f & 0x8000000000000000ULL) == 0)
         {
-            return;
+            v.f <<= 1;
+            v.e--;
         }
+        return v;
+    }
 
-        // Parse or skip the field if it's unknown
-        if (field != nullptr)
-        {
-            ParserValue(ctx, t, object + field->offset, field->type, field->qualifier.op, field, transient_flags);
-        }
-        else
-        {
-            ParserValue(ctx, t, nullptr, nullptr, clcpp::Qualifier::VALUE, nullptr, transient_flags);
-        }
+    DiyFp Multiply(const DiyFp& a, const DiyFp& b)
+    {
+        // Keep the upper 64 bits of the 128-bit product, rounded
+        const clcpp::uint64 mask = 0xFFFFFFFF;
+        clcpp::uint64 ah = a.f >> 32, al = a.f & mask;
+        clcpp::uint64 bh = b.f >> 32, bl = b.f & mask;
+        clcpp::uint64 hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+        clcpp::uint64 mid = (ll >> 32) + (hl & mask) + (lh & mask) + (1U << 31);
+        return DiyFp(hh + (hl >> 32) + (lh >> 32) + (mid >> 32), a.e + b.e + 64);
+    }
+
+    // Normalised 64-bit approximations of the powers of ten 10^k, for k = -348 + 8i, rounded to nearest
+    struct CachedPower
+    {
+        clcpp::uint64 f;
+        short e;
+        short k;
+    };
+    const CachedPower g_CachedPowers[] = {
+        { 0xFA8FD5A0081C0288ULL, -1220, -348 },
+        { 0xBAAEE17FA23EBF76ULL, -1193, -340 },
+        { 0x8B16FB203055AC76ULL, -1166, -332 },
+        { 0xCF42894A5DCE35EAULL, -1140, -324 },
+        { 0x9A6BB0AA55653B2DULL, -1113, -316 },
+        { 0xE61ACF033D1A45DFULL, -1087, -308 },
+        { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+        { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+        { 0xBE5691EF416BD60CULL, -1007, -284 },
+        { 0x8DD01FAD907FFC3CULL, -980, -276 },
+        { 0xD3515C2831559A83ULL, -954, -268 },
+        { 0x9D71AC8FADA6C9B5ULL, -927, -260 },
+        { 0xEA9C227723EE8BCBULL, -901, -252 },
+        { 0xAECC49914078536DULL, -874, -244 },
+        { 0x823C12795DB6CE57ULL, -847, -236 },
+        { 0xC21094364DFB5637ULL, -821, -228 },
+        { 0x9096EA6F3848984FULL, -794, -220 },
+        { 0xD77485CB25823AC7ULL, -768, -212 },
+        { 0xA086CFCD97BF97F4ULL, -741, -204 },
+        { 0xEF340A98172AACE5ULL, -715, -196 },
+        { 0xB23867FB2A35B28EULL, -688, -188 },
+        { 0x84C8D4DFD2C63F3BULL, -661, -180 },
+        { 0xC5DD44271AD3CDBAULL, -635, -172 },
+        { 0x936B9FCEBB25C996ULL, -608, -164 },
+        { 0xDBAC6C247D62A584ULL, -582, -156 },
+        { 0xA3AB66580D5FDAF6ULL, -555, -148 },
+        { 0xF3E2F893DEC3F126ULL, -529, -140 },
+        { 0xB5B5ADA8AAFF80B8ULL, -502, -132 },
+        { 0x87625F056C7C4A8BULL, -475, -124 },
+        { 0xC9BCFF6034C13053ULL, -449, -116 },
+        { 0x964E858C91BA2655ULL, -422, -108 },
+        { 0xDFF9772470297EBDULL, -396, -100 },
+        { 0xA6DFBD9FB8E5B88FULL, -369, -92 },
+        { 0xF8A95FCF88747D94ULL, -343, -84 },
+        { 0xB94470938FA89BCFULL, -316, -76 },
+        { 0x8A08F0F8BF0F156BULL, -289, -68 },
+        { 0xCDB02555653131B6ULL, -263, -60 },
+        { 0x993FE2C6D07B7FACULL, -236, -52 },
+        { 0xE45C10C42A2B3B06ULL, -210, -44 },
+        { 0xAA242499697392D3ULL, -183, -36 },
+        { 0xFD87B5F28300CA0EULL, -157, -28 },
+        { 0xBCE5086492111AEBULL, -130, -20 },
+        { 0x8CBCCC096F5088CCULL, -103, -12 },
+        { 0xD1B71758E219652CULL, -77, -4 },
+        { 0x9C40000000000000ULL, -50, 4 },
+        { 0xE8D4A51000000000ULL, -24, 12 },
+        { 0xAD78EBC5AC620000ULL, 3, 20 },
+        { 0x813F3978F8940984ULL, 30, 28 },
+        { 0xC097CE7BC90715B3ULL, 56, 36 },
+        { 0x8F7E32CE7BEA5C70ULL, 83, 44 },
+        { 0xD5D238A4ABE98068ULL, 109, 52 },
+        { 0x9F4F2726179A2245ULL, 136, 60 },
+        { 0xED63A231D4C4FB27ULL, 162, 68 },
+        { 0xB0DE65388CC8ADA8ULL, 189, 76 },
+        { 0x83C7088E1AAB65DBULL, 216, 84 },
+        { 0xC45D1DF942711D9AULL, 242, 92 },
+        { 0x924D692CA61BE758ULL, 269, 100 },
+        { 0xDA01EE641A708DEAULL, 295, 108 },
+        { 0xA26DA3999AEF774AULL, 322, 116 },
+        { 0xF209787BB47D6B85ULL, 348, 124 },
+        { 0xB454E4A179DD1877ULL, 375, 132 },
+        { 0x865B86925B9BC5C2ULL, 402, 140 },
+        { 0xC83553C5C8965D3DULL, 428, 148 },
+        { 0x952AB45CFA97A0B3ULL, 455, 156 },
+        { 0xDE469FBD99A05FE3ULL, 481, 164 },
+        { 0xA59BC234DB398C25ULL, 508, 172 },
+        { 0xF6C69A72A3989F5CULL, 534, 180 },
+        { 0xB7DCBF5354E9BECEULL, 561, 188 },
+        { 0x88FCF317F22241E2ULL, 588, 196 },
+        { 0xCC20CE9BD35C78A5ULL, 614, 204 },
+        { 0x98165AF37B2153DFULL, 641, 212 },
+        { 0xE2A0B5DC971F303AULL, 667, 220 },
+        { 0xA8D9D1535CE3B396ULL, 694, 228 },
+        { 0xFB9B7CD9A4A7443CULL, 720, 236 },
+        { 0xBB764C4CA7A44410ULL, 747, 244 },
+        { 0x8BAB8EEFB6409C1AULL, 774, 252 },
+        { 0xD01FEF10A657842CULL, 800, 260 },
+        { 0x9B10A4E5E9913129ULL, 827, 268 },
+        { 0xE7109BFBA19C0C9DULL, 853, 276 },
+        { 0xAC2820D9623BF429ULL, 880, 284 },
+        { 0x80444B5E7AA7CF85ULL, 907, 292 },
+        { 0xBF21E44003ACDD2DULL, 933, 300 },
+        { 0x8E679C2F5E44FF8FULL, 960, 308 },
+        { 0xD433179D9C8CB841ULL, 986, 316 },
+        { 0x9E19DB92B4E31BA9ULL, 1013, 324 },
+        { 0xEB96BF6EBADF77D9ULL, 1039, 332 },
+        { 0xAF87023B9BF0EE6BULL, 1066, 340 }
+    };
+
+    // Get the cached power of ten that scales a value with binary exponent e so that the scaled
+    // exponent lies in [-60, -32], leaving the integral part of the scaled value within 32 bits
+    DiyFp GetCachedPower(int e, int& k)
+    {
+        // Index with ceil((-61 - e) * log10(2)), offset to keep it positive
+        double dk = (-61 - e) * 0.30102999566398114 + 348;
+        int ik = static_cast<int>(dk);
+        if (dk - ik > 0)
+            ik++;
+
+        const CachedPower& power = g_CachedPowers[(ik - 1) / 8 + 1];
+        k = power.k;
+        return DiyFp(power.f, power.e);
     }
 
-    void ParserMembers(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                       unsigned int transient_flags)
+    // Adjusts the last generated digit towards the value and checks that the digits are the shortest that
+    // uniquely identify it, despite the imprecision of the scaled values. See "Printing Floating-Point
+    // Numbers Quickly and Accurately with Integers", Loitsch 2010.
+    bool RoundWeed(char* digits, int nb_digits, clcpp::uint64 distance_too_high_w, clcpp::uint64 unsafe_interval,
+                   clcpp::uint64 rest, clcpp::uint64 ten_kappa, clcpp::uint64 unit)
     {
-        ParserPair(ctx, t, object, type, transient_flags);
+        clcpp::uint64 small_distance = distance_too_high_w - unit;
+        clcpp::uint64 big_distance = distance_too_high_w + unit;
 
-        // Recurse, parsing more members in the list
-        if (t.type == clutl::JSON_TOKEN_COMMA)
+        // Move the last digit down while that gets closer to the value and stays in the safe interval
+        while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+               (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance))
         {
-            t = LexerNextToken(ctx);
-            ParserMembers(ctx, t, object, type, transient_flags);
+            digits[nb_digits - 1]--;
+            rest += ten_kappa;
         }
+
+        // Fail if the other end of the value's error range would have taken another step
+        if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+            (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance))
+            return false;
+
+        // The digits must be safely inside the unsafe interval
+        return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
     }
 
-    void ParserDictionary(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                          unsigned int transient_flags)
+    bool GenerateDigits(const DiyFp& low, const DiyFp& w, const DiyFp& high, char* digits, int& nb_digits, int& kappa)
     {
-        // Create the writer with an unknown count
-        clcpp::WriteIterator writer;
-        writer.Initialise(type, object, 0);
+        // Widen the boundaries by the imprecision of the scaled values, giving the interval that
+        // may contain values outside the boundaries
+        clcpp::uint64 unit = 1;
+        DiyFp too_low(low.f - unit, low.e);
+        DiyFp too_high(high.f + unit, high.e);
+        clcpp::uint64 unsafe_interval = too_high.f - too_low.f;
+
+        // Split the upper boundary into integral and fractional parts
+        int shift = -w.e;
+        clcpp::uint64 one = 1ULL << shift;
+        clcpp::uint32 integrals = static_cast<clcpp::uint32>(too_high.f >> shift);
+        clcpp::uint64 fractionals = too_high.f & (one - 1);
+
+        // Find the biggest power of ten that's no larger than the integral part
+        clcpp::uint32 divisor = 0;
+        kappa = 0;
+        for (clcpp::uint64 power = 1; power <= integrals; power *= 10)
+        {
+            divisor = static_cast<clcpp::uint32>(power);
+            kappa++;
+        }
 
-        // Loop until closing right brace found
-        while (t.IsValid() && t.type != clutl::JSON_TOKEN_RBRACE)
+        // Generate integral digits until the remainder falls within the unsafe interval
+        nb_digits = 0;
+        while (kappa > 0)
         {
-            // Parse the key, storing the value on the stack
-            char key_data[128];
-            clcpp::internal::Assert(writer.m_KeyType->size < sizeof(key_data));
-            ParserValue(ctx, t, key_data, writer.m_KeyType, clcpp::Qualifier::VALUE, nullptr, transient_flags);
+            digits[nb_digits++] = static_cast<char>('0' + integrals / divisor);
+            integrals %= divisor;
+            kappa--;
 
-            // Key/value separator
-            if (!Expect(ctx, t, clutl::JSON_TOKEN_COLON).IsValid())
+            clcpp::uint64 rest = (static_cast<clcpp::uint64>(integrals) << shift) + fractionals;
+            if (rest < unsafe_interval)
             {
-                return;
+                return RoundWeed(digits, nb_digits, too_high.f - w.f, unsafe_interval, rest,
+                                 static_cast<clcpp::uint64>(divisor) << shift, unit);
             }
+            divisor /= 10;
+        }
+
+        // Continue with fractional digits, scaling the imprecision with them
+        while (true)
+        {
+            fractionals *= 10;
+            unit *= 10;
+            unsafe_interval *= 10;
 
-            // Allocate space for new data and parse it
-            void* value_data = writer.AddEmpty(key_data);
-            ParserObject(ctx, t, static_cast<char*>(value_data), writer.m_ValueType, transient_flags);
-            Expect(ctx, t, clutl::JSON_TOKEN_RBRACE);
+            digits[nb_digits++] = static_cast<char>('0' + (fractionals >> shift));
+            fractionals &= one - 1;
+            kappa--;
 
-            if (t.type == clutl::JSON_TOKEN_COMMA)
-            {
-                t = LexerNextToken(ctx);
-            }
+            if (fractionals < unsafe_interval)
+                return RoundWeed(digits, nb_digits, (too_high.f - w.f) * unit, unsafe_interval, fractionals, one, unit);
         }
     }
 
-    void ParserObject(clutl::JSONContext& ctx, clutl::JSONToken& t, char* object, const clcpp::Type* type,
-                      unsigned int transient_flags)
+    // Generates the shortest digits that read back as the given positive, finite value. Single precision
+    // values have their boundaries placed half-way to their neighbouring floats. Returns false in the
+    // rare cases where the digits can't be proven to be the shortest.
+    bool Grisu3(double value, bool single, char* digits, int& nb_digits, int& exponent)
     {
-        if (!Expect(ctx, t, clutl::JSON_TOKEN_LBRACE).IsValid())
-        {
-            return;
+        // Unpack the significand and exponent, accounting for denormals
+        union { double d; clcpp::uint64 u; } bits = { value };
+        clcpp::uint64 significand = bits.u & 0x000FFFFFFFFFFFFFULL;
+        int biased_exponent = static_cast<int>(bits.u >> 52);
+        DiyFp v = biased_exponent == 0 ? DiyFp(significand, -1074) : DiyFp(significand | 0x0010000000000000ULL, biased_exponent - 1075);
+        DiyFp w = Normalise(v);
+
+        // Boundaries are half-way between the value and its neighbours, with the lower neighbour closer
+        // when the significand is a power of two
+        DiyFp boundary(v.f, v.e);
+        bool lower_closer = significand == 0 && biased_exponent > 1;
+        if (single)
+        {
+            union { float f; clcpp::uint32 u; } fbits = { static_cast<float>(value) };
+            clcpp::uint32 fsignificand = fbits.u & 0x007FFFFF;
+            int fbiased_exponent = static_cast<int>(fbits.u >> 23);
+            boundary = fbiased_exponent == 0 ? DiyFp(fsignificand, -149) : DiyFp(fsignificand | 0x00800000, fbiased_exponent - 150);
+            lower_closer = fsignificand == 0 && fbiased_exponent > 1;
         }
+        DiyFp high = Normalise(DiyFp((boundary.f << 1) + 1, boundary.e - 1));
+        DiyFp low = lower_closer ? DiyFp((boundary.f << 2) - 1, boundary.e - 2) : DiyFp((boundary.f << 1) - 1, boundary.e - 1);
+        low.f <<= low.e - high.e;
+        low.e = high.e;
+
+        // Scale everything so that the integral part of the value fits in 32 bits
+        int k;
+        DiyFp ten_k = GetCachedPower(w.e, k);
+        DiyFp scaled_w = Multiply(w, ten_k);
+        DiyFp scaled_low = Multiply(low, ten_k);
+        DiyFp scaled_high = Multiply(high, ten_k);
+
+        int kappa;
+        bool shortest = GenerateDigits(scaled_low, scaled_w, scaled_high, digits, nb_digits, kappa);
+        exponent = kappa - k;
+        return shortest;
+    }
 
-        // Empty object?
-        if (t.type == clutl::JSON_TOKEN_RBRACE)
+    // Search for the shortest digits by printing at increasing precision until the value reads back
+    void PrintShortest(double value, bool single, char* digits, int& nb_digits, int& exponent)
+    {
+        char buffer[32];
+        for (int precision = 0; ; precision++)
         {
-            // t = LexerNextToken(ctx);
-            return;
+            snprintf(buffer, sizeof(buffer), "%.*e", precision, value);
+            if (single ? strtof(buffer, 0) == static_cast<float>(value) : strtod(buffer, 0) == value)
+                break;
         }
 
-        // If we're parsing an object and the target type has a container info, this is a dictionary
-        if (type != nullptr && type->ci != nullptr)
+        // Collect the digits either side of the decimal point, which is written for the current locale
+        const char* c = buffer;
+        nb_digits = 0;
+        for ( ; *c != 'e'; c++)
         {
-            ParserDictionary(ctx, t, object, type, transient_flags);
+            if (*c >= '0' && *c <= '9')
+                digits[nb_digits++] = *c;
         }
-        else
+
+        // Read the exponent, adjusted to be relative to the last digit
+        bool negative = *++c == '-';
+        exponent = 0;
+        while (*++c != 0)
+            exponent = exponent * 10 + (*c - '0');
+        exponent = (negative ? -exponent : exponent) - (nb_digits - 1);
+    }
+
+    // Writes the shortest decimal that reads back as the given value, returning the number of characters
+    int FormatDecimal(char* dest, double value, bool single)
+    {
+        char* out = dest;
+        union { double d; clcpp::uint64 u; } bits = { value };
+        if (bits.u >> 63)
         {
-            ParserMembers(ctx, t, object, type, transient_flags);
+            *out++ = '-';
+            value = -value;
         }
 
-        if (type != nullptr && type->kind == clcpp::Primitive::KIND_CLASS)
-        {
-            const clcpp::Class* class_type = type->AsClass();
+        // Digits are valued digits * 10^exponent
+        char digits[20];
+        int nb_digits = 1, exponent = 0;
+        digits[0] = '0';
+        if (value != 0 && !Grisu3(value, single, digits, nb_digits, exponent))
+            PrintShortest(value, single, digits, nb_digits, exponent);
+
+        // Use plain notation where that isn't excessively long, always keeping a decimal point
+        int point = nb_digits + exponent;
+        if (point > 0 && point <= 21)
+        {
+            for (int i = 0; i < point; i++)
+                *out++ = i < nb_digits ? digits[i] : '0';
+            *out++ = '.';
+            if (point >= nb_digits)
+                *out++ = '0';
+            for (int i = point; i < nb_digits; i++)
+                *out++ = digits[i];
+        }
+        else if (point <= 0 && point > -6)
+        {
+            *out++ = '0';
+            *out++ = '.';
+            for (int i = point; i < 0; i++)
+                *out++ = '0';
+            for (int i = 0; i < nb_digits; i++)
+                *out++ = digits[i];
+        }
 
-            // Run any attached post-load functions
-            if ((class_type->flag_attributes & attrFlag_PostLoad) != 0)
+        // Otherwise use scientific notation with one digit before the decimal point
+        else
+        {
+            *out++ = digits[0];
+            if (nb_digits > 1)
             {
-                static unsigned int hash = clcpp::internal::HashNameString("post_load");
-                if (const clcpp::Attribute* attr = clcpp::FindPrimitive(class_type->attributes, hash))
-                {
-                    const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
-                    if (name_attr->primitive != nullptr)
-                    {
-                        clcpp::CallFunction(static_cast<const clcpp::Function*>(name_attr->primitive), object);
-                    }
-                }
+                *out++ = '.';
+                for (int i = 1; i < nb_digits; i++)
+                    *out++ = digits[i];
+            }
+            *out++ = 'e';
+            int e = point - 1;
+            if (e < 0)
+            {
+                *out++ = '-';
+                e = -e;
             }
+            char e_digits[4];
+            int nb_e_digits = 0;
+            do
+            {
+                e_digits[nb_e_digits++] = static_cast<char>('0' + e % 10);
+                e /= 10;
+            } while (e != 0);
+            while (nb_e_digits)
+                *out++ = e_digits[--nb_e_digits];
         }
-    }
-}
-
-CLCPP_API clutl::JSONError clutl::LoadJSON(ReadBuffer& in, void* object, const clcpp::Type* type, unsigned int transient_flags)
-{
-    SetupTypeDispatchLUT();
-    clutl::JSONContext ctx(in);
-    clutl::JSONToken t = LexerNextToken(ctx);
-    ParserObject(ctx, t, static_cast<char*>(object), type, transient_flags);
-    return ctx.GetError();
-}
 
-CLCPP_API clutl::JSONError clutl::LoadJSON(clutl::JSONContext& ctx, void* object, const clcpp::Field* field,
-                                           unsigned int transient_flags)
-{
-    SetupTypeDispatchLUT();
-    clutl::JSONToken t = LexerNextToken(ctx);
-    ParserValue(ctx, t, static_cast<char*>(object), field->type, field->qualifier.op, field, transient_flags);
-    return ctx.GetError();
-}
+        return static_cast<int>(out - dest);
+    }
 
-namespace
-{
     // ----------------------------------------------------------------------------------------------------
     // JSON text writer using reflected objects
     // ----------------------------------------------------------------------------------------------------
@@ -690,29 +2539,31 @@ namespace
         SaveHexInteger(out, *reinterpret_cast<const TYPE*>(object));
     }
 
-    void SaveDecimal(clutl::WriteBuffer& out, double decimal, unsigned int flags)
+    void SaveDecimal(clutl::WriteBuffer& out, double decimal, bool single, unsigned int flags)
     {
-        if ((flags & clutl::JSONFlags::EMIT_HEX_FLOATS) != 0)
+        // JSON has no representation of infinity or NaN so fall back to hex for them
+        union { double d; clcpp::uint64 u; } bits = { decimal };
+        if ((flags & clutl::JSONFlags::EMIT_HEX_FLOATS) != 0 || (bits.u & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL)
         {
             // Use a specific prefix to inform the lexer to alias as a decimal
             out.WriteStr("0d");
-            SaveHexInteger(out, reinterpret_cast<clcpp::uint64&>(decimal));
+            SaveHexInteger(out, bits.u);
             return;
         }
 
-        // Serialise full float rep
-        char float_buffer[512];
-        int count = snprintf(float_buffer, sizeof(float_buffer), "%f", decimal);
+        // Serialise the shortest decimal that reads back as the same value, at the precision it was stored
+        char float_buffer[32];
+        int count = FormatDecimal(float_buffer, decimal, single);
         out.Write(float_buffer, count);
     }
 
     void SaveDouble(clutl::WriteBuffer& out, const char* object, unsigned int flags)
     {
-        SaveDecimal(out, *reinterpret_cast<const double*>(object), flags);
+        SaveDecimal(out, *reinterpret_cast<const double*>(object), false, flags);
     }
     void SaveFloat(clutl::WriteBuffer& out, const char* object, unsigned int flags)
     {
-        SaveDecimal(out, *reinterpret_cast<const float*>(object), flags);
+        SaveDecimal(out, *reinterpret_cast<const float*>(object), true, flags);
     }
 
     void SaveType(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type, unsigned int flags)
@@ -814,6 +2665,17 @@ namespace
 
         out.WriteChar(reader.m_KeyType != nullptr ? '{' : '[');
 
+        // Unmappable pointers are skipped so the length is only known up-front for arrays of values
+        if ((flags & clutl::JSONFlags::EMIT_ARRAY_LENGTHS) != 0 && reader.m_KeyType == nullptr && !reader.m_ValueIsPtr)
+        {
+            out.WriteChar('#');
+            SaveUnsignedInteger(out, reader.m_Count);
+            if (reader.m_Count != 0)
+            {
+                out.WriteChar(',');
+            }
+        }
+
         // Save comma-separated objects
         bool written = false;
         for (unsigned int i = 0; i < reader.m_Count; i++)
@@ -1087,7 +2949,7 @@ namespace
                     SaveInteger(out, token.val.integer);
                     break;
                 case clutl::JSON_TOKEN_DECIMAL:
-                    SaveDecimal(out, token.val.decimal, flags);
+                    SaveDecimal(out, token.val.decimal, false, flags);
                     break;
                 default:
                     clcpp::internal::Assert(false && "Invalid token output type");
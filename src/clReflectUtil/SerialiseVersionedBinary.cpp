@@ -155,183 +155,348 @@ namespace
         unsigned int valueTypeSize;
     };
 
-    void SaveObject(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type);
-    void LoadObject(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size, unsigned int type_hash);
+    void LoadObject(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size, unsigned int type_hash,
+                    clutl::SerialisePlanCache& plans);
 
-    void SaveType(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type)
+    //
+    // A single plan instruction, with operands relative to the start of the object being saved
+    //
+    struct PlanOp
     {
-        out.Write(object, type->size);
+        enum Code
+        {
+            // Copy size bytes of a built-in type from offset
+            WRITE,
+
+            // Write the name hash of the enum constant at offset
+            WRITE_ENUM,
+
+            // Write a chunk header for the field with type hash and name hash, recording where its data size
+            // needs patching in the slot for the chunk's depth
+            BEGIN_CHUNK,
+
+            // Patch the data size of the last chunk started at depth
+            END_CHUNK,
+
+            // Call a custom save function with the object and the field at offset
+            CALL_SAVE,
+
+            // Save a C-array field or a container at offset
+            FIELD_ARRAY,
+            CONTAINER,
+
+            // Execute the plan for a class at offset that's nested too deeply to be inlined
+            OBJECT,
+        };
+
+        Code code;
+
+        // Offset of the value, or chunk depth
+        unsigned int offset;
+
+        // Byte size, type hash or offset of the object passed to custom save functions
+        unsigned int a;
+
+        // Name hash
+        unsigned int b;
+
+        // Enum, function, field or type
+        const void* data;
+    };
+
+    // Deeper nesting of classes is split into separate plans
+    const unsigned int MAX_CHUNK_DEPTH = 32;
+
+    void EmitOp(clutl::WriteBuffer& ops, PlanOp::Code code, unsigned int offset, unsigned int a, unsigned int b, const void* data)
+    {
+        PlanOp* op = static_cast<PlanOp*>(ops.Alloc(sizeof(PlanOp)));
+        op->code = code;
+        op->offset = offset;
+        op->a = a;
+        op->b = b;
+        op->data = data;
     }
 
-    void SaveEnum(clutl::WriteBuffer& out, const char* object, const clcpp::Enum* enum_type)
+    void CompileClass(clutl::WriteBuffer& ops, const clcpp::Class* class_type, unsigned int offset, unsigned int depth,
+                      unsigned int transient_flags);
+
+    void CompileObject(clutl::WriteBuffer& ops, const clcpp::Type* type, unsigned int offset, unsigned int depth,
+                       unsigned int transient_flags)
     {
-        // Do a linear search for an enum with a matching value
-        // TODO: Optimise this to a binary search by storing sorted enum values?
-        //       They're currently sorted by name...
-        int value = *(int*)object;
-        clcpp::Name enum_name;
-        for (unsigned int i = 0; i < enum_type->constants.size; i++)
+        if (type->ci != nullptr)
         {
-            if (enum_type->constants[i]->value == value)
+            EmitOp(ops, PlanOp::CONTAINER, offset, 0, 0, type);
+            return;
+        }
+
+        // Decide how to save based on kind
+        switch (type->kind)
+        {
+        case (clcpp::Primitive::KIND_TYPE):
+            EmitOp(ops, PlanOp::WRITE, offset, type->size, 0, nullptr);
+            break;
+
+        case (clcpp::Primitive::KIND_ENUM):
+            EmitOp(ops, PlanOp::WRITE_ENUM, offset, 0, 0, type);
+            break;
+
+        case (clcpp::Primitive::KIND_CLASS):
+            if (depth < MAX_CHUNK_DEPTH)
             {
-                enum_name = enum_type->constants[i]->name;
-                break;
+                CompileClass(ops, type->AsClass(), offset, depth, transient_flags);
             }
-        }
+            else
+            {
+                EmitOp(ops, PlanOp::OBJECT, offset, 0, 0, type);
+            }
+            break;
 
-        // TODO: What if a match can't be found?
+        case (clcpp::Primitive::KIND_TEMPLATE_TYPE):
+            EmitOp(ops, PlanOp::CONTAINER, offset, 0, 0, type);
+            break;
 
-        // Write the name's has as the value
-        out.Write(&enum_name.hash, sizeof(enum_name.hash));
+        default:
+            clcpp::internal::Assert(false && "Invalid primitive kind for type");
+        }
     }
 
-    void SaveContainer(clutl::WriteBuffer& out, clcpp::ReadIterator& reader)
+    void CompileClass(clutl::WriteBuffer& ops, const clcpp::Class* class_type, unsigned int offset, unsigned int depth,
+                      unsigned int transient_flags)
     {
-        // Add the container header
-        ContainerChunkHeader header(out, reader);
-
-        for (unsigned int i = 0; i < reader.m_Count; i++)
+        // Skip transient classes
+        if ((class_type->flag_attributes & transient_flags) != 0)
         {
-            clcpp::ContainerKeyValue kv = reader.GetKeyValue();
+            return;
+        }
 
-            // Write the key value
-            if (reader.m_KeyType != nullptr)
+        // Save each field in the class within its own chunk
+        const clcpp::CArray<const clcpp::Field*>& fields = class_type->fields;
+        for (unsigned int i = 0; i < fields.size; i++)
+        {
+            const clcpp::Field* field = fields[i];
+            if ((field->flag_attributes & transient_flags) != 0)
             {
-                // TODO(don): Support for pointer keys
-                SaveObject(out, static_cast<const char*>(kv.key), reader.m_KeyType);
+                continue;
             }
 
-            // If this is a value that could have variable data written, store a size next to it
-            SizeBackPatcher patcher;
-            if (header.valueTypeSize == 0)
+            EmitOp(ops, PlanOp::BEGIN_CHUNK, depth, field->type->name.hash, field->name.hash, nullptr);
+            unsigned int field_offset = offset + field->offset;
+
+            // Is there a custom save function for this field?
+            // TODO: Flag for marking custom saves on a field
+            const clcpp::Attribute* attr = nullptr;
+            if (field->attributes.size != 0)
             {
-                patcher.Mark(out);
+                static unsigned int hash = clcpp::internal::HashNameString("save_vbin");
+                attr = clcpp::FindPrimitive(field->attributes, hash);
             }
 
-            if (reader.m_ValueIsPtr)
+            // ContainerInfos for fields can only be C-Arrays
+            if (attr != nullptr)
             {
-                // Ask the user if they want to save this pointer
-                // void* ptr = *(void**)kv.value;
-                // if (ptr_save == 0 || !ptr_save->CanMapPtr(ptr, field, reader.m_ValueType))
-                //	continue;
-
-                // SavePtr(out, kv.value, ptr_save, flags);
+                EmitOp(ops, PlanOp::CALL_SAVE, field_offset, offset, 0, attr->AsPrimitiveAttribute()->primitive);
+            }
+            else if (field->ci != nullptr)
+            {
+                EmitOp(ops, PlanOp::FIELD_ARRAY, field_offset, 0, 0, field);
             }
             else
             {
-                SaveObject(out, (char*)kv.value, reader.m_ValueType);
+                CompileObject(ops, field->type, field_offset, depth + 1, transient_flags);
             }
 
-            // Patch any accompanying sizes
-            patcher.Patch(out);
+            EmitOp(ops, PlanOp::END_CHUNK, depth, 0, 0, nullptr);
+        }
 
-            reader.MoveNext();
+        // Inline base types, which share the same object address
+        for (unsigned int i = 0; i < class_type->base_types.size; i++)
+        {
+            const clcpp::Type* base_type = class_type->base_types[i];
+            CompileClass(ops, base_type->AsClass(), offset, depth, transient_flags);
         }
     }
 
-    void SaveFieldArray(clutl::WriteBuffer& out, const char* object, const clcpp::Field* field)
+    //
+    // A field that can be loaded into an object of a plan's class type
+    //
+    struct PlanField
     {
-        // Construct a read iterator and serialise as container
-        clcpp::ReadIterator reader;
-        reader.Initialise(field, object);
-        SaveContainer(out, reader);
-    }
+        // Field name hash, as written in the chunk header
+        unsigned int name_hash;
 
-    void SaveClassField(clutl::WriteBuffer& out, const char* object, const char* field_object, const clcpp::Field* field)
+        const clcpp::Field* field;
+
+        // Custom load function for the field, if it has one
+        const clcpp::Function* load_function;
+    };
+
+    void AddPlanField(clutl::WriteBuffer& fields, const clcpp::Field* field)
     {
-        if ((field->flag_attributes & attrFlag_Transient) != 0)
-        {
-            return;
+        // Find where the field goes in the table, sorted by name hash. A field hides any base class
+        // field of the same name, which is added after it.
+        PlanField* begin = (PlanField*)fields.GetData();
+        PlanField* end = begin + fields.GetBytesWritten() / sizeof(PlanField);
+        PlanField* insert = end;
+        while (insert != begin && insert[-1].name_hash >= field->name.hash)
+        {
+            if (insert[-1].name_hash == field->name.hash)
+            {
+                return;
+            }
+            insert--;
         }
+        unsigned int index = (unsigned int)(insert - begin);
 
-        ChunkHeaderWriter header_writer(out, field->type->name.hash, field->name.hash);
-
-        // Is there a custom save function for this field?
-        // TODO: Flag for marking custom saves on a field
+        // Is there a custom load function for this field?
+        // TODO: Flag for marking custom loads on a field
+        const clcpp::Function* load_function = nullptr;
         if (field->attributes.size != 0)
         {
-            static unsigned int hash = clcpp::internal::HashNameString("save_vbin");
+            static unsigned int hash = clcpp::internal::HashNameString("load_vbin");
             if (const clcpp::Attribute* attr = clcpp::FindPrimitive(field->attributes, hash))
             {
-                // Call the function to write data
-                const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
-                clcpp::CallFunction((clcpp::Function*)name_attr->primitive, clcpp::ByRef(out), object, field_object);
-                return;
+                load_function = (const clcpp::Function*)attr->AsPrimitiveAttribute()->primitive;
             }
         }
 
-        // ContainerInfos for fields can only be C-Arrays
-        if (field->ci != nullptr)
-        {
-            SaveFieldArray(out, field_object, field);
-        }
-        else
+        // Shift everything after the insertion point up, allocating first as it may move the table
+        fields.Alloc(sizeof(PlanField));
+        PlanField* table = (PlanField*)fields.GetData();
+        unsigned int count = fields.GetBytesWritten() / sizeof(PlanField);
+        for (unsigned int i = count - 1; i > index; i--)
         {
-            SaveObject(out, field_object, field->type);
+            table[i] = table[i - 1];
         }
+        table[index].name_hash = field->name.hash;
+        table[index].field = field;
+        table[index].load_function = load_function;
     }
 
-    void SaveClass(clutl::WriteBuffer& out, const char* object, const clcpp::Class* class_type)
+    void CompileFields(clutl::WriteBuffer& fields, const clcpp::Class* class_type, unsigned int transient_flags)
     {
-        // Skip transient classes
-        if ((class_type->flag_attributes & attrFlag_Transient) != 0)
+        // Transient fields are left out so that their chunks are skipped
+        for (unsigned int i = 0; i < class_type->fields.size; i++)
         {
-            return;
+            const clcpp::Field* field = class_type->fields[i];
+            if ((field->flag_attributes & transient_flags) == 0)
+            {
+                AddPlanField(fields, field);
+            }
         }
 
-        // Save each field in the class
-        const clcpp::CArray<const clcpp::Field*>& fields = class_type->fields;
-        for (unsigned int i = 0; i < fields.size; i++)
+        // Base types share the same object address
+        for (unsigned int i = 0; i < class_type->base_types.size; i++)
         {
-            const clcpp::Field* field = fields[i];
-            const char* field_object = object + field->offset;
-            SaveClassField(out, object, field_object, field);
+            CompileFields(fields, class_type->base_types[i]->AsClass(), transient_flags);
         }
+    }
 
-        // Recurse into base types
-        for (unsigned int i = 0; i < class_type->base_types.size; i++)
-        {
-            const clcpp::Type* base_type = class_type->base_types[i];
-            SaveClass(out, object, base_type->AsClass());
+    const PlanField* FindPlanField(const clutl::WriteBuffer& fields, unsigned int name_hash)
+    {
+        // Binary search the sorted table
+        const PlanField* table = (const PlanField*)fields.GetData();
+        int first = 0;
+        int last = fields.GetBytesWritten() / sizeof(PlanField) - 1;
+        while (first <= last)
+        {
+            int mid = (first + last) / 2;
+            unsigned int mid_hash = table[mid].name_hash;
+            if (mid_hash < name_hash)
+            {
+                first = mid + 1;
+            }
+            else if (mid_hash > name_hash)
+            {
+                last = mid - 1;
+            }
+            else
+            {
+                return table + mid;
+            }
         }
+
+        return nullptr;
     }
 
-    void SaveContainer(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type)
+    void SaveEnum(clutl::WriteBuffer& out, const char* object, const clcpp::Enum* enum_type)
     {
-        clcpp::ReadIterator reader;
-        reader.Initialise(type, object);
-        SaveContainer(out, reader);
+        // Do a linear search for an enum with a matching value
+        // TODO: Optimise this to a binary search by storing sorted enum values?
+        //       They're currently sorted by name...
+        int value = *(int*)object;
+        clcpp::Name enum_name;
+        for (unsigned int i = 0; i < enum_type->constants.size; i++)
+        {
+            if (enum_type->constants[i]->value == value)
+            {
+                enum_name = enum_type->constants[i]->name;
+                break;
+            }
+        }
+
+        // TODO: What if a match can't be found?
+
+        // Write the name's has as the value
+        out.Write(&enum_name.hash, sizeof(enum_name.hash));
     }
 
-    void SaveObject(clutl::WriteBuffer& out, const char* object, const clcpp::Type* type)
+    void SaveContainer(clutl::WriteBuffer& out, clcpp::ReadIterator& reader, clutl::SerialisePlanCache& plans,
+                       unsigned int transient_flags)
     {
-        if (type->ci != nullptr)
+        // Add the container header
+        ContainerChunkHeader header(out, reader);
+
+        // Get the plans for saving keys and values once for all entries
+        const clutl::SerialisePlan* key_plan = nullptr;
+        const clutl::SerialisePlan* value_plan = nullptr;
+        if (reader.m_Count != 0)
         {
-            SaveContainer(out, object, type);
-            return;
+            if (reader.m_KeyType != nullptr)
+            {
+                key_plan = plans.Get(reader.m_KeyType, transient_flags);
+            }
+            if (!reader.m_ValueIsPtr)
+            {
+                value_plan = plans.Get(reader.m_ValueType, transient_flags);
+            }
         }
 
-        // Dispatch to a save function based on kind
-        switch (type->kind)
+        for (unsigned int i = 0; i < reader.m_Count; i++)
         {
-        case (clcpp::Primitive::KIND_TYPE):
-            SaveType(out, object, type);
-            break;
+            clcpp::ContainerKeyValue kv = reader.GetKeyValue();
 
-        case (clcpp::Primitive::KIND_ENUM):
-            SaveEnum(out, object, type->AsEnum());
-            break;
+            // Write the key value
+            if (reader.m_KeyType != nullptr)
+            {
+                // TODO(don): Support for pointer keys
+                key_plan->Save(out, kv.key, plans);
+            }
 
-        case (clcpp::Primitive::KIND_CLASS):
-            SaveClass(out, object, type->AsClass());
-            break;
+            // If this is a value that could have variable data written, store a size next to it
+            SizeBackPatcher patcher;
+            if (header.valueTypeSize == 0)
+            {
+                patcher.Mark(out);
+            }
 
-        case (clcpp::Primitive::KIND_TEMPLATE_TYPE):
-            SaveContainer(out, object, type);
-            break;
+            if (reader.m_ValueIsPtr)
+            {
+                // Ask the user if they want to save this pointer
+                // void* ptr = *(void**)kv.value;
+                // if (ptr_save == 0 || !ptr_save->CanMapPtr(ptr, field, reader.m_ValueType))
+                //	continue;
 
-        default:
-            clcpp::internal::Assert(false && "Invalid primitive kind for type");
+                // SavePtr(out, kv.value, ptr_save, flags);
+            }
+            else
+            {
+                value_plan->Save(out, kv.value, plans);
+            }
+
+            // Patch any accompanying sizes
+            patcher.Patch(out);
+
+            reader.MoveNext();
         }
     }
 
@@ -369,7 +534,8 @@ namespace
             *(int*)object = constant->value;
     }
 
-    void LoadContainer(clutl::ReadBuffer& in, clcpp::WriteIterator& writer, unsigned int data_size, unsigned int expected_count)
+    void LoadContainer(clutl::ReadBuffer& in, clcpp::WriteIterator& writer, unsigned int data_size, unsigned int expected_count,
+                       clutl::SerialisePlanCache& plans)
     {
         unsigned int end_pos = in.GetBytesRead() + data_size;
 
@@ -406,7 +572,7 @@ namespace
                 // Load the key value onto the stack
                 char key_data[128];
                 clcpp::internal::Assert(writer.m_KeyType->size < sizeof(key_data));
-                LoadObject(in, key_data, writer.m_KeyType, header.keyTypeSize, header.keyTypeHash);
+                LoadObject(in, key_data, writer.m_KeyType, header.keyTypeSize, header.keyTypeHash, plans);
 
                 // Allocate space for the new data with its key
                 value_data = static_cast<char*>(writer.AddEmpty(key_data));
@@ -434,7 +600,7 @@ namespace
             }
             else
             {
-                LoadObject(in, value_data, writer.m_ValueType, value_type_size, writer.m_ValueType->name.hash);
+                LoadObject(in, value_data, writer.m_ValueType, value_type_size, writer.m_ValueType->name.hash, plans);
             }
         }
 
@@ -460,114 +626,71 @@ namespace
         }
     }
 
-    void LoadFieldArray(clutl::ReadBuffer& in, char* object, const clcpp::Field* field, unsigned int data_size)
+    void LoadFieldArray(clutl::ReadBuffer& in, char* object, const clcpp::Field* field, unsigned int data_size,
+                        clutl::SerialisePlanCache& plans)
     {
         // Create an array write iterator
         clcpp::WriteIterator writer;
         writer.Initialise(field, object);
-        LoadContainer(in, writer, data_size, field->ci->count);
+        LoadContainer(in, writer, data_size, field->ci->count, plans);
     }
 
-    const clcpp::Field* FindFieldsRecursive(const clcpp::Class* type, unsigned int hash)
+    void LoadClassField(clutl::ReadBuffer& in, char* object, const PlanField& plan_field, const ChunkHeader& header,
+                        clutl::SerialisePlanCache& plans)
     {
-        // Check fields of this class
-        if (const clcpp::Field* field = clcpp::FindPrimitive(type->fields, hash))
-        {
-            return field;
-        }
+        const clcpp::Field* field = plan_field.field;
+        char* field_object = object + field->offset;
 
-        // Search up through the inheritance hierarchy
-        for (unsigned int i = 0; i < type->base_types.size; i++)
+        if (plan_field.load_function != nullptr)
         {
-            if (const clcpp::Field* field = FindFieldsRecursive(type->base_types[i]->AsClass(), hash))
-            {
-                return field;
-            }
-        }
-
-        return nullptr;
-    }
+            int end_pos = in.GetBytesRead() + header.data_size;
 
-    void LoadClassField(clutl::ReadBuffer& in, char* object, const clcpp::Class* class_type)
-    {
-        // Read the header and skip the chunk if the field doesn't exist or its destination is transient
-        ChunkHeader header(in);
-        const clcpp::Field* field = FindFieldsRecursive(class_type, header.name_hash);
-        if (field == nullptr || (field->flag_attributes & attrFlag_Transient) != 0)
-        {
-            in.SeekRel(header.data_size);
-            return;
-        }
-        char* field_object = object + field->offset;
+            // Call the function to read the data
+            clcpp::CallFunction(plan_field.load_function, clcpp::ByRef(in), object, field_object);
 
-        // Is there a custom load function for this field?
-        // TODO: Flag for marking custom loads on a field
-        if (field->attributes.size != 0)
-        {
-            static unsigned int hash = clcpp::internal::HashNameString("load_vbin");
-            if (const clcpp::Attribute* attr = clcpp::FindPrimitive(field->attributes, hash))
+            // Correct any read errors in the custom function
+            int position = in.GetBytesRead();
+            if (position < end_pos)
             {
-                int end_pos = in.GetBytesRead() + header.data_size;
-
-                // Call the function to read the data
-                const clcpp::PrimitiveAttribute* name_attr = attr->AsPrimitiveAttribute();
-                clcpp::CallFunction((clcpp::Function*)name_attr->primitive, clcpp::ByRef(in), object, field_object);
-
-                // Correct any read errors in the custom function
-                int position = in.GetBytesRead();
-                if (position < end_pos)
-                {
-                    // TODO: Warning, not enough data read by custom reader
-                    in.SeekRel(end_pos - position);
-                }
-                else if (position > end_pos)
-                {
-                    // TODO: Warning, too much data read by custom reader
-                    in.SeekRel(end_pos - position);
-                }
-
-                return;
+                // TODO: Warning, not enough data read by custom reader
+                in.SeekRel(end_pos - position);
+            }
+            else if (position > end_pos)
+            {
+                // TODO: Warning, too much data read by custom reader
+                in.SeekRel(end_pos - position);
             }
         }
 
-        if (field->ci != nullptr)
+        else if (field->ci != nullptr)
         {
             // TODO: What happens if counts differ?
-            LoadFieldArray(in, field_object, field, header.data_size);
+            LoadFieldArray(in, field_object, field, header.data_size, plans);
         }
         else
         {
-            LoadObject(in, field_object, field->type, header.data_size, header.type_hash);
+            LoadObject(in, field_object, field->type, header.data_size, header.type_hash, plans);
         }
     }
 
-    void LoadContainer(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size);
+    void LoadContainer(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size,
+                       clutl::SerialisePlanCache& plans);
 
-    void LoadClass(clutl::ReadBuffer& in, char* object, const clcpp::Class* class_type, unsigned int data_size)
+    void LoadClass(clutl::ReadBuffer& in, char* object, const clcpp::Class* class_type, unsigned int data_size,
+                   clutl::SerialisePlanCache& plans)
     {
-        unsigned int end_pos = in.GetBytesRead() + data_size;
-
-        if (class_type != nullptr && class_type->ci != nullptr)
+        if (class_type->ci != nullptr)
         {
-            LoadContainer(in, object, class_type, data_size);
+            LoadContainer(in, object, class_type, data_size, plans);
         }
         else
         {
-            // Loop until all the data for this class has been read
-            while (in.GetBytesRead() < end_pos)
-            {
-                LoadClassField(in, object, class_type);
-            }
-        }
-
-        if (in.GetBytesRead() != end_pos)
-        {
-            // TODO: Error! More than an internal error, as long as custom fields are read correctly
-            // TODO: Check custom field reads
+            plans.Get(class_type, attrFlag_Transient)->Load(in, object, data_size, plans);
         }
     }
 
-    void LoadContainer(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size)
+    void LoadContainer(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size,
+                       clutl::SerialisePlanCache& plans)
     {
         // Get count from the header
         unsigned int count = ContainerChunkHeader::PeekCount(in);
@@ -575,10 +698,11 @@ namespace
         // Create an array write iterator
         clcpp::WriteIterator writer;
         writer.Initialise(type, object, count);
-        LoadContainer(in, writer, data_size, count);
+        LoadContainer(in, writer, data_size, count, plans);
     }
 
-    void LoadObject(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size, unsigned int type_hash)
+    void LoadObject(clutl::ReadBuffer& in, char* object, const clcpp::Type* type, unsigned int data_size, unsigned int type_hash,
+                    clutl::SerialisePlanCache& plans)
     {
         // If the header type doesn't match the expected type, skip this object
         // TODO: If types are not equal, are they convertible?
@@ -599,11 +723,11 @@ namespace
             break;
 
         case (clcpp::Primitive::KIND_CLASS):
-            LoadClass(in, object, type->AsClass(), data_size);
+            LoadClass(in, object, type->AsClass(), data_size, plans);
             break;
 
         case (clcpp::Primitive::KIND_TEMPLATE_TYPE):
-            LoadContainer(in, object, type, data_size);
+            LoadContainer(in, object, type, data_size, plans);
             break;
 
         default:
@@ -613,16 +737,201 @@ namespace
     }
 }
 
+clutl::SerialisePlan::SerialisePlan(const clcpp::Type* type, unsigned int transient_flags)
+    : m_Type(type)
+    , m_TransientFlags(transient_flags)
+{
+    CompileObject(m_Ops, type, 0, 0, transient_flags);
+
+    // Only classes are loaded field by field
+    if (type->kind == clcpp::Primitive::KIND_CLASS && type->ci == nullptr)
+    {
+        CompileFields(m_Fields, type->AsClass(), transient_flags);
+    }
+}
+
+void clutl::SerialisePlan::Save(WriteBuffer& out, const void* object, SerialisePlanCache& plans) const
+{
+    const char* base = static_cast<const char*>(object);
+    const PlanOp* op = reinterpret_cast<const PlanOp*>(m_Ops.GetData());
+    const PlanOp* end = op + m_Ops.GetBytesWritten() / sizeof(PlanOp);
+
+    // Position of the data size of the chunk open at each depth
+    unsigned int chunk_sizes[MAX_CHUNK_DEPTH];
+
+    for (; op != end; op++)
+    {
+        switch (op->code)
+        {
+        case PlanOp::WRITE:
+            out.Write(base + op->offset, op->a);
+            break;
+
+        case PlanOp::WRITE_ENUM:
+            SaveEnum(out, base + op->offset, static_cast<const clcpp::Enum*>(op->data));
+            break;
+
+        case PlanOp::BEGIN_CHUNK: {
+            // Write the hashes with a zero data size for patching
+            unsigned int header[3] = { op->a, op->b, 0 };
+            out.Write(header, sizeof(header));
+            chunk_sizes[op->offset] = out.GetBytesWritten() - sizeof(unsigned int);
+            break;
+        }
+
+        case PlanOp::END_CHUNK: {
+            unsigned int size_offset = chunk_sizes[op->offset];
+            unsigned int* patch_size = (unsigned int*)(out.GetData() + size_offset);
+            *patch_size = out.GetBytesWritten() - (size_offset + sizeof(unsigned int));
+            break;
+        }
+
+        case PlanOp::CALL_SAVE:
+            // Call the function to write data
+            clcpp::CallFunction(static_cast<const clcpp::Function*>(op->data), clcpp::ByRef(out), base + op->a, base + op->offset);
+            break;
+
+        case PlanOp::FIELD_ARRAY: {
+            // Construct a read iterator and serialise as container
+            clcpp::ReadIterator reader;
+            reader.Initialise(static_cast<const clcpp::Field*>(op->data), base + op->offset);
+            SaveContainer(out, reader, plans, m_TransientFlags);
+            break;
+        }
+
+        case PlanOp::CONTAINER: {
+            clcpp::ReadIterator reader;
+            reader.Initialise(static_cast<const clcpp::Type*>(op->data), base + op->offset);
+            SaveContainer(out, reader, plans, m_TransientFlags);
+            break;
+        }
+
+        case PlanOp::OBJECT:
+            plans.Get(static_cast<const clcpp::Type*>(op->data), m_TransientFlags)->Save(out, base + op->offset, plans);
+            break;
+        }
+    }
+}
+
+void clutl::SerialisePlan::Load(ReadBuffer& in, void* object, unsigned int data_size, SerialisePlanCache& plans) const
+{
+    // Loop until all the data for this class has been read
+    unsigned int end_pos = in.GetBytesRead() + data_size;
+    while (in.GetBytesRead() < end_pos)
+    {
+        // Read the header and skip the chunk if the field doesn't exist or its destination is transient
+        ChunkHeader header(in);
+        const PlanField* field = FindPlanField(m_Fields, header.name_hash);
+        if (field == nullptr)
+        {
+            in.SeekRel(header.data_size);
+            continue;
+        }
+
+        LoadClassField(in, static_cast<char*>(object), *field, header, plans);
+    }
+
+    if (in.GetBytesRead() != end_pos)
+    {
+        // TODO: Error! More than an internal error, as long as custom fields are read correctly
+        // TODO: Check custom field reads
+    }
+}
+
+clutl::SerialisePlanCache::~SerialisePlanCache()
+{
+    Clear();
+    delete[] m_Plans;
+}
+
+const clutl::SerialisePlan* clutl::SerialisePlanCache::Get(const clcpp::Type* type, unsigned int transient_flags)
+{
+    // Keep the table at most half full
+    if ((m_Size + 1) * 2 > m_Capacity)
+    {
+        Grow();
+    }
+
+    unsigned int index = Index(type, transient_flags);
+    while (SerialisePlan* plan = m_Plans[index])
+    {
+        if (plan->GetType() == type && plan->GetTransientFlags() == transient_flags)
+        {
+            return plan;
+        }
+        index = (index + 1) & (m_Capacity - 1);
+    }
+
+    m_Plans[index] = new SerialisePlan(type, transient_flags);
+    m_Size++;
+    return m_Plans[index];
+}
+
+void clutl::SerialisePlanCache::Clear()
+{
+    for (unsigned int i = 0; i < m_Capacity; i++)
+    {
+        delete m_Plans[i];
+        m_Plans[i] = nullptr;
+    }
+    m_Size = 0;
+}
+
+unsigned int clutl::SerialisePlanCache::Index(const clcpp::Type* type, unsigned int transient_flags) const
+{
+    unsigned int hash = static_cast<unsigned int>(reinterpret_cast<clcpp::pointer_type>(type) >> 4);
+    return ((hash ^ transient_flags) * 0x9E3779B9) & (m_Capacity - 1);
+}
+
+void clutl::SerialisePlanCache::Grow()
+{
+    SerialisePlan** old_plans = m_Plans;
+    unsigned int old_capacity = m_Capacity;
+    m_Capacity = m_Capacity != 0 ? m_Capacity * 2 : 16;
+    m_Plans = new SerialisePlan*[m_Capacity];
+    for (unsigned int i = 0; i < m_Capacity; i++)
+    {
+        m_Plans[i] = nullptr;
+    }
+
+    // Reinsert all existing plans
+    for (unsigned int i = 0; i < old_capacity; i++)
+    {
+        if (SerialisePlan* plan = old_plans[i])
+        {
+            unsigned int index = Index(plan->GetType(), plan->GetTransientFlags());
+            while (m_Plans[index] != nullptr)
+            {
+                index = (index + 1) & (m_Capacity - 1);
+            }
+            m_Plans[index] = plan;
+        }
+    }
+    delete[] old_plans;
+}
+
 CLCPP_API void clutl::SaveVersionedBinary(WriteBuffer& out, const void* object, const clcpp::Type* type)
+{
+    SerialisePlanCache plans;
+    SaveVersionedBinary(out, object, type, plans);
+}
+
+CLCPP_API void clutl::SaveVersionedBinary(WriteBuffer& out, const void* object, const clcpp::Type* type, SerialisePlanCache& plans)
 {
     ChunkHeaderWriter header_writer(out, type->name.hash, 0);
-    SaveObject(out, (const char*)object, type);
+    plans.Get(type, attrFlag_Transient)->Save(out, object, plans);
 }
 
 CLCPP_API void clutl::LoadVersionedBinary(ReadBuffer& in, void* object, const clcpp::Type* type)
+{
+    SerialisePlanCache plans;
+    LoadVersionedBinary(in, object, type, plans);
+}
+
+CLCPP_API void clutl::LoadVersionedBinary(ReadBuffer& in, void* object, const clcpp::Type* type, SerialisePlanCache& plans)
 {
     ChunkHeader header(in);
-    LoadObject(in, (char*)object, type, header.data_size, header.type_hash);
+    LoadObject(in, (char*)object, type, header.data_size, header.type_hash, plans);
 
     // TODO: verify position
 }
\ No newline at end of file